@@ -7,10 +7,19 @@
  * - Displays time as HHMM on 7-segment display
  * - Decimal point on 100s digit flashes like a colon (seconds indicator)
  * - AP mode web interface for WiFi and preferences configuration
- * - Timezone configuration via Preferences with automatic DST handling
+ * - Named timezones (POSIX TZ rules) with automatic DST handling
  * - Version display at boot
  * - IP address scrolling in AP mode
  * - Improv WiFi provisioning via ESP Web Tools
+ * - No heap use in steady state: pages and settings live in static buffers,
+ *   and allocations are counted per subsystem (/heap, and hourly on serial)
+ * - Binary event log on serial (tools/clock_log.py), kept across resets
+ * - Live telemetry: UDP broadcast for many clocks, dashboard page fed by
+ *   Server-Sent Events (/dashboard)
+ * - Holdover: learned, temperature-dependent drift correction keeps time
+ *   while syncs are lost; a dot after the last digit shows it
+ * - Buttons on edge interrupts (ButtonInput/): presses aren't lost while the
+ *   loop is busy, and UP/DOWN repeat while held
  */
 
  #define FIRMWARE_VERSION "2.17"
@@ -20,50 +29,68 @@
 #include <HTTPClient.h>
 #include <ArduinoJson.h>
 #include <time.h>
+#include <sys/time.h>
+#include <esp_timer.h>
+#include <esp_system.h>
 #include <SPI.h>
 #include <Preferences.h>
 #include <string.h>
-#include <ImprovWiFiLibrary.h>
+#include <math.h>
+#include <sys/select.h>
+#include <atomic>
 #include "SevenSegmentDisplay/MAX7219Display.h"
 #include "SevenSegmentDisplay/MAX7219Display.cpp"
+#include "ButtonInput/ButtonInput.h"
+#include "spsc_ring.h"
+#include "event_log.h"
+#include "sntp_client.h"
+#include "timezones.h"
+#include "timezone_lookup.h"
+#include "wifi_scan_cache.h"
+#include "improv_serial.h"
+#include "ota_update.h"
 #include "web_pages.h"
+#include "heap_stats.h"
+#include "live_telemetry.h"
 
 // =============================================================================
 // ESP32-S3 USB CDC WORKAROUND
 // ESP32-S3 has a bug where Serial.available() doesn't reliably update.
 // This buffered wrapper uses event callbacks to capture incoming data.
 // =============================================================================
+
+// Improv packets are < 128 bytes; 256 leaves room for a burst while loop() is busy
+#ifndef IMPROV_RX_BUFFER_SIZE
+#define IMPROV_RX_BUFFER_SIZE 256
+#endif
+
 class BufferedHWCDC : public Stream {
 private:
-  uint8_t buffer[256];
-  volatile uint16_t head = 0;
-  volatile uint16_t tail = 0;
-  volatile uint16_t count = 0;
+  SpscRing<IMPROV_RX_BUFFER_SIZE> rx;
 
 public:
-  void feedByte(uint8_t byte) {
-    if (count < sizeof(buffer)) {
-      buffer[tail] = byte;
-      tail = (tail + 1) % sizeof(buffer);
-      count++;
-    }
+  // Producer side - only ever called from pumpSerialRx()
+  size_t feed(const uint8_t* data, size_t len) {
+    return rx.write(data, len);
   }
 
+  uint32_t overflows() const { return rx.overflows(); }
+  uint32_t highWater() const { return rx.highWater(); }
+
   virtual int available() override {
-    return count;
+    return rx.available();
   }
 
   virtual int read() override {
-    if (count == 0) return -1;
-    uint8_t byte = buffer[head];
-    head = (head + 1) % sizeof(buffer);
-    count--;
-    return byte;
+    return rx.read();
+  }
+
+  size_t read(uint8_t* out, size_t len) {
+    return rx.read(out, len);
   }
 
   virtual int peek() override {
-    if (count == 0) return -1;
-    return buffer[head];
+    return rx.peek();
   }
 
   virtual void flush() override {
@@ -85,21 +112,34 @@ public:
 
 BufferedHWCDC bufferedSerial;
 
+// Move everything the HW CDC driver has into the ring in bulk. Both the RX
+// event callback and the loop() fallback poll call this; the flag keeps it to
+// one producer at a time, which is what the lock-free ring requires.
+// Only LOG() here - Serial.printf() could block the RX path on the TX side.
+static void pumpSerialRx() {
+  static std::atomic<bool> pumping(false);
+  if (pumping.exchange(true, std::memory_order_acquire)) return;
+  
+  uint8_t chunk[64];
+  int pending;
+  while ((pending = Serial.available()) > 0) {
+    size_t got = Serial.read(chunk, min((size_t)pending, sizeof(chunk)));
+    if (got == 0) break;
+    if (bufferedSerial.feed(chunk, got) < got) {
+      LOG(RX_OVERFLOW, (unsigned long)bufferedSerial.overflows(), (unsigned long)bufferedSerial.highWater(),
+          (unsigned)IMPROV_RX_BUFFER_SIZE);
+    }
+  }
+  
+  pumping.store(false, std::memory_order_release);
+}
+
 // Event callback for ESP32-S3 USB CDC RX events
 // This is called by Serial.onEvent() when data arrives
 static void hwcdcEventCallback(void* arg, esp_event_base_t event_base, 
                                 int32_t event_id, void* event_data) {
   if (event_base == ARDUINO_HW_CDC_EVENTS && event_id == ARDUINO_HW_CDC_RX_EVENT) {
-    // Read all available bytes from Serial and feed to buffer
-    int count = 0;
-    while (Serial.available()) {
-      bufferedSerial.feedByte(Serial.read());
-      count++;
-    }
-    if (count > 0) {
-      Serial.printf("[EVENT] Fed %d bytes to buffer\n", count);
-      Serial.flush();
-    }
+    pumpSerialRx();
   }
 }
  
@@ -118,46 +158,94 @@ static void hwcdcEventCallback(void* arg, esp_event_base_t event_base,
 const int PIN_CS_DISP  = 11;
  
  // --- AP MODE CONFIGURATION ---
- String apSSID = "";  // Will be set dynamically using MAC address
+ char apSSID[24] = "";  // Will be set dynamically using MAC address
  const char* AP_PASSWORD = ""; // Open AP
  
  // --- NTP CONFIGURATION ---
- const char* ntpServer = "pool.ntp.org";
- long  gmtOffset_sec = 0;  // Will be loaded from Preferences
- int   daylightOffset_sec = 3600;  // Default 1 hour for DST
+ char ntpServers[SNTP_SERVERS_MAX_LEN] = SNTP_DEFAULT_SERVERS;  // Comma-separated, loaded from Preferences
+ LocalClock localClock;  // Zone loaded from Preferences ("tz_name")
+ 
+ // Auto-detected zones are looked up again after this long
+ #define TZ_LOOKUP_TTL_SEC      (30UL * 24 * 3600)
+ #define TZ_LOOKUP_RETRY_MS     60000UL
+ #define TZ_LOOKUP_MAX_RETRY_MS 3600000UL
  
 // --- OBJECTS ---
 MAX7219Display display(PIN_CS_DISP);
 Preferences preferences;
 WebServer server(80);
+WifiScanCache wifiNetworks;  // Background scans, shared by Improv and the config page
 // Use buffered wrapper instead of Serial directly to work around ESP32-S3 USB CDC bug
-ImprovWiFi improvSerial(&bufferedSerial);
+ImprovSerial improvSerial(bufferedSerial, wifiNetworks);
+SntpClient sntp;
+TimezoneLookup tzLookup;
+OtaUpdate otaUpdate;
+
+// --- BOOT SCREENS ---
+// Version splash, then "Conn" or "AP" for a second; played by display.update()
+static constexpr Keyframe VERSION_FRAMES[] = { keyframe(FIRMWARE_VERSION, 5000, 0x00, true) };
+static constexpr Keyframe CONN_FRAMES[] = { keyframe("Conn", 1000) };
+static constexpr Keyframe AP_FRAMES[] = { keyframe("AP", 1000) };
+static constexpr Animation VERSION_SPLASH = animation(VERSION_FRAMES);
+static constexpr Animation CONN_SCREEN = animation(CONN_FRAMES);
+static constexpr Animation AP_SCREEN = animation(AP_FRAMES);
  
 // --- STATE VARIABLES ---
 bool wifiConnected = false;
 bool timeSynced = false;
 bool apMode = false;
-unsigned long lastTimeUpdate = 0;
+volatile bool secondTick = false; // Set by the second-boundary timer, consumed by loop()
 int displayBrightness = 8; // 0-15, default medium
 bool use24Hour = true; // 24-hour format (true) or 12-hour format (false)
 bool showIPAddress = false; // Flag to show IP address twice after WiFi connects
 int ipDisplayCount = 0; // Count how many times IP has been displayed
 bool resetIPScrolling = false; // Flag to force reset IP scrolling state when transitioning from AP mode
-bool showingVersion = true; // Guard flag to prevent loop() from overwriting version display
-unsigned long versionStartTime = 0; // When version display started
+bool showingVersion = true; // Guard flag to prevent loop() from overwriting the boot screens
 bool showConnAfterVersion = false; // Flag to show "Conn" after version display
 bool showAPAfterVersion = false; // Flag to show "AP" after version display
-bool improvConnected = false; // Flag set when Improv WiFi successfully connects
 
 // Beep state variables (using LEDC instead of tone() to avoid timer conflicts)
 unsigned long beepEndTime = 0;
 bool beepActive = false;
+
+// Timezone lookup retry / TTL state
+unsigned long tzRetryAt = 0;        // 0 = no retry scheduled
+unsigned long tzRetryDelay = TZ_LOOKUP_RETRY_MS;
+unsigned long tzTtlCheckedAt = 0;   // 0 = not checked yet
+
+// Die temperature, for the drift model and telemetry
+#define CHIP_TEMP_MS 10000
+float chipTemperatureC = NAN;
+unsigned long chipTemperatureAt = 0;
+
+// Learned drift goes to flash at most this often
+#define DRIFT_SAVE_MS (6UL * 3600000UL)
+unsigned long driftSavedAt = 0;     // 0 = not saved this boot
+
+// Live telemetry: snapshot for the event stream and the broadcast; RSSI is
+// noisy, so read less often
+#define TELEMETRY_SNAPSHOT_MS 250
+#define TELEMETRY_SLOW_MS     10000
+TelemetrySnapshot telemetrySnapshot;
+unsigned long telemetrySnapshotAt = 0;
+unsigned long telemetrySlowAt = 0;
+
+// Heap report on serial
+#define HEAP_REPORT_MS 3600000UL
+unsigned long heapReportAt = 0;
+
+// Second-boundary display timer
+esp_timer_handle_t secondTimer = nullptr;
+TaskHandle_t loopTaskHandle = nullptr;
+uint32_t phaseSamples = 0;   // Renders since the last phase report
+int64_t phaseSumUs = 0;      // Sum of |phase error| over those renders
+int32_t phaseMaxUs = 0;      // Worst |phase error| over those renders
  
- // Button state tracking
- unsigned long lastButtonPress = 0;
- bool lastModeState = false;
- bool lastUpState = false;
- bool lastDownState = false;
+ // Buttons, debounced from their edge interrupts (see ButtonInput.h); added
+ // in this order in setup()
+ enum { BTN_MODE, BTN_UP, BTN_DOWN };
+ ButtonInput buttons;
+ bool brightnessChanged = false;   // Saved when UP/DOWN is let go
  
  // Forward declarations
  void handleButtons();
@@ -165,49 +253,46 @@ void handleRoot();
 void handleConfig();
 void handleSave();
 void handleFactoryReset();
+void handleUpdatePage();
+void handleUpdateUpload();
+void handleUpdateUploadDone();
+void handleUpdatePull();
+void handleHeap();
+void handleDashboard();
+void sendPage(int code, const WebPage& page);
+void copyArg(const char* name, char* out, size_t size);
+void reportHeap();
+void startWebServer();
+void startTelemetry();
+void pollTelemetry();
+void serviceSecondTick();
+void pollOtaUpdate();
 void startBeep(int frequency, int duration);
 void updateBeep();
 void beepBlocking(int frequency, int duration);
-bool detectTimezoneFromIP();
+void requestTimezoneLookup();
+void pollTimezoneLookup();
+void startSecondTimer();
+static void armSecondTimer();
+void renderTime();
+void applyTimezone();
+bool timezoneConfigured();
+void startTimeSync();
+void readChipTemperature();
+void loadDriftModel();
+void saveDriftModel();
+void onVersionSplashDone();
+void onBootScreenDone();
 
 // =============================================================================
-// IMPROV WIFI CALLBACKS - These are REQUIRED for Improv to work!
+// IMPROV WIFI CALLBACKS
 // =============================================================================
 
-// This function is called by the Improv library to actually connect to WiFi
-// WITHOUT THIS, Improv receives credentials but doesn't know how to use them!
-bool onImprovWiFiConnect(const char* ssid, const char* password) {
-  Serial.printf("Improv: Attempting to connect to SSID: %s\n", ssid);
-  Serial.flush();
-  
-  WiFi.mode(WIFI_STA);
-  WiFi.begin(ssid, password);
-  
-  // Wait for connection (up to 10 seconds)
-  int attempts = 0;
-  while (WiFi.status() != WL_CONNECTED && attempts < 20) {
-    delay(500);
-    Serial.print(".");
-    attempts++;
-  }
-  Serial.println();
-  
-  if (WiFi.status() == WL_CONNECTED) {
-    Serial.printf("Improv: Connected! IP: %s\n", WiFi.localIP().toString().c_str());
-    Serial.flush();
-    improvConnected = true;
-    return true;
-  } else {
-    Serial.println("Improv: Connection failed");
-    Serial.flush();
-    return false;
-  }
-}
-
-// This callback is called AFTER successful WiFi connection via Improv
-// Use this to save credentials and do post-connection setup
+// Called from improvSerial.handleSerial() once the network sent over Improv
+// has connected. ImprovSerial does the connecting itself, without blocking;
+// this saves the credentials and does post-connection setup.
 void onImprovWiFiConnected(const char* ssid, const char* password) {
-  Serial.printf("Improv: Saving credentials for SSID: %s\n", ssid);
+  LOG(IMPROV_SAVING, ssid);
   
   // Save WiFi credentials
   preferences.begin("wifi_config", false);
@@ -215,14 +300,10 @@ void onImprovWiFiConnected(const char* ssid, const char* password) {
   preferences.putString("password", password);
   preferences.end();
   
-  // Try to auto-detect timezone from IP geolocation if not already configured
-  preferences.begin("ntp_clock", false);
-  long savedTimezone = preferences.getLong("timezone", 0);
-  preferences.end();
-  
-  // Only auto-detect if timezone hasn't been manually configured (default is 0)
-  if (savedTimezone == 0) {
-    detectTimezoneFromIP();
+  // Only auto-detect the timezone from IP geolocation if it hasn't been configured.
+  // The lookup runs in the background so provisioning can answer immediately.
+  if (!timezoneConfigured()) {
+    requestTimezoneLookup();
   }
 }
 
@@ -234,6 +315,10 @@ void setup() {
   // Init Serial IMMEDIATELY - ESP32-S3 USB CDC needs this early
   Serial.begin(115200);
   
+  // Log records queue from here on; the drain task sends them once the port is up
+  eventLog.begin(logSerialSink);
+  LOG(BOOT, FIRMWARE_VERSION, (int)esp_reset_reason());
+  
   // CRITICAL: Wait for USB CDC to enumerate on ESP32-S3
   // This is necessary because USB CDC takes time to initialize after reboot
   unsigned long serialWaitStart = millis();
@@ -246,43 +331,34 @@ void setup() {
   // This captures incoming Serial data via events since Serial.available() is broken
   // With USB CDC on boot enabled (USBMode=hwcdc,CDCOnBoot=1 in build.yml), Serial is HWCDC
   Serial.onEvent(hwcdcEventCallback);
-  
-  Serial.println("\n\n=== NTP Clock v" FIRMWARE_VERSION " Starting ===");
-  Serial.println("HWCDC event handler registered");
-  Serial.flush();
+  heapStats.begin();
   
   // Initialize WiFi in STA mode early - Improv needs this
   WiFi.mode(WIFI_STA);
   delay(100);
   
   // Generate unique AP SSID using MAC address
-  String macAddress = WiFi.macAddress();
-  macAddress.replace(":", "");
-  String macSuffix = macAddress.substring(macAddress.length() - 6);
-  apSSID = "NTP_Clock_" + macSuffix;
+  uint8_t mac[6];
+  WiFi.macAddress(mac);
+  snprintf(apSSID, sizeof(apSSID), "NTP_Clock_%02X%02X%02X", mac[3], mac[4], mac[5]);
   
   // ==========================================================================
   // IMPROV WIFI SETUP - Must happen BEFORE any blocking operations
   // ==========================================================================
-  Serial.println("Setting up Improv WiFi...");
+  LOG(IMPROV_SETUP);
   
   // Configure device info
   improvSerial.setDeviceInfo(
-    ImprovTypes::ChipFamily::CF_ESP32_S3,
-    "NTP-Clock",           // Short device name
+    "NTP-Clock",           // Firmware name
     FIRMWARE_VERSION,      // Firmware version
-    "NTP Clock"            // Device description
+    "ESP32-S3",            // Chip
+    "NTP Clock"            // Device name
   );
   
-  // THIS IS THE KEY PART YOU WERE MISSING!
-  // Set the callback that actually performs the WiFi connection
-  improvSerial.setCustomConnectWiFi(onImprovWiFiConnect);
-  
-  // Set the callback for after successful connection (to save credentials)
-  improvSerial.onImprovConnected(onImprovWiFiConnected);
+  // Save credentials once an Improv connection attempt succeeds
+  improvSerial.onProvisioned(onImprovWiFiConnected);
   
-  Serial.println("Improv WiFi ready - waiting for provisioning...");
-  Serial.flush();
+  LOG(IMPROV_READY);
   
   // ==========================================================================
   // IMPROV GRACE PERIOD
@@ -295,14 +371,16 @@ void setup() {
   unsigned long improvStart = millis();
   unsigned long improvTimeout = 10000; // 10 seconds
   
-  while (millis() - improvStart < improvTimeout) {
+  // A connection attempt that starts late in the window is allowed to finish
+  while (millis() - improvStart < improvTimeout || improvSerial.isProvisioning()) {
     // Process Improv commands
     // The bufferedSerial wrapper now handles Serial input via event callbacks
     improvSerial.handleSerial();
+    wifiNetworks.poll(!improvSerial.isProvisioning());
     
     // If Improv connected us, we're done waiting
-    if (improvConnected || WiFi.status() == WL_CONNECTED) {
-      Serial.println("Improv WiFi connected during grace period!");
+    if (improvSerial.isProvisioned() || WiFi.status() == WL_CONNECTED) {
+      LOG(IMPROV_GRACE_WIFI);
       break;
     }
     
@@ -310,8 +388,7 @@ void setup() {
     delay(10);
   }
   
-  Serial.println("Improv grace period ended");
-  Serial.flush();
+  LOG(IMPROV_GRACE_ENDED);
   
   // ==========================================================================
   // HARDWARE INITIALIZATION
@@ -325,6 +402,10 @@ void setup() {
   pinMode(PIN_BTN_MODE, INPUT_PULLUP); 
   pinMode(PIN_BTN_UP,   INPUT_PULLUP);
   pinMode(PIN_BTN_DOWN, INPUT_PULLUP);
+  buttons.add(PIN_BTN_MODE);
+  buttons.add(PIN_BTN_UP, BUTTON_REPEATS);
+  buttons.add(PIN_BTN_DOWN, BUTTON_REPEATS);
+  buttons.begin();
   digitalWrite(PIN_BUZZER, LOW);
   
   SPI.begin(PIN_SPI_SCK, PIN_SPI_MISO, PIN_SPI_MOSI);
@@ -338,17 +419,21 @@ void setup() {
   preferences.begin("ntp_clock", false);
   displayBrightness = preferences.getInt("brightness", 8);
   use24Hour = preferences.getBool("24hour", true);
-  gmtOffset_sec = preferences.getLong("timezone", -28800);
-  daylightOffset_sec = preferences.getInt("dst_offset", 0);
+  loadPrefString(preferences, "ntp_servers", ntpServers, sizeof(ntpServers), SNTP_DEFAULT_SERVERS);
   preferences.end();
+  applyTimezone();
+  readChipTemperature();
+  loadDriftModel();
   
   display.setBrightness(displayBrightness);
   delay(50);
   
-  // Show version
+  // Drive time rendering from wall-clock second boundaries
+  startSecondTimer();
+  
+  // Show version - loop() plays it out and follows with "Conn" or "AP"
   showingVersion = true;
-  versionStartTime = millis();
-  display.displayText(FIRMWARE_VERSION, true);
+  display.play(VERSION_SPLASH, onVersionSplashDone);
   delay(100);
   
   // ==========================================================================
@@ -357,43 +442,33 @@ void setup() {
   
   if (WiFi.status() == WL_CONNECTED) {
     // Already connected via Improv
-    Serial.println("Using Improv WiFi connection");
+    LOG(WIFI_USING_IMPROV);
     wifiConnected = true;
     showConnAfterVersion = true;
     beepBlocking(2000, 100);
     
     // Setup web server
-    server.on("/", handleRoot);
-    server.on("/config", handleConfig);
-    server.on("/save", HTTP_POST, handleSave);
-    server.on("/factory-reset", HTTP_POST, handleFactoryReset);
-    server.begin();
+    startWebServer();
     
     showIPAddress = true;
     ipDisplayCount = 0;
-    lastTimeUpdate = 0;
+    secondTick = true;
     
-    // Configure NTP
-    configTime(gmtOffset_sec, daylightOffset_sec, ntpServer);
-    delay(1000);
-    struct tm timeinfo;
-    if (getLocalTime(&timeinfo)) {
-      timeSynced = true;
-      beepBlocking(2500, 50);
-      delay(100);
-      beepBlocking(3000, 50);
-    }
+    // Start NTP - loop() polls the client and beeps once the first sync lands
+    startTimeSync();
   } else {
     // Try saved credentials
     preferences.begin("wifi_config", false);
-    String savedSSID = preferences.getString("ssid", "");
-    String savedPassword = preferences.getString("password", "");
+    char savedSSID[33];
+    char savedPassword[65];
+    loadPrefString(preferences, "ssid", savedSSID, sizeof(savedSSID), "");
+    loadPrefString(preferences, "password", savedPassword, sizeof(savedPassword), "");
     preferences.end();
     
-    if (savedSSID.length() > 0) {
-      Serial.printf("Trying saved credentials: %s\n", savedSSID.c_str());
+    if (savedSSID[0] != '\0') {
+      LOG(WIFI_TRYING_SAVED, savedSSID);
       WiFi.mode(WIFI_STA);
-      WiFi.begin(savedSSID.c_str(), savedPassword.c_str());
+      WiFi.begin(savedSSID, savedPassword);
     
       int wifiAttempts = 0;
       while (WiFi.status() != WL_CONNECTED && wifiAttempts < 30) {
@@ -403,70 +478,50 @@ void setup() {
       }
     
       if (WiFi.status() == WL_CONNECTED) {
-        Serial.println("Connected to saved WiFi");
+        LOG(WIFI_CONNECTED_SAVED);
         wifiConnected = true;
         showConnAfterVersion = true;
         beepBlocking(2000, 100);
         
-        // Try to auto-detect timezone if not configured
-        preferences.begin("ntp_clock", false);
-        long savedTimezone = preferences.getLong("timezone", 0);
-        preferences.end();
-        
-        if (savedTimezone == 0) {
-          detectTimezoneFromIP();
-          preferences.begin("ntp_clock", false);
-          gmtOffset_sec = preferences.getLong("timezone", -28800);
-          daylightOffset_sec = preferences.getInt("dst_offset", 0);
-          preferences.end();
+        // Try to auto-detect timezone if not configured (in the background)
+        if (!timezoneConfigured()) {
+          requestTimezoneLookup();
         }
         
         // Setup web server
-        server.on("/", handleRoot);
-        server.on("/config", handleConfig);
-        server.on("/save", HTTP_POST, handleSave);
-        server.on("/factory-reset", HTTP_POST, handleFactoryReset);
-        server.begin();
+        startWebServer();
         
         showIPAddress = true;
         ipDisplayCount = 0;
-        lastTimeUpdate = 0;
+        secondTick = true;
         
-        // Configure NTP
-        configTime(gmtOffset_sec, daylightOffset_sec, ntpServer);
-        delay(1000);
-        struct tm timeinfo;
-        if (getLocalTime(&timeinfo)) {
-          timeSynced = true;
-          beepBlocking(2500, 50);
-          delay(100);
-          beepBlocking(3000, 50);
-        }
+        // Start NTP - loop() polls the client and beeps once the first sync lands
+        applyTimezone();
+        startTimeSync();
       }
     }
   }
   
   // If still not connected, start AP mode
   if (WiFi.status() != WL_CONNECTED) {
-    Serial.println("Starting AP mode");
+    LOG(WIFI_AP_START);
     apMode = true;
     showAPAfterVersion = true;
     
     WiFi.mode(WIFI_AP);
-    WiFi.softAP(apSSID.c_str(), AP_PASSWORD);
+    WiFi.softAP(apSSID, AP_PASSWORD);
     delay(500);
     
-    server.on("/", handleRoot);
-    server.on("/config", handleConfig);
-    server.on("/save", HTTP_POST, handleSave);
-    server.on("/factory-reset", HTTP_POST, handleFactoryReset);
-    server.begin();
+    startWebServer();
     
     beepBlocking(1500, 200);
   }
   
-  display.clear();
   delay(500);
+  
+  // Everything from here on should reuse what setup() allocated
+  heapStats.markSteady();
+  reportHeap();
 }
 
 // =============================================================================
@@ -477,48 +532,67 @@ void loop() {
   // FALLBACK: Always poll Serial directly as backup
   // This is a workaround for ESP32-S3 USB CDC Serial.available() bug
   // Even with event handler, polling ensures we don't miss data
-  static unsigned long lastPollDebug = 0;
-  if (Serial.available() > 0) {
-    int pollCount = 0;
-    while (Serial.available()) {
-      bufferedSerial.feedByte(Serial.read());
-      pollCount++;
-    }
-    if (millis() - lastPollDebug > 1000) {  // Debug once per second max
-      Serial.printf("[POLL] Fed %d bytes to buffer\n", pollCount);
-      Serial.flush();
-      lastPollDebug = millis();
-    }
-  }
+  pumpSerialRx();
   
   // ALWAYS process Improv commands - allows re-provisioning while running
-  improvSerial.handleSerial();
+  {
+    HeapScope scope(HEAP_IMPROV);
+    improvSerial.handleSerial();
+  }
+  {
+    HeapScope scope(HEAP_WIFI);
+    wifiNetworks.poll(!improvSerial.isProvisioning());
+  }
+  
+  heapStats.sample();
+  if ((long)(millis() - heapReportAt) >= 0) reportHeap();
+  readChipTemperature();
   
   if (showingVersion) {
-    if (millis() - versionStartTime >= 5000) {
-      showingVersion = false;
-      display.clear();
-      
-      if (showConnAfterVersion) {
-        display.displayText("Conn");
-        delay(1000);
-        showConnAfterVersion = false;
-      } else if (showAPAfterVersion) {
-        display.displayText("AP  ");
-        delay(1000);
-        showAPAfterVersion = false;
-      }
-    }
+    // Boot screens advance from here; onBootScreenDone() hands the display back
+    HeapScope scope(HEAP_DISPLAY);
+    display.update();
     return;
   }
   
   updateBeep();
-  display.update();
+  {
+    HeapScope scope(HEAP_DISPLAY);
+    display.update();
+  }
+  {
+    HeapScope scope(HEAP_OTA);
+    pollOtaUpdate();
+  }
+  {
+    HeapScope scope(HEAP_TELEMETRY);
+    pollTelemetry();
+  }
+  
+  if (wifiConnected) {
+    {
+      HeapScope scope(HEAP_TZ);
+      pollTimezoneLookup();
+    }
+    HeapScope scope(HEAP_NTP);
+    sntp.poll();
+    saveDriftModel();
+    if (!timeSynced && sntp.isSynced()) {
+      timeSynced = true;
+      // The first sync steps the clock, so re-align the boundary timer
+      esp_timer_stop(secondTimer);
+      armSecondTimer();
+      secondTick = true;
+      beepBlocking(2500, 50);
+      delay(100);
+      beepBlocking(3000, 50);
+    }
+  }
   
   if (apMode) {
     // Check if WiFi connected while in AP mode (e.g., via Improv WiFi provisioning)
     if (WiFi.status() == WL_CONNECTED) {
-      Serial.println("WiFi connected while in AP mode - switching to STA mode");
+      LOG(WIFI_AP_TO_STA);
       apMode = false;
       wifiConnected = true;
       showIPAddress = true;
@@ -526,10 +600,11 @@ void loop() {
       display.clear();
       delay(500);
       
-      // Configure NTP now that we're connected
-      configTime(gmtOffset_sec, daylightOffset_sec, ntpServer);
+      // Start NTP now that we're connected
+      applyTimezone();
+      startTimeSync();
       timeSynced = false;
-      lastTimeUpdate = 0;
+      secondTick = true;
       
       // Stop AP mode
       WiFi.softAPdisconnect(true);
@@ -545,14 +620,17 @@ void loop() {
       // Continue to normal WiFi mode handling below
     } else {
       // Still in AP mode - handle AP mode display
-      server.handleClient();
+      {
+        HeapScope scope(HEAP_WEB);
+        server.handleClient();
+      }
       handleButtons();
       
-      static String ipAddressStr = "";
+      static char ipAddressStr[16];
       static bool ipScrollingStarted = false;
       if (!ipScrollingStarted) {
-        ipAddressStr = WiFi.softAPIP().toString();
-        display.startScrolling(ipAddressStr.c_str(), 350);
+        formatIP(WiFi.softAPIP(), ipAddressStr, sizeof(ipAddressStr));
+        display.startScrolling(ipAddressStr, 350);
         ipScrollingStarted = true;
       }
       return; // Stay in AP mode handling
@@ -561,7 +639,10 @@ void loop() {
   
   // Normal WiFi mode (not AP mode)
   if (!apMode) {
-    server.handleClient();
+    {
+      HeapScope scope(HEAP_WEB);
+      server.handleClient();
+    }
     handleButtons();
     
     if (showIPAddress && wifiConnected) {
@@ -599,110 +680,224 @@ void loop() {
       return;
     }
     
-    if (millis() - lastTimeUpdate >= 1000) {
-      lastTimeUpdate = millis();
-      
-      if (wifiConnected && timeSynced) {
-        struct tm timeinfo;
-        if (getLocalTime(&timeinfo)) {
-          int hours = timeinfo.tm_hour;
-          int minutes = timeinfo.tm_min;
-          int seconds = timeinfo.tm_sec;
-          bool showColon = (seconds % 2 == 0);
-          display.displayTime(hours, minutes, showColon, !use24Hour);
-        } else {
-          display.displayText("Err ");
-          timeSynced = false;
-        }
-      }
-    }
+    HeapScope scope(HEAP_DISPLAY);
+    serviceSecondTick();
   }
   
-  delay(10);
+  // Sleep until the next poll or until the second timer wakes us at the boundary
+  ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(10));
 }
 
 // =============================================================================
-// BUTTON HANDLERS
+// BOOT SCREENS
 // =============================================================================
 
-void handleButtons() {
-  bool btnMode = (digitalRead(PIN_BTN_MODE) == LOW);
-  bool btnUp = (digitalRead(PIN_BTN_UP) == LOW);
-  bool btnDown = (digitalRead(PIN_BTN_DOWN) == LOW);
-  unsigned long now = millis();
-  
-  if (btnMode && !lastModeState && (now - lastButtonPress > 200)) {
-    use24Hour = !use24Hour;
-    preferences.begin("ntp_clock", false);
-    preferences.putBool("24hour", use24Hour);
-    preferences.end();
-    startBeep(2000, 50);
-    lastButtonPress = now;
+void onVersionSplashDone() {
+  if (showConnAfterVersion) {
+    showConnAfterVersion = false;
+    display.play(CONN_SCREEN, onBootScreenDone);
+  } else if (showAPAfterVersion) {
+    showAPAfterVersion = false;
+    display.play(AP_SCREEN, onBootScreenDone);
+  } else {
+    onBootScreenDone();
   }
-  lastModeState = btnMode;
+}
+
+void onBootScreenDone() {
+  showingVersion = false;
+}
+
+// =============================================================================
+// SECOND-BOUNDARY TIMER
+// =============================================================================
+
+// Arm the one-shot timer for the next wall-clock second rollover
+static void armSecondTimer() {
+  struct timeval tv;
+  gettimeofday(&tv, nullptr);
+  uint64_t untilBoundary = 1000000 - tv.tv_usec;
+  esp_timer_start_once(secondTimer, untilBoundary);
+}
+
+// Runs in the esp_timer task: flag the render and wake loop() immediately
+static void onSecondBoundary(void* arg) {
+  secondTick = true;
+  if (loopTaskHandle != nullptr) {
+    xTaskNotifyGive(loopTaskHandle);
+  }
+  armSecondTimer();
+}
+
+void startSecondTimer() {
+  loopTaskHandle = xTaskGetCurrentTaskHandle();
   
-  if (btnUp && !lastUpState && (now - lastButtonPress > 200)) {
-    if (displayBrightness < 15) {
-      displayBrightness++;
-      display.setBrightness(displayBrightness);
-      preferences.begin("ntp_clock", false);
-      preferences.putInt("brightness", displayBrightness);
-      preferences.end();
-      startBeep(1500, 30);
+  esp_timer_create_args_t timerArgs = {};
+  timerArgs.callback = onSecondBoundary;
+  timerArgs.name = "second";
+  esp_timer_create(&timerArgs, &secondTimer);
+  armSecondTimer();
+}
+
+// Render HHMM for the second that just started. Never blocks: the clock is read
+// directly instead of through getLocalTime(), which waits up to 5 s when unsynced.
+void renderTime() {
+  struct timeval tv;
+  gettimeofday(&tv, nullptr);
+  
+  // A slew in progress can make the timer fire slightly early; round to the
+  // nearest boundary
+  time_t now = tv.tv_sec;
+  if (tv.tv_usec >= 500000) now++;
+  
+  LocalTime local;
+  localClock.toLocal(now, local);
+  bool showColon = (local.second % 2 == 0);
+  display.displayTime(local.hour, local.minute, showColon, !use24Hour, sntp.inHoldover());
+  
+  // Phase error is measured once the digits are latched, not when we woke up
+  struct timeval written;
+  gettimeofday(&written, nullptr);
+  int32_t phaseUs = (int32_t)(((int64_t)written.tv_sec - now) * 1000000LL + written.tv_usec);
+  
+  int32_t absPhase = phaseUs < 0 ? -phaseUs : phaseUs;
+  phaseSumUs += absPhase;
+  if (absPhase > phaseMaxUs) phaseMaxUs = absPhase;
+  if (++phaseSamples >= 60) {
+    LOG(TIME_PHASE, (long)(phaseSumUs / phaseSamples), (long)phaseMaxUs);
+    phaseSamples = 0;
+    phaseSumUs = 0;
+    phaseMaxUs = 0;
+  }
+}
+
+// Render on the second boundary if the timer has flagged one. Also called from
+// the firmware upload callback, which holds loop() for the whole upload.
+void serviceSecondTick() {
+  if (secondTick) {
+    secondTick = false;
+    
+    if (wifiConnected && timeSynced) {
+      renderTime();
     }
-    lastButtonPress = now;
   }
-  lastUpState = btnUp;
-  
-  if (btnDown && !lastDownState && (now - lastButtonPress > 200)) {
-    if (displayBrightness > 0) {
-      displayBrightness--;
+}
+
+// =============================================================================
+// BUTTON HANDLERS
+// =============================================================================
+
+// MODE toggles 12/24 hour; UP/DOWN step the brightness, repeating while held
+void handleButtons() {
+  ButtonEvent ev;
+  while (buttons.next(ev)) {
+    if (ev.button == BTN_MODE) {
+      if (ev.type != BUTTON_PRESS) continue;
+      use24Hour = !use24Hour;
+      preferences.begin("ntp_clock", false);
+      preferences.putBool("24hour", use24Hour);
+      preferences.end();
+      startBeep(2000, 50);
+    } else if (ev.type == BUTTON_PRESS || ev.type == BUTTON_REPEAT) {
+      bool up = ev.button == BTN_UP;
+      if (up ? displayBrightness >= 15 : displayBrightness <= 0) continue;
+      displayBrightness += up ? 1 : -1;
       display.setBrightness(displayBrightness);
+      brightnessChanged = true;
+      startBeep(up ? 1500 : 1000, 30);
+    } else if (ev.type == BUTTON_RELEASE && brightnessChanged) {
+      brightnessChanged = false;
       preferences.begin("ntp_clock", false);
       preferences.putInt("brightness", displayBrightness);
       preferences.end();
-      startBeep(1000, 30);
     }
-    lastButtonPress = now;
   }
-  lastDownState = btnDown;
 }
 
 // =============================================================================
 // WEB SERVER HANDLERS
 // =============================================================================
 
+void startWebServer() {
+  server.on("/", handleRoot);
+  server.on("/config", handleConfig);
+  server.on("/save", HTTP_POST, handleSave);
+  server.on("/factory-reset", HTTP_POST, handleFactoryReset);
+  server.on("/update", HTTP_GET, handleUpdatePage);
+  server.on("/update", HTTP_POST, handleUpdateUploadDone, handleUpdateUpload);
+  server.on("/update/pull", HTTP_POST, handleUpdatePull);
+  server.on("/heap", HTTP_GET, handleHeap);
+  server.on("/dashboard", HTTP_GET, handleDashboard);
+  server.begin();
+  startTelemetry();
+}
+
+// send_P() writes the buffer as it is; send() would copy it into a String first
+void sendPage(int code, const WebPage& page) {
+  server.send_P(code, "text/html", page.c_str(), page.length());
+}
+
+// WebServer keeps arguments as Strings; copy out so nothing else holds one
+void copyArg(const char* name, char* out, size_t size) {
+  snprintf(out, size, "%s", server.arg(name).c_str());
+}
+
+static void trimInPlace(char* text) {
+  char* start = text;
+  while (*start == ' ' || *start == '\t' || *start == '\r' || *start == '\n') start++;
+  size_t len = strlen(start);
+  while (len > 0 && (start[len - 1] == ' ' || start[len - 1] == '\t' || start[len - 1] == '\r' || start[len - 1] == '\n')) len--;
+  memmove(text, start, len);
+  text[len] = '\0';
+}
+
 void handleRoot() {
-  server.send(200, "text/html", getConfigPageHTML(preferences));
+  sendPage(200, getConfigPageHTML(preferences, wifiNetworks));
 }
 
 void handleConfig() {
-  server.send(200, "text/html", getConfigPageHTML(preferences));
+  sendPage(200, getConfigPageHTML(preferences, wifiNetworks));
 }
 
 void handleSave() {
-  String ssid = server.arg("ssid");
-  String password = server.arg("password");
-  String timezoneStr = server.arg("timezone");
-  String dstOffsetStr = server.arg("dst_offset");
-  String brightnessStr = server.arg("brightness");
-  String hourFormatStr = server.arg("hour_format");
+  char ssid[33];
+  char password[65];
+  char tzName[48];
+  char brightnessStr[8];
+  char hourFormatStr[4];
+  char ntpServersStr[SNTP_SERVERS_MAX_LEN];
+  char telemetryPeriodStr[8];
+  char telemetryBatchStr[4];
+  copyArg("ssid", ssid, sizeof(ssid));
+  copyArg("password", password, sizeof(password));
+  copyArg("tz", tzName, sizeof(tzName));
+  copyArg("brightness", brightnessStr, sizeof(brightnessStr));
+  copyArg("hour_format", hourFormatStr, sizeof(hourFormatStr));
+  copyArg("ntp_servers", ntpServersStr, sizeof(ntpServersStr));
+  copyArg("tm_period", telemetryPeriodStr, sizeof(telemetryPeriodStr));
+  copyArg("tm_batch", telemetryBatchStr, sizeof(telemetryBatchStr));
   
   preferences.begin("wifi_config", false);
   preferences.putString("ssid", ssid);
-  if (password.length() > 0) {
+  if (password[0] != '\0') {
     preferences.putString("password", password);
   }
   preferences.end();
   
-  long timezoneOffset = timezoneStr.toInt();
-  int dstOffset = dstOffsetStr.toInt();
   preferences.begin("ntp_clock", false);
-  preferences.putLong("timezone", timezoneOffset);
-  preferences.putInt("dst_offset", dstOffset);
+  if (findTimeZone(tzName) != nullptr) {
+    preferences.putString("tz_name", tzName);
+    preferences.putString("tz_source", "manual");
+    preferences.remove("timezone");
+    preferences.remove("dst_offset");
+  }
   
-  if (brightnessStr.length() > 0) {
-    int brightness = brightnessStr.toInt();
+  if (ntpServersStr[0] != '\0') {
+    preferences.putString("ntp_servers", ntpServersStr);
+  }
+  
+  if (brightnessStr[0] != '\0') {
+    int brightness = atoi(brightnessStr);
     if (brightness >= 0 && brightness <= 15) {
       preferences.putInt("brightness", brightness);
       displayBrightness = brightness;
@@ -710,14 +905,28 @@ void handleSave() {
     }
   }
   
-  if (hourFormatStr.length() > 0) {
-    preferences.putBool("24hour", hourFormatStr == "24");
-    use24Hour = (hourFormatStr == "24");
+  if (hourFormatStr[0] != '\0') {
+    use24Hour = (strcmp(hourFormatStr, "24") == 0);
+    preferences.putBool("24hour", use24Hour);
+  }
+  
+  if (telemetryPeriodStr[0] != '\0') {
+    long period = atol(telemetryPeriodStr);
+    if (period >= 0 && period <= 60000) {
+      preferences.putUInt("tm_period", period);
+    }
+  }
+  
+  if (telemetryBatchStr[0] != '\0') {
+    int batch = atoi(telemetryBatchStr);
+    if (batch >= 1 && batch <= TELEMETRY_BATCH_MAX) {
+      preferences.putUInt("tm_batch", batch);
+    }
   }
   
   preferences.end();
   
-  server.send(200, "text/html", getSaveSuccessPageHTML());
+  sendPage(200, getSaveSuccessPageHTML());
   delay(1000);
   ESP.restart();
 }
@@ -731,11 +940,202 @@ void handleFactoryReset() {
   preferences.clear();
   preferences.end();
   
-  server.send(200, "text/html", getFactoryResetPageHTML());
+  sendPage(200, getFactoryResetPageHTML());
   delay(1000);
   ESP.restart();
 }
 
+void handleUpdatePage() {
+  preferences.begin("ntp_clock", true);
+  char pullUrl[OTA_URL_LEN];
+  loadPrefString(preferences, "ota_url", pullUrl, sizeof(pullUrl), "");
+  preferences.end();
+  sendPage(200, getUpdatePageHTML(pullUrl, otaUpdate));
+}
+
+// Called per chunk while the image streams in. The form puts sha256 ahead of
+// the file, so it has already been parsed when the upload starts.
+void handleUpdateUpload() {
+  HTTPUpload& upload = server.upload();
+  
+  if (upload.status == UPLOAD_FILE_START) {
+    LOG(OTA_UPLOAD_START, upload.filename.c_str());
+    char sha[OTA_SHA_HEX_LEN + 1];
+    copyArg("sha256", sha, sizeof(sha));
+    otaUpdate.beginUpload(sha);
+  } else if (upload.status == UPLOAD_FILE_WRITE) {
+    otaUpdate.writeUpload(upload.buf, upload.currentSize);
+  } else if (upload.status == UPLOAD_FILE_END) {
+    otaUpdate.endUpload();
+  } else if (upload.status == UPLOAD_FILE_ABORTED) {
+    otaUpdate.abortUpload();
+  }
+  
+  // loop() doesn't run until the upload is over; keep the time on the display
+  serviceSecondTick();
+}
+
+// pollOtaUpdate() restarts into the new image once this page has gone out
+void handleUpdateUploadDone() {
+  sendPage(otaUpdate.succeeded() ? 200 : 500, getUpdatePageHTML("", otaUpdate));
+}
+
+void handleUpdatePull() {
+  char url[OTA_URL_LEN];
+  char sha[OTA_SHA_HEX_LEN + 8];   // Room to spot a value that is too long
+  copyArg("url", url, sizeof(url));
+  copyArg("sha256", sha, sizeof(sha));
+  trimInPlace(url);
+  trimInPlace(sha);
+  
+  preferences.begin("ntp_clock", false);
+  preferences.putString("ota_url", url);
+  preferences.end();
+  
+  if (!otaUpdate.startPull(url, sha)) {
+    server.send_P(400, "text/plain", "Update not started: check the URL and SHA-256, or wait for the running update");
+    return;
+  }
+  heapStats.tagTask(otaUpdate.workerTask(), HEAP_OTA);
+  LOG(OTA_PULL, url);
+  server.sendHeader("Location", "/update");
+  server.send(303);
+}
+
+// Heap counters as plain text, rendered without the heap like the pages
+void handleHeap() {
+  webPage.clear();
+  heapStats.report(webPage);
+  server.send_P(200, "text/plain", webPage.c_str(), webPage.length());
+}
+
+void handleDashboard() {
+  server.send_P(200, "text/html", DASHBOARD_HTML, sizeof(DASHBOARD_HTML) - 1);
+}
+
+// Same figures in the log, hourly; subsystems that never allocated are left out
+void reportHeap() {
+  heapReportAt = millis() + HEAP_REPORT_MS;
+  LOG(HEAP_SUMMARY, (unsigned long)heap_caps_get_free_size(MALLOC_CAP_8BIT),
+      (unsigned long)heap_caps_get_minimum_free_size(MALLOC_CAP_8BIT),
+      (unsigned long)heap_caps_get_largest_free_block(MALLOC_CAP_8BIT),
+      (unsigned long)heapStats.largestBlockLowWater());
+  for (uint8_t i = 0; i < HEAP_SUBSYSTEMS; i++) {
+    uint32_t allocs, bytes, steadyAllocs, steadyBytes;
+    heapStats.counts(i, allocs, bytes, steadyAllocs, steadyBytes);
+    if (allocs == 0) continue;
+    LOG(HEAP_SUBSYSTEM, HeapStats::subsystemName(i), (unsigned long)allocs, (unsigned long)bytes,
+        (unsigned long)steadyAllocs, (unsigned long)steadyBytes);
+  }
+}
+
+// =============================================================================
+// FIRMWARE UPDATE
+// =============================================================================
+
+// Called from loop(): restarts into a finished update, logs a failed one
+void pollOtaUpdate() {
+  OtaUpdate::Result result = otaUpdate.poll();
+  if (result == OtaUpdate::OTA_DONE) {
+    LOG(OTA_DONE, otaUpdate.source(), (unsigned)otaUpdate.bytesWritten());
+    beepBlocking(3000, 100);
+    delay(1000);
+    ESP.restart();
+  } else if (result == OtaUpdate::OTA_FAILED) {
+    LOG(OTA_FAILED, otaUpdate.source(), otaUpdate.error(), otaUpdate.lastError());
+    startBeep(1000, 300);
+  }
+}
+
+// =============================================================================
+// LIVE TELEMETRY
+// =============================================================================
+
+// EventStream's view of a dashboard connection. writable() asks the socket
+// without waiting, so a slow browser is skipped instead of stalling loop().
+struct EventClient {
+  WiFiClient client;
+  
+  bool connected() { return client.connected(); }
+  int available() { return client.available(); }
+  int read() { return client.read(); }
+  size_t write(const uint8_t* data, size_t len) { return client.write(data, len); }
+  void stop() { client.stop(); }
+  
+  bool writable() {
+    int fd = client.fd();
+    if (fd < 0) return false;
+    fd_set set;
+    FD_ZERO(&set);
+    FD_SET(fd, &set);
+    struct timeval zero = {0, 0};
+    return select(fd + 1, nullptr, &set, nullptr, &zero) > 0;
+  }
+};
+
+WiFiServer eventServer(TELEMETRY_SSE_PORT);
+EventStream<EventClient> liveEvents;
+WiFiUDP telemetryUdp;
+TelemetryBroadcast telemetry;
+
+static bool telemetrySink(const uint8_t* data, size_t len) {
+  if (!telemetryUdp.beginPacket(IPAddress(255, 255, 255, 255), TELEMETRY_UDP_PORT)) return false;
+  telemetryUdp.write(data, len);
+  return telemetryUdp.endPacket();
+}
+
+void startTelemetry() {
+  preferences.begin("ntp_clock", true);
+  uint32_t period = preferences.getUInt("tm_period", TELEMETRY_DEFAULT_PERIOD_MS);
+  uint32_t batch = preferences.getUInt("tm_batch", TELEMETRY_DEFAULT_BATCH);
+  preferences.end();
+  
+  // Same three MAC bytes as the AP name, so the listener and the label agree
+  uint8_t mac[6];
+  WiFi.macAddress(mac);
+  uint32_t device = ((uint32_t)mac[3] << 16) | ((uint32_t)mac[4] << 8) | mac[5];
+  telemetry.begin(telemetrySink, device, TELEMETRY_KIND_CLOCK, period, batch > 255 ? 255 : batch);
+  eventServer.begin();
+  LOG(TELEMETRY_START, (unsigned)TELEMETRY_SSE_PORT, (unsigned long)period, (unsigned)batch);
+}
+
+static int32_t clampToInt32(int64_t v) {
+  return v > INT32_MAX ? INT32_MAX : v < INT32_MIN ? INT32_MIN : (int32_t)v;
+}
+
+static void updateTelemetrySnapshot(unsigned long now) {
+  TelemetrySnapshot& snap = telemetrySnapshot;
+  snap.set(TM_SYNCED, !timeSynced ? 0 : sntp.inHoldover() ? 2 : 1);
+  if (timeSynced) {
+    const SntpClient::Stats& stats = sntp.getStats();
+    snap.set(TM_OFFSET_US, clampToInt32(stats.offsetUs));
+    snap.set(TM_JITTER_US, clampToInt32(stats.jitterUs));
+    snap.set(TM_DRIFT_PPM, (int32_t)lroundf(stats.driftPpm * 1000));
+    snap.set(TM_POLL_SEC, (int32_t)stats.pollIntervalSec);
+  }
+  snap.set(TM_BRIGHTNESS, displayBrightness);
+  if (telemetrySlowAt == 0 || now - telemetrySlowAt >= TELEMETRY_SLOW_MS) {
+    telemetrySlowAt = now == 0 ? 1 : now;
+    if (!isnan(chipTemperatureC)) snap.set(TM_CHIP_C, (int32_t)lroundf(chipTemperatureC * 100));
+    if (WiFi.status() == WL_CONNECTED) snap.set(TM_RSSI, WiFi.RSSI());
+  }
+}
+
+// Called from loop(): takes new dashboard connections and publishes the
+// snapshot to them and the broadcast
+void pollTelemetry() {
+  unsigned long now = millis();
+  if (now - telemetrySnapshotAt < TELEMETRY_SNAPSHOT_MS) return;
+  telemetrySnapshotAt = now;
+  
+  WiFiClient client = eventServer.accept();
+  if (client) liveEvents.add(EventClient{client}, now);
+  
+  updateTelemetrySnapshot(now);
+  liveEvents.poll(telemetrySnapshot, now);
+  telemetry.poll(telemetrySnapshot, now);
+}
+
 // =============================================================================
 // BEEP FUNCTIONS
 // =============================================================================
@@ -763,39 +1163,158 @@ void beepBlocking(int frequency, int duration) {
   ledcDetach(PIN_BUZZER);
 }
 
+// =============================================================================
+// TIME SYNC
+// =============================================================================
+
+void startTimeSync() {
+  LOG(SNTP_START, ntpServers);
+  sntp.begin(ntpServers);
+}
+
+// The crystal's error depends on temperature; the die sensor is close enough
+// to track it
+void readChipTemperature() {
+  unsigned long now = millis();
+  if (chipTemperatureAt != 0 && now - chipTemperatureAt < CHIP_TEMP_MS) return;
+  chipTemperatureAt = now == 0 ? 1 : now;
+  chipTemperatureC = temperatureRead();
+  sntp.setTemperature(chipTemperatureC);
+}
+
+// Start from what earlier boots learned, so the first minutes after a power
+// cut (and a holdover right after one) are already corrected
+void loadDriftModel() {
+  DriftModel saved;
+  preferences.begin("ntp_clock", true);
+  bool found = preferences.getBytesLength("drift") == sizeof(saved) &&
+               preferences.getBytes("drift", &saved, sizeof(saved)) == sizeof(saved);
+  preferences.end();
+  if (!found || !saved.valid()) return;
+  sntp.setDriftModel(saved);
+  LOG(DRIFT_RESTORED, sntp.getStats().driftPpm, saved.trained() ? "by temperature" : "not by temperature yet");
+}
+
+// After the first sync that taught the model anything, then every few hours
+void saveDriftModel() {
+  if (!sntp.driftModelChanged()) return;
+  if (driftSavedAt != 0 && millis() - driftSavedAt < DRIFT_SAVE_MS) return;
+  driftSavedAt = millis() == 0 ? 1 : millis();
+  const DriftModel& model = sntp.getDriftModel();
+  preferences.begin("ntp_clock", false);
+  preferences.putBytes("drift", &model, sizeof(model));
+  preferences.end();
+  sntp.driftModelSaved();
+}
+
+// Older firmware stored the value of the timezone dropdown as a raw offset
+// ("timezone" + "dst_offset"); map those to the zone the option was labelled with
+static const TimeZone* legacyTimeZone(long offset) {
+  switch (offset) {
+    case -28800: return findTimeZone("America/Los_Angeles");
+    case -21600: return findTimeZone("America/Denver");
+    case -18000: return findTimeZone("America/Chicago");
+    case -14400: return findTimeZone("America/New_York");
+    case 0:      return findTimeZone("UTC");
+    case 3600:
+    case 7200:   return findTimeZone("Europe/Berlin");
+    case 28800:  return findTimeZone("Asia/Shanghai");
+    case 32400:  return findTimeZone("Asia/Tokyo");
+    case 36000:  return findTimeZone("Australia/Sydney");
+    default:     return findTimeZoneByOffset(offset);
+  }
+}
+
+bool timezoneConfigured() {
+  preferences.begin("ntp_clock", true);
+  bool configured = preferences.isKey("tz_name") || preferences.isKey("timezone");
+  preferences.end();
+  return configured;
+}
+
+// Load the zone from Preferences, migrating a legacy offset if that's all we have
+void applyTimezone() {
+  preferences.begin("ntp_clock", false);
+  char name[48];
+  loadPrefString(preferences, "tz_name", name, sizeof(name), "");
+  const TimeZone* zone = findTimeZone(name);
+  if (zone == nullptr && preferences.isKey("timezone")) {
+    zone = legacyTimeZone(preferences.getLong("timezone", -28800));
+    if (zone != nullptr) {
+      preferences.putString("tz_name", zone->name);
+      preferences.remove("timezone");
+      preferences.remove("dst_offset");
+    }
+  }
+  preferences.end();
+  
+  localClock.setZone(zone);
+  setenv("TZ", localClock.getZone()->posix, 1);
+  tzset();
+  LOG(TZ_APPLIED, localClock.getZone()->name, localClock.getZone()->posix);
+}
+
 // =============================================================================
 // TIMEZONE DETECTION
 // =============================================================================
 
-bool detectTimezoneFromIP() {
-  HTTPClient http;
-  http.begin("http://ip-api.com/json/?fields=status,offset");
-  http.setTimeout(5000);
+void requestTimezoneLookup() {
+  if (tzLookup.start()) {
+    heapStats.tagTask(tzLookup.workerTask(), HEAP_TZ);
+    LOG(TZ_LOOKUP_STARTED);
+  }
+}
+
+void saveDetectedTimezone(const TimeZone* zone) {
+  time_t now = time(nullptr);
+  preferences.begin("ntp_clock", false);
+  preferences.putString("tz_name", zone->name);
+  preferences.putString("tz_source", "auto");
+  preferences.putULong64("tz_lookup_at", timeSynced ? (uint64_t)now : 0);
+  preferences.end();
+  applyTimezone();
+}
+
+// Called from loop(): applies finished lookups, retries failures with backoff
+// and refreshes auto-detected zones once their cached result is older than the TTL
+void pollTimezoneLookup() {
+  const TimeZone* zone = nullptr;
+  TimezoneLookup::Result result = tzLookup.poll(&zone);
+  
+  if (result == TimezoneLookup::LOOKUP_OK) {
+    LOG(TZ_LOOKUP_OK, zone->name);
+    saveDetectedTimezone(zone);
+    tzRetryAt = 0;
+    tzRetryDelay = TZ_LOOKUP_RETRY_MS;
+  } else if (result == TimezoneLookup::LOOKUP_FAILED) {
+    LOG(TZ_LOOKUP_FAILED, tzLookup.lastError(), tzRetryDelay / 1000);
+    tzRetryAt = millis() + tzRetryDelay;
+    if (tzRetryAt == 0) tzRetryAt = 1;
+    tzRetryDelay = min(tzRetryDelay * 2, (unsigned long)TZ_LOOKUP_MAX_RETRY_MS);
+  }
+  
+  if (!wifiConnected || tzLookup.isRunning()) return;
   
-  int httpCode = http.GET();
+  if (tzRetryAt != 0 && (long)(millis() - tzRetryAt) >= 0) {
+    tzRetryAt = 0;
+    requestTimezoneLookup();
+    return;
+  }
   
-  if (httpCode == HTTP_CODE_OK) {
-    String payload = http.getString();
+  // TTL check needs real time, so only once synced, and at most hourly
+  if (timeSynced && (tzTtlCheckedAt == 0 || millis() - tzTtlCheckedAt >= 3600000UL)) {
+    tzTtlCheckedAt = millis();
+    if (tzTtlCheckedAt == 0) tzTtlCheckedAt = 1;
     
-    DynamicJsonDocument doc(512);
-    DeserializationError error = deserializeJson(doc, payload);
+    preferences.begin("ntp_clock", true);
+    char source[8];
+    loadPrefString(preferences, "tz_source", source, sizeof(source), "");
+    uint64_t lookedUpAt = preferences.getULong64("tz_lookup_at", 0);
+    preferences.end();
     
-    if (!error && doc["status"] == "success" && doc.containsKey("offset")) {
-      long offset = doc["offset"].as<long>();
-      
-      preferences.begin("ntp_clock", false);
-      preferences.putLong("timezone", offset);
-      preferences.putInt("dst_offset", 0);
-      preferences.end();
-      
-      gmtOffset_sec = offset;
-      daylightOffset_sec = 0;
-      
-      http.end();
-      return true;
+    uint64_t now = (uint64_t)time(nullptr);
+    if (strcmp(source, "auto") == 0 && (lookedUpAt == 0 || now - lookedUpAt > TZ_LOOKUP_TTL_SEC)) {
+      requestTimezoneLookup();
     }
   }
-  
-  http.end();
-  return false;
 }
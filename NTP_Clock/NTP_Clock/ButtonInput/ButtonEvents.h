@@ -0,0 +1,229 @@
+/*
+ * ButtonEvents - Debounced press, long-press and auto-repeat events from raw edges
+ *
+ * The GPIO interrupt only timestamps each edge and queues it (pushEdge()); all
+ * the deciding happens later, in loop(), from those timestamps. So a press
+ * made while loop() sat in a delay() or an HTTP call is still seen, at the
+ * time it happened, and a bounce burst is judged by its real spacing rather
+ * than by when loop() came round to look.
+ *
+ * Per button, a new level counts once it has held for BUTTON_DEBOUNCE_MS with
+ * no further edge; anything shorter (contact bounce, a glitch) is dropped.
+ * The event is stamped with the first edge of the burst. While a button is
+ * held it can also produce:
+ *
+ * - BUTTON_LONG_PRESS once, after BUTTON_LONG_MS
+ * - BUTTON_REPEAT after BUTTON_REPEAT_DELAY_MS, then every
+ *   BUTTON_REPEAT_START_MS, each gap 1/8 shorter down to BUTTON_REPEAT_MIN_MS
+ *   (at most one per service(), so a stalled loop doesn't fire a burst)
+ *
+ * and BUTTON_RELEASE with how long it was held.
+ *
+ * The edge queue is lock-free, one producer (the GPIO ISR) and one consumer
+ * (loop()), like SpscRing. If it overflows, the consumer resyncs from the
+ * pin levels (see ButtonInput::service()).
+ *
+ * Pure C++ - no Arduino dependencies. bench/bounce_bench.cpp runs it against
+ * synthetic bounce waveforms.
+ */
+
+#ifndef BUTTONEVENTS_H
+#define BUTTONEVENTS_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+
+// Code the ISR calls must be in IRAM on the ESP32; ButtonInput.h sets this
+#ifndef BUTTON_ISR_ATTR
+#define BUTTON_ISR_ATTR
+#endif
+
+#define BUTTON_MAX               4
+#define BUTTON_EDGE_QUEUE        128    // Power of two
+#define BUTTON_EVENT_QUEUE       16
+#define BUTTON_DEBOUNCE_MS       20     // A level must hold this long to count
+#define BUTTON_LONG_MS           800
+#define BUTTON_REPEAT_DELAY_MS   400    // First repeat, from the press
+#define BUTTON_REPEAT_START_MS   150    // Gap to the second repeat
+#define BUTTON_REPEAT_MIN_MS     40     // Fastest repeat
+
+enum ButtonEventType : uint8_t {
+  BUTTON_PRESS,
+  BUTTON_LONG_PRESS,
+  BUTTON_REPEAT,
+  BUTTON_RELEASE,
+};
+
+// What a button reports beyond press and release
+enum ButtonFlags : uint8_t {
+  BUTTON_REPEATS = 1,
+  BUTTON_LONG = 2,
+};
+
+struct ButtonEvent {
+  uint8_t button;
+  ButtonEventType type;
+  uint16_t repeats;      // BUTTON_REPEAT: 1 for the first
+  uint32_t us;           // When it happened (micros())
+  uint32_t heldMs;       // BUTTON_RELEASE: press to release
+};
+
+struct ButtonEdge {
+  uint32_t us;
+  uint8_t button;
+  uint8_t pressed;
+};
+
+class ButtonEvents {
+  static_assert((BUTTON_EDGE_QUEUE & (BUTTON_EDGE_QUEUE - 1)) == 0, "BUTTON_EDGE_QUEUE must be a power of two");
+
+public:
+  ButtonEvents() : head(0), tail(0), overflowCount(0), eventHead(0), eventCount(0), eventDrops(0) {
+    for (uint8_t i = 0; i < BUTTON_MAX; i++) buttons[i] = Button();
+  }
+
+  void configure(uint8_t button, uint8_t flags) {
+    if (button < BUTTON_MAX) buttons[button].flags = flags;
+  }
+
+  // --- Producer side (the GPIO ISR) ---
+
+  bool BUTTON_ISR_ATTR pushEdge(uint8_t button, bool pressed, uint32_t us) {
+    uint32_t t = tail.load(std::memory_order_relaxed);
+    if (t - head.load(std::memory_order_acquire) >= BUTTON_EDGE_QUEUE) {
+      overflowCount.fetch_add(1, std::memory_order_relaxed);
+      return false;
+    }
+    ButtonEdge& e = edges[t & (BUTTON_EDGE_QUEUE - 1)];
+    e.us = us;
+    e.button = button;
+    e.pressed = pressed;
+    tail.store(t + 1, std::memory_order_release);
+    return true;
+  }
+
+  // --- Consumer side (loop()) ---
+
+  // Works through the queued edges in order, then the timers up to nowUs
+  void service(uint32_t nowUs) {
+    uint32_t h = head.load(std::memory_order_relaxed);
+    uint32_t t = tail.load(std::memory_order_acquire);
+    for (; h != t; h++) {
+      const ButtonEdge& e = edges[h & (BUTTON_EDGE_QUEUE - 1)];
+      advanceAll(e.us);
+      applyEdge(e.button, e.pressed, e.us);
+    }
+    head.store(h, std::memory_order_release);
+    advanceAll(nowUs);
+  }
+
+  // Sets a button's level as read from the pin, for after an overflow;
+  // counts as an edge at us if it differs from what the queue last said
+  void resync(uint8_t button, bool pressed, uint32_t us) {
+    advanceAll(us);
+    applyEdge(button, pressed, us);
+  }
+
+  bool next(ButtonEvent& ev) {
+    if (eventCount == 0) return false;
+    ev = events[eventHead];
+    eventHead = (eventHead + 1) % BUTTON_EVENT_QUEUE;
+    eventCount--;
+    return true;
+  }
+
+  bool isPressed(uint8_t button) const { return button < BUTTON_MAX && buttons[button].stable; }
+  uint32_t edgeOverflows() const { return overflowCount.load(std::memory_order_relaxed); }
+  uint32_t eventOverflows() const { return eventDrops; }
+
+private:
+  struct Button {
+    uint8_t flags = 0;
+    bool raw = false;           // Level from the latest edge
+    bool stable = false;        // Debounced level
+    bool longSent = false;
+    uint32_t changeUs = 0;      // First edge away from the stable level
+    uint32_t lastEdgeUs = 0;
+    uint32_t pressedUs = 0;
+    uint32_t nextRepeatUs = 0;
+    uint32_t repeatGapUs = 0;
+    uint16_t repeats = 0;
+  };
+
+  ButtonEdge edges[BUTTON_EDGE_QUEUE];
+  std::atomic<uint32_t> head;
+  std::atomic<uint32_t> tail;
+  std::atomic<uint32_t> overflowCount;
+
+  Button buttons[BUTTON_MAX];
+  ButtonEvent events[BUTTON_EVENT_QUEUE];
+  uint8_t eventHead;
+  uint8_t eventCount;
+  uint32_t eventDrops;
+
+  static bool reached(uint32_t now, uint32_t at) { return (int32_t)(now - at) >= 0; }
+
+  void applyEdge(uint8_t index, bool pressed, uint32_t us) {
+    if (index >= BUTTON_MAX) return;
+    Button& b = buttons[index];
+    if (pressed == b.raw) return;   // Missed its partner; nothing changed
+    // Leaving the stable level: a new burst, unless this is the same one
+    // bouncing back out
+    if (b.raw == b.stable && reached(us, b.lastEdgeUs + BUTTON_DEBOUNCE_MS * 1000UL)) b.changeUs = us;
+    b.raw = pressed;
+    b.lastEdgeUs = us;
+  }
+
+  void advanceAll(uint32_t us) {
+    for (uint8_t i = 0; i < BUTTON_MAX; i++) advance(i, us);
+  }
+
+  void advance(uint8_t index, uint32_t us) {
+    Button& b = buttons[index];
+    if (b.raw != b.stable && reached(us, b.lastEdgeUs + BUTTON_DEBOUNCE_MS * 1000UL)) {
+      b.stable = b.raw;
+      if (b.stable) {
+        b.pressedUs = b.changeUs;
+        b.longSent = false;
+        b.repeats = 0;
+        b.nextRepeatUs = b.pressedUs + BUTTON_REPEAT_DELAY_MS * 1000UL;
+        b.repeatGapUs = BUTTON_REPEAT_START_MS * 1000UL;
+        emit(index, BUTTON_PRESS, b.pressedUs, 0);
+      } else {
+        emit(index, BUTTON_RELEASE, b.changeUs, 0, (b.changeUs - b.pressedUs) / 1000);
+      }
+    }
+    // Nothing more once released, or while what may be the release settles
+    if (!b.stable || !b.raw) return;
+
+    if ((b.flags & BUTTON_LONG) && !b.longSent && reached(us, b.pressedUs + BUTTON_LONG_MS * 1000UL)) {
+      b.longSent = true;
+      emit(index, BUTTON_LONG_PRESS, b.pressedUs + BUTTON_LONG_MS * 1000UL, 0);
+    }
+    if ((b.flags & BUTTON_REPEATS) && reached(us, b.nextRepeatUs)) {
+      emit(index, BUTTON_REPEAT, b.nextRepeatUs, ++b.repeats);
+      // Late by more than a gap: carry on from now instead of catching up
+      uint32_t from = reached(us, b.nextRepeatUs + b.repeatGapUs) ? us : b.nextRepeatUs;
+      b.nextRepeatUs = from + b.repeatGapUs;
+      b.repeatGapUs -= b.repeatGapUs / 8;
+      if (b.repeatGapUs < BUTTON_REPEAT_MIN_MS * 1000UL) b.repeatGapUs = BUTTON_REPEAT_MIN_MS * 1000UL;
+    }
+  }
+
+  void emit(uint8_t button, ButtonEventType type, uint32_t us, uint16_t repeats, uint32_t heldMs = 0) {
+    if (eventCount == BUTTON_EVENT_QUEUE) {
+      eventDrops++;
+      return;
+    }
+    ButtonEvent& ev = events[(eventHead + eventCount) % BUTTON_EVENT_QUEUE];
+    ev.button = button;
+    ev.type = type;
+    ev.repeats = repeats;
+    ev.us = us;
+    ev.heldMs = heldMs;
+    eventCount++;
+  }
+};
+
+#endif // BUTTONEVENTS_H
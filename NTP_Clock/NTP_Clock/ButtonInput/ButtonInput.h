@@ -0,0 +1,92 @@
+/*
+ * ButtonInput - Interrupt-driven buttons for the ESP32 sketches
+ *
+ * Wires ButtonEvents to the pins: a CHANGE interrupt on each button pin reads
+ * the level and timestamps it into the edge queue, and next() in loop() turns
+ * the queue into debounced events. Buttons are active low (INPUT_PULLUP, set
+ * up by the sketch).
+ *
+ *   ButtonInput buttons;
+ *   buttons.add(PIN_BTN_UP, BUTTON_REPEATS);   // -> button 0
+ *   buttons.begin();
+ *   ...
+ *   ButtonEvent ev;
+ *   while (buttons.next(ev)) { ... }
+ *
+ * The interrupts are attached on the core that calls begin(), where the GPIO
+ * ISR runs for every pin, so the queue has the one producer it needs.
+ */
+
+#ifndef BUTTONINPUT_H
+#define BUTTONINPUT_H
+
+#include <Arduino.h>
+#include <hal/gpio_ll.h>
+
+#define BUTTON_ISR_ATTR IRAM_ATTR
+#include "ButtonEvents.h"
+
+class ButtonInput {
+public:
+  ButtonInput() : count(0), overflowsSeen(0) {}
+
+  // Returns the button's index in events, or -1 if there's no room
+  int add(int pin, uint8_t flags = 0) {
+    if (count >= BUTTON_MAX) return -1;
+    pins[count] = {this, (uint8_t)pin, count};
+    events.configure(count, flags);
+    return count++;
+  }
+
+  void begin() {
+    for (uint8_t i = 0; i < count; i++) {
+      // A button already down at boot counts as pressed then
+      if (readPin(pins[i].pin)) events.pushEdge(i, true, micros());
+      attachInterruptArg(digitalPinToInterrupt(pins[i].pin), onEdge, &pins[i], CHANGE);
+    }
+  }
+
+  bool next(ButtonEvent& ev) {
+    service();
+    return events.next(ev);
+  }
+
+  // Brings the events up to date; next() calls it
+  void service() {
+    uint32_t now = micros();
+    events.service(now);
+    // Edges were lost; go by the levels as they are now
+    uint32_t overflows = events.edgeOverflows();
+    if (overflows != overflowsSeen) {
+      overflowsSeen = overflows;
+      for (uint8_t i = 0; i < count; i++) events.resync(i, readPin(pins[i].pin), now);
+    }
+  }
+
+  bool isPressed(uint8_t button) const { return events.isPressed(button); }
+  uint32_t edgeOverflows() const { return events.edgeOverflows(); }
+
+private:
+  struct Pin {
+    ButtonInput* owner;
+    uint8_t pin;
+    uint8_t index;
+  };
+
+  ButtonEvents events;
+  Pin pins[BUTTON_MAX];
+  uint8_t count;
+  uint32_t overflowsSeen;
+
+  // gpio_ll rather than digitalRead(), which isn't safe from an IRAM ISR
+  static bool IRAM_ATTR readPin(uint8_t pin) {
+    return gpio_ll_get_level(&GPIO, (gpio_num_t)pin) == 0;
+  }
+
+  static void IRAM_ATTR onEdge(void* arg) {
+    Pin* p = static_cast<Pin*>(arg);
+    p->owner->events.pushEdge(p->index, readPin(p->pin), micros());
+  }
+};
+
+#endif // BUTTONINPUT_H
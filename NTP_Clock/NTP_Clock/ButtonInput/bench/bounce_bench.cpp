@@ -0,0 +1,268 @@
+/*
+ * Bounce bench - ButtonEvents against synthetic button waveforms
+ *
+ * Builds the level on a button pin as a list of transitions: presses and
+ * releases with contact bounce (a burst of edges a few microseconds to a few
+ * milliseconds apart), and short glitches on an idle line. An ISR model reads
+ * the level a few microseconds after each transition and pushes it as
+ * ButtonInput's interrupt does, so edges closer together than that arrive
+ * with the same level. loop() is modelled as a 10 ms pass that now and then
+ * stalls for a chirp or an HTTP call; each pass services the queue as
+ * ButtonInput::service() does, resync after an overflow included.
+ *
+ * Every scenario checks the events against what the waveform was built
+ * from; the tap scenarios also run the polled handler the sketches had
+ * (a digitalRead() per pass, 200 ms lockout) for comparison.
+ *
+ * Build and run from this directory (exit status 1 on failure):
+ *   g++ -std=gnu++17 -O2 -I.. bounce_bench.cpp -o bounce_bench && ./bounce_bench
+ */
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+#include "ButtonEvents.h"
+
+#define LOOP_US       10000
+#define ISR_LATENCY   4        // us from an edge to the level read in the ISR
+
+struct Transition {
+  uint32_t us;
+  bool pressed;
+};
+
+// xorshift64*, as clock_sim
+static uint64_t rngState = 1;
+static uint32_t random(uint32_t lo, uint32_t hi) {
+  rngState ^= rngState >> 12;
+  rngState ^= rngState << 25;
+  rngState ^= rngState >> 27;
+  return lo + (uint32_t)(((rngState * 0x2545F4914F6CDD1DULL) >> 33) % (hi - lo + 1));
+}
+
+// --- Waveforms ---
+
+struct Wave {
+  std::vector<Transition> edges;
+  std::vector<uint32_t> presses;   // Intended press times
+  bool level = false;
+
+  // Goes to pressed, chattering for up to bounceUs first
+  void to(bool pressed, uint32_t us, uint32_t bounceUs, uint8_t maxBounces) {
+    uint8_t bounces = bounceUs ? random(0, maxBounces) : 0;
+    uint32_t t = us;
+    for (uint8_t i = 0; i < 2 * bounces; i++) {
+      edges.push_back({t, i % 2 == 0 ? pressed : !pressed});
+      t += random(5, bounceUs / (2 * bounces) + 5);
+    }
+    edges.push_back({t, pressed});
+    level = pressed;
+  }
+
+  void press(uint32_t us, uint32_t holdUs, uint32_t bounceUs, uint8_t maxBounces = 10) {
+    presses.push_back(us);
+    to(true, us, bounceUs, maxBounces);
+    to(false, us + holdUs, bounceUs, maxBounces);
+  }
+
+  void glitch(uint32_t us, uint32_t widthUs) {
+    edges.push_back({us, true});
+    edges.push_back({us + widthUs, false});
+  }
+
+  bool levelAt(uint32_t us) const {
+    bool l = false;
+    for (const Transition& t : edges) {
+      if (t.us > us) break;
+      l = t.pressed;
+    }
+    return l;
+  }
+};
+
+// --- The loop ---
+
+struct Stalls {
+  uint32_t chirpPermille = 0;   // Chance per pass of a 150 ms stall
+  uint32_t httpPermille = 0;    // ... and of a 1.5 s one
+};
+
+struct Run {
+  std::vector<ButtonEvent> events;
+  uint32_t polledPresses = 0;
+  uint32_t overflows = 0;
+  bool pressedAtEnd = false;
+};
+
+static Run run(const Wave& wave, uint8_t flags, uint32_t endUs, Stalls stalls) {
+  ButtonEvents input;
+  input.configure(0, flags);
+  Run r;
+  size_t nextEdge = 0;
+  uint32_t overflowsSeen = 0;
+  bool lastPolled = false;
+  uint32_t lastPolledPress = 0;
+
+  for (uint32_t now = 0; now < endUs;) {
+    // Interrupts up to now
+    for (; nextEdge < wave.edges.size() && wave.edges[nextEdge].us < now; nextEdge++) {
+      uint32_t at = wave.edges[nextEdge].us + ISR_LATENCY;
+      input.pushEdge(0, wave.levelAt(at), at);
+    }
+
+    // ButtonInput::service()
+    input.service(now);
+    if (input.edgeOverflows() != overflowsSeen) {
+      overflowsSeen = input.edgeOverflows();
+      input.resync(0, wave.levelAt(now), now);
+    }
+    ButtonEvent ev;
+    while (input.next(ev)) r.events.push_back(ev);
+
+    // What handleButtons() did before
+    bool polled = wave.levelAt(now);
+    if (polled && !lastPolled && now - lastPolledPress > 200000) {
+      r.polledPresses++;
+      lastPolledPress = now;
+    }
+    lastPolled = polled;
+
+    now += LOOP_US;
+    if (random(1, 1000) <= stalls.chirpPermille) now += 150000;
+    if (random(1, 1000) <= stalls.httpPermille) now += 1500000;
+  }
+  r.overflows = overflowsSeen;
+  r.pressedAtEnd = input.isPressed(0);
+  return r;
+}
+
+// --- Scenarios ---
+
+static bool ok = true;
+
+static void report(const char* name, bool pass, const char* fmt, ...) __attribute__((format(printf, 3, 4)));
+static void report(const char* name, bool pass, const char* fmt, ...) {
+  char detail[160];
+  va_list ap;
+  va_start(ap, fmt);
+  vsnprintf(detail, sizeof(detail), fmt, ap);
+  va_end(ap);
+  printf("%-28s %s%s\n", name, detail, pass ? "" : "  FAIL");
+  ok = ok && pass;
+}
+
+// Taps 80-250 ms long, 150-600 ms apart; all must come out, each stamped
+// with its first edge
+static void taps(const char* name, uint32_t bounceUs, Stalls stalls) {
+  Wave wave;
+  uint32_t t = 300000;   // Clear of the old handler's lockout from boot
+  for (int i = 0; i < 400; i++) {
+    uint32_t holdUs = random(80000, 250000);
+    wave.press(t, holdUs, bounceUs);
+    t += holdUs + random(150000, 600000);
+  }
+  Run r = run(wave, 0, t + 100000, stalls);
+
+  uint32_t presses = 0, releases = 0, worstUs = 0;
+  for (const ButtonEvent& ev : r.events) {
+    if (ev.type == BUTTON_RELEASE) releases++;
+    if (ev.type != BUTTON_PRESS) continue;
+    if (presses < wave.presses.size()) {
+      uint32_t err = ev.us - wave.presses[presses];
+      if (err > worstUs) worstUs = err;
+    }
+    presses++;
+  }
+  size_t want = wave.presses.size();
+  report(name, presses == want && releases == want && worstUs <= ISR_LATENCY,
+         "%u/%zu presses, stamp +%u us, %u edges dropped; polled %u/%zu", presses, want, worstUs, r.overflows,
+         r.polledPresses, want);
+}
+
+// Short pulses on an idle line: no events at all
+static void glitches() {
+  Wave wave;
+  uint32_t t = 100000;
+  for (int i = 0; i < 1000; i++) {
+    wave.glitch(t, random(1, BUTTON_DEBOUNCE_MS * 1000 - 1000));
+    t += random(30000, 200000);
+  }
+  Run r = run(wave, BUTTON_REPEATS | BUTTON_LONG, t + 100000, Stalls());
+  report("glitches", r.events.empty(), "%zu events from 1000 glitches", r.events.size());
+}
+
+// Held 3 s: long press at 800 ms, repeats from 400 ms speeding up to the minimum
+static void hold(Stalls stalls, const char* name) {
+  Wave wave;
+  const uint32_t holdUs = 3000000;
+  wave.press(100000, holdUs, 3000);
+  Run r = run(wave, BUTTON_REPEATS | BUTTON_LONG, holdUs + 500000, stalls);
+
+  uint32_t longs = 0, longUs = 0, repeats = 0, lastUs = 0, minGapUs = UINT32_MAX, firstUs = 0;
+  bool shrinking = true;
+  uint32_t lastGap = UINT32_MAX;
+  for (const ButtonEvent& ev : r.events) {
+    if (ev.type == BUTTON_LONG_PRESS) {
+      longs++;
+      longUs = ev.us - 100000;
+    }
+    if (ev.type != BUTTON_REPEAT) continue;
+    if (repeats++ == 0) {
+      firstUs = ev.us - 100000;
+    } else {
+      uint32_t gap = ev.us - lastUs;
+      if (gap > lastGap && stalls.chirpPermille == 0) shrinking = false;
+      if (gap < minGapUs) minGapUs = gap;
+      lastGap = gap;
+    }
+    lastUs = ev.us;
+  }
+
+  // Expected count with no stalls: delay, then gaps shrinking by 1/8 to the minimum
+  uint32_t want = 0;
+  for (uint32_t at = BUTTON_REPEAT_DELAY_MS * 1000, gap = BUTTON_REPEAT_START_MS * 1000; at <= holdUs;) {
+    want++;
+    at += gap;
+    gap -= gap / 8;
+    if (gap < BUTTON_REPEAT_MIN_MS * 1000) gap = BUTTON_REPEAT_MIN_MS * 1000;
+  }
+  // Stamps are from the press, which the ISR saw ISR_LATENCY late
+  bool pass = longs == 1 && longUs - BUTTON_LONG_MS * 1000 <= ISR_LATENCY &&
+              firstUs - BUTTON_REPEAT_DELAY_MS * 1000 <= ISR_LATENCY && shrinking &&
+              minGapUs >= BUTTON_REPEAT_MIN_MS * 1000 &&
+              (stalls.chirpPermille ? repeats < want : repeats == want);
+  report(name, pass, "%u long, %u repeats (%u unstalled), first at %u ms, fastest %u ms", longs, repeats, want,
+         firstUs / 1000, minGapUs / 1000);
+}
+
+// A press with far more bounce than the queue holds, during a stall:
+// the queue overflows and the resync must still land on "pressed"
+static void overflow() {
+  Wave wave;
+  wave.to(true, 15000, 20000, 200);
+  Stalls stalls;
+  stalls.chirpPermille = 1000;
+  Run r = run(wave, 0, 600000, stalls);
+  bool pressed = false;
+  for (const ButtonEvent& ev : r.events) pressed = pressed || ev.type == BUTTON_PRESS;
+  report("edge queue overflow", r.overflows > 0 && pressed && r.pressedAtEnd, "%u edges dropped, %s", r.overflows,
+         r.pressedAtEnd ? "pressed after resync" : "lost the press");
+}
+
+int main() {
+  Stalls none, busy;
+  busy.chirpPermille = 60;
+  busy.httpPermille = 3;
+
+  taps("clean taps", 0, none);
+  taps("bouncy taps", 5000, none);
+  taps("bouncy taps, stalled loop", 5000, busy);
+  glitches();
+  hold(none, "hold 3 s");
+  hold(busy, "hold 3 s, stalled loop");
+  overflow();
+
+  printf("%s\n", ok ? "ok" : "FAILED");
+  return ok ? 0 : 1;
+}
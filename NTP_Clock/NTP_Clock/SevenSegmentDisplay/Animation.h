@@ -0,0 +1,71 @@
+/*
+ * Animation - Constexpr keyframe sequences for 7-segment displays
+ *
+ * A Keyframe is one screenful held for durationMs, with optional per-digit
+ * blinking. An Animation is a static array of keyframes plus a loop count.
+ * Both are built at compile time and stored in flash; the display only
+ * keeps a pointer to the Animation and a few counters, so nothing is
+ * allocated and the Animation must outlive playback (declare it static).
+ *
+ *   static constexpr Keyframe BOOT_FRAMES[] = {
+ *     keyframe("2.17", 2000, 0x00, true),   // right-aligned
+ *     keyframe("Conn", 1000, 0x0F),         // all four digits blink
+ *   };
+ *   static constexpr Animation BOOT = animation(BOOT_FRAMES);
+ *   display.play(BOOT, onBootDone);
+ *
+ * Segments are stored in canonical order (see glyphs.h) and remapped to the
+ * backend's wiring when drawn, so one sequence works on any display.
+ *
+ * Pure C++ - no Arduino dependencies.
+ */
+
+#ifndef ANIMATION_H
+#define ANIMATION_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "glyphs.h"
+
+#define ANIMATION_MAX_DIGITS 8
+#define ANIMATION_BLINK_MS   250   // Blinking digits are on for this long, then off for this long
+
+struct Keyframe {
+  uint8_t segments[ANIMATION_MAX_DIGITS];  // Canonical order, leftmost first
+  uint8_t length;                          // Digits used in segments
+  bool alignRight;                         // Right-align on wider displays
+  uint8_t blinkMask;                       // Bit n: display digit n (from the left) blinks
+  uint16_t durationMs;
+};
+
+// Text keyframe; dots merge into the previous character like displayText()
+constexpr Keyframe keyframe(const char* text, uint16_t durationMs, uint8_t blinkMask = 0, bool alignRight = false) {
+  Keyframe k = {};
+  for (int i = 0; text[i] != '\0'; i++) {
+    if (text[i] == '.') {
+      if (k.length > 0) k.segments[k.length - 1] |= 0x80;
+    } else if (k.length < ANIMATION_MAX_DIGITS) {
+      k.segments[k.length++] = canonicalGlyph(text[i]);
+    }
+  }
+  k.alignRight = alignRight;
+  k.blinkMask = blinkMask;
+  k.durationMs = durationMs;
+  return k;
+}
+
+typedef void (*AnimationDone)();
+
+struct Animation {
+  const Keyframe* frames;
+  uint8_t count;
+  uint8_t loops;   // 0 = repeat until stopped
+};
+
+template <size_t N>
+constexpr Animation animation(const Keyframe (&frames)[N], uint8_t loops = 1) {
+  static_assert(N > 0 && N < 256, "Animation needs 1-255 keyframes");
+  return Animation{frames, (uint8_t)N, loops};
+}
+
+#endif // ANIMATION_H
@@ -0,0 +1,20 @@
+/*
+ * HT16K33Display - HT16K33 I2C access
+ */
+
+#include "HT16K33Display.h"
+
+void HT16K33Bus::writeCommand(uint8_t command) {
+  wire.beginTransmission(address);
+  wire.write(command);
+  wire.endTransmission();
+  transactions++;
+}
+
+void HT16K33Bus::writeRam(uint8_t start, const uint8_t* data, uint8_t len) {
+  wire.beginTransmission(address);
+  wire.write(start);
+  wire.write(data, len);
+  wire.endTransmission();
+  transactions++;
+}
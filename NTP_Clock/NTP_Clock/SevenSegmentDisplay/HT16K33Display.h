@@ -0,0 +1,96 @@
+#ifndef HT16K33DISPLAY_H
+#define HT16K33DISPLAY_H
+
+#include "SevenSegmentDisplay.h"
+#include "SegmentFrame.h"
+#include <Wire.h>
+#include <stdint.h>
+
+#define HT16K33_DEFAULT_ADDRESS 0x70
+
+// I2C access to one HT16K33 (HT16K33Display.cpp)
+class HT16K33Bus {
+public:
+  static constexpr uint8_t CMD_OSCILLATOR = 0x21;  // System setup: oscillator on
+  static constexpr uint8_t CMD_DISPLAY    = 0x80;  // | 0x01 on, blink off
+  static constexpr uint8_t CMD_DIMMING    = 0xE0;  // | brightness 0-15
+  static constexpr uint8_t RAM_SIZE       = 16;    // 8 rows x 16 columns
+
+  HT16K33Bus(uint8_t address, TwoWire& wire) : address(address), wire(wire), transactions(0) {}
+
+  void writeCommand(uint8_t command);
+  // One transaction: RAM pointer then len bytes, auto-incrementing
+  void writeRam(uint8_t start, const uint8_t* data, uint8_t len);
+
+  uint32_t getTransactionCount() const { return transactions; }
+
+private:
+  uint8_t address;
+  TwoWire& wire;
+  uint32_t transactions;
+};
+
+// Digit i is the low byte of display RAM row i
+struct HT16K33LayoutPlain {
+  static constexpr uint8_t ramAddress(uint8_t digit) { return digit * 2; }
+};
+
+// Adafruit 0.56" 4-digit backpack: row 2 is the colon, so digits sit on rows 0, 1, 3, 4
+struct HT16K33LayoutBackpack {
+  static constexpr uint8_t ramAddress(uint8_t digit) { return (digit < 2 ? digit : digit + 1) * 2; }
+};
+
+// HT16K33 backend. The chip has no per-digit registers worth addressing
+// separately, so any change rewrites the whole display RAM image in one I2C
+// transaction.
+template <uint8_t Digits = 4, class Map = SegmentMapLinear, class Order = DigitOrderLeftToRight,
+          class Layout = HT16K33LayoutBackpack>
+class HT16K33Driver : public SegmentFrame<HT16K33Driver<Digits, Map, Order, Layout>, Digits, Map, Order> {
+  static_assert(Layout::ramAddress(Digits - 1) < HT16K33Bus::RAM_SIZE, "Layout doesn't fit HT16K33 RAM");
+
+public:
+  explicit HT16K33Driver(uint8_t address = HT16K33_DEFAULT_ADDRESS, TwoWire& wire = Wire) : bus(address, wire) {}
+
+  // Call Wire.begin() first
+  void begin() {
+    bus.writeCommand(HT16K33Bus::CMD_OSCILLATOR);
+    this->resetFrame();
+    sendFrame();
+    bus.writeCommand(HT16K33Bus::CMD_DISPLAY | 0x01);
+    bus.writeCommand(HT16K33Bus::CMD_DIMMING | 8);
+  }
+
+  void setBrightness(uint8_t level) {
+    if (level > 15) level = 15;
+    bus.writeCommand(HT16K33Bus::CMD_DIMMING | level);
+  }
+
+  void flush() {
+    if (!this->frameDirty()) return;
+    sendFrame();
+    memcpy(this->shown[0], this->frame[0], Digits);
+  }
+
+  uint32_t getTransactionCount() const { return bus.getTransactionCount(); }
+
+private:
+  static constexpr uint8_t RAM_USED = Layout::ramAddress(Digits - 1) + 2;
+
+  HT16K33Bus bus;
+
+  void sendFrame() {
+    uint8_t ram[RAM_USED] = {0};
+    for (uint8_t i = 0; i < Digits; i++) {
+      ram[Layout::ramAddress(i)] = this->frame[0][i];
+    }
+    bus.writeRam(0, ram, RAM_USED);
+  }
+};
+
+template <uint8_t Digits = 4, class Map = SegmentMapLinear, class Order = DigitOrderLeftToRight,
+          class Layout = HT16K33LayoutBackpack>
+using HT16K33DisplayT = SevenSegmentAdapter<HT16K33Driver<Digits, Map, Order, Layout>>;
+
+typedef HT16K33DisplayT<> HT16K33Display;
+
+#endif // HT16K33DISPLAY_H
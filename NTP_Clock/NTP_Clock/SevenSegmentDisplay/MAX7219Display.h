@@ -2,62 +2,114 @@
 #define MAX7219DISPLAY_H
 
 #include "SevenSegmentDisplay.h"
+#include "SegmentFrame.h"
+#include "SpiArbiter.h"
 #include <stdint.h>
 
-// Forward declarations
-uint8_t charToSegment(char c);
-bool isCodeBCompatible(char value);
+#define MAX7219_MAX_DEVICES 8   // Chained MAX7219s on one CS line
+#define MAX7219_SPI_HZ      1000000
 
-class MAX7219Display : public SevenSegmentDisplay {
+// SPI access shared by every MAX7219Driver configuration (MAX7219Display.cpp).
+// Every MAX7219 in a chain latches the last 16 bits shifted into it when CS
+// rises, so one CS-low transaction carries one register write per device.
+class MAX7219Bus {
 public:
-  MAX7219Display(int csPin);
-  
-  // Implementation of SevenSegmentDisplay interface
-  void begin() override;
-  void clear() override;
-  void setBrightness(uint8_t level) override;
-  void displayText(const char* text, bool rightJustify = false) override;
-  void displayDigits(uint8_t d0, uint8_t d1, uint8_t d2, uint8_t d3) override;
-  void displayTime(uint8_t hours, uint8_t minutes, bool showColon = false, bool hideLeadingZero = false) override;
-  void startScrolling(const char* text, unsigned long scrollDelay = 350) override;
-  void update() override;
-  bool isScrolling() const override;
-  void animatePattern(const uint8_t* pattern, size_t patternLen, unsigned long delayMs) override;
-  bool isAnimating() const override;
+  // MAX7219 register addresses
+  static constexpr uint8_t REG_NOOP        = 0x00;
+  static constexpr uint8_t REG_DIGIT0      = 0x01;
+  static constexpr uint8_t REG_DECODE_MODE = 0x09;
+  static constexpr uint8_t REG_INTENSITY   = 0x0A;
+  static constexpr uint8_t REG_SCAN_LIMIT  = 0x0B;
+  static constexpr uint8_t REG_SHUTDOWN    = 0x0C;
+  static constexpr uint8_t REG_TEST        = 0x0F;
+
+  explicit MAX7219Bus(int csPin)
+    : csPin(csPin), transactions(0), device{(int8_t)csPin, MAX7219_SPI_HZ, SPI_MODE0}, arbiter(nullptr) {}
+
+  // Test off, scan limit, no-decode mode, blank digits, wake up - on all devices
+  void init(uint8_t devices, uint8_t digits);
+  // address[d]/value[d] for device d; the farthest device's word goes out first
+  void writeChain(const uint8_t* address, const uint8_t* value, uint8_t devices);
+  void writeAll(uint8_t address, uint8_t value, uint8_t devices);
+
+  uint32_t getTransactionCount() const { return transactions; }
+
+  // With an arbiter, writes go through its acquire()/release() instead of
+  // opening their own SPI transaction
+  void setArbiter(SpiArbiter* bus) { arbiter = bus; }
+  SpiArbiter* getArbiter() const { return arbiter; }
+  const SpiDevice& getDevice() const { return device; }
 
 private:
   int csPin;
-  uint8_t decodeMask;
-  
-  struct ScrollState {
-    bool active;
-    char text[64];
-    uint8_t dpMask[64];
-    int textLen;
-    int scrollPosition;
-    unsigned long lastUpdate;
-    unsigned long scrollDelay;
-  } scrollState;
-  
-  struct AnimState {
-    bool active;
-    const uint8_t* pattern;
-    size_t patternLen;
-    int currentFrame;
-    unsigned long lastUpdate;
-    unsigned long delayMs;
-  } animState;
-  
-  void writeRegister(uint8_t address, uint8_t value);
-  void bitBangWrite(uint8_t address, uint8_t value);
-  bool decodeEnabledForDigit(int digit) const;
-  bool isCodeBCompatible(char value) const;
-  uint8_t raw7seg(char c);
-  void setDigitRaw(int digit, int value, bool dp);
-  void setCharRaw(int digit, char value, bool dp);
-  void writeRawSegment(int digit, uint8_t segments);
-  void processScrollingText(const char* text, char* output, uint8_t* dpMask, int* len);
-  void renderScrollFrame();
+  uint32_t transactions;
+  SpiDevice device;
+  SpiArbiter* arbiter;
+};
+
+// MAX7219 backend. Device 0 is the one wired to the MCU; chained devices hang
+// off its DOUT. Each changed digit row goes out as one transaction covering
+// the whole chain, with no-op words for devices whose row didn't change.
+template <uint8_t Digits = 4, class Map = SegmentMapMAX7219, class Order = DigitOrderLeftToRight, uint8_t Devices = 1>
+class MAX7219Driver : public SegmentFrame<MAX7219Driver<Digits, Map, Order, Devices>, Digits, Map, Order, Devices> {
+  static_assert(Devices <= MAX7219_MAX_DEVICES, "Too many chained MAX7219s");
+
+public:
+  explicit MAX7219Driver(int csPin) : bus(csPin) {}
+
+  void begin() {
+    bus.init(Devices, Digits);
+    this->resetFrame();
+  }
+
+  // Applies to every device in the chain
+  void setBrightness(uint8_t level) {
+    if (level > 15) level = 15;
+    bus.writeAll(MAX7219Bus::REG_INTENSITY, level, Devices);
+  }
+
+  // Shares the bus through an arbiter: flushes become display-priority jobs,
+  // so several frame changes close together go out as one batch
+  void setArbiter(SpiArbiter* arbiter) { bus.setArbiter(arbiter); }
+
+  void flush() {
+    SpiArbiter* arbiter = bus.getArbiter();
+    if (arbiter != nullptr) {
+      if (this->frameDirty()) arbiter->submit(bus.getDevice(), SPI_PRIORITY_DISPLAY, flushJob, this);
+      return;
+    }
+    writeDirtyRows();
+  }
+
+  // CS transactions sent since construction, for measuring bus traffic
+  uint32_t getTransactionCount() const { return bus.getTransactionCount(); }
+
+private:
+  MAX7219Bus bus;
+
+  static void flushJob(void* driver) { static_cast<MAX7219Driver*>(driver)->writeDirtyRows(); }
+
+  void writeDirtyRows() {
+    for (uint8_t row = 0; row < Digits; row++) {
+      if (!this->rowDirty(row)) continue;
+
+      uint8_t addr[Devices];
+      uint8_t val[Devices];
+      for (uint8_t d = 0; d < Devices; d++) {
+        bool changed = this->frame[d][row] != this->shown[d][row];
+        addr[d] = changed ? MAX7219Bus::REG_DIGIT0 + row : MAX7219Bus::REG_NOOP;
+        val[d] = changed ? this->frame[d][row] : 0x00;
+        this->shown[d][row] = this->frame[d][row];
+      }
+      bus.writeChain(addr, val, Devices);
+    }
+  }
 };
 
+// Drop-in SevenSegmentDisplay for the clock boards: 4 digits, one device
+template <uint8_t Digits = 4, class Map = SegmentMapMAX7219, class Order = DigitOrderLeftToRight, uint8_t Devices = 1>
+using MAX7219DisplayT = SevenSegmentAdapter<MAX7219Driver<Digits, Map, Order, Devices>>;
+
+typedef MAX7219DisplayT<> MAX7219Display;
+
 #endif // MAX7219DISPLAY_H
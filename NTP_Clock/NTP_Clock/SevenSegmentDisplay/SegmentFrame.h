@@ -0,0 +1,373 @@
+/*
+ * SegmentFrame - Shared framebuffer and rendering for 7-segment backends
+ *
+ * Holds what every digit should show (frame) and what was last sent to the
+ * chip (shown), for one or more chained devices. All text, number, time,
+ * scroll and keyframe animation rendering happens here, into the frame only; the
+ * backend's flush() then sends whatever differs in as few bus transactions
+ * as the chip allows and copies it into shown.
+ *
+ * Digit count, segment wiring and digit order are template parameters, so
+ * loop bounds and glyph tables are compile-time constants and positions
+ * never need range checks. Backends derive from this with CRTP:
+ *
+ *   class MyDriver : public SegmentFrame<MyDriver, 4, SegmentMapLinear> {
+ *     void flush();   // send dirty rows/frame
+ *   };
+ */
+
+#ifndef SEGMENTFRAME_H
+#define SEGMENTFRAME_H
+
+#include <Arduino.h>
+#include <stdint.h>
+#include <string.h>
+#include "glyphs.h"
+#include "Animation.h"
+
+#define SEGMENT_SCROLL_LEN 64  // Scroll buffer, including padding and terminator
+
+template <class Backend, uint8_t Digits, class Map, class Order = DigitOrderLeftToRight, uint8_t Devices = 1>
+class SegmentFrame {
+  static_assert(Digits >= 1 && Digits <= 8, "Digits must be 1-8");
+  static_assert(Devices >= 1 && Devices <= 8, "Devices must be 1-8");
+
+public:
+  typedef GlyphTable<Map> Glyphs;
+
+  // Route subsequent drawing calls to one device in the chain
+  void selectDevice(uint8_t device) {
+    if (device < Devices) selected = device;
+  }
+  uint8_t getSelectedDevice() const { return selected; }
+  static constexpr uint8_t getDeviceCount() { return Devices; }
+  static constexpr uint8_t getDigitCount() { return Digits; }
+
+  void clear() {
+    memset(frame[selected], 0, Digits);
+    backend().flush();
+  }
+
+  // Code-B digit values, d0=leftmost
+  void displayDigits(uint8_t d0, uint8_t d1, uint8_t d2, uint8_t d3) {
+    const uint8_t codes[4] = {d0, d1, d2, d3};
+    for (uint8_t i = 0; i < 4 && i < Digits; i++) {
+      put(i, Glyphs::codeB(codes[i]));
+    }
+    backend().flush();
+  }
+
+  void displayText(const char* text, bool rightJustify = false) {
+    // Stop any scrolling/animation running on this device
+    stopEffects(selected);
+
+    // Process text to merge dots with previous characters (like IP scrolling)
+    uint8_t segs[Digits];
+    uint8_t len = 0;
+
+    for (int i = 0; text[i] != '\0'; i++) {
+      if (text[i] == '.') {
+        // Merge dot with previous character
+        if (len > 0) segs[len - 1] |= Glyphs::DP;
+      } else if (len < Digits) {
+        segs[len++] = Glyphs::of(text[i]);
+      } else {
+        break;
+      }
+    }
+
+    // Leaves spaces on the left when right-justified
+    uint8_t start = (rightJustify && len < Digits) ? Digits - len : 0;
+    for (uint8_t i = 0; i < Digits; i++) {
+      put(i, (i >= start && i - start < len) ? segs[i - start] : 0x00);
+    }
+    backend().flush();
+  }
+
+  // Fixed-point number, right-aligned: value is in units of 10^-decimals.
+  // Integer only; values that don't fit are clamped to the largest that does.
+  void displayFixed(int32_t value, int decimals) {
+    // Stop any scrolling/animation running on this device
+    stopEffects(selected);
+
+    static const uint32_t POW10[] = {1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000};
+
+    bool negative = value < 0;
+    uint32_t magnitude = negative ? 0u - (uint32_t)value : (uint32_t)value;
+
+    // Drop decimal places that leave no room for the integer digit and sign
+    int maxDecimals = Digits - 1 - (negative ? 1 : 0);
+    if (maxDecimals < 0) maxDecimals = 0;
+    if (decimals < 0) decimals = 0;
+    while (decimals > maxDecimals) {
+      magnitude /= 10;
+      decimals--;
+    }
+
+    // Clamp to what fits, keeping one digit free for the minus sign
+    uint32_t limit = POW10[Digits - (negative ? 1 : 0)] - 1;
+    if (magnitude > limit) magnitude = limit;
+
+    // Fill from the right; always show at least one digit before the point
+    int pos = Digits - 1;
+    for (int n = 0; pos >= 0 && (magnitude > 0 || n <= decimals); n++, pos--) {
+      uint8_t seg = Glyphs::digit(magnitude % 10);
+      if (decimals > 0 && n == decimals) seg |= Glyphs::DP;
+      put(pos, seg);
+      magnitude /= 10;
+    }
+    if (negative && pos >= 0) put(pos--, Glyphs::MINUS);
+    while (pos >= 0) put(pos--, 0x00);
+
+    backend().flush();
+  }
+
+  // HHMM on the first four digits, DP on the hours ones digit as the colon;
+  // showMark lights the DP on the minutes ones digit
+  void displayTime(uint8_t hours, uint8_t minutes, bool showColon = false, bool hideLeadingZero = false,
+                   bool showMark = false) {
+    if constexpr (Digits >= 4) {
+      // Stop any scrolling/animation running on this device
+      stopEffects(selected);
+
+      // Convert to 12-hour format if needed
+      if (hideLeadingZero) {
+        if (hours == 0) hours = 12;
+        else if (hours > 12) hours -= 12;
+      }
+
+      // No settle delays here: this runs on the second boundary and every
+      // millisecond spent here shows up as display phase error.
+      put(0, (hideLeadingZero && hours < 10) ? 0x00 : Glyphs::digit(hours / 10));
+      put(1, Glyphs::digit(hours % 10) | (showColon ? Glyphs::DP : 0x00));
+      put(2, Glyphs::digit(minutes / 10));
+      put(3, Glyphs::digit(minutes % 10) | (showMark ? Glyphs::DP : 0x00));
+      for (uint8_t i = 4; i < Digits; i++) put(i, 0x00);
+      backend().flush();
+    }
+  }
+
+  // Generic scrolling - dots become decimal points on the previous character
+  void startScrolling(const char* text, unsigned long scrollDelay = 350) {
+    scrollState.active = true;
+    scrollState.device = selected;
+    scrollState.scrollDelay = scrollDelay;
+    scrollState.scrollPosition = 0;
+    scrollState.lastUpdate = millis();
+
+    // Process text (handle dots, add padding)
+    processScrollingText(text);
+
+    // Render first frame
+    renderScrollFrame();
+    backend().flush();
+  }
+
+  // Update scrolling/animation state - call from loop() regularly
+  void update() {
+    unsigned long now = millis();
+    bool changed = false;
+
+    if (scrollState.active && now - scrollState.lastUpdate >= scrollState.scrollDelay) {
+      scrollState.lastUpdate = now;
+      renderScrollFrame();
+      changed = true;
+
+      scrollState.scrollPosition++;
+      if (scrollState.scrollPosition > scrollState.textLen - Digits) {
+        scrollState.scrollPosition = 0;  // Reset scroll position
+      }
+    }
+
+    AnimationDone done = nullptr;
+    if (animState.active) {
+      if (now - animState.frameStart >= animState.animation->frames[animState.frame].durationMs) {
+        animState.frameStart = now;
+        if (++animState.frame >= animState.animation->count) {
+          animState.frame = 0;
+          animState.loop++;
+          if (animState.animation->loops != 0 && animState.loop >= animState.animation->loops) {
+            // Last keyframe stays on screen
+            animState.active = false;
+            done = animState.onDone;
+          }
+        }
+      }
+      if (animState.active) {
+        renderKeyframe(now);
+        changed = true;
+      }
+    }
+
+    if (changed) backend().flush();
+
+    // Last, so the callback can start something else
+    if (done != nullptr) done();
+  }
+
+  bool isScrolling() const { return scrollState.active; }
+
+  // Keyframe animation (see Animation.h), advanced by update(). Replaces any
+  // animation already playing; onDone runs from update() after the last loop.
+  void play(const Animation& animation, AnimationDone onDone = nullptr) {
+    animState.active = true;
+    animState.device = selected;
+    animState.animation = &animation;
+    animState.frame = 0;
+    animState.loop = 0;
+    animState.frameStart = millis();
+    animState.onDone = onDone;
+
+    // Stop scrolling on this device
+    if (scrollState.device == selected) scrollState.active = false;
+
+    renderKeyframe(animState.frameStart);
+    backend().flush();
+  }
+
+  // Leaves the current keyframe on screen; onDone is not called
+  void stopAnimation() { animState.active = false; }
+
+  bool isAnimating() const { return animState.active; }
+
+protected:
+  // Indexed by the chip's digit index, not the logical position
+  uint8_t frame[Devices][Digits];
+  uint8_t shown[Devices][Digits];
+  uint8_t selected;
+
+  SegmentFrame() : selected(0) {
+    resetFrame();
+
+    scrollState.active = false;
+    scrollState.device = 0;
+    scrollState.text[0] = '\0';
+    scrollState.textLen = 0;
+    scrollState.scrollPosition = 0;
+    scrollState.lastUpdate = 0;
+    scrollState.scrollDelay = 350;
+
+    animState.active = false;
+    animState.device = 0;
+    animState.animation = nullptr;
+    animState.frame = 0;
+    animState.loop = 0;
+    animState.frameStart = 0;
+    animState.onDone = nullptr;
+  }
+
+  // For backends that have just blanked the chip
+  void resetFrame() {
+    memset(frame, 0, sizeof(frame));
+    memset(shown, 0, sizeof(shown));
+  }
+
+  bool rowDirty(uint8_t index) const {
+    for (uint8_t d = 0; d < Devices; d++) {
+      if (frame[d][index] != shown[d][index]) return true;
+    }
+    return false;
+  }
+
+  bool frameDirty() const {
+    return memcmp(frame, shown, sizeof(frame)) != 0;
+  }
+
+private:
+  struct ScrollState {
+    bool active;
+    uint8_t device;
+    char text[SEGMENT_SCROLL_LEN];
+    uint8_t dpMask[SEGMENT_SCROLL_LEN];
+    int textLen;
+    int scrollPosition;
+    unsigned long lastUpdate;
+    unsigned long scrollDelay;
+  } scrollState;
+
+  struct AnimState {
+    bool active;
+    uint8_t device;
+    const Animation* animation;
+    uint8_t frame;
+    uint8_t loop;
+    unsigned long frameStart;
+    AnimationDone onDone;
+  } animState;
+
+  Backend& backend() { return *static_cast<Backend*>(this); }
+
+  void put(uint8_t pos, uint8_t segments) {
+    frame[selected][Order::index(pos, Digits)] = segments;
+  }
+
+  void putOn(uint8_t device, uint8_t pos, uint8_t segments) {
+    frame[device][Order::index(pos, Digits)] = segments;
+  }
+
+  void stopEffects(uint8_t device) {
+    if (scrollState.device == device) scrollState.active = false;
+    if (animState.device == device) animState.active = false;
+  }
+
+  void processScrollingText(const char* text) {
+    int len = 0;
+    memset(scrollState.dpMask, 0, sizeof(scrollState.dpMask));
+
+    // Add leading spaces
+    for (uint8_t i = 0; i < Digits; i++) {
+      scrollState.text[len++] = ' ';
+    }
+
+    // Copy text, converting dots to decimal points on previous digit.
+    // Leave room for the trailing padding and the terminator.
+    // Dots after the cut belong to dropped characters, not the last kept one.
+    const int textLimit = SEGMENT_SCROLL_LEN - 1 - Digits;
+    bool kept = true;
+    for (int i = 0; text[i] != '\0'; i++) {
+      if (text[i] == '.') {
+        if (kept) scrollState.dpMask[len - 1] = 1;  // Add DP to previous char
+      } else if (len < textLimit) {
+        scrollState.text[len++] = text[i];
+      } else {
+        kept = false;
+      }
+    }
+
+    // Add trailing spaces
+    for (uint8_t i = 0; i < Digits; i++) {
+      scrollState.text[len++] = ' ';
+    }
+    scrollState.text[len] = '\0';
+    scrollState.textLen = len;
+  }
+
+  void renderScrollFrame() {
+    // Display one screenful starting at scrollPosition
+    for (uint8_t i = 0; i < Digits; i++) {
+      int strPos = scrollState.scrollPosition + i;
+      uint8_t seg = 0x00;
+
+      if (strPos < scrollState.textLen) {
+        seg = Glyphs::of(scrollState.text[strPos]);
+        if (scrollState.dpMask[strPos]) seg |= Glyphs::DP;
+      }
+      putOn(scrollState.device, i, seg);
+    }
+  }
+
+  void renderKeyframe(unsigned long now) {
+    const Keyframe& k = animState.animation->frames[animState.frame];
+    bool blinkOff = ((now - animState.frameStart) / ANIMATION_BLINK_MS) & 1;
+    uint8_t start = (k.alignRight && k.length < Digits) ? Digits - k.length : 0;
+
+    for (uint8_t i = 0; i < Digits; i++) {
+      uint8_t seg = 0x00;
+      if (i >= start && i - start < k.length) seg = Map::remap(k.segments[i - start]);
+      if (blinkOff && (k.blinkMask & (1 << i))) seg = 0x00;
+      putOn(animState.device, i, seg);
+    }
+  }
+};
+
+#endif // SEGMENTFRAME_H
@@ -3,12 +3,18 @@
  * 
  * Abstract interface for 7-segment display drivers.
  * Allows swapping between different display chips (MAX7219, TM1637, HT16K33, etc.)
+ *
+ * The drivers themselves are templates resolved at compile time (see
+ * SegmentFrame.h); SevenSegmentAdapter wraps one behind this interface.
  */
 
 #ifndef SEVENSEGMENTDISPLAY_H
 #define SEVENSEGMENTDISPLAY_H
 
 #include <stdint.h>
+#include <stddef.h>
+#include <utility>
+#include "Animation.h"
 
 class SevenSegmentDisplay {
 public:
@@ -25,12 +31,19 @@ public:
   
   virtual void displayDigits(uint8_t d0, uint8_t d1, uint8_t d2, uint8_t d3) = 0;
   
+  // Fixed-point number, right-aligned: value is in units of 10^-decimals
+  // (displayFixed(1234, 1) shows "123.4"). Integer-only; values that don't
+  // fit are clamped to the largest one that does.
+  virtual void displayFixed(int32_t value, int decimals) = 0;
+
   // Time display - formatted HHMM with optional colon
   // hours: 0-23 (will be converted to 12-hour if hideLeadingZero is true)
   // minutes: 0-59
   // showColon: blink decimal point on 100s digit as colon
   // hideLeadingZero: suppress leading zero in 12-hour mode (e.g., " 1:23" instead of "01:23")
-  virtual void displayTime(uint8_t hours, uint8_t minutes, bool showColon = false, bool hideLeadingZero = false) = 0;
+  // showMark: decimal point on the last digit, a steady status mark (e.g. time not synced)
+  virtual void displayTime(uint8_t hours, uint8_t minutes, bool showColon = false, bool hideLeadingZero = false,
+                           bool showMark = false) = 0;
   
   // Generic scrolling - works for any text (IP addresses, messages, etc.)
   // Automatically handles dot-to-decimal-point conversion for IP addresses
@@ -44,14 +57,45 @@ public:
   // Check if currently scrolling
   virtual bool isScrolling() const = 0;
   
-  // Pattern animation - custom segment patterns
-  // pattern: array of segment patterns (one per digit)
-  // patternLen: number of patterns in array
-  // delayMs: milliseconds between pattern changes
-  virtual void animatePattern(const uint8_t* pattern, size_t patternLen, unsigned long delayMs) = 0;
+  // Keyframe animation - plays a constexpr keyframe sequence (see Animation.h)
+  // from update(), with per-digit blinking and loop counts
+  // onDone: called from update() when the last loop finishes
+  virtual void play(const Animation& animation, AnimationDone onDone = nullptr) = 0;
+  virtual void stopAnimation() = 0;
   
   // Check if currently animating
   virtual bool isAnimating() const = 0;
 };
 
+// Thin virtual wrapper around a compile-time driver. Driver-specific calls
+// (selectDevice, transaction counts) go through driver().
+template <class Driver>
+class SevenSegmentAdapter : public SevenSegmentDisplay {
+public:
+  template <class... Args>
+  explicit SevenSegmentAdapter(Args&&... args) : impl(std::forward<Args>(args)...) {}
+
+  Driver& driver() { return impl; }
+
+  void begin() override { impl.begin(); }
+  void clear() override { impl.clear(); }
+  void setBrightness(uint8_t level) override { impl.setBrightness(level); }
+  void displayText(const char* text, bool rightJustify = false) override { impl.displayText(text, rightJustify); }
+  void displayDigits(uint8_t d0, uint8_t d1, uint8_t d2, uint8_t d3) override { impl.displayDigits(d0, d1, d2, d3); }
+  void displayFixed(int32_t value, int decimals) override { impl.displayFixed(value, decimals); }
+  void displayTime(uint8_t hours, uint8_t minutes, bool showColon = false, bool hideLeadingZero = false,
+                   bool showMark = false) override {
+    impl.displayTime(hours, minutes, showColon, hideLeadingZero, showMark);
+  }
+  void startScrolling(const char* text, unsigned long scrollDelay = 350) override { impl.startScrolling(text, scrollDelay); }
+  void update() override { impl.update(); }
+  bool isScrolling() const override { return impl.isScrolling(); }
+  void play(const Animation& animation, AnimationDone onDone = nullptr) override { impl.play(animation, onDone); }
+  void stopAnimation() override { impl.stopAnimation(); }
+  bool isAnimating() const override { return impl.isAnimating(); }
+
+private:
+  Driver impl;
+};
+
 #endif // SEVENSEGMENTDISPLAY_H
@@ -0,0 +1,92 @@
+#ifndef TM1637DISPLAY_H
+#define TM1637DISPLAY_H
+
+#include "SevenSegmentDisplay.h"
+#include "SegmentFrame.h"
+#include <stdint.h>
+
+#define TM1637_BIT_DELAY_US 5   // Half clock period; ~100 kHz, well under the 250 kHz limit
+
+// Bit-banged TM1637 two-wire bus (TM1637Display.cpp). Not I2C: no device
+// address, LSB first, and the lines are driven open-drain by switching the
+// pin between OUTPUT LOW and INPUT with the module's pull-ups.
+class TM1637Bus {
+public:
+  static constexpr uint8_t CMD_DATA_AUTO = 0x40;  // Write display data, auto-increment address
+  static constexpr uint8_t CMD_ADDRESS   = 0xC0;  // | digit address 0-5
+  static constexpr uint8_t CMD_DISPLAY   = 0x80;  // | 0x08 on | brightness 0-7
+
+  TM1637Bus(int clkPin, int dioPin) : clkPin(clkPin), dioPin(dioPin), transactions(0) {}
+
+  void init();
+  // One burst: data command, start address, len digit bytes
+  void writeDigits(uint8_t address, const uint8_t* data, uint8_t len);
+  void writeCommand(uint8_t command);
+
+  uint32_t getTransactionCount() const { return transactions; }
+
+private:
+  int clkPin;
+  int dioPin;
+  uint32_t transactions;
+
+  void release(int pin);
+  void pullLow(int pin);
+  void start();
+  void stop();
+  bool writeByte(uint8_t value);
+};
+
+// TM1637 backend, for the common 4- and 6-digit modules. The chip has
+// auto-increment addressing, so a flush sends the span from the first to
+// the last changed digit as a single burst.
+template <uint8_t Digits = 4, class Map = SegmentMapLinear, class Order = DigitOrderLeftToRight>
+class TM1637Driver : public SegmentFrame<TM1637Driver<Digits, Map, Order>, Digits, Map, Order> {
+  static_assert(Digits <= 6, "TM1637 drives at most 6 digits");
+
+public:
+  TM1637Driver(int clkPin, int dioPin) : bus(clkPin, dioPin), brightness(4) {}
+
+  void begin() {
+    bus.init();
+    uint8_t blank[Digits] = {0};
+    bus.writeDigits(0, blank, Digits);
+    this->resetFrame();
+    bus.writeCommand(TM1637Bus::CMD_DISPLAY | 0x08 | brightness);
+  }
+
+  // 0-15 like the other backends; the TM1637 has 8 steps
+  void setBrightness(uint8_t level) {
+    if (level > 15) level = 15;
+    brightness = level >> 1;
+    bus.writeCommand(TM1637Bus::CMD_DISPLAY | 0x08 | brightness);
+  }
+
+  void flush() {
+    uint8_t first = Digits;
+    uint8_t last = 0;
+    for (uint8_t i = 0; i < Digits; i++) {
+      if (this->frame[0][i] != this->shown[0][i]) {
+        if (first == Digits) first = i;
+        last = i;
+      }
+    }
+    if (first == Digits) return;
+
+    bus.writeDigits(first, &this->frame[0][first], last - first + 1);
+    memcpy(this->shown[0], this->frame[0], Digits);
+  }
+
+  uint32_t getTransactionCount() const { return bus.getTransactionCount(); }
+
+private:
+  TM1637Bus bus;
+  uint8_t brightness;
+};
+
+template <uint8_t Digits = 4, class Map = SegmentMapLinear, class Order = DigitOrderLeftToRight>
+using TM1637DisplayT = SevenSegmentAdapter<TM1637Driver<Digits, Map, Order>>;
+
+typedef TM1637DisplayT<> TM1637Display;
+
+#endif // TM1637DISPLAY_H
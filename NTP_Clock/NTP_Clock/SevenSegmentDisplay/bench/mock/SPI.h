@@ -0,0 +1,40 @@
+#ifndef MOCK_SPI_H
+#define MOCK_SPI_H
+
+#include <Arduino.h>
+
+#define MOCK_SPI_BEGIN_NS 2000   // beginTransaction(): bus lock and reprogramming clock/mode
+
+struct SPISettings {
+  SPISettings(uint32_t clock, uint8_t, uint8_t mode) : clock(clock), mode(mode) {}
+  uint32_t clock;
+  uint8_t mode;
+};
+
+class SPIClass {
+public:
+  // Counted for benches: every beginTransaction(), and those that changed the settings
+  uint32_t transactions = 0;
+  uint32_t modeSwitches = 0;
+
+  void beginTransaction(SPISettings settings) {
+    mockBusNs += MOCK_SPI_BEGIN_NS;
+    if (transactions > 0 && (settings.clock != clock || settings.mode != mode)) modeSwitches++;
+    transactions++;
+    clock = settings.clock;
+    mode = settings.mode;
+  }
+  void endTransaction() {}
+  uint8_t transfer(uint8_t) {
+    mockBusNs += 8ULL * 1000000000ULL / clock;
+    return 0;
+  }
+
+private:
+  uint32_t clock = 1000000;
+  uint8_t mode = 0;
+};
+
+extern SPIClass SPI;
+
+#endif // MOCK_SPI_H
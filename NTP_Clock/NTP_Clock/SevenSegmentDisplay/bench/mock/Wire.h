@@ -0,0 +1,25 @@
+#ifndef MOCK_WIRE_H
+#define MOCK_WIRE_H
+
+#include <Arduino.h>
+
+// Start + address byte + data bytes (each 8 bits + ACK) + stop
+class TwoWire {
+public:
+  void setClock(uint32_t hz) { clock = hz; }
+  void beginTransmission(uint8_t) { bytes = 1; }
+  size_t write(uint8_t) { bytes++; return 1; }
+  size_t write(const uint8_t*, size_t len) { bytes += len; return len; }
+  uint8_t endTransmission() {
+    mockBusNs += (2ULL + 9ULL * bytes) * 1000000000ULL / clock;
+    return 0;
+  }
+
+private:
+  uint32_t clock = 400000;
+  size_t bytes = 0;
+};
+
+extern TwoWire Wire;
+
+#endif // MOCK_WIRE_H
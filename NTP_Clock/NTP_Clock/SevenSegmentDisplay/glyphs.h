@@ -1,68 +1,139 @@
+/*
+ * Glyphs - Segment maps and compile-time glyph tables
+ *
+ * Glyphs are defined once in canonical segment order (bit0 = A ... bit6 = G,
+ * bit7 = DP). A SegmentMap says which register bit drives each segment on a
+ * given chip or board, and GlyphTable<Map> remaps the canonical set into a
+ * constexpr ASCII table for that wiring, so a lookup is a single array index.
+ *
+ *      A
+ *    F   B
+ *      G
+ *    E   C
+ *      D   DP
+ *
+ * Pure C++ - no Arduino dependencies.
+ */
+
 #ifndef GLYPHS_H
 #define GLYPHS_H
 
 #include <stdint.h>
 
-// Segments are REVERSED:  bit0->G, bit1->F, bit2->E, bit3->D, bit4->C, bit5->B, bit6->A, bit7->DP
-// To display segment A (top), send bit6. To display B (top-right), send bit5. etc.
-// This matches the physical display wiring
-
-inline uint8_t charToSegment(char c) {
+constexpr uint8_t canonicalGlyph(char c) {
   switch (c) {
     // digits
-    case '0': return 0x7E; // A B C D E F
-    case '1': return 0x30; // B C
-    case '2': return 0x6D; // A B D E G
-    case '3': return 0x79; // A B C D G
-    case '4': return 0x33; // B C F G
-    case '5': return 0x5B; // A C D F G
-    case '6': return 0x5F; // A C D E F G
-    case '7': return 0x70; // A B C
+    case '0': return 0x3F; // A B C D E F
+    case '1': return 0x06; // B C
+    case '2': return 0x5B; // A B D E G
+    case '3': return 0x4F; // A B C D G
+    case '4': return 0x66; // B C F G
+    case '5': return 0x6D; // A C D F G
+    case '6': return 0x7D; // A C D E F G
+    case '7': return 0x07; // A B C
     case '8': return 0x7F; // A B C D E F G
-    case '9': return 0x7B; // A B C D F G
-
-    // letters - Segments are REVERSED: bit0->G, bit1->F, bit2->E, bit3->D, bit4->C, bit5->B, bit6->A, bit7->DP
-    case 'A': case 'a': return 0x77; // A B C E F G -> bit6|bit5|bit4|bit2|bit1|bit0 = 0x40|0x20|0x10|0x04|0x02|0x01 = 0x77
-    case 'B': case 'b': return 0x7C; // C D E F G
-    case 'C': case 'c': return 0x4E; // A D E F -> bit6|bit3|bit2|bit1 = 0x40|0x08|0x04|0x02 = 0x4E
-    case 'D': case 'd': return 0x5E; // B C D E G
-    case 'E': case 'e': return 0x4F; // A D E F G -> bit6|bit3|bit2|bit1|bit0 = 0x40|0x08|0x04|0x02|0x01 = 0x4F
-    case 'F': case 'f': return 0x47; // A E F G
-    case 'G': case 'g': return 0x5E; // A C D E F
-    case 'H': case 'h': return 0x37; // B C E F G -> bit5|bit4|bit2|bit1|bit0 = 0x20|0x10|0x04|0x02|0x01 = 0x37
-    case 'I': case 'i': return 0x30; // B C
-    case 'J': case 'j': return 0x3C; // B C D E
-    case 'K': case 'k': return 0x37; // B C E F G (same as H)
-    case 'L': case 'l': return 0x0E; // D E F -> bit3|bit2|bit1 = 0x08|0x04|0x02 = 0x0E
-    case 'M': case 'm': return 0x77; // A B C E F G (same as A)
-    case 'N': case 'n': return 0x15; // C E G -> bit4|bit2|bit0 = 0x10|0x04|0x01 = 0x15
-    case 'O': case 'o': return 0x1D; // C D E G -> bit4|bit3|bit2|bit0 = 0x10|0x08|0x04|0x01 = 0x1D
-    case 'P': case 'p': return 0x67; // A B E F G -> bit6|bit5|bit2|bit1|bit0 = 0x40|0x20|0x04|0x02|0x01 = 0x67
-    case 'Q': case 'q': return 0x73; // A B C F G
-    case 'R': case 'r': return 0x05; // E G -> bit2|bit0 = 0x04|0x01 = 0x05
-    case 'S': case 's': return 0x5B; // A C D F G (same as 5)
-    case 'T': case 't': return 0x0F; // D E F G
+    case '9': return 0x6F; // A B C D F G
+
+    // letters
+    case 'A': case 'a': return 0x77; // A B C E F G
+    case 'B': case 'b': return 0x1F; // A B C D E
+    case 'C': case 'c': return 0x39; // A D E F
+    case 'D': case 'd': return 0x3D; // A C D E F
+    case 'E': case 'e': return 0x79; // A D E F G
+    case 'F': case 'f': return 0x71; // A E F G
+    case 'G': case 'g': return 0x3D; // A C D E F
+    case 'H': case 'h': return 0x76; // B C E F G
+    case 'I': case 'i': return 0x06; // B C
+    case 'J': case 'j': return 0x1E; // B C D E
+    case 'K': case 'k': return 0x76; // B C E F G
+    case 'L': case 'l': return 0x38; // D E F
+    case 'M': case 'm': return 0x77; // A B C E F G
+    case 'N': case 'n': return 0x54; // C E G
+    case 'O': case 'o': return 0x5C; // C D E G
+    case 'P': case 'p': return 0x73; // A B E F G
+    case 'Q': case 'q': return 0x67; // A B C F G
+    case 'R': case 'r': return 0x50; // E G
+    case 'S': case 's': return 0x6D; // A C D F G
+    case 'T': case 't': return 0x78; // D E F G
     case 'U': case 'u': return 0x3E; // B C D E F
-    case 'V': case 'v': return 0x3E; // B C D E F (same as U)
-    case 'W': case 'w': return 0x7E; // A B C D E F (same as 0)
-    case 'X': case 'x': return 0x37; // B C E F G (same as H)
-    case 'Y': case 'y': return 0x3B; // B C D F G
-    case 'Z': case 'z': return 0x6D; // A B D E G (same as 2)
-    case '-': return 0x01; // G -> bit0 = 0x01 (middle segment)
+    case 'V': case 'v': return 0x3E; // B C D E F
+    case 'W': case 'w': return 0x3F; // A B C D E F
+    case 'X': case 'x': return 0x76; // B C E F G
+    case 'Y': case 'y': return 0x6E; // B C D F G
+    case 'Z': case 'z': return 0x5B; // A B D E G
+
+    case '-': return 0x40; // G
     case '_': return 0x08; // D
-    case '=': return 0x09; // D G
-    case ' ': return 0x00; // Blank
-    case '.': return 0x80; // DP only
+    case '=': return 0x48; // D G
+    case ' ': return 0x00; // blank
+    case '.': return 0x80; // DP
     default: return 0x00; // Blank for unknown characters
   }
 }
 
-inline bool isCodeBCompatible(char value) {
-  // MAX7219 Code-B decode mode supports: 0-9, -, E, H, L, P, blank
-  return (value >= '0' && value <= '9') || 
-         value == '-' || 
-         value == 'E' || value == 'H' || value == 'L' || value == 'P' || 
-         value == ' ';
+// Register bit driving each segment
+template <uint8_t A, uint8_t B, uint8_t C, uint8_t D, uint8_t E, uint8_t F, uint8_t G, uint8_t DP>
+struct SegmentMap {
+  static constexpr uint8_t remap(uint8_t canonical) {
+    return ((canonical >> 0) & 1) << A | ((canonical >> 1) & 1) << B |
+           ((canonical >> 2) & 1) << C | ((canonical >> 3) & 1) << D |
+           ((canonical >> 4) & 1) << E | ((canonical >> 5) & 1) << F |
+           ((canonical >> 6) & 1) << G | ((canonical >> 7) & 1) << DP;
+  }
+};
+
+// MAX7219 no-decode mode: DP A B C D E F G from the MSB down
+typedef SegmentMap<6, 5, 4, 3, 2, 1, 0, 7> SegmentMapMAX7219;
+// Canonical order, used by TM1637 and HT16K33 modules
+typedef SegmentMap<0, 1, 2, 3, 4, 5, 6, 7> SegmentMapLinear;
+
+// Logical position 0 is always the leftmost digit; the order maps it to the
+// chip's digit index
+struct DigitOrderLeftToRight {
+  static constexpr uint8_t index(uint8_t pos, uint8_t /*digits*/) { return pos; }
+};
+
+struct DigitOrderRightToLeft {
+  static constexpr uint8_t index(uint8_t pos, uint8_t digits) { return digits - 1 - pos; }
+};
+
+struct GlyphArray {
+  uint8_t ascii[128];
+  uint8_t codeB[16];
+};
+
+template <class Map>
+constexpr GlyphArray buildGlyphs() {
+  GlyphArray out = {};
+  for (int c = 0; c < 128; c++) {
+    out.ascii[c] = Map::remap(canonicalGlyph((char)c));
+  }
+  // MAX7219 Code-B values: 0-9, -, E, H, L, P, blank
+  const char codeB[] = "0123456789-EHLP ";
+  for (int i = 0; i < 16; i++) {
+    out.codeB[i] = Map::remap(canonicalGlyph(codeB[i]));
+  }
+  return out;
 }
 
+template <class Map>
+struct GlyphTable {
+  static constexpr GlyphArray table = buildGlyphs<Map>();
+  static constexpr uint8_t DP = Map::remap(0x80);
+  static constexpr uint8_t MINUS = Map::remap(0x40);
+
+  static constexpr uint8_t of(char c) {
+    return (uint8_t)c < 128 ? table.ascii[(uint8_t)c] : 0;
+  }
+
+  static constexpr uint8_t digit(uint8_t value) {
+    return table.ascii['0' + value];
+  }
+
+  // Code-B digit value (bit7 = DP), for callers written against decode mode
+  static constexpr uint8_t codeB(uint8_t code) {
+    return table.codeB[code & 0x0F] | ((code & 0x80) ? DP : 0);
+  }
+};
+
 #endif // GLYPHS_H
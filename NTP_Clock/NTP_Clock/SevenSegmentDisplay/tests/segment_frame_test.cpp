@@ -0,0 +1,294 @@
+/*
+ * SegmentFrame unit tests - number, text, scroll and keyframe rendering
+ *
+ * Renders into a backend whose flush() only latches the frame, and checks
+ * the segments against canonicalGlyph() (SegmentMapLinear is the canonical
+ * order, so no remapping is involved). Time comes from the mock Arduino
+ * core, so scrolling and blinking are stepped by hand.
+ *
+ * Built by the CMakeLists.txt at the top of the repository.
+ */
+
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+#include "Arduino.h"
+#include "SegmentFrame.h"
+
+uint64_t mockBusNs = 0;
+
+template <uint8_t Digits, class Order = DigitOrderLeftToRight, uint8_t Devices = 1>
+class TestDisplay
+    : public SegmentFrame<TestDisplay<Digits, Order, Devices>, Digits, SegmentMapLinear, Order, Devices> {
+public:
+  void flush() {
+    memcpy(this->shown, this->frame, sizeof(this->frame));
+    flushes++;
+  }
+
+  // Logical position, leftmost first
+  uint8_t at(uint8_t pos, uint8_t device = 0) const {
+    return this->shown[device][Order::index(pos, Digits)];
+  }
+
+  int flushes = 0;
+};
+
+// Segments a 4-digit display should show for text with no dots, plus a DP
+// mask (bit n: position n)
+static void expectShows(const TestDisplay<4>& d, const char* text, uint8_t dpMask = 0) {
+  for (uint8_t i = 0; i < 4; i++) {
+    uint8_t want = canonicalGlyph(text[i]) | ((dpMask >> i) & 1 ? 0x80 : 0x00);
+    EXPECT_EQ(want, d.at(i)) << "position " << (int)i << " of \"" << text << "\"";
+  }
+}
+
+static void advanceMs(unsigned long ms) { mockBusNs += (uint64_t)ms * 1000000; }
+
+// --- displayFixed ---
+
+TEST(DisplayFixed, OneDecimal) {
+  TestDisplay<4> d;
+  d.displayFixed(1234, 1);
+  expectShows(d, "1234", 0x04);
+  d.displayFixed(56, 1);
+  expectShows(d, "  56", 0x04);
+}
+
+TEST(DisplayFixed, LeadingZeroBeforePoint) {
+  TestDisplay<4> d;
+  d.displayFixed(5, 1);
+  expectShows(d, "  05", 0x04);
+  d.displayFixed(0, 1);
+  expectShows(d, "  00", 0x04);
+  d.displayFixed(7, 3);
+  expectShows(d, "0007", 0x01);
+}
+
+TEST(DisplayFixed, Negative) {
+  TestDisplay<4> d;
+  d.displayFixed(-5, 1);
+  expectShows(d, " -05", 0x04);
+  d.displayFixed(-123, 1);
+  expectShows(d, "-123", 0x04);
+}
+
+TEST(DisplayFixed, ClampsToWhatFits) {
+  TestDisplay<4> d;
+  d.displayFixed(123456, 1);
+  expectShows(d, "9999", 0x04);
+  d.displayFixed(-123456, 1);
+  expectShows(d, "-999", 0x04);
+  d.displayFixed(INT32_MIN, 0);
+  expectShows(d, "-999");
+}
+
+TEST(DisplayFixed, DropsDecimalsThatDontFit) {
+  TestDisplay<4> d;
+  d.displayFixed(12345, 4);   // 1.2345 -> 1.234
+  expectShows(d, "1234", 0x01);
+  d.displayFixed(-12345, 4);  // -1.2345 -> -1.23
+  expectShows(d, "-123", 0x02);
+  d.displayFixed(42, -1);     // Negative decimals are whole numbers
+  expectShows(d, "  42");
+}
+
+TEST(DisplayFixed, RightToLeftWiring) {
+  TestDisplay<4, DigitOrderRightToLeft> d;
+  d.displayFixed(1234, 1);
+  const char* text = "1234";
+  for (uint8_t i = 0; i < 4; i++) {
+    EXPECT_EQ(canonicalGlyph(text[i]) | (i == 2 ? 0x80 : 0x00), d.at(i));
+  }
+}
+
+TEST(DisplayFixed, ChainedDevicesAreIndependent) {
+  TestDisplay<4, DigitOrderLeftToRight, 2> d;
+  d.displayFixed(11, 0);
+  d.selectDevice(1);
+  d.displayFixed(22, 0);
+  for (uint8_t i = 0; i < 4; i++) {
+    EXPECT_EQ(canonicalGlyph("  11"[i]), d.at(i, 0)) << "position " << (int)i;
+    EXPECT_EQ(canonicalGlyph("  22"[i]), d.at(i, 1)) << "position " << (int)i;
+  }
+}
+
+// --- displayText dot merging ---
+
+TEST(DisplayText, DotsMergeIntoPreviousDigit) {
+  TestDisplay<4> d;
+  d.displayText("1.2.3.4.");
+  expectShows(d, "1234", 0x0F);
+  d.displayText("12.34");
+  expectShows(d, "1234", 0x02);
+}
+
+TEST(DisplayText, LeadingAndDoubledDots) {
+  TestDisplay<4> d;
+  d.displayText(".12");
+  expectShows(d, "12  ");
+  d.displayText("1..2");
+  expectShows(d, "12  ", 0x01);
+}
+
+TEST(DisplayText, DotAfterLastDigitStillMerges) {
+  TestDisplay<4> d;
+  d.displayText("1234.5");
+  expectShows(d, "1234", 0x08);
+}
+
+TEST(DisplayText, TruncatesAndJustifies) {
+  TestDisplay<4> d;
+  d.displayText("12345");
+  expectShows(d, "1234");
+  d.displayText("Err");
+  expectShows(d, "Err ");
+  d.displayText("Err", true);
+  expectShows(d, " Err");
+  d.displayText("2.17", true);
+  expectShows(d, " 217", 0x02);
+  d.displayText("");
+  expectShows(d, "    ");
+}
+
+// --- Scrolling ---
+
+// The first count frames update() shows after startScrolling(), as text
+// (DPs in dps, bit n: position n)
+static std::vector<std::string> scrollFrames(TestDisplay<4>& d, const char* text, size_t count,
+                                             std::vector<uint8_t>* dps = nullptr) {
+  std::vector<std::string> frames;
+  d.startScrolling(text, 100);
+  while (frames.size() < count) {
+    advanceMs(100);
+    d.update();
+    std::string shown;
+    uint8_t dp = 0;
+    for (uint8_t i = 0; i < 4; i++) {
+      uint8_t seg = d.at(i);
+      if (seg & 0x80) dp |= 1 << i;
+      char c = '?';
+      for (const char* g = " 0123456789ABCEFHJLPU-"; *g != '\0'; g++) {
+        if (canonicalGlyph(*g) == (seg & 0x7F)) {
+          c = *g;
+          break;
+        }
+      }
+      shown += c;
+    }
+    frames.push_back(shown);
+    if (dps != nullptr) dps->push_back(dp);
+  }
+  return frames;
+}
+
+TEST(Scrolling, PadsStepsAndWraps) {
+  TestDisplay<4> d;
+  std::vector<std::string> frames = scrollFrames(d, "123", 10);
+  const char* want[] = {"    ", "   1", "  12", " 123", "123 ", "23  ", "3   ", "    ", "    ", "   1"};
+  for (size_t i = 0; i < frames.size(); i++) EXPECT_EQ(want[i], frames[i]) << "step " << i;
+}
+
+TEST(Scrolling, IpAddressDots) {
+  TestDisplay<4> d;
+  std::vector<uint8_t> dps;
+  // "10.0.0.1" scrolls as "    10001    " with DPs on the middle zeros
+  std::vector<std::string> frames = scrollFrames(d, "10.0.0.1", 10, &dps);
+  EXPECT_EQ("1000", frames[4]);
+  EXPECT_EQ(0x0E, dps[4]);
+  EXPECT_EQ("0001", frames[5]);
+  EXPECT_EQ(0x07, dps[5]);
+}
+
+TEST(Scrolling, LongTextStaysInBuffer) {
+  // Far past SEGMENT_SCROLL_LEN with padding; this used to run off the end
+  // of the scroll buffer
+  std::string text;
+  for (int i = 0; i < 200; i++) text += (char)('0' + i % 10);
+  std::string kept = "    " + text.substr(0, SEGMENT_SCROLL_LEN - 1 - 2 * 4) + "    ";
+
+  TestDisplay<4> d;
+  size_t positions = kept.size() - 4 + 1;
+  std::vector<std::string> frames = scrollFrames(d, text.c_str(), positions + 2);
+  for (size_t p = 0; p < positions; p++) EXPECT_EQ(kept.substr(p, 4), frames[p]) << "step " << p;
+  // Then back to the start
+  EXPECT_EQ(kept.substr(0, 4), frames[positions]);
+  EXPECT_EQ(kept.substr(1, 4), frames[positions + 1]);
+}
+
+TEST(Scrolling, DotsPastTheCutDontMarkTheLastCharacter) {
+  std::string text;
+  for (int i = 0; i < 100; i++) text += (char)('0' + i % 10);
+  text += ".5.5.";
+  TestDisplay<4> d;
+  std::vector<uint8_t> dps;
+  scrollFrames(d, text.c_str(), SEGMENT_SCROLL_LEN, &dps);
+  for (size_t p = 0; p < dps.size(); p++) EXPECT_EQ(0, dps[p]) << "step " << p;
+}
+
+TEST(Scrolling, TextExactlyAtTheLimit) {
+  std::string text(SEGMENT_SCROLL_LEN - 1 - 2 * 4, '7');
+  TestDisplay<4> d;
+  std::vector<std::string> frames = scrollFrames(d, (text + "1").c_str(), SEGMENT_SCROLL_LEN);
+  for (const std::string& f : frames) EXPECT_EQ(std::string::npos, f.find('1')) << f;
+  EXPECT_EQ("7777", frames[4]);
+}
+
+TEST(Scrolling, DisplayTextStopsIt) {
+  TestDisplay<4> d;
+  d.startScrolling("12345678");
+  EXPECT_TRUE(d.isScrolling());
+  d.displayText("Err");
+  EXPECT_FALSE(d.isScrolling());
+  advanceMs(1000);
+  d.update();
+  expectShows(d, "Err ");
+}
+
+// --- Keyframes ---
+
+TEST(Keyframe, DotsMergeLikeDisplayText) {
+  constexpr Keyframe k = keyframe("2.17", 1000);
+  static_assert(k.length == 3, "dot is not a digit");
+  EXPECT_EQ(canonicalGlyph('2') | 0x80, k.segments[0]);
+  EXPECT_EQ(canonicalGlyph('1'), k.segments[1]);
+  EXPECT_EQ(canonicalGlyph('7'), k.segments[2]);
+
+  constexpr Keyframe lead = keyframe(".A.", 1000);
+  EXPECT_EQ(1, lead.length);
+  EXPECT_EQ(canonicalGlyph('A') | 0x80, lead.segments[0]);
+}
+
+TEST(Keyframe, TruncatesAtMaxDigits) {
+  constexpr Keyframe k = keyframe("123456789.", 1000);
+  EXPECT_EQ(ANIMATION_MAX_DIGITS, k.length);
+  EXPECT_EQ(canonicalGlyph('8') | 0x80, k.segments[ANIMATION_MAX_DIGITS - 1]);
+}
+
+static int animationsDone = 0;
+static void onAnimationDone() { animationsDone++; }
+
+TEST(Keyframe, PlaysAlignsAndBlinks) {
+  static constexpr Keyframe FRAMES[] = {
+    keyframe("2.17", 1000, 0x00, true),
+    keyframe("Conn", 1000, 0x0F),
+  };
+  static constexpr Animation BOOT = animation(FRAMES);
+  TestDisplay<4> d;
+  animationsDone = 0;
+  d.play(BOOT, onAnimationDone);
+  expectShows(d, " 217", 0x02);
+
+  advanceMs(1000);
+  d.update();
+  expectShows(d, "Conn");
+  advanceMs(ANIMATION_BLINK_MS);
+  d.update();
+  expectShows(d, "    ");
+  EXPECT_TRUE(d.isAnimating());
+
+  advanceMs(1000);
+  d.update();
+  EXPECT_FALSE(d.isAnimating());
+  EXPECT_EQ(1, animationsDone);
+}
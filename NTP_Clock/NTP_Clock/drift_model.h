@@ -0,0 +1,167 @@
+/*
+ * DriftModel - Learned oscillator frequency error, by temperature
+ *
+ * The clock's time base is the crystal behind the ESP32 system timer: a few
+ * ppm off (around a second a week per ppm) and further off as it warms or
+ * cools. SntpClient measures that error at every sync - the correction it
+ * applied since the last sync plus the offset that built up anyway, over the
+ * interval - and files it here under the average die temperature of the
+ * interval, as a running average per DRIFT_BIN_WIDTH_C bin. The offset
+ * error is about the same whatever the interval, so a measurement over
+ * 64 s is sixteen times as rough as one over 1024 s; weights go with the
+ * square of the interval.
+ *
+ * In holdover (no sync for a while, e.g. WiFi down) the correction comes from
+ * here instead of the last sync: the current temperature's value,
+ * interpolated between the nearest learned bins either side. The model is
+ * plain data, so the sketch keeps it in Preferences and the next boot starts
+ * out corrected. The crystal may have aged since it was saved, so restored
+ * bins count for little and, until one of them has been measured again, the
+ * others move with it.
+ *
+ * DriftAccumulator turns a ppm rate into whole-microsecond slews without
+ * losing the fraction, so a 0.05 ppm correction still adds up.
+ *
+ * Pure C++ - no Arduino dependencies. tools/holdover_sim.cpp runs it against
+ * a simulated crystal.
+ */
+
+#ifndef DRIFT_MODEL_H
+#define DRIFT_MODEL_H
+
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+
+#define DRIFT_MODEL_VERSION 2       // 2: weights by interval squared; version 1 saves are dropped
+#define DRIFT_BINS          14
+#define DRIFT_BIN_MIN_C     10      // Bins cover 10-80 C of die temperature
+#define DRIFT_BIN_WIDTH_C   5
+#define DRIFT_WEIGHT_UNIT_S 64      // A measurement over this long weighs 1; over 1024 s, 256
+#define DRIFT_SAMPLE_MAX_S  1024    // Longer intervals (an outage) weigh no more than this
+#define DRIFT_WEIGHT_MAX    2048    // Running average over about 8 syncs at 1024 s
+#define DRIFT_RESTORED_MAX  64      // What a saved bin weighs after a reboot
+#define DRIFT_CONFIRMED     512     // Weight at which a restored bin stops moving the others
+#define DRIFT_MAX_PPM       500.0f
+
+// Kept in Preferences as it is, so plain data with a version
+struct DriftModel {
+  uint8_t version;
+  uint8_t reserved;
+  uint16_t unconfirmed;             // Restored bins not measured enough since, one bit each
+  float currentPpm;                 // The sync loop's latest estimate, to start the next boot from
+  float ppm[DRIFT_BINS];
+  uint16_t weight[DRIFT_BINS];      // Measurement weight in each bin, up to DRIFT_WEIGHT_MAX
+
+  DriftModel() { clear(); }
+
+  void clear() {
+    memset(this, 0, sizeof(*this));
+    version = DRIFT_MODEL_VERSION;
+  }
+
+  bool valid() const { return version == DRIFT_MODEL_VERSION && !isnan(currentPpm); }
+
+  bool trained() const {
+    for (uint8_t i = 0; i < DRIFT_BINS; i++) {
+      if (weight[i] > 0) return true;
+    }
+    return false;
+  }
+
+  // Saved by an earlier boot: the bins are a guess until measured again
+  void restored() {
+    unconfirmed = 0;
+    for (uint8_t i = 0; i < DRIFT_BINS; i++) {
+      if (weight[i] > DRIFT_RESTORED_MAX) weight[i] = DRIFT_RESTORED_MAX;
+      if (weight[i] > 0) unconfirmed |= 1u << i;
+    }
+  }
+
+  // One measurement of the oscillator error over an interval at tempC (NAN: unknown)
+  void learn(float measuredPpm, float tempC, uint32_t seconds) {
+    if (isnan(measuredPpm) || isnan(tempC)) return;
+    if (measuredPpm > DRIFT_MAX_PPM) measuredPpm = DRIFT_MAX_PPM;
+    if (measuredPpm < -DRIFT_MAX_PPM) measuredPpm = -DRIFT_MAX_PPM;
+    if (seconds > DRIFT_SAMPLE_MAX_S) seconds = DRIFT_SAMPLE_MAX_S;
+    uint32_t w = seconds * seconds / (DRIFT_WEIGHT_UNIT_S * DRIFT_WEIGHT_UNIT_S);
+    if (w == 0) w = 1;
+    int b = binOf(tempC);
+    w += weight[b];
+    float step = (measuredPpm - ppm[b]) * (w - weight[b]) / w;
+    weight[b] = w < DRIFT_WEIGHT_MAX ? w : DRIFT_WEIGHT_MAX;
+
+    // Aging moves every bin about alike, so what a restored bin turns out to
+    // be off by, the restored bins not measured yet are taken to be off by too
+    uint16_t bit = 1u << b;
+    if (!(unconfirmed & bit)) {
+      ppm[b] += step;
+      return;
+    }
+    for (uint8_t i = 0; i < DRIFT_BINS; i++) {
+      if (unconfirmed & (1u << i)) ppm[i] += step;
+    }
+    if (weight[b] >= DRIFT_CONFIRMED) unconfirmed &= ~bit;
+  }
+
+  // Correction for tempC: straight line between the learned bins around it,
+  // the nearest one past the end, fallback if nothing is learned yet
+  float predict(float tempC, float fallback) const {
+    if (isnan(tempC)) return fallback;
+    float x = (tempC - DRIFT_BIN_MIN_C) / DRIFT_BIN_WIDTH_C - 0.5f;   // In bin centres
+    int lo = (int)floorf(x);
+    int hi = lo + 1;
+    if (lo > DRIFT_BINS - 1) lo = DRIFT_BINS - 1;
+    if (hi < 0) hi = 0;
+    while (lo >= 0 && weight[lo] == 0) lo--;
+    while (hi < DRIFT_BINS && weight[hi] == 0) hi++;
+    if (lo < 0 && hi >= DRIFT_BINS) return fallback;
+    if (lo < 0) return ppm[hi];
+    if (hi >= DRIFT_BINS || hi == lo) return ppm[lo];
+    float t = (x - lo) / (hi - lo);
+    if (t < 0) t = 0;
+    if (t > 1) t = 1;
+    return ppm[lo] + (ppm[hi] - ppm[lo]) * t;
+  }
+
+  static int binOf(float tempC) {
+    int b = (int)floorf((tempC - DRIFT_BIN_MIN_C) / DRIFT_BIN_WIDTH_C);
+    return b < 0 ? 0 : b >= DRIFT_BINS ? DRIFT_BINS - 1 : b;
+  }
+};
+
+// Oscillator error over an interval: the rate that was applied, plus what
+// still built up (offset = server - local, so positive means we ran slow)
+inline float driftMeasuredPpm(int64_t appliedUs, int64_t offsetUs, int64_t elapsedUs) {
+  return (float)((double)(appliedUs + offsetUs) * 1e6 / (double)elapsedUs);
+}
+
+// Frequency-locked loop step: the residual offset since the last correction
+// is error the estimate doesn't cover yet (gain 1/4)
+inline float driftLoopUpdate(float ppm, int64_t offsetUs, int64_t elapsedUs) {
+  ppm += (float)((double)offsetUs * 1e6 / (double)elapsedUs) / 4.0f;
+  if (ppm > DRIFT_MAX_PPM) ppm = DRIFT_MAX_PPM;
+  if (ppm < -DRIFT_MAX_PPM) ppm = -DRIFT_MAX_PPM;
+  return ppm;
+}
+
+class DriftAccumulator {
+public:
+  DriftAccumulator() : carryNs(0) {}
+
+  // Whole microseconds to slew for elapsedMs at ppm (1 ppm for 1 ms is 1 ns);
+  // the rest waits for the next call
+  int64_t takeUs(float ppm, uint32_t elapsedMs) {
+    int64_t ns = (int64_t)llround((double)ppm * elapsedMs) + carryNs;
+    int64_t us = ns / 1000;
+    carryNs = ns - us * 1000;
+    return us;
+  }
+
+  void reset() { carryNs = 0; }
+
+private:
+  int64_t carryNs;
+};
+
+#endif // DRIFT_MODEL_H
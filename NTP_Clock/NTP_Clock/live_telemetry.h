@@ -0,0 +1,367 @@
+/*
+ * Live telemetry - Field snapshots as UDP broadcasts and Server-Sent Events
+ *
+ * The sketch fills a TelemetrySnapshot (sync state, brightness, temperature,
+ * ...) a few times a second; two publishers take it from there:
+ *
+ * - TelemetryBroadcast samples it every periodMs and sends batches of
+ *   samples as one UDP broadcast, for a host watching many devices
+ *   (tools/telemetry_listen.py). Each packet decodes on its own: the first
+ *   sample carries every field, later ones only the fields that changed.
+ * - EventStream keeps a few HTTP connections open as an event stream
+ *   (text/event-stream) and pushes a JSON object of just the fields that
+ *   changed since that subscriber's last event, for the dashboard page.
+ *   A subscriber whose socket can't take more is skipped, not waited for,
+ *   and gets the accumulated changes once it can; one that stays stuck for
+ *   TELEMETRY_SSE_STALL_MS is dropped.
+ *
+ * A UDP packet is, little-endian:
+ *
+ *   u8  version        TELEMETRY_UDP_VERSION
+ *   u8  type           TELEMETRY_UDP_TYPE ('T')
+ *   u8  kind           TELEMETRY_KIND_*: which firmware sent it
+ *   u8  count          Samples in this packet
+ *   u32 device         Low three bytes of the MAC
+ *   u16 seq            Packet counter; gaps mean lost packets
+ *   u32 ms             millis() of the first sample
+ *   count x {
+ *     u16 dt           ms since the previous sample (0 for the first)
+ *     u16 mask         Bit n set: field n follows
+ *     fields           In TELEMETRY_FIELDS order, each its own width, signed
+ *   }
+ *
+ * Pure C++ - no Arduino dependencies. The sketch hands EventStream its
+ * connections wrapped in a Client type with connected(), available(), read(),
+ * writable(), write() and stop(); tools/telemetry_bench.cpp runs both
+ * publishers over localhost sockets.
+ */
+
+#ifndef LIVE_TELEMETRY_H
+#define LIVE_TELEMETRY_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#define TELEMETRY_UDP_PORT       4210
+#define TELEMETRY_UDP_VERSION    1
+#define TELEMETRY_UDP_TYPE       0x54    // 'T'
+#define TELEMETRY_UDP_HEADER     14
+#define TELEMETRY_BATCH_MAX      32      // Keeps a full packet under one Ethernet MTU
+#define TELEMETRY_PERIOD_MIN_MS  250
+#define TELEMETRY_DEFAULT_PERIOD_MS 0    // Off until asked for: broadcasts reach the whole network
+#define TELEMETRY_DEFAULT_BATCH  10
+#define TELEMETRY_SSE_PORT       81
+#define TELEMETRY_SSE_MAX        4       // Open dashboards at once
+#define TELEMETRY_SSE_EVENT_MAX  384
+#define TELEMETRY_SSE_REQUEST_MS 1000    // Longest to wait for the request before answering
+#define TELEMETRY_SSE_KEEPALIVE_MS 15000 // Comment line when nothing changed, to spot dead peers
+#define TELEMETRY_SSE_STALL_MS   10000
+
+#define TELEMETRY_KIND_CLOCK     1
+#define TELEMETRY_KIND_CHIRP     2
+
+// id, JSON name, bytes in a UDP sample, divisor for the JSON value.
+// Append only: receivers decode by position.
+#define TELEMETRY_FIELDS(X) \
+  X(SYNCED,     "synced",     1, 1)     /* 0 never, 1 synced, 2 holdover (syncs lost) */ \
+  X(OFFSET_US,  "offset_us",  4, 1)     /* Last SNTP offset */ \
+  X(JITTER_US,  "jitter_us",  4, 1) \
+  X(DRIFT_PPM,  "drift_ppm",  4, 1000)  /* Learned oscillator error */ \
+  X(POLL_SEC,   "poll_s",     2, 1)     /* SNTP poll interval */ \
+  X(BRIGHTNESS, "brightness", 1, 1) \
+  X(CHIP_C,     "chip_c",     2, 100)   /* Die temperature */ \
+  X(TEMP_C,     "temp_c",     2, 100)   /* Probe temperature (temp_chirp) */ \
+  X(BAND,       "band",       1, 1)     /* Chirp band, -1 below threshold (temp_chirp) */ \
+  X(RSSI,       "rssi",       1, 1)
+
+#define TELEMETRY_FIELD_ENUM(id, name, bytes, scale) TM_##id,
+enum TelemetryField : uint8_t {
+  TELEMETRY_FIELDS(TELEMETRY_FIELD_ENUM)
+  TELEMETRY_FIELD_COUNT
+};
+#undef TELEMETRY_FIELD_ENUM
+
+static_assert(TELEMETRY_FIELD_COUNT <= 16, "Sample masks are 16 bits");
+
+struct TelemetryFieldInfo {
+  const char* name;
+  uint8_t bytes;
+  int32_t scale;
+};
+
+inline const TelemetryFieldInfo& telemetryField(uint8_t field) {
+#define TELEMETRY_FIELD_INFO(id, name, bytes, scale) {name, bytes, scale},
+  static const TelemetryFieldInfo FIELDS[] = { TELEMETRY_FIELDS(TELEMETRY_FIELD_INFO) };
+#undef TELEMETRY_FIELD_INFO
+  return FIELDS[field];
+}
+
+// Largest UDP sample: dt, mask and every field
+constexpr size_t telemetrySampleMax() {
+#define TELEMETRY_FIELD_BYTES(id, name, bytes, scale) + bytes
+  return 4 TELEMETRY_FIELDS(TELEMETRY_FIELD_BYTES);
+#undef TELEMETRY_FIELD_BYTES
+}
+
+#define TELEMETRY_UDP_MAX (TELEMETRY_UDP_HEADER + TELEMETRY_BATCH_MAX * telemetrySampleMax())
+static_assert(TELEMETRY_UDP_MAX <= 1472, "A full batch must fit one datagram");
+
+// The fields a device has, with their current values. Values are stored at
+// full width and cut to the field's width when sent.
+struct TelemetrySnapshot {
+  uint16_t present;
+  int32_t value[TELEMETRY_FIELD_COUNT];
+
+  TelemetrySnapshot() : present(0) { memset(value, 0, sizeof(value)); }
+
+  void set(TelemetryField field, int32_t v) {
+    present |= 1u << field;
+    value[field] = v;
+  }
+
+  // Fields present in this snapshot whose value differs from (or is missing in) before
+  uint16_t changedFrom(const TelemetrySnapshot& before) const {
+    uint16_t changed = present & ~before.present;
+    for (uint8_t i = 0; i < TELEMETRY_FIELD_COUNT; i++) {
+      if ((present & before.present & (1u << i)) && value[i] != before.value[i]) changed |= 1u << i;
+    }
+    return changed;
+  }
+};
+
+inline void telemetryPut(uint8_t* out, size_t& len, uint32_t v, uint8_t bytes) {
+  for (uint8_t b = 0; b < bytes; b++) out[len++] = (uint8_t)(v >> (8 * b));
+}
+
+// "name":value for each field in mask, scaled values with their decimals.
+// Returns the length written, 0 if it didn't fit.
+inline size_t telemetryJson(const TelemetrySnapshot& snap, uint16_t mask, char* out, size_t size) {
+  size_t n = 0;
+  out[n++] = '{';
+  for (uint8_t i = 0; i < TELEMETRY_FIELD_COUNT; i++) {
+    if (!(mask & (1u << i))) continue;
+    const TelemetryFieldInfo& f = telemetryField(i);
+    int32_t v = snap.value[i];
+    int w;
+    if (f.scale == 1) {
+      w = snprintf(out + n, size - n, "%s\"%s\":%ld", n > 1 ? "," : "", f.name, (long)v);
+    } else {
+      int decimals = 0;
+      for (int32_t s = f.scale; s > 1; s /= 10) decimals++;
+      uint32_t mag = v < 0 ? 0u - (uint32_t)v : (uint32_t)v;
+      w = snprintf(out + n, size - n, "%s\"%s\":%s%lu.%0*lu", n > 1 ? "," : "", f.name, v < 0 ? "-" : "",
+                   (unsigned long)(mag / f.scale), decimals, (unsigned long)(mag % f.scale));
+    }
+    if (w < 0 || (size_t)w >= size - n) return 0;
+    n += w;
+  }
+  if (n + 2 > size) return 0;
+  out[n++] = '}';
+  out[n] = '\0';
+  return n;
+}
+
+class TelemetryBroadcast {
+public:
+  typedef bool (*Sink)(const uint8_t* data, size_t len);   // False: packet not sent
+
+  TelemetryBroadcast() : sink(nullptr), device(0), kind(0), periodMs(0), batch(1), seq(0), count(0),
+                         len(0), firstMs(0), lastMs(0), sampledMs(0), packets(0), failures(0) {}
+
+  // periodMs 0 turns the broadcast off
+  void begin(Sink output, uint32_t deviceId, uint8_t deviceKind, uint32_t period, uint8_t samplesPerPacket) {
+    sink = output;
+    device = deviceId;
+    kind = deviceKind;
+    periodMs = period == 0 ? 0 : period < TELEMETRY_PERIOD_MIN_MS ? TELEMETRY_PERIOD_MIN_MS : period > 60000 ? 60000 : period;
+    batch = samplesPerPacket < 1 ? 1 : samplesPerPacket > TELEMETRY_BATCH_MAX ? TELEMETRY_BATCH_MAX : samplesPerPacket;
+    count = 0;
+    sampledMs = 0;
+  }
+
+  bool enabled() const { return sink != nullptr && periodMs != 0; }
+
+  // Takes a sample if one is due, and sends the packet once it holds batch samples
+  void poll(const TelemetrySnapshot& snap, unsigned long now) {
+    if (!enabled()) return;
+    if (sampledMs != 0 && now - sampledMs < periodMs) return;
+    sampledMs = now == 0 ? 1 : now;
+
+    if (count > 0 && now - lastMs > 0xFFFF) flush();
+    if (count == 0) {
+      len = TELEMETRY_UDP_HEADER;
+      firstMs = lastMs = now;
+    }
+    uint16_t mask = count == 0 ? snap.present : snap.changedFrom(previous);
+    telemetryPut(packet, len, now - lastMs, 2);
+    telemetryPut(packet, len, mask, 2);
+    for (uint8_t i = 0; i < TELEMETRY_FIELD_COUNT; i++) {
+      if (mask & (1u << i)) telemetryPut(packet, len, (uint32_t)snap.value[i], telemetryField(i).bytes);
+    }
+    previous = snap;
+    lastMs = now;
+    if (++count >= batch) flush();
+  }
+
+  uint32_t packetsSent() const { return packets; }
+  uint32_t sendFailures() const { return failures; }
+
+private:
+  Sink sink;
+  uint32_t device;
+  uint8_t kind;
+  uint32_t periodMs;
+  uint8_t batch;
+  uint16_t seq;
+  uint8_t count;
+  size_t len;
+  unsigned long firstMs;
+  unsigned long lastMs;
+  unsigned long sampledMs;
+  uint32_t packets;
+  uint32_t failures;
+  TelemetrySnapshot previous;
+  uint8_t packet[TELEMETRY_UDP_MAX];
+
+  void flush() {
+    size_t header = 0;
+    packet[header++] = TELEMETRY_UDP_VERSION;
+    packet[header++] = TELEMETRY_UDP_TYPE;
+    packet[header++] = kind;
+    packet[header++] = count;
+    telemetryPut(packet, header, device, 4);
+    telemetryPut(packet, header, seq++, 2);
+    telemetryPut(packet, header, firstMs, 4);
+    if (sink(packet, len)) packets++;
+    else failures++;
+    count = 0;
+  }
+};
+
+template <class Client, uint8_t MaxSubscribers = TELEMETRY_SSE_MAX>
+class EventStream {
+public:
+  EventStream() : bytes(0), events(0) {
+    for (uint8_t i = 0; i < MaxSubscribers; i++) subs[i].state = FREE;
+  }
+
+  // A new connection; answered once its request is in. When all slots are
+  // taken it is turned away with 503.
+  void add(const Client& client, unsigned long now) {
+    for (uint8_t i = 0; i < MaxSubscribers; i++) {
+      Subscriber& s = subs[i];
+      if (s.state != FREE) continue;
+      s.client = client;
+      s.state = REQUEST;
+      s.matched = 0;
+      s.sinceMs = now;
+      s.blockedMs = 0;
+      s.sent = TelemetrySnapshot();
+      return;
+    }
+    Client rejected = client;
+    static const char BUSY[] = "HTTP/1.1 503 Service Unavailable\r\nConnection: close\r\nContent-Length: 0\r\n\r\n";
+    if (rejected.writable()) rejected.write((const uint8_t*)BUSY, sizeof(BUSY) - 1);
+    rejected.stop();
+  }
+
+  void poll(const TelemetrySnapshot& snap, unsigned long now) {
+    for (uint8_t i = 0; i < MaxSubscribers; i++) {
+      Subscriber& s = subs[i];
+      if (s.state == FREE) continue;
+      if (!s.client.connected()) {
+        close(s);
+        continue;
+      }
+      if (s.state == REQUEST && !readRequest(s, now)) continue;
+
+      if (!s.client.writable()) {
+        if (s.blockedMs == 0) s.blockedMs = now == 0 ? 1 : now;
+        else if (now - s.blockedMs >= TELEMETRY_SSE_STALL_MS) close(s);
+        continue;
+      }
+      s.blockedMs = 0;
+      if (s.state == REQUEST) {
+        // Allows the dashboard to be served from the main web server's port
+        static const char HEADER[] =
+          "HTTP/1.1 200 OK\r\nContent-Type: text/event-stream\r\nCache-Control: no-cache\r\n"
+          "Access-Control-Allow-Origin: *\r\nConnection: keep-alive\r\n\r\nretry: 3000\n\n";
+        if (!send(s, HEADER, sizeof(HEADER) - 1, now)) continue;
+        s.state = STREAMING;
+      }
+
+      uint16_t changed = snap.changedFrom(s.sent);
+      if (changed != 0) {
+        char event[TELEMETRY_SSE_EVENT_MAX];
+        size_t n = 6;
+        memcpy(event, "data: ", 6);
+        size_t json = telemetryJson(snap, changed, event + n, sizeof(event) - n - 2);
+        if (json == 0) continue;
+        n += json;
+        event[n++] = '\n';
+        event[n++] = '\n';
+        if (!send(s, event, n, now)) continue;
+        s.sent = snap;
+        events++;
+      } else if (now - s.sinceMs >= TELEMETRY_SSE_KEEPALIVE_MS) {
+        send(s, ":\n\n", 3, now);
+      }
+    }
+  }
+
+  uint8_t subscribers() const {
+    uint8_t n = 0;
+    for (uint8_t i = 0; i < MaxSubscribers; i++) n += subs[i].state == STREAMING;
+    return n;
+  }
+
+  uint32_t bytesSent() const { return bytes; }
+  uint32_t eventsSent() const { return events; }
+
+private:
+  enum State : uint8_t { FREE, REQUEST, STREAMING };
+
+  struct Subscriber {
+    Client client;
+    State state;
+    uint8_t matched;          // How much of the blank line ending the request has been read
+    unsigned long sinceMs;    // Connected, or last written to
+    unsigned long blockedMs;  // When the socket stopped taking writes, 0 if it hasn't
+    TelemetrySnapshot sent;   // What this subscriber has been told
+  };
+
+  Subscriber subs[MaxSubscribers];
+  uint32_t bytes;
+  uint32_t events;
+
+  // Reads (and ignores) the request; true once it has ended or taken too long
+  bool readRequest(Subscriber& s, unsigned long now) {
+    static const char END[] = "\r\n\r\n";
+    while (s.matched < 4 && s.client.available() > 0) {
+      char c = (char)s.client.read();
+      s.matched = c == END[s.matched] ? s.matched + 1 : (c == '\r' ? 1 : 0);
+    }
+    if (s.matched < 4 && now - s.sinceMs < TELEMETRY_SSE_REQUEST_MS) return false;
+    s.sinceMs = now;
+    return true;
+  }
+
+  bool send(Subscriber& s, const char* data, size_t len, unsigned long now) {
+    if (s.client.write((const uint8_t*)data, len) != len) {
+      close(s);
+      return false;
+    }
+    s.sinceMs = now;
+    bytes += len;
+    return true;
+  }
+
+  void close(Subscriber& s) {
+    s.client.stop();
+    s.client = Client();
+    s.state = FREE;
+  }
+};
+
+#endif // LIVE_TELEMETRY_H
@@ -0,0 +1,479 @@
+/*
+ * SntpClient - Multi-server SNTP client with delay filtering and drift tracking
+ *
+ * Replaces the single-server configTime() SNTP so we can see offset, delay and
+ * sync quality. Call poll() from loop(); it never blocks waiting for a reply.
+ *
+ * - Each poll sends a short burst of SNTP_BURST_SIZE requests to every configured
+ *   server (one request in flight at a time)
+ * - Per server, the sample with the lowest round-trip delay in the burst wins,
+ *   since queueing delay is what makes offsets wrong (the classic NTP clock filter)
+ * - The poll result is the median of the per-server filtered offsets
+ * - Small offsets are slewed with adjtime(), only large ones step the clock
+ * - Residual offset between polls trains a frequency estimate (ppm), which is
+ *   applied as a small slew every SNTP_DRIFT_TICK_MS and lets the poll
+ *   interval back off from 64s to 1024s once the clock is stable
+ * - Server names are looked up once and the address kept. A server that
+ *   answers nothing for SNTP_STALE_POLLS polls is looked up again (pool
+ *   rotation); a failed lookup is retried after a doubling back-off, since
+ *   WiFi.hostByName() blocks the loop while DNS is unreachable
+ * - Each poll also measures the oscillator error against the die temperature
+ *   (drift_model.h). With no good poll for twice the poll interval, the
+ *   clock is in holdover and is corrected from that model for the current
+ *   temperature until syncs come back
+ */
+
+#ifndef SNTP_CLIENT_H
+#define SNTP_CLIENT_H
+
+#include <WiFi.h>
+#include <WiFiUdp.h>
+#include <sys/time.h>
+#include <time.h>
+#include <string.h>
+#include "event_log.h"
+#include "drift_model.h"
+
+#define SNTP_DEFAULT_SERVERS    "pool.ntp.org,time.google.com,time.cloudflare.com"
+#define SNTP_MAX_SERVERS        4
+#define SNTP_SERVERS_MAX_LEN    200     // The comma-separated list as saved in Preferences
+#define SNTP_BURST_SIZE         4
+#define SNTP_PORT               123
+#define SNTP_LOCAL_PORT         4123
+#define SNTP_REPLY_TIMEOUT_MS   1500
+#define SNTP_MIN_POLL_EXP       6       // 64 s
+#define SNTP_MAX_POLL_EXP       10      // 1024 s
+#define SNTP_RETRY_MS           8000    // Retry interval before first sync
+#define SNTP_STEP_THRESHOLD_US  128000  // Offsets above this step instead of slewing
+#define SNTP_STABLE_OFFSET_US   5000    // Offsets below this count towards backing off
+#define SNTP_UNSTABLE_OFFSET_US 50000   // Offsets above this tighten polling again
+#define SNTP_DRIFT_TICK_MS      10000
+#define SNTP_HOLDOVER_GRACE_MS  60000   // Past twice the poll interval before holdover starts
+#define SNTP_STALE_POLLS        3       // Polls without a reply before looking the name up again
+#define SNTP_RESOLVE_RETRY_MS   8000    // First retry after a failed lookup, doubling
+#define SNTP_RESOLVE_MAX_MS     1024000 // Longest wait between failed lookups
+
+// NTP timestamps count seconds from 1900, Unix time from 1970
+#define SNTP_UNIX_OFFSET 2208988800ULL
+
+class SntpClient {
+public:
+  struct Stats {
+    int64_t offsetUs;          // Last combined offset (server - local)
+    int64_t delayUs;           // Round-trip delay of the best sample used
+    int64_t jitterUs;          // Spread of the per-server offsets
+    float driftPpm;            // Learned local oscillator error
+    uint32_t pollIntervalSec;
+    uint8_t serversUsed;       // Servers that contributed to the last poll
+    uint32_t polls;
+    uint32_t timeouts;
+  };
+
+  SntpClient() {
+    serverCount = 0;
+    state = STATE_IDLE;
+    synced = false;
+    memset(&stats, 0, sizeof(stats));
+    pollExp = SNTP_MIN_POLL_EXP;
+    stableCount = 0;
+    nextPollAt = 0;
+    lastDriftTick = 0;
+    lastSyncUs = 0;
+    lastGoodPollMs = 0;
+    appliedSinceSyncUs = 0;
+    holdover = false;
+    modelDirty = false;
+    temperatureC = NAN;
+    tempSum = 0;
+    tempCount = 0;
+  }
+
+  // servers: comma-separated host names, e.g. "pool.ntp.org,time.google.com"
+  void begin(const char* servers) {
+    serverCount = 0;
+    const char* p = servers;
+    while (*p && serverCount < SNTP_MAX_SERVERS) {
+      while (*p == ',' || *p == ' ') p++;
+      const char* end = p;
+      while (*end && *end != ',') end++;
+      size_t len = end - p;
+      while (len > 0 && p[len - 1] == ' ') len--;
+      if (len > 0 && len < sizeof(this->servers[0].host)) {
+        Server& s = this->servers[serverCount++];
+        memcpy(s.host, p, len);
+        s.host[len] = '\0';
+        s.resolved = false;
+        s.resolveFails = 0;
+        s.resolveAt = 0;
+        s.missedPolls = 0;
+        s.sampleCount = 0;
+      }
+      p = end;
+    }
+
+    udp.stop();
+    udp.begin(SNTP_LOCAL_PORT);
+    state = STATE_IDLE;
+    nextPollAt = millis();
+    lastDriftTick = millis();
+  }
+
+  void poll() {
+    unsigned long now = millis();
+
+    applyDrift(now);
+    checkHoldover(now);
+
+    if (serverCount == 0 || WiFi.status() != WL_CONNECTED) return;
+
+    switch (state) {
+      case STATE_IDLE:
+        if ((long)(now - nextPollAt) >= 0) {
+          for (int i = 0; i < serverCount; i++) servers[i].sampleCount = 0;
+          currentServer = 0;
+          burstIndex = 0;
+          state = STATE_SEND;
+        }
+        break;
+
+      case STATE_SEND:
+        if (currentServer >= serverCount) {
+          finishPoll();
+          break;
+        }
+        if (sendRequest(servers[currentServer], now)) {
+          requestSentAt = now;
+          state = STATE_WAIT;
+        } else {
+          nextServer();
+        }
+        break;
+
+      case STATE_WAIT:
+        if (receiveReply(servers[currentServer])) {
+          servers[currentServer].missedPolls = 0;
+          if (++burstIndex >= SNTP_BURST_SIZE) nextServer();
+          state = STATE_SEND;
+        } else if (now - requestSentAt >= SNTP_REPLY_TIMEOUT_MS) {
+          stats.timeouts++;
+          Server& s = servers[currentServer];
+          if (burstIndex == 0 && ++s.missedPolls >= SNTP_STALE_POLLS) {
+            s.resolved = false;  // Gone quiet: the pool may have moved it (look it up again)
+            s.missedPolls = 0;
+          }
+          nextServer();
+          state = STATE_SEND;
+        }
+        break;
+    }
+  }
+
+  bool isSynced() const { return synced; }
+  const Stats& getStats() const { return stats; }
+
+  // Synced before, but not for a while: the time is running on the drift model
+  bool inHoldover() const { return holdover; }
+
+  // Die temperature in C, every few seconds, for the drift model
+  void setTemperature(float c) {
+    temperatureC = c;
+    tempSum += c;
+    tempCount++;
+  }
+
+  // A model saved by an earlier boot; the loop starts from its estimate
+  void setDriftModel(const DriftModel& saved) {
+    if (!saved.valid()) return;
+    model = saved;
+    model.restored();
+    stats.driftPpm = model.predict(temperatureC, model.currentPpm);
+  }
+
+  const DriftModel& getDriftModel() const { return model; }
+  bool driftModelChanged() const { return modelDirty; }
+  void driftModelSaved() { modelDirty = false; }
+
+private:
+  enum State { STATE_IDLE, STATE_SEND, STATE_WAIT };
+
+  struct Sample {
+    int64_t offsetUs;
+    int64_t delayUs;
+  };
+
+  struct Server {
+    char host[48];
+    IPAddress ip;
+    bool resolved;
+    uint8_t resolveFails;      // Failed lookups in a row, for the back-off
+    unsigned long resolveAt;   // No lookup before this after a failure
+    uint8_t missedPolls;       // Polls in a row it didn't answer at all
+    Sample samples[SNTP_BURST_SIZE];
+    uint8_t sampleCount;
+  };
+
+  WiFiUDP udp;
+  Server servers[SNTP_MAX_SERVERS];
+  uint8_t serverCount;
+  uint8_t currentServer;
+  uint8_t burstIndex;
+  State state;
+  bool synced;
+  Stats stats;
+  uint8_t pollExp;
+  uint8_t stableCount;
+  unsigned long nextPollAt;
+  unsigned long requestSentAt;
+  unsigned long lastDriftTick;
+  int64_t lastSyncUs;
+  unsigned long lastGoodPollMs;
+  int64_t appliedSinceSyncUs;  // Drift correction slewed in since lastSyncUs
+  DriftAccumulator driftCarry;
+  DriftModel model;
+  bool holdover;
+  bool modelDirty;
+  float temperatureC;
+  float tempSum;               // Temperatures since the last sync, for its average
+  uint32_t tempCount;
+  uint32_t sentSec;
+  uint32_t sentFrac;
+  int64_t sentUs;
+
+  void nextServer() {
+    currentServer++;
+    burstIndex = 0;
+  }
+
+  static int64_t nowUs() {
+    struct timeval tv;
+    gettimeofday(&tv, nullptr);
+    return (int64_t)tv.tv_sec * 1000000LL + tv.tv_usec;
+  }
+
+  static uint32_t readBE32(const uint8_t* p) {
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+  }
+
+  static void writeBE32(uint8_t* p, uint32_t v) {
+    p[0] = v >> 24; p[1] = v >> 16; p[2] = v >> 8; p[3] = v;
+  }
+
+  // NTP 32.32 fixed point to Unix microseconds
+  static int64_t ntpToUs(uint32_t sec, uint32_t frac) {
+    int64_t unixSec = (int64_t)sec - (int64_t)SNTP_UNIX_OFFSET;
+    return unixSec * 1000000LL + (int64_t)(((uint64_t)frac * 1000000ULL) >> 32);
+  }
+
+  bool sendRequest(Server& s, unsigned long now) {
+    if (!s.resolved && !resolve(s, now)) return false;
+
+    // Drop anything left over from a previous (timed out) request
+    while (udp.parsePacket() > 0) {
+      while (udp.available()) udp.read();
+    }
+
+    uint8_t packet[48];
+    memset(packet, 0, sizeof(packet));
+    packet[0] = 0x23;  // LI=0, VN=4, Mode=3 (client)
+
+    sentUs = nowUs();
+    sentSec = (uint32_t)(sentUs / 1000000LL + SNTP_UNIX_OFFSET);
+    sentFrac = (uint32_t)(((uint64_t)(sentUs % 1000000LL) << 32) / 1000000ULL);
+    writeBE32(packet + 40, sentSec);  // Transmit timestamp, echoed back as originate
+    writeBE32(packet + 44, sentFrac);
+
+    if (!udp.beginPacket(s.ip, SNTP_PORT)) return false;
+    udp.write(packet, sizeof(packet));
+    return udp.endPacket();
+  }
+
+  // Blocks for the DNS round trip (or its timeout), so only when needed
+  bool resolve(Server& s, unsigned long now) {
+    if (s.resolveFails > 0 && (long)(now - s.resolveAt) < 0) return false;
+    if (!WiFi.hostByName(s.host, s.ip)) {
+      unsigned long waitMs = SNTP_RESOLVE_RETRY_MS << (s.resolveFails < 7 ? s.resolveFails : 7);
+      s.resolveAt = now + (waitMs < SNTP_RESOLVE_MAX_MS ? waitMs : SNTP_RESOLVE_MAX_MS);
+      if (s.resolveFails < 255) s.resolveFails++;
+      return false;
+    }
+    s.resolved = true;
+    s.resolveFails = 0;
+    return true;
+  }
+
+  bool receiveReply(Server& s) {
+    int size = udp.parsePacket();
+    if (size <= 0) return false;
+
+    int64_t t4 = nowUs();
+    uint8_t packet[48];
+    if (size < 48 || udp.read(packet, sizeof(packet)) < 48) return false;
+
+    // Ignore replies that don't answer our outstanding request
+    if (readBE32(packet + 24) != sentSec || readBE32(packet + 28) != sentFrac) return false;
+
+    uint8_t mode = packet[0] & 0x07;
+    uint8_t leap = packet[0] >> 6;
+    uint8_t stratum = packet[1];
+    if (mode != 4 || leap == 3 || stratum == 0 || stratum > 15) return true;  // Answered, but unusable
+
+    int64_t t1 = sentUs;
+    int64_t t2 = ntpToUs(readBE32(packet + 32), readBE32(packet + 36));
+    int64_t t3 = ntpToUs(readBE32(packet + 40), readBE32(packet + 44));
+
+    Sample sample;
+    sample.offsetUs = ((t2 - t1) + (t3 - t4)) / 2;
+    sample.delayUs = (t4 - t1) - (t3 - t2);
+    if (sample.delayUs < 0) sample.delayUs = 0;
+
+    if (s.sampleCount < SNTP_BURST_SIZE) s.samples[s.sampleCount++] = sample;
+    return true;
+  }
+
+  // Lowest-delay sample of the server's burst
+  static bool bestSample(const Server& s, Sample& best) {
+    if (s.sampleCount == 0) return false;
+    best = s.samples[0];
+    for (int i = 1; i < s.sampleCount; i++) {
+      if (s.samples[i].delayUs < best.delayUs) best = s.samples[i];
+    }
+    return true;
+  }
+
+  void finishPoll() {
+    state = STATE_IDLE;
+    stats.polls++;
+
+    Sample candidates[SNTP_MAX_SERVERS];
+    int n = 0;
+    for (int i = 0; i < serverCount; i++) {
+      if (bestSample(servers[i], candidates[n])) n++;
+    }
+
+    if (n == 0) {
+      nextPollAt = millis() + (synced ? (1000UL << SNTP_MIN_POLL_EXP) : SNTP_RETRY_MS);
+      return;
+    }
+
+    // Median by offset (insertion sort, n <= SNTP_MAX_SERVERS)
+    for (int i = 1; i < n; i++) {
+      Sample key = candidates[i];
+      int j = i - 1;
+      while (j >= 0 && candidates[j].offsetUs > key.offsetUs) {
+        candidates[j + 1] = candidates[j];
+        j--;
+      }
+      candidates[j + 1] = key;
+    }
+    Sample chosen = candidates[n / 2];
+
+    if (holdover) {
+      LOG(SNTP_HOLDOVER_END, (unsigned long)((millis() - lastGoodPollMs) / 1000), (long long)chosen.offsetUs);
+      holdover = false;
+    }
+    lastGoodPollMs = millis();
+
+    stats.offsetUs = chosen.offsetUs;
+    stats.delayUs = chosen.delayUs;
+    stats.jitterUs = candidates[n - 1].offsetUs - candidates[0].offsetUs;
+    stats.serversUsed = n;
+
+    discipline(chosen.offsetUs);
+
+    stats.pollIntervalSec = 1UL << pollExp;
+    nextPollAt = millis() + stats.pollIntervalSec * 1000UL;
+
+    LOG(SNTP_SYNC, (long long)stats.offsetUs, (long long)stats.delayUs, (long long)stats.jitterUs,
+        stats.driftPpm, stats.serversUsed, (unsigned long)stats.pollIntervalSec);
+  }
+
+  void discipline(int64_t offsetUs) {
+    int64_t now = nowUs();
+    int64_t absOffset = offsetUs < 0 ? -offsetUs : offsetUs;
+    int64_t elapsedUs = now - lastSyncUs;
+
+    // What the oscillator actually did since the last sync, at the average
+    // temperature over that time (a step after a long outage counts too)
+    if (synced && elapsedUs >= 60000000LL) {
+      float avgTemp = tempCount > 0 ? tempSum / tempCount : NAN;
+      model.learn(driftMeasuredPpm(appliedSinceSyncUs, offsetUs, elapsedUs), avgTemp,
+                  (uint32_t)(elapsedUs / 1000000));
+      modelDirty = true;
+    }
+    tempSum = 0;
+    tempCount = 0;
+    appliedSinceSyncUs = 0;
+
+    if (!synced || absOffset > SNTP_STEP_THRESHOLD_US) {
+      int64_t target = now + offsetUs;
+      struct timeval tv;
+      tv.tv_sec = target / 1000000LL;
+      tv.tv_usec = target % 1000000LL;
+      settimeofday(&tv, nullptr);
+      pollExp = SNTP_MIN_POLL_EXP;
+      stableCount = 0;
+      lastSyncUs = target;
+      synced = true;
+      return;
+    }
+
+    // Residual offset since the last correction is frequency error not yet
+    // covered by the drift estimate
+    if (elapsedUs >= 60000000LL) {
+      stats.driftPpm = driftLoopUpdate(stats.driftPpm, offsetUs, elapsedUs);
+      model.currentPpm = stats.driftPpm;
+    }
+
+    // The measured offset already includes any slew still in progress, so replace it
+    struct timeval delta;
+    delta.tv_sec = offsetUs / 1000000LL;
+    delta.tv_usec = offsetUs % 1000000LL;
+    adjtime(&delta, nullptr);
+    lastSyncUs = now + offsetUs;
+
+    if (absOffset < SNTP_STABLE_OFFSET_US) {
+      if (++stableCount >= 3 && pollExp < SNTP_MAX_POLL_EXP) {
+        pollExp++;
+        stableCount = 0;
+      }
+    } else if (absOffset > SNTP_UNSTABLE_OFFSET_US) {
+      if (pollExp > SNTP_MIN_POLL_EXP) pollExp--;
+      stableCount = 0;
+    }
+  }
+
+  // Holdover once the last good poll is well past when the next was due
+  void checkHoldover(unsigned long now) {
+    if (!synced || holdover) return;
+    unsigned long dueMs = 2 * (1000UL << pollExp) + SNTP_HOLDOVER_GRACE_MS;
+    if (now - lastGoodPollMs < dueMs) return;
+    holdover = true;
+    LOG(SNTP_HOLDOVER_START, (unsigned long)((now - lastGoodPollMs) / 1000),
+        model.predict(temperatureC, stats.driftPpm), temperatureC);
+  }
+
+  // Spread the learned frequency correction over the poll interval as small
+  // slews: the sync loop's estimate, or the model's for this temperature in holdover
+  void applyDrift(unsigned long now) {
+    unsigned long elapsedMs = now - lastDriftTick;
+    if (elapsedMs < SNTP_DRIFT_TICK_MS) return;
+    lastDriftTick = now;
+    if (!synced) return;
+
+    float ppm = holdover ? model.predict(temperatureC, stats.driftPpm) : stats.driftPpm;
+    int64_t correctionUs = driftCarry.takeUs(ppm, elapsedMs);
+    if (correctionUs == 0) return;
+    appliedSinceSyncUs += correctionUs;
+
+    // adjtime() replaces the outstanding adjustment, so carry over what is left of it
+    struct timeval remaining;
+    adjtime(nullptr, &remaining);
+    int64_t totalUs = (int64_t)remaining.tv_sec * 1000000LL + remaining.tv_usec + correctionUs;
+    struct timeval delta;
+    delta.tv_sec = totalUs / 1000000LL;
+    delta.tv_usec = totalUs % 1000000LL;
+    adjtime(&delta, nullptr);
+  }
+};
+
+#endif // SNTP_CLIENT_H
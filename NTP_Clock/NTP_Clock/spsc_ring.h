@@ -0,0 +1,120 @@
+/*
+ * SpscRing - Lock-free single-producer/single-consumer byte ring
+ *
+ * Head and tail are free-running 32-bit counters; the capacity must be a power
+ * of two so the buffer index is a mask instead of a modulo, and the fill level
+ * is simply tail - head. Only the producer writes tail and only the consumer
+ * writes head, so no lock is needed: each side publishes its index with a
+ * release store after touching the data and reads the other side's with acquire.
+ *
+ * Bytes that don't fit are counted as overflow, not silently dropped, and the
+ * highest fill level seen is tracked so the size can be tuned.
+ *
+ * Pure C++ - no Arduino dependencies.
+ */
+
+#ifndef SPSC_RING_H
+#define SPSC_RING_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <atomic>
+
+template <size_t Capacity>
+class SpscRing {
+  static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0, "SpscRing capacity must be a power of two");
+
+public:
+  SpscRing() : head(0), tail(0), overflowCount(0), highWaterMark(0) {}
+
+  // --- Producer side ---
+
+  // Copies as much of data as fits; returns the number of bytes stored
+  size_t write(const uint8_t* data, size_t len) {
+    uint32_t t = tail.load(std::memory_order_relaxed);
+    uint32_t h = head.load(std::memory_order_acquire);
+    size_t space = Capacity - (t - h);
+
+    size_t n = len < space ? len : space;
+    if (n < len) {
+      overflowCount.fetch_add(len - n, std::memory_order_relaxed);
+    }
+    if (n == 0) return 0;
+
+    size_t start = t & MASK;
+    size_t first = Capacity - start;
+    if (first > n) first = n;
+    memcpy(buffer + start, data, first);
+    memcpy(buffer, data + first, n - first);
+
+    tail.store(t + n, std::memory_order_release);
+
+    uint32_t used = (t + n) - h;
+    if (used > highWaterMark.load(std::memory_order_relaxed)) {
+      highWaterMark.store(used, std::memory_order_relaxed);
+    }
+    return n;
+  }
+
+  bool write(uint8_t byte) {
+    return write(&byte, 1) == 1;
+  }
+
+  // --- Consumer side ---
+
+  // Copies up to len bytes out; returns the number of bytes read
+  size_t read(uint8_t* out, size_t len) {
+    uint32_t h = head.load(std::memory_order_relaxed);
+    uint32_t t = tail.load(std::memory_order_acquire);
+    size_t used = t - h;
+
+    size_t n = len < used ? len : used;
+    if (n == 0) return 0;
+
+    size_t start = h & MASK;
+    size_t first = Capacity - start;
+    if (first > n) first = n;
+    memcpy(out, buffer + start, first);
+    memcpy(out + first, buffer, n - first);
+
+    head.store(h + n, std::memory_order_release);
+    return n;
+  }
+
+  int read() {
+    uint8_t byte;
+    return read(&byte, 1) == 1 ? byte : -1;
+  }
+
+  int peek() const {
+    uint32_t h = head.load(std::memory_order_relaxed);
+    uint32_t t = tail.load(std::memory_order_acquire);
+    if (t == h) return -1;
+    return buffer[h & MASK];
+  }
+
+  // --- Either side (snapshot) ---
+
+  size_t available() const {
+    // Head first: tail only grows, so it can never be read as behind head
+    uint32_t h = head.load(std::memory_order_acquire);
+    uint32_t t = tail.load(std::memory_order_acquire);
+    return t - h;
+  }
+
+  static constexpr size_t capacity() { return Capacity; }
+  uint32_t overflows() const { return overflowCount.load(std::memory_order_relaxed); }
+  uint32_t highWater() const { return highWaterMark.load(std::memory_order_relaxed); }
+
+private:
+  static const uint32_t MASK = Capacity - 1;
+
+  uint8_t buffer[Capacity];
+  std::atomic<uint32_t> head;           // Next byte to read, written by the consumer only
+  std::atomic<uint32_t> tail;           // Next byte to write, written by the producer only
+  std::atomic<uint32_t> overflowCount;  // Bytes rejected because the ring was full
+  std::atomic<uint32_t> highWaterMark;  // Highest fill level seen
+};
+
+#endif // SPSC_RING_H
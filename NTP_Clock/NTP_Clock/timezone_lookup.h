@@ -0,0 +1,123 @@
+/*
+ * TimezoneLookup - Background IP geolocation timezone lookup
+ *
+ * Runs the ip-api.com request in its own FreeRTOS task so boot and Improv
+ * provisioning never wait on the network. The response is parsed straight off
+ * the socket with an ArduinoJson field filter, so only status, timezone and
+ * offset are ever stored - there is no full-body String copy.
+ *
+ * start() kicks off a lookup, poll() from loop() reports the outcome once.
+ * Persisting the result is left to the caller, which owns Preferences.
+ */
+
+#ifndef TIMEZONE_LOOKUP_H
+#define TIMEZONE_LOOKUP_H
+
+#include <WiFi.h>
+#include <HTTPClient.h>
+#include <ArduinoJson.h>
+#include <sys/time.h>
+#include "timezones.h"
+
+#define TZ_LOOKUP_URL        "http://ip-api.com/json/?fields=status,timezone,offset"
+#ifndef TZ_LOOKUP_TIMEOUT_MS
+#define TZ_LOOKUP_TIMEOUT_MS 4000   // Connect, and each wait for data
+#endif
+#define TZ_LOOKUP_STACK      6144
+
+class TimezoneLookup {
+public:
+  enum Result { LOOKUP_NONE, LOOKUP_OK, LOOKUP_FAILED };
+
+  TimezoneLookup() : state(STATE_IDLE), resultZone(nullptr), lastHttpCode(0), worker(nullptr) {}
+
+  // Returns false if a lookup is already in flight
+  bool start() {
+    if (state == STATE_RUNNING) return false;
+    state = STATE_RUNNING;
+    if (xTaskCreate(task, "tz_lookup", TZ_LOOKUP_STACK, this, 1, &worker) != pdPASS) {
+      state = STATE_IDLE;
+      return false;
+    }
+    return true;
+  }
+
+  bool isRunning() const { return state == STATE_RUNNING; }
+
+  // Reports a finished lookup exactly once; zone is set on LOOKUP_OK
+  Result poll(const TimeZone** zone) {
+    if (state == STATE_OK) {
+      state = STATE_IDLE;
+      *zone = resultZone;
+      return LOOKUP_OK;
+    }
+    if (state == STATE_FAILED) {
+      state = STATE_IDLE;
+      return LOOKUP_FAILED;
+    }
+    return LOOKUP_NONE;
+  }
+
+  // HTTP status of the last failed attempt, or a negative HTTPClient error
+  int lastError() const { return lastHttpCode; }
+
+  // The task started by the last successful start(); stale once it has finished
+  TaskHandle_t workerTask() const { return worker; }
+
+private:
+  enum State { STATE_IDLE, STATE_RUNNING, STATE_OK, STATE_FAILED };
+
+  volatile State state;
+  const TimeZone* volatile resultZone;
+  volatile int lastHttpCode;
+  TaskHandle_t worker;
+
+  static void task(void* arg) {
+    TimezoneLookup* self = (TimezoneLookup*)arg;
+    const TimeZone* zone = nullptr;
+    int code = self->fetch(&zone);
+
+    self->lastHttpCode = code;
+    self->resultZone = zone;
+    self->state = (zone != nullptr) ? STATE_OK : STATE_FAILED;
+    vTaskDelete(nullptr);
+  }
+
+  int fetch(const TimeZone** zone) {
+    HTTPClient http;
+    http.useHTTP10(true);  // No chunked encoding, so the body can be parsed off the socket
+    http.setConnectTimeout(TZ_LOOKUP_TIMEOUT_MS);
+    http.setTimeout(TZ_LOOKUP_TIMEOUT_MS);
+    if (!http.begin(TZ_LOOKUP_URL)) return -1;
+
+    int httpCode = http.GET();
+    if (httpCode != HTTP_CODE_OK) {
+      http.end();
+      return httpCode;
+    }
+
+    StaticJsonDocument<64> filter;
+    filter["status"] = true;
+    filter["timezone"] = true;
+    filter["offset"] = true;
+
+    // A slow or truncated body ends in IncompleteInput once the stream times out
+    StaticJsonDocument<192> doc;
+    DeserializationError error = deserializeJson(doc, http.getStream(), DeserializationOption::Filter(filter));
+    http.end();
+
+    if (error || doc["status"] != "success") return httpCode;
+
+    // Prefer the IANA name; for zones we don't ship, match the offset as it
+    // is now (it includes DST, so Paris reports 7200 in summer, not 3600)
+    *zone = findTimeZone(doc["timezone"].as<const char*>());
+    if (*zone == nullptr && doc.containsKey("offset")) {
+      struct timeval now;
+      gettimeofday(&now, nullptr);
+      *zone = findTimeZoneByCurrentOffset(doc["offset"].as<long>(), now.tv_sec);
+    }
+    return httpCode;
+  }
+};
+
+#endif // TIMEZONE_LOOKUP_H
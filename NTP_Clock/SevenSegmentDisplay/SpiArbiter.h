@@ -0,0 +1,212 @@
+/*
+ * SpiArbiter - One owner for an SPI bus shared by devices in different modes
+ *
+ * The MAX7219 wants SPI mode 0, the MAX31865 mode 1 (or 3), and they share
+ * SCK/MOSI/MISO. Left to themselves each driver wraps every register access
+ * in its own beginTransaction(), and the bus is reprogrammed back and forth
+ * on almost every call. The arbiter sits in between:
+ *
+ * - acquire()/release() group transfers: the transaction stays open after
+ *   release(), and the next acquire() with the same clock and mode just
+ *   carries on in it. Only a different clock or mode reopens the bus.
+ * - Work that can wait (display flushes) is submit()ted as a job. service()
+ *   runs the queue by priority, one acquisition per run of jobs that share
+ *   a clock and mode, and coalesces repeat submissions of the same job, so
+ *   a frame that changes several times in a batch window goes out once.
+ * - Sensor work comes first: SPI_PRIORITY_SENSOR jobs run before display
+ *   jobs, and a display job is held back while the preempt hook reports a
+ *   sensor result waiting (up to SPI_MAX_DEFER_US, so it can't starve).
+ *
+ * Everything runs in the caller's task; this orders bus use, it doesn't lock
+ * it. All SPI users must go through the arbiter, or call idle() first.
+ */
+
+#ifndef SPIARBITER_H
+#define SPIARBITER_H
+
+#include <Arduino.h>
+#include <SPI.h>
+#include <stdint.h>
+
+#define SPI_QUEUE_MAX       8
+#define SPI_BATCH_US        50000   // Display jobs collect this long before they run
+#define SPI_MAX_DEFER_US    20000   // Longest a waiting sensor may hold back a due display job
+
+enum SpiPriority : uint8_t {
+  SPI_PRIORITY_SENSOR = 0,   // Runs on the next service(), before anything else
+  SPI_PRIORITY_DISPLAY = 1,  // Batched; yields to waiting sensor reads
+};
+
+// What a device needs from the bus. The device's own driver toggles CS.
+struct SpiDevice {
+  int8_t cs;
+  uint32_t clock;
+  uint8_t mode;
+};
+
+struct SpiBusStats {
+  uint32_t acquisitions;   // acquire() calls, grouped or not
+  uint32_t transactions;   // beginTransaction()s actually issued
+  uint32_t modeSwitches;   // ...of those, ones that changed the clock or mode
+  uint32_t jobs;           // Jobs run from the queue
+  uint32_t coalesced;      // Submissions folded into a job already queued
+  uint32_t deferrals;      // service() passes that held display work for a sensor
+  uint32_t dropped;        // Submissions refused because the queue was full
+  uint64_t busyUs;         // Time between acquire() and release()
+  uint64_t waitUsTotal;    // Queue wait, summed over jobs run
+  uint32_t waitUsMax;
+  uint32_t sinceUs;        // micros() when the stats were last reset
+};
+
+class SpiArbiter {
+public:
+  typedef void (*Job)(void* ctx);
+  typedef bool (*Preempt)();   // True while a sensor has a result waiting
+
+  SpiArbiter() : open(false), openClock(0), openMode(0), lastClock(0), lastMode(0), depth(0),
+                 acquiredAt(0), queued(0), preempt(nullptr) {
+    resetStats();
+  }
+
+  void setPreempt(Preempt hook) { preempt = hook; }
+
+  // Start of a group of transfers for dev. Keeps the bus as it is when it is
+  // already set up for dev's clock and mode.
+  void acquire(const SpiDevice& dev) {
+    stats.acquisitions++;
+    if (depth++ > 0) return;   // Nested: the outer acquire() owns the settings
+    acquiredAt = micros();
+    if (open && openClock == dev.clock && openMode == dev.mode) return;
+
+    if (open) SPI.endTransaction();
+    SPI.beginTransaction(SPISettings(dev.clock, MSBFIRST, dev.mode));
+    stats.transactions++;
+    if (lastClock != 0 && (lastClock != dev.clock || lastMode != dev.mode)) stats.modeSwitches++;
+    open = true;
+    openClock = lastClock = dev.clock;
+    openMode = lastMode = dev.mode;
+  }
+
+  // End of the group. The transaction stays open for the next acquire().
+  void release() {
+    if (depth == 0) return;
+    if (--depth == 0) stats.busyUs += micros() - acquiredAt;
+  }
+
+  // Closes the open transaction, for code that talks to the bus directly
+  void idle() {
+    if (depth > 0 || !open) return;
+    SPI.endTransaction();
+    open = false;
+  }
+
+  // Queues job(ctx) to run from service() with dev's settings. A job already
+  // queued (same job and ctx) stays queued once, keeping its place and wait.
+  bool submit(const SpiDevice& dev, SpiPriority priority, Job job, void* ctx) {
+    for (uint8_t i = 0; i < queued; i++) {
+      if (queue[i].job == job && queue[i].ctx == ctx) {
+        stats.coalesced++;
+        return true;
+      }
+    }
+    if (queued == SPI_QUEUE_MAX) {
+      stats.dropped++;
+      return false;
+    }
+    queue[queued++] = {&dev, priority, job, ctx, (uint32_t)micros()};
+    return true;
+  }
+
+  // Call from loop(), after the sensors have been read. Runs what is due.
+  void service() {
+    uint32_t now = micros();
+    while (queued > 0) {
+      uint8_t pick = nextDue(now);
+      if (pick == queued) return;   // Only display jobs still inside their batch window
+
+      Entry first = queue[pick];
+      if (first.priority != SPI_PRIORITY_SENSOR && preempt != nullptr && preempt() &&
+          now - first.queuedAt < SPI_BATCH_US + SPI_MAX_DEFER_US) {
+        stats.deferrals++;
+        return;
+      }
+
+      // Everything due at this priority that can share the bus settings goes in one acquisition
+      acquire(*first.dev);
+      for (uint8_t i = 0; i < queued;) {
+        const Entry& e = queue[i];
+        if (e.priority != first.priority || !due(e, now) ||
+            e.dev->clock != first.dev->clock || e.dev->mode != first.dev->mode) {
+          i++;
+          continue;
+        }
+        Entry run = e;
+        remove(i);
+        uint32_t waited = micros() - run.queuedAt;
+        stats.waitUsTotal += waited;
+        if (waited > stats.waitUsMax) stats.waitUsMax = waited;
+        stats.jobs++;
+        run.job(run.ctx);
+      }
+      release();
+    }
+  }
+
+  uint8_t pending() const { return queued; }
+  const SpiBusStats& getStats() const { return stats; }
+
+  // Percent of the time since resetStats() the bus was held
+  float utilization() const {
+    uint32_t elapsed = micros() - stats.sinceUs;
+    return elapsed > 0 ? 100.0f * (float)stats.busyUs / (float)elapsed : 0.0f;
+  }
+
+  void resetStats() {
+    memset(&stats, 0, sizeof(stats));
+    stats.sinceUs = micros();
+    lastClock = 0;
+    lastMode = 0;
+  }
+
+private:
+  struct Entry {
+    const SpiDevice* dev;
+    SpiPriority priority;
+    Job job;
+    void* ctx;
+    uint32_t queuedAt;
+  };
+
+  bool open;           // A transaction is open with openClock/openMode
+  uint32_t openClock;
+  uint8_t openMode;
+  uint32_t lastClock;  // Settings of the last transaction, for counting switches
+  uint8_t lastMode;
+  uint8_t depth;
+  uint32_t acquiredAt;
+  Entry queue[SPI_QUEUE_MAX];
+  uint8_t queued;
+  Preempt preempt;
+  SpiBusStats stats;
+
+  static bool due(const Entry& e, uint32_t now) {
+    return e.priority == SPI_PRIORITY_SENSOR || now - e.queuedAt >= SPI_BATCH_US;
+  }
+
+  // Highest-priority due entry, oldest first; queued if none is due
+  uint8_t nextDue(uint32_t now) const {
+    uint8_t pick = queued;
+    for (uint8_t i = 0; i < queued; i++) {
+      if (!due(queue[i], now)) continue;
+      if (pick == queued || queue[i].priority < queue[pick].priority) pick = i;
+    }
+    return pick;
+  }
+
+  void remove(uint8_t i) {
+    for (uint8_t j = i + 1; j < queued; j++) queue[j - 1] = queue[j];
+    queued--;
+  }
+};
+
+#endif // SPIARBITER_H
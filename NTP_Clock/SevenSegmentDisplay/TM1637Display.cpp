@@ -0,0 +1,79 @@
+/*
+ * TM1637Display - TM1637 bit-banged bus
+ *
+ * Data changes while CLK is low and is sampled on the rising edge; start is
+ * DIO falling while CLK is high, stop is DIO rising while CLK is high. The
+ * chip pulls DIO low during the ninth clock to acknowledge each byte.
+ */
+
+#include "TM1637Display.h"
+
+void TM1637Bus::release(int pin) {
+  pinMode(pin, INPUT);   // Pull-up takes the line high
+}
+
+void TM1637Bus::pullLow(int pin) {
+  pinMode(pin, OUTPUT);
+  digitalWrite(pin, LOW);
+}
+
+void TM1637Bus::init() {
+  release(clkPin);
+  release(dioPin);
+  delayMicroseconds(TM1637_BIT_DELAY_US);
+}
+
+void TM1637Bus::start() {
+  pullLow(dioPin);
+  delayMicroseconds(TM1637_BIT_DELAY_US);
+}
+
+void TM1637Bus::stop() {
+  pullLow(dioPin);
+  delayMicroseconds(TM1637_BIT_DELAY_US);
+  release(clkPin);
+  delayMicroseconds(TM1637_BIT_DELAY_US);
+  release(dioPin);
+  delayMicroseconds(TM1637_BIT_DELAY_US);
+}
+
+bool TM1637Bus::writeByte(uint8_t value) {
+  for (int bit = 0; bit < 8; bit++) {
+    pullLow(clkPin);
+    if (value & 0x01) release(dioPin);
+    else pullLow(dioPin);
+    delayMicroseconds(TM1637_BIT_DELAY_US);
+    release(clkPin);
+    delayMicroseconds(TM1637_BIT_DELAY_US);
+    value >>= 1;
+  }
+
+  // Ninth clock: let go of DIO and read the ACK
+  pullLow(clkPin);
+  release(dioPin);
+  delayMicroseconds(TM1637_BIT_DELAY_US);
+  release(clkPin);
+  delayMicroseconds(TM1637_BIT_DELAY_US);
+  bool ack = digitalRead(dioPin) == LOW;
+  pullLow(clkPin);
+  return ack;
+}
+
+void TM1637Bus::writeCommand(uint8_t command) {
+  start();
+  writeByte(command);
+  stop();
+  transactions++;
+}
+
+void TM1637Bus::writeDigits(uint8_t address, const uint8_t* data, uint8_t len) {
+  writeCommand(CMD_DATA_AUTO);
+
+  start();
+  writeByte(CMD_ADDRESS | address);
+  for (uint8_t i = 0; i < len; i++) {
+    writeByte(data[i]);
+  }
+  stop();
+  transactions++;
+}
@@ -0,0 +1,100 @@
+/*
+ * Frame bench - CPU cost of SegmentFrame rendering, with no bus
+ *
+ * Google Benchmark timings for the calls the sketches make every loop pass
+ * or every second: numbers, text, the time, a scroll step and a keyframe.
+ * flush() only latches the frame, so this is the rendering alone;
+ * backend_bench.cpp measures the bus side.
+ *
+ * Built by the CMakeLists.txt at the top of the repository
+ * (cmake --build <dir> --target frame_bench).
+ */
+
+#include <benchmark/benchmark.h>
+#include "Arduino.h"
+#include "SegmentFrame.h"
+
+uint64_t mockBusNs = 0;
+
+template <uint8_t Digits>
+class NullDisplay : public SegmentFrame<NullDisplay<Digits>, Digits, SegmentMapMAX7219> {
+public:
+  void flush() {
+    memcpy(this->shown, this->frame, sizeof(this->frame));
+    benchmark::DoNotOptimize(this->shown);
+  }
+};
+
+static void BM_DisplayFixed(benchmark::State& state) {
+  NullDisplay<4> d;
+  int32_t value = -999;
+  for (auto _ : state) {
+    d.displayFixed(value, 1);
+    if (++value > 9999) value = -999;
+  }
+}
+BENCHMARK(BM_DisplayFixed);
+
+static void BM_DisplayFixed8(benchmark::State& state) {
+  NullDisplay<8> d;
+  int32_t value = 0;
+  for (auto _ : state) {
+    d.displayFixed(value, 3);
+    value += 12347;
+  }
+}
+BENCHMARK(BM_DisplayFixed8);
+
+static void BM_DisplayText(benchmark::State& state) {
+  NullDisplay<4> d;
+  const char* texts[] = {"1.2.3.4.", "Conn", "Err", "2.17"};
+  unsigned i = 0;
+  for (auto _ : state) {
+    d.displayText(texts[i & 3], (i & 4) != 0);
+    i++;
+  }
+}
+BENCHMARK(BM_DisplayText);
+
+static void BM_DisplayTime(benchmark::State& state) {
+  NullDisplay<4> d;
+  uint8_t minute = 0;
+  for (auto _ : state) {
+    d.displayTime(13, minute, minute & 1, true);
+    if (++minute == 60) minute = 0;
+  }
+}
+BENCHMARK(BM_DisplayTime);
+
+static void BM_ScrollStart(benchmark::State& state) {
+  NullDisplay<4> d;
+  for (auto _ : state) d.startScrolling("192.168.100.200");
+}
+BENCHMARK(BM_ScrollStart);
+
+static void BM_ScrollStep(benchmark::State& state) {
+  NullDisplay<4> d;
+  d.startScrolling("192.168.100.200", 1);
+  for (auto _ : state) {
+    mockBusNs += 1000000;
+    d.update();
+  }
+}
+BENCHMARK(BM_ScrollStep);
+
+static void BM_KeyframeStep(benchmark::State& state) {
+  static constexpr Keyframe FRAMES[] = {
+    keyframe("Conn", 1, 0x0F),
+    keyframe("2.17", 1, 0x00, true),
+  };
+  static constexpr Animation LOOP = animation(FRAMES, 0);
+  NullDisplay<4> d;
+  d.play(LOOP);
+  for (auto _ : state) {
+    mockBusNs += 1000000;
+    d.update();
+  }
+}
+BENCHMARK(BM_KeyframeStep);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,48 @@
+/*
+ * Mock Arduino core for the host backend benchmark. Instead of touching
+ * hardware, every GPIO call and delay advances mockBusNs, the simulated time
+ * spent on the display bus.
+ */
+
+#ifndef MOCK_ARDUINO_H
+#define MOCK_ARDUINO_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#define HIGH 1
+#define LOW 0
+#define INPUT 0
+#define OUTPUT 1
+#define INPUT_PULLUP 2
+#define MSBFIRST 1
+#define SPI_MODE0 0
+#define SPI_MODE1 1
+#define SPI_MODE2 2
+#define SPI_MODE3 3
+
+#define MOCK_GPIO_NS 100   // One pinMode/digitalWrite/digitalRead on an ESP32-S3
+
+extern uint64_t mockBusNs;
+
+// Optional pin models for a bench (DRDY lines and the like): digitalRead()
+// returns mockPinRead(pin) when set, and digitalWrite() reports to mockPinWrite
+inline int (*mockPinRead)(int pin) = nullptr;
+inline void (*mockPinWrite)(int pin, int value) = nullptr;
+
+inline unsigned long millis() { return (unsigned long)(mockBusNs / 1000000); }
+inline unsigned long micros() { return (unsigned long)(mockBusNs / 1000); }
+inline void delay(unsigned long ms) { mockBusNs += (uint64_t)ms * 1000000; }
+inline void delayMicroseconds(unsigned int us) { mockBusNs += (uint64_t)us * 1000; }
+inline void pinMode(int, int) { mockBusNs += MOCK_GPIO_NS; }
+inline void digitalWrite(int pin, int value) {
+  mockBusNs += MOCK_GPIO_NS;
+  if (mockPinWrite != nullptr) mockPinWrite(pin, value);
+}
+inline int digitalRead(int pin) {
+  mockBusNs += MOCK_GPIO_NS;
+  return mockPinRead != nullptr ? mockPinRead(pin) : LOW;
+}
+
+#endif // MOCK_ARDUINO_H
@@ -0,0 +1,329 @@
+/*
+ * Config page - Renders the configuration form and the other pages from plain values
+ *
+ * web_pages.h loads the saved settings and network addresses into a
+ * ConfigPageData (or an UpdatePageData) and hands it here; this file only
+ * builds the HTML. The output type is anything with += for const char* and
+ * char (a static PageBuffer on the device, std::string on the host).
+ * Saved values are HTML-escaped, so an SSID or server list containing
+ * quotes can't break the form.
+ *
+ * Pure C++ - no Arduino dependencies.
+ */
+
+#ifndef CONFIG_PAGE_H
+#define CONFIG_PAGE_H
+
+#include <stdio.h>
+#include <string.h>
+#include "timezones.h"
+#include "live_telemetry.h"
+
+// Fits the largest page below: the config form with a full network list of
+// long SSIDs, a full password and server list, all needing escapes (8938
+// bytes; tools/heap_check.cpp and tests/config_page_test.cpp check it)
+#ifndef WEB_PAGE_BUFFER_SIZE
+#define WEB_PAGE_BUFFER_SIZE 9216
+#endif
+
+struct ConfigPageData {
+  const char* ssid;
+  const char* password;
+  const char* timezone;     // IANA name, matched against TIMEZONES
+  const char* ntpServers;
+  int brightness;
+  bool use24Hour;
+  const char* stationIP;
+  const char* apIP;
+  const char* const* networks;  // Nearby SSIDs to suggest, strongest first
+  uint8_t networkCount;
+  unsigned long telemetryPeriodMs;  // 0 = broadcast off
+  unsigned telemetryBatch;
+};
+
+// Everything the firmware update page shows
+struct UpdatePageData {
+  const char* pullUrl;      // Last URL pulled from, to fill in the form
+  bool running;
+  bool succeeded;
+  const char* source;       // "upload" or the URL of the running/last update
+  const char* error;        // Empty unless the last update failed
+  unsigned long bytesIn;
+  unsigned long bytesTotal; // 0 if unknown
+  unsigned long bytesWritten;
+  bool compressed;
+  unsigned resumes;
+};
+
+template <class Out>
+void appendNumber(Out& html, unsigned long value) {
+  char digits[12];
+  snprintf(digits, sizeof(digits), "%lu", value);
+  html += (const char*)digits;
+}
+
+// Safe inside text and single- or double-quoted attribute values
+template <class Out>
+void appendEscaped(Out& html, const char* text) {
+  for (; *text != '\0'; text++) {
+    switch (*text) {
+      case '&':  html += "&amp;"; break;
+      case '<':  html += "&lt;"; break;
+      case '>':  html += "&gt;"; break;
+      case '"':  html += "&quot;"; break;
+      case '\'': html += "&#39;"; break;
+      default:   html += *text; break;
+    }
+  }
+}
+
+template <class Out>
+void renderConfigPage(Out& html, const ConfigPageData& data) {
+  html += "<!DOCTYPE html><html><head>";
+  html += "<meta name='viewport' content='width=device-width, initial-scale=1'>";
+  html += "<meta charset='UTF-8'>";
+  html += "<title>NTP Clock Configuration</title>";
+  html += "<style>";
+  html += "body{font-family:Arial,sans-serif;max-width:600px;margin:20px auto;padding:20px;background:#f5f5f5;}";
+  html += "h1{color:#333;margin-bottom:20px;}";
+  html += ".form-group{margin-bottom:15px;}";
+  html += "label{display:block;margin-bottom:5px;font-weight:bold;color:#555;}";
+  html += "input,select{width:100%;padding:8px;box-sizing:border-box;border:1px solid #ddd;border-radius:4px;font-size:14px;}";
+  html += "input:focus,select:focus{outline:none;border-color:#4CAF50;}";
+  html += "button{background:#4CAF50;color:white;padding:10px 20px;border:none;border-radius:4px;cursor:pointer;font-size:16px;width:100%;margin-top:10px;}";
+  html += "button:hover{background:#45a049;}";
+  html += ".reset-btn{background:#f44336;margin-top:20px;}";
+  html += ".reset-btn:hover{background:#da190b;}";
+  html += ".note{margin-top:20px;padding:10px;background:#fff3cd;border-left:4px solid #ffc107;border-radius:4px;}";
+  html += ".info{margin-top:15px;padding:10px;background:#e3f2fd;border-left:4px solid #2196F3;border-radius:4px;font-size:0.9em;}";
+  html += "</style></head><body>";
+  html += "<h1>NTP Clock Configuration</h1>";
+  html += "<form method='POST' action='/save'>";
+  html += "<div class='form-group'><label>WiFi SSID:</label>";
+  html += "<input type='text' name='ssid' list='networks' value='";
+  appendEscaped(html, data.ssid);
+  html += "' required>";
+  html += "<datalist id='networks'>";
+  for (uint8_t i = 0; i < data.networkCount; i++) {
+    html += "<option value='";
+    appendEscaped(html, data.networks[i]);
+    html += "'>";
+  }
+  html += "</datalist></div>";
+  html += "<div class='form-group'><label>WiFi Password:</label>";
+  html += "<input type='password' name='password' value='";
+  appendEscaped(html, data.password);
+  html += "' placeholder='Leave blank to keep current password'></div>";
+  html += "<div class='form-group'><label>Timezone:</label>";
+  html += "<select name='tz' required>";
+  for (size_t i = 0; i < TIMEZONE_COUNT; i++) {
+    const TimeZone& tz = TIMEZONES[i];
+    html += "<option value='";
+    html += tz.name;
+    html += "'";
+    if (strcmp(data.timezone, tz.name) == 0) html += " selected";
+    html += ">";
+    html += tz.label;
+    html += " (";
+    html += tz.name;
+    html += ")</option>";
+  }
+  html += "</select>";
+  html += "<small style='display:block;color:#666;margin-top:5px;'>Daylight saving time is applied automatically</small></div>";
+  html += "<div class='form-group'><label>NTP Servers:</label>";
+  html += "<input type='text' name='ntp_servers' value='";
+  appendEscaped(html, data.ntpServers);
+  html += "'>";
+  html += "<small style='display:block;color:#666;margin-top:5px;'>Comma-separated, up to 4 (e.g. pool.ntp.org,time.google.com)</small></div>";
+  html += "<div class='form-group'><label>Brightness (0-15):</label>";
+  char brightness[12];
+  snprintf(brightness, sizeof(brightness), "%d", data.brightness);
+  html += "<input type='number' name='brightness' min='0' max='15' value='";
+  html += brightness;
+  html += "'></div>";
+  html += "<div class='form-group'><label>Hour Format:</label>";
+  html += "<select name='hour_format'>";
+  html += data.use24Hour ? "<option value='24' selected>24-hour</option>" : "<option value='24'>24-hour</option>";
+  html += data.use24Hour ? "<option value='12'>12-hour</option>" : "<option value='12' selected>12-hour</option>";
+  html += "</select></div>";
+  html += "<div class='form-group'><label>Telemetry Broadcast (ms, 0 = off):</label>";
+  html += "<input type='number' name='tm_period' min='0' max='60000' value='";
+  appendNumber(html, data.telemetryPeriodMs);
+  html += "'>";
+  html += "<small style='display:block;color:#666;margin-top:5px;'>How often to sample for the UDP broadcast on port ";
+  appendNumber(html, TELEMETRY_UDP_PORT);
+  html += "</small></div>";
+  html += "<div class='form-group'><label>Samples per Packet:</label>";
+  html += "<input type='number' name='tm_batch' min='1' max='";
+  appendNumber(html, TELEMETRY_BATCH_MAX);
+  html += "' value='";
+  appendNumber(html, data.telemetryBatch);
+  html += "'></div>";
+  html += "<button type='submit'>Save and Restart</button>";
+  html += "</form>";
+  html += "<form method='POST' action='/factory-reset'>";
+  html += "<button type='submit' class='reset-btn'>Factory Reset</button>";
+  html += "</form>";
+  html += "<div class='note'><strong>Note:</strong> After saving, the device will restart and connect to WiFi.</div>";
+  html += "<div class='info'><strong>Current IP:</strong> ";
+  html += data.stationIP;
+  html += " (if connected) or ";
+  html += data.apIP;
+  html += " (AP mode)</div>";
+  html += "<div class='info'><a href='/dashboard'>Live dashboard</a> | <a href='/update'>Firmware update</a></div>";
+  html += "</body></html>";
+}
+
+template <class Out>
+void renderSaveSuccessPage(Out& html) {
+  html += "<!DOCTYPE html><html><head>";
+  html += "<meta name='viewport' content='width=device-width, initial-scale=1'>";
+  html += "<meta charset='UTF-8'>";
+  html += "<title>Settings Saved</title>";
+  html += "<style>";
+  html += "body{font-family:Arial,sans-serif;max-width:600px;margin:20px auto;padding:20px;text-align:center;}";
+  html += "h1{color:#4CAF50;}";
+  html += "p{margin-top:20px;color:#666;}";
+  html += "</style></head><body>";
+  html += "<h1>Settings Saved!</h1>";
+  html += "<p>The device is restarting and will connect to WiFi.</p>";
+  html += "<p>You will be redirected to the configuration page shortly.</p>";
+  html += "</body></html>";
+}
+
+template <class Out>
+void renderFactoryResetPage(Out& html) {
+  html += "<!DOCTYPE html><html><head>";
+  html += "<meta name='viewport' content='width=device-width, initial-scale=1'>";
+  html += "<meta charset='UTF-8'>";
+  html += "<title>Factory Reset</title>";
+  html += "<style>";
+  html += "body{font-family:Arial,sans-serif;max-width:600px;margin:20px auto;padding:20px;text-align:center;}";
+  html += "h1{color:#f44336;}";
+  html += "p{margin-top:20px;color:#666;}";
+  html += "</style></head><body>";
+  html += "<h1>Factory Reset Complete</h1>";
+  html += "<p>All settings have been cleared. The device is restarting.</p>";
+  html += "<p>The device will start in AP mode. Connect to the access point and configure at 192.168.4.1</p>";
+  html += "</body></html>";
+}
+
+template <class Out>
+void renderUpdatePage(Out& html, const UpdatePageData& data, const char* firmwareVersion) {
+  html += "<!DOCTYPE html><html><head>";
+  html += "<meta name='viewport' content='width=device-width, initial-scale=1'>";
+  html += "<meta charset='UTF-8'>";
+  if (data.running) {
+    html += "<meta http-equiv='refresh' content='2'>";
+  }
+  html += "<title>Firmware Update</title>";
+  html += "<style>";
+  html += "body{font-family:Arial,sans-serif;max-width:600px;margin:20px auto;padding:20px;background:#f5f5f5;}";
+  html += "h1{color:#333;margin-bottom:20px;}h2{color:#555;font-size:1.1em;margin-top:25px;}";
+  html += ".form-group{margin-bottom:15px;}";
+  html += "label{display:block;margin-bottom:5px;font-weight:bold;color:#555;}";
+  html += "input{width:100%;padding:8px;box-sizing:border-box;border:1px solid #ddd;border-radius:4px;font-size:14px;}";
+  html += "button{background:#4CAF50;color:white;padding:10px 20px;border:none;border-radius:4px;cursor:pointer;font-size:16px;width:100%;margin-top:10px;}";
+  html += "button:hover{background:#45a049;}";
+  html += ".info{margin-top:15px;padding:10px;background:#e3f2fd;border-left:4px solid #2196F3;border-radius:4px;font-size:0.9em;}";
+  html += ".error{margin-top:15px;padding:10px;background:#fdecea;border-left:4px solid #f44336;border-radius:4px;}";
+  html += "</style></head><body>";
+  html += "<h1>Firmware Update</h1>";
+  html += "<div class='info'><strong>Running:</strong> v";
+  html += firmwareVersion;
+  html += "</div>";
+
+  // Status of the current or last update
+  if (data.running || data.bytesIn > 0 || data.error[0] != '\0') {
+    html += "<div class='info'><strong>";
+    html += data.running ? "Updating" : (data.succeeded ? "Update complete, restarting" : "Update failed");
+    html += "</strong> from ";
+    appendEscaped(html, data.source);
+    html += "<br>";
+    appendNumber(html, data.bytesIn);
+    if (data.bytesTotal > 0) {
+      html += " of ";
+      appendNumber(html, data.bytesTotal);
+    }
+    html += " bytes received";
+    if (data.compressed) {
+      html += ", ";
+      appendNumber(html, data.bytesWritten);
+      html += " bytes unpacked";
+    }
+    if (data.resumes > 0) {
+      html += ", resumed ";
+      appendNumber(html, data.resumes);
+      html += "x";
+    }
+    html += "</div>";
+    if (!data.running && !data.succeeded) {
+      html += "<div class='error'>";
+      appendEscaped(html, data.error);
+      html += "</div>";
+    }
+  }
+
+  html += "<h2>Upload</h2>";
+  html += "<form method='POST' action='/update' enctype='multipart/form-data'>";
+  html += "<div class='form-group'><label>SHA-256 of the image (optional):</label>";
+  html += "<input type='text' name='sha256' maxlength='64'></div>";
+  html += "<div class='form-group'><label>App image (NTP_Clock.ino.bin or .bin.gz):</label>";
+  html += "<input type='file' name='firmware' accept='.bin,.gz' required></div>";
+  html += "<button type='submit'>Upload and Restart</button>";
+  html += "</form>";
+
+  html += "<h2>Download</h2>";
+  html += "<form method='POST' action='/update/pull'>";
+  html += "<div class='form-group'><label>Image URL:</label>";
+  html += "<input type='text' name='url' value='";
+  appendEscaped(html, data.pullUrl);
+  html += "' placeholder='http://server/firmware-ota.bin.gz' required></div>";
+  html += "<div class='form-group'><label>SHA-256 of the image:</label>";
+  html += "<input type='text' name='sha256' maxlength='64' required></div>";
+  html += "<button type='submit'>Download and Restart</button>";
+  html += "</form>";
+  html += "<div class='info'>The clock keeps running during the update and restarts when it has been verified. ";
+  html += "Use the app image, not the installer's merged image.</div>";
+  html += "</body></html>";
+}
+
+#define CONFIG_PAGE_STR(x) #x
+#define CONFIG_PAGE_XSTR(x) CONFIG_PAGE_STR(x)
+
+// Static, so it is sent straight from flash. The values come from the event
+// stream on TELEMETRY_SSE_PORT; the browser reconnects by itself and gets
+// every field again when it does.
+static const char DASHBOARD_HTML[] =
+  "<!DOCTYPE html><html><head>"
+  "<meta name='viewport' content='width=device-width, initial-scale=1'>"
+  "<meta charset='UTF-8'>"
+  "<title>NTP Clock Live</title>"
+  "<style>"
+  "body{font-family:Arial,sans-serif;max-width:600px;margin:20px auto;padding:20px;background:#f5f5f5;}"
+  "h1{color:#333;margin-bottom:20px;}"
+  "table{width:100%;border-collapse:collapse;background:white;}"
+  "td{padding:8px;border-bottom:1px solid #eee;}td+td{text-align:right;font-family:monospace;}"
+  ".changed{background:#fff3cd;}"
+  ".info{margin-top:15px;padding:10px;background:#e3f2fd;border-left:4px solid #2196F3;border-radius:4px;font-size:0.9em;}"
+  "</style></head><body>"
+  "<h1>NTP Clock Live</h1>"
+  "<table id='fields'></table>"
+  "<div class='info'><span id='state'>Connecting...</span> | <a href='/'>Configuration</a></div>"
+  "<script>"
+  "var labels={synced:'Time synced',offset_us:'Offset (us)',jitter_us:'Jitter (us)',drift_ppm:'Drift (ppm)',"
+  "poll_s:'SNTP poll (s)',brightness:'Brightness',chip_c:'Chip temperature (C)',temp_c:'Temperature (C)',"
+  "band:'Band',rssi:'WiFi signal (dBm)'};"
+  "var state=document.getElementById('state');"
+  "var es=new EventSource('http://'+location.hostname+':" CONFIG_PAGE_XSTR(TELEMETRY_SSE_PORT) "/events');"
+  "es.onopen=function(){state.textContent='Live';};"
+  "es.onerror=function(){state.textContent='Reconnecting...';};"
+  "es.onmessage=function(e){var d=JSON.parse(e.data);for(var k in d){"
+  "var row=document.getElementById('f_'+k);"
+  "if(!row){row=document.getElementById('fields').insertRow();row.id='f_'+k;"
+  "row.insertCell().textContent=labels[k]||k;row.insertCell();}"
+  "row.cells[1].textContent=k=='synced'?['no','yes','holdover'][d[k]]:d[k];"
+  "row.className='changed';setTimeout(function(r){r.className='';},600,row);}};"
+  "</script></body></html>";
+
+#endif // CONFIG_PAGE_H
@@ -0,0 +1,433 @@
+/*
+ * EventLog - Deferred-format binary logging that never waits on the port
+ *
+ * Serial.printf() formats on the spot and, on USB CDC, can block until the
+ * host reads; it also shares the port with Improv. LOG(ID, args...) instead
+ * stores the message ID (log_messages.h) and the raw arguments in a ring:
+ * a timestamp, a compare-and-swap to claim a slot, a few stores and a
+ * release - tens of cycles, safe from timer callbacks, event handlers and
+ * any task (not from ISRs that run with the flash cache disabled).
+ * Formatting happens later, somewhere that has time for it.
+ *
+ * - A low-priority task drains the ring in frames to a sink (the serial port
+ *   unless setSink() names another, e.g. a flash writer). A sink that can't
+ *   take a frame is retried for LOG_STALL_MS, then the frame is counted as
+ *   unsent and skipped, so the ring keeps moving with no host attached.
+ * - The ring lives in RTC memory that a reset doesn't clear, and records
+ *   aren't erased when sent. After a panic, watchdog or software reset the
+ *   last LOG_RING_SIZE records are sent again, tagged with the boot they
+ *   came from. A power cycle starts empty.
+ * - A full ring drops new records and counts them; the count goes out with
+ *   every frame.
+ *
+ * A frame on the wire is 0x00, then COBS of
+ *
+ *   u8  version        LOG_FRAME_VERSION
+ *   u8  type           LOG_FRAME_TYPE ('L')
+ *   u8  boot           Boot counter, wraps
+ *   u8  count          Records in this frame
+ *   u32 dropped        Records lost to a full ring since power-on
+ *   u32 unsent         Records the sink never took since power-on
+ *   count x {
+ *     u32 ms           millis() when logged
+ *     u16 id           LogId
+ *     u8  boot         Boot it was logged in
+ *     u8  len          Argument bytes that follow
+ *     len x u8         Arguments, as log_messages.h describes
+ *   }
+ *   u16 crc            CRC-16/CCITT-FALSE over everything above
+ *
+ * then 0x00, all little-endian. The zeros keep frames apart from Improv
+ * packets and any plain text on the port. tools/clock_log.py reads them.
+ * With LOG_TEXT_OUTPUT the drain task formats each record as a text line
+ * instead, for a plain serial monitor.
+ *
+ * Include from the sketch only - it defines the ring and eventLog.
+ */
+
+#ifndef EVENT_LOG_H
+#define EVENT_LOG_H
+
+#include <Arduino.h>
+#include <esp_attr.h>
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <stdint.h>
+#include <string.h>
+#include <atomic>
+#include <type_traits>
+#include "log_messages.h"
+
+#define LOG_RING_SIZE        64      // Records; also how many survive a reset
+#define LOG_RECORD_PAYLOAD   40      // Argument bytes per record
+#define LOG_STRING_SHARE     12      // Bytes a string keeps back for each later string
+#define LOG_FRAME_MAX        240     // Encoded frame, fits the HW CDC TX buffer
+#define LOG_FRAME_VERSION    1
+#define LOG_FRAME_TYPE       0x4C    // 'L'
+#define LOG_FRAME_HEADER     12
+#define LOG_RECORD_HEADER    8
+#define LOG_DRAIN_MS         20      // Drain task sleep when the ring is empty
+#define LOG_STALL_MS         500     // Longest a frame waits for the sink
+#define LOG_TASK_STACK       3072
+#define LOG_TASK_PRIORITY    0       // Below loop(); only runs when nothing else needs the CPU
+#define LOG_MAGIC            0x4C4F4731
+
+#ifndef LOG_TEXT_OUTPUT
+#define LOG_TEXT_OUTPUT 0
+#endif
+
+static_assert((LOG_RING_SIZE & (LOG_RING_SIZE - 1)) == 0, "LOG_RING_SIZE must be a power of two");
+static_assert(LOG_FRAME_HEADER + LOG_RECORD_HEADER + LOG_RECORD_PAYLOAD + 2 + 3 <= LOG_FRAME_MAX,
+              "A full record must fit a frame");
+
+#define LOG(id, ...) eventLog.write(LOG_##id, ##__VA_ARGS__)
+
+// --- Argument encoding ---
+
+// Fewest bytes an argument can take; strings can be cut down to their NUL
+template <class T>
+constexpr size_t logArgMin() {
+  typedef typename std::decay<T>::type U;
+  return std::is_pointer<U>::value ? 1 : (std::is_integral<U>::value && sizeof(U) > 4) ? 8 : 4;
+}
+
+template <class... Args>
+constexpr size_t logArgsMin() { return (0 + ... + logArgMin<Args>()); }
+
+// What a string leaves for the arguments after it, so a long first string
+// can't squeeze out a second one
+template <class... Args>
+constexpr size_t logArgsShare() {
+  return (0 + ... + (std::is_pointer<typename std::decay<Args>::type>::value ? LOG_STRING_SHARE : logArgMin<Args>()));
+}
+
+// Appends v at out[len]. minAfter bytes must remain for the later arguments;
+// a string also tries to leave shareAfter.
+template <class T>
+inline void logPutArg(uint8_t* out, uint8_t& len, size_t minAfter, size_t shareAfter, T v) {
+  if constexpr (std::is_pointer<T>::value) {
+    size_t room = LOG_RECORD_PAYLOAD - len - minAfter;
+    if (len + shareAfter + 1 < LOG_RECORD_PAYLOAD && LOG_RECORD_PAYLOAD - len - shareAfter < room) {
+      room = LOG_RECORD_PAYLOAD - len - shareAfter;
+    }
+    const char* s = v != nullptr ? (const char*)v : "(null)";
+    size_t n = 0;
+    while (n + 1 < room && s[n] != '\0') n++;
+    memcpy(out + len, s, n);
+    out[len + n] = '\0';
+    len += n + 1;
+  } else if constexpr (std::is_floating_point<T>::value) {
+    float f = (float)v;
+    memcpy(out + len, &f, 4);
+    len += 4;
+  } else if constexpr (sizeof(T) > 4) {
+    uint64_t x = (uint64_t)v;
+    memcpy(out + len, &x, 8);
+    len += 8;
+  } else {
+    uint32_t x;
+    if constexpr (std::is_signed<T>::value) x = (uint32_t)(int32_t)v;
+    else x = (uint32_t)v;
+    memcpy(out + len, &x, 4);
+    len += 4;
+  }
+}
+
+inline void logPutArgs(uint8_t*, uint8_t&) {}
+
+template <class T, class... Rest>
+inline void logPutArgs(uint8_t* out, uint8_t& len, T first, Rest... rest) {
+  logPutArg(out, len, logArgsMin<Rest...>(), logArgsShare<Rest...>(), first);
+  logPutArgs(out, len, rest...);
+}
+
+// Applies format to the stored arguments, printf-style (the host tool does
+// the same in Python). Missing arguments print as "?".
+inline size_t logFormat(const char* format, const uint8_t* args, uint8_t len, char* out, size_t size) {
+  size_t n = 0;
+  uint8_t pos = 0;
+  while (*format != '\0' && n + 1 < size) {
+    if (*format != '%') {
+      out[n++] = *format++;
+      continue;
+    }
+    format++;
+    if (*format == '%') {
+      out[n++] = *format++;
+      continue;
+    }
+
+    char spec[16] = "%";
+    size_t s = 1;
+    while (*format != '\0' && strchr("-+ #0123456789.", *format) != nullptr && s < 10) spec[s++] = *format++;
+    int longs = 0;
+    while (*format == 'l' || *format == 'h' || *format == 'z') longs += (*format++ == 'l');
+    char conv = *format != '\0' ? *format++ : 'd';
+
+    int w;
+    if (conv == 's') {
+      spec[s++] = 's';
+      const char* text = pos < len ? (const char*)args + pos : "?";
+      if (pos < len) pos += strnlen(text, len - pos) + 1;
+      w = snprintf(out + n, size - n, spec, text);
+    } else if (strchr("fFeEgG", conv) != nullptr) {
+      spec[s++] = conv;
+      float f = 0;
+      bool have = pos + 4 <= len;
+      if (have) memcpy(&f, args + pos, 4);
+      pos += 4;
+      w = have ? snprintf(out + n, size - n, spec, (double)f) : snprintf(out + n, size - n, "?");
+    } else if (longs >= 2) {
+      spec[s++] = 'l';
+      spec[s++] = 'l';
+      spec[s++] = conv;
+      uint64_t v = 0;
+      bool have = pos + 8 <= len;
+      if (have) memcpy(&v, args + pos, 8);
+      pos += 8;
+      if (!have) w = snprintf(out + n, size - n, "?");
+      else if (conv == 'd' || conv == 'i') w = snprintf(out + n, size - n, spec, (long long)v);
+      else w = snprintf(out + n, size - n, spec, (unsigned long long)v);
+    } else {
+      spec[s++] = conv;
+      uint32_t v = 0;
+      bool have = pos + 4 <= len;
+      if (have) memcpy(&v, args + pos, 4);
+      pos += 4;
+      if (!have) w = snprintf(out + n, size - n, "?");
+      else if (conv == 'd' || conv == 'i' || conv == 'c') w = snprintf(out + n, size - n, spec, (int)(int32_t)v);
+      else w = snprintf(out + n, size - n, spec, (unsigned)v);
+    }
+    if (w > 0) n += (size_t)w < size - n ? (size_t)w : size - n - 1;
+  }
+  out[n] = '\0';
+  return n;
+}
+
+inline const char* logMessageFormat(uint16_t id) {
+#define LOG_FORMAT_ENTRY(id, format) format,
+  static const char* const FORMATS[] = { LOG_MESSAGES(LOG_FORMAT_ENTRY) };
+#undef LOG_FORMAT_ENTRY
+  return id < LOG_MESSAGE_COUNT ? FORMATS[id] : "unknown message %u";
+}
+
+// --- Ring ---
+
+struct LogRecord {
+  std::atomic<uint32_t> seq;   // Ring index + 1 once the record is complete
+  uint32_t ms;
+  uint16_t id;
+  uint8_t boot;
+  uint8_t len;
+  uint8_t args[LOG_RECORD_PAYLOAD];
+};
+
+// Survives resets: begin() checks magic and indices before trusting it
+struct LogRetained {
+  uint32_t magic;
+  uint8_t boot;
+  std::atomic<uint32_t> head;   // Next index to claim
+  std::atomic<uint32_t> tail;   // Next index to send
+  LogRecord ring[LOG_RING_SIZE];
+};
+
+RTC_NOINIT_ATTR LogRetained logRetained;
+
+class EventLog {
+public:
+  typedef bool (*Sink)(const uint8_t* data, size_t len);   // False: can't take it yet, ask again
+
+  EventLog() : sink(nullptr), replayEnd(0), droppedCount(0), unsentCount(0), frameLen(0), frameRecords(0) {}
+
+  // Early in setup(). Queues the previous boot's records to be sent again.
+  void begin(Sink output) {
+    sink = output;
+    LogRetained& r = logRetained;
+    uint32_t head = r.head.load(std::memory_order_relaxed);
+    if (r.magic != LOG_MAGIC || head - r.tail.load(std::memory_order_relaxed) > LOG_RING_SIZE) {
+      memset((void*)&r, 0, sizeof(r));
+      r.magic = LOG_MAGIC;
+      head = 0;
+    }
+    r.boot++;
+    r.tail.store(head >= LOG_RING_SIZE ? head - LOG_RING_SIZE : 0, std::memory_order_relaxed);
+    replayEnd = head;
+    xTaskCreate(task, "event_log", LOG_TASK_STACK, this, LOG_TASK_PRIORITY, nullptr);
+  }
+
+  void setSink(Sink output) { sink = output; }
+
+  template <class... Args>
+  void write(LogId id, Args... args) {
+    static_assert(logArgsMin<Args...>() <= LOG_RECORD_PAYLOAD, "Too many log arguments for one record");
+    LogRetained& r = logRetained;
+    uint32_t slot = r.head.load(std::memory_order_relaxed);
+    do {
+      if (slot - r.tail.load(std::memory_order_acquire) >= LOG_RING_SIZE) {
+        droppedCount.fetch_add(1, std::memory_order_relaxed);
+        return;
+      }
+    } while (!r.head.compare_exchange_weak(slot, slot + 1, std::memory_order_acq_rel, std::memory_order_relaxed));
+
+    LogRecord& rec = r.ring[slot & (LOG_RING_SIZE - 1)];
+    rec.ms = (uint32_t)(esp_timer_get_time() / 1000);
+    rec.id = id;
+    rec.boot = r.boot;
+    uint8_t len = 0;
+    logPutArgs(rec.args, len, args...);
+    rec.len = len;
+    rec.seq.store(slot + 1, std::memory_order_release);
+  }
+
+  uint32_t dropped() const { return droppedCount.load(std::memory_order_relaxed); }
+  uint32_t unsent() const { return unsentCount; }
+
+private:
+  Sink sink;
+  uint32_t replayEnd;            // Records before this index are from an earlier boot
+  std::atomic<uint32_t> droppedCount;
+  uint32_t unsentCount;
+  uint8_t frame[LOG_FRAME_MAX];
+  size_t frameLen;
+  uint8_t frameRecords;
+  uint8_t encoded[LOG_FRAME_MAX + 2];
+
+  static void task(void* arg) {
+    EventLog* self = static_cast<EventLog*>(arg);
+    for (;;) {
+      if (!self->drain()) vTaskDelay(pdMS_TO_TICKS(LOG_DRAIN_MS));
+    }
+  }
+
+  // Takes the next complete record off the ring; false if there is none yet
+  bool next(LogRecord& out) {
+    LogRetained& r = logRetained;
+    uint32_t t = r.tail.load(std::memory_order_relaxed);
+    while (t != r.head.load(std::memory_order_acquire)) {
+      LogRecord& rec = r.ring[t & (LOG_RING_SIZE - 1)];
+      if (rec.seq.load(std::memory_order_acquire) == t + 1) {
+        out.ms = rec.ms;
+        out.id = rec.id;
+        out.boot = rec.boot;
+        out.len = rec.len > LOG_RECORD_PAYLOAD ? LOG_RECORD_PAYLOAD : rec.len;
+        memcpy(out.args, rec.args, out.len);
+        r.tail.store(t + 1, std::memory_order_release);
+        return true;
+      }
+      // Still being written - unless it was cut off by the reset before this boot
+      if (t >= replayEnd) return false;
+      r.tail.store(++t, std::memory_order_release);
+    }
+    return false;
+  }
+
+  // Sends what the ring holds, one frame (or line) at a time; false if it was empty
+  bool drain() {
+    LogRecord rec;
+    bool any = false;
+    while (next(rec)) {
+      any = true;
+#if LOG_TEXT_OUTPUT
+      char line[160];
+      int n = snprintf(line, sizeof(line), "%s%lu.%03lu ", rec.boot != logRetained.boot ? "(prev boot) " : "",
+                       (unsigned long)(rec.ms / 1000), (unsigned long)(rec.ms % 1000));
+      n += logFormat(logMessageFormat(rec.id), rec.args, rec.len, line + n, sizeof(line) - n - 1);
+      line[n++] = '\n';
+      send((const uint8_t*)line, n, 1);
+#else
+      // CRC, COBS code byte and the two zeros must still fit
+      if (frameRecords > 0 && frameLen + LOG_RECORD_HEADER + rec.len + 2 + 3 > LOG_FRAME_MAX) flushFrame();
+      if (frameRecords == 0) frameLen = LOG_FRAME_HEADER;
+      memcpy(frame + frameLen, &rec.ms, 4);
+      memcpy(frame + frameLen + 4, &rec.id, 2);
+      frame[frameLen + 6] = rec.boot;
+      frame[frameLen + 7] = rec.len;
+      memcpy(frame + frameLen + LOG_RECORD_HEADER, rec.args, rec.len);
+      frameLen += LOG_RECORD_HEADER + rec.len;
+      frameRecords++;
+#endif
+    }
+#if !LOG_TEXT_OUTPUT
+    if (frameRecords > 0) flushFrame();
+#endif
+    return any;
+  }
+
+  void flushFrame() {
+    if (frameRecords == 0) return;
+    uint32_t droppedNow = dropped();
+    frame[0] = LOG_FRAME_VERSION;
+    frame[1] = LOG_FRAME_TYPE;
+    frame[2] = logRetained.boot;
+    frame[3] = frameRecords;
+    memcpy(frame + 4, &droppedNow, 4);
+    memcpy(frame + 8, &unsentCount, 4);
+    uint16_t crc = logCrc16(frame, frameLen);
+    frame[frameLen] = crc & 0xFF;
+    frame[frameLen + 1] = crc >> 8;
+
+    encoded[0] = 0x00;
+    size_t n = 1 + logCobsEncode(frame, frameLen + 2, encoded + 1);
+    encoded[n++] = 0x00;
+    send(encoded, n, frameRecords);
+    frameRecords = 0;
+    frameLen = 0;
+  }
+
+  void send(const uint8_t* data, size_t len, uint8_t records) {
+    unsigned long start = millis();
+    while (sink == nullptr || !sink(data, len)) {
+      if (millis() - start >= LOG_STALL_MS) {
+        unsentCount += records;
+        return;
+      }
+      vTaskDelay(pdMS_TO_TICKS(LOG_DRAIN_MS));
+    }
+  }
+
+  // CRC-16/CCITT-FALSE (poly 0x1021, init 0xFFFF), as temp_chirp's telemetry
+  static uint16_t logCrc16(const uint8_t* data, size_t len) {
+    uint16_t crc = 0xFFFF;
+    for (size_t i = 0; i < len; i++) {
+      crc ^= (uint16_t)data[i] << 8;
+      for (int b = 0; b < 8; b++) crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+    }
+    return crc;
+  }
+
+  // Consistent Overhead Byte Stuffing; returns the encoded length
+  static size_t logCobsEncode(const uint8_t* in, size_t len, uint8_t* out) {
+    size_t codeIndex = 0;
+    size_t outIndex = 1;
+    uint8_t code = 1;
+    for (size_t i = 0; i < len; i++) {
+      if (in[i] == 0) {
+        out[codeIndex] = code;
+        codeIndex = outIndex++;
+        code = 1;
+      } else {
+        out[outIndex++] = in[i];
+        if (++code == 0xFF) {
+          out[codeIndex] = code;
+          codeIndex = outIndex++;
+          code = 1;
+        }
+      }
+    }
+    out[codeIndex] = code;
+    return outIndex;
+  }
+};
+
+EventLog eventLog;
+
+// Default sink: whole frames only, and only when the TX buffer has room for
+// one, so a frame never holds the port while Improv waits to answer
+inline bool logSerialSink(const uint8_t* data, size_t len) {
+  if (Serial.availableForWrite() < (int)len) return false;
+  Serial.write(data, len);
+  return true;
+}
+
+#endif // EVENT_LOG_H
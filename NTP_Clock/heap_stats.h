@@ -0,0 +1,278 @@
+/*
+ * HeapStats - Who allocates, how much, and how low the heap has been
+ *
+ * A clock runs for months, so the heap must reach a steady state after
+ * setup(): pages render into a static PageBuffer, settings load into char
+ * arrays, and nothing the loop does every pass should allocate. This keeps
+ * the score:
+ * - Every allocation is counted, with its size, against the subsystem that
+ *   made it: loop() code marks what it is doing with a HeapScope, and
+ *   background tasks are tagged by handle. Anything else (the WiFi driver,
+ *   lwIP, other tasks) counts as "system".
+ * - Counts after markSteady() (the end of setup()) are kept separately;
+ *   those are the ones that should stay at zero outside the web server
+ *   and one-off events like a timezone lookup.
+ * - Free heap and the largest free block are sampled, with low-water
+ *   marks, since fragmentation shows up in the second long before the first.
+ *
+ * Counting needs every allocation to pass through here. The stock
+ * arduino-esp32 libraries aren't built with the ESP-IDF heap hooks
+ * (CONFIG_HEAP_USE_HOOKS), so the release build links malloc(), calloc()
+ * and realloc() through wrappers instead: -DHEAP_STATS_WRAP_MALLOC with
+ * -Wl,--wrap=malloc,--wrap=calloc,--wrap=realloc (see the compile step in
+ * .github/workflows/build.yml). That covers new, the String class, lwIP and
+ * newlib's public calls; drivers calling heap_caps_malloc() directly, like
+ * the WiFi blob's, are missed. A core with the hooks uses them instead.
+ * With neither, it falls back to sampling free heap around each HeapScope:
+ * only net growth inside a scope is seen, as one allocation of that many bytes.
+ *
+ * Include from the sketch only - it defines the hooks and heapStats.
+ */
+
+#ifndef HEAP_STATS_H
+#define HEAP_STATS_H
+
+#include <Arduino.h>
+#include <esp_heap_caps.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <atomic>
+#include "config_page.h"
+
+#define HEAP_TAGGED_TASKS 4
+
+#if defined(HEAP_STATS_WRAP_MALLOC)
+#define HEAP_STATS_WRAPS    1
+#define HEAP_STATS_COUNTING 1
+#elif defined(CONFIG_HEAP_USE_HOOKS)
+#define HEAP_STATS_HOOKS    1
+#define HEAP_STATS_COUNTING 1
+#else
+#define HEAP_STATS_COUNTING 0
+#endif
+
+enum HeapSubsystem : uint8_t {
+  HEAP_SYSTEM,    // Other tasks: WiFi, lwIP, timers
+  HEAP_LOOP,      // loop() outside any HeapScope
+  HEAP_WEB,       // server.handleClient() and the page handlers
+  HEAP_IMPROV,
+  HEAP_WIFI,      // Background network scans
+  HEAP_NTP,
+  HEAP_TZ,        // Timezone lookup task and its results
+  HEAP_OTA,       // Firmware update task and its results
+  HEAP_DISPLAY,
+  HEAP_TELEMETRY, // UDP broadcast and dashboard event stream
+  HEAP_SUBSYSTEMS
+};
+
+class HeapStats {
+public:
+  HeapStats() : loopTask(nullptr), current(HEAP_LOOP), steady(false),
+                minLargestBlock(UINT32_MAX), lastSampleMs(0) {
+    for (uint8_t i = 0; i < HEAP_TAGGED_TASKS; i++) tagged[i] = {nullptr, HEAP_SYSTEM};
+  }
+
+  // From the loop task, early in setup()
+  void begin() {
+    loopTask = xTaskGetCurrentTaskHandle();
+    sample();
+  }
+
+  // End of setup(): from here on allocations also count as steady-state
+  void markSteady() { steady.store(true, std::memory_order_relaxed); }
+
+  // Counts allocations made by task against sub, until it is tagged again
+  void tagTask(TaskHandle_t task, HeapSubsystem sub) {
+    if (task == nullptr) return;
+    uint8_t slot = 0;
+    for (uint8_t i = 0; i < HEAP_TAGGED_TASKS; i++) {
+      if (tagged[i].task == task || tagged[i].sub == sub) {
+        slot = i;
+        break;
+      }
+      if (tagged[i].task == nullptr) slot = i;
+    }
+    tagged[slot] = {task, sub};
+  }
+
+  // Loop task only; HeapScope pairs these up
+  HeapSubsystem enter(HeapSubsystem sub) {
+    HeapSubsystem outer = current;
+    current = sub;
+    return outer;
+  }
+
+  void leave(HeapSubsystem outer) { current = outer; }
+
+  // Called from the allocation hook or wrappers (any task, any core). Must not allocate.
+  void IRAM_ATTR record(size_t size) {
+    HeapSubsystem sub = subsystemOf(xTaskGetCurrentTaskHandle());
+    count(sub, size);
+  }
+
+  // Free-heap fallback when allocations can't be counted
+  void recordGrowth(HeapSubsystem sub, size_t bytes) { count(sub, bytes); }
+
+  // Largest free block needs a heap walk, so at most once a second
+  void sample() {
+    unsigned long now = millis();
+    if (lastSampleMs != 0 && now - lastSampleMs < 1000) return;
+    lastSampleMs = now == 0 ? 1 : now;
+    uint32_t largest = heap_caps_get_largest_free_block(MALLOC_CAP_8BIT);
+    if (largest < minLargestBlock) minLargestBlock = largest;
+  }
+
+  uint32_t steadyAllocations() const {
+    uint32_t total = 0;
+    for (uint8_t i = 0; i < HEAP_SUBSYSTEMS; i++) total += counters[i].steadyAllocs.load(std::memory_order_relaxed);
+    return total;
+  }
+
+  static const char* subsystemName(uint8_t sub) {
+    static const char* const NAMES[HEAP_SUBSYSTEMS] = {
+      "system", "loop", "web", "improv", "wifi", "ntp", "tz", "ota", "display", "telemetry"
+    };
+    return sub < HEAP_SUBSYSTEMS ? NAMES[sub] : "?";
+  }
+
+  uint32_t largestBlockLowWater() const { return minLargestBlock == UINT32_MAX ? 0 : minLargestBlock; }
+
+  // Since boot and after setup, for one subsystem
+  void counts(uint8_t sub, uint32_t& allocs, uint32_t& bytes, uint32_t& steadyAllocs, uint32_t& steadyBytes) const {
+    const Counter& c = counters[sub];
+    allocs = c.allocs.load(std::memory_order_relaxed);
+    bytes = c.bytes.load(std::memory_order_relaxed);
+    steadyAllocs = c.steadyAllocs.load(std::memory_order_relaxed);
+    steadyBytes = c.steadyBytes.load(std::memory_order_relaxed);
+  }
+
+  // Plain-text report for /heap
+  template <class Out>
+  void report(Out& out) const {
+    out += "free ";
+    appendNumber(out, heap_caps_get_free_size(MALLOC_CAP_8BIT));
+    out += " min ";
+    appendNumber(out, heap_caps_get_minimum_free_size(MALLOC_CAP_8BIT));
+    out += ", largest block ";
+    appendNumber(out, heap_caps_get_largest_free_block(MALLOC_CAP_8BIT));
+    out += " min ";
+    appendNumber(out, largestBlockLowWater());
+    out += HEAP_STATS_COUNTING ? "\n" : " (allocations not counted: net growth per scope only)\n";
+    out += "allocs/bytes since boot, after setup:\n";
+    for (uint8_t i = 0; i < HEAP_SUBSYSTEMS; i++) {
+      uint32_t allocs, bytes, steadyAllocs, steadyBytes;
+      counts(i, allocs, bytes, steadyAllocs, steadyBytes);
+      out += "  ";
+      out += subsystemName(i);
+      out += ' ';
+      appendNumber(out, allocs);
+      out += '/';
+      appendNumber(out, bytes);
+      out += ", ";
+      appendNumber(out, steadyAllocs);
+      out += '/';
+      appendNumber(out, steadyBytes);
+      out += '\n';
+    }
+  }
+
+private:
+  struct Counter {
+    std::atomic<uint32_t> allocs{0};
+    std::atomic<uint32_t> bytes{0};
+    std::atomic<uint32_t> steadyAllocs{0};
+    std::atomic<uint32_t> steadyBytes{0};
+  };
+
+  struct TaggedTask {
+    TaskHandle_t task;
+    HeapSubsystem sub;
+  };
+
+  TaskHandle_t loopTask;
+  volatile HeapSubsystem current;
+  std::atomic<bool> steady;
+  TaggedTask tagged[HEAP_TAGGED_TASKS];
+  Counter counters[HEAP_SUBSYSTEMS];
+  uint32_t minLargestBlock;
+  unsigned long lastSampleMs;
+
+  HeapSubsystem IRAM_ATTR subsystemOf(TaskHandle_t task) const {
+    if (task == loopTask) return current;
+    for (uint8_t i = 0; i < HEAP_TAGGED_TASKS; i++) {
+      if (tagged[i].task == task) return tagged[i].sub;
+    }
+    return HEAP_SYSTEM;
+  }
+
+  void IRAM_ATTR count(HeapSubsystem sub, size_t size) {
+    Counter& c = counters[sub];
+    c.allocs.fetch_add(1, std::memory_order_relaxed);
+    c.bytes.fetch_add(size, std::memory_order_relaxed);
+    if (steady.load(std::memory_order_relaxed)) {
+      c.steadyAllocs.fetch_add(1, std::memory_order_relaxed);
+      c.steadyBytes.fetch_add(size, std::memory_order_relaxed);
+    }
+  }
+};
+
+HeapStats heapStats;
+
+#if defined(HEAP_STATS_WRAPS)
+// The linker sends every call from outside the heap component here first
+extern "C" {
+void* __real_malloc(size_t size);
+void* __real_calloc(size_t n, size_t size);
+void* __real_realloc(void* ptr, size_t size);
+
+void* IRAM_ATTR __wrap_malloc(size_t size) {
+  heapStats.record(size);
+  return __real_malloc(size);
+}
+
+void* IRAM_ATTR __wrap_calloc(size_t n, size_t size) {
+  heapStats.record(n * size);
+  return __real_calloc(n, size);
+}
+
+// A new block, unless it's really a free()
+void* IRAM_ATTR __wrap_realloc(void* ptr, size_t size) {
+  if (size > 0) heapStats.record(size);
+  return __real_realloc(ptr, size);
+}
+}
+#elif defined(HEAP_STATS_HOOKS)
+// Replaces the weak hook in ESP-IDF's heap component; runs on every malloc
+extern "C" void IRAM_ATTR esp_heap_trace_alloc_hook(void* ptr, size_t size, uint32_t caps) {
+  (void)ptr;
+  (void)caps;
+  heapStats.record(size);
+}
+#endif
+
+// Marks loop() code as belonging to sub for as long as it is in scope
+class HeapScope {
+public:
+  explicit HeapScope(HeapSubsystem sub) : sub(sub), outer(heapStats.enter(sub)) {
+#if !HEAP_STATS_COUNTING
+    freeAtEntry = heap_caps_get_free_size(MALLOC_CAP_8BIT);
+#endif
+  }
+
+  ~HeapScope() {
+#if !HEAP_STATS_COUNTING
+    size_t freeNow = heap_caps_get_free_size(MALLOC_CAP_8BIT);
+    if (freeNow < freeAtEntry) heapStats.recordGrowth(sub, freeAtEntry - freeNow);
+#endif
+    heapStats.leave(outer);
+  }
+
+private:
+  HeapSubsystem sub;
+  HeapSubsystem outer;
+#if !HEAP_STATS_COUNTING
+  size_t freeAtEntry;
+#endif
+};
+
+#endif // HEAP_STATS_H
@@ -0,0 +1,299 @@
+/*
+ * ImprovSerial - Non-blocking Improv WiFi provisioning over serial
+ *
+ * Speaks the Improv serial protocol (https://www.improv-wifi.com/serial/)
+ * used by ESP Web Tools, without ever waiting on the radio:
+ * - WiFi credentials are answered at once with state "provisioning"; the
+ *   connection attempt then runs while loop() carries on, and handleSerial()
+ *   reports "provisioned" (with the clock's URL) or "unable to connect"
+ *   when it resolves
+ * - Network lists come from WifiScanCache. A request is answered from the
+ *   cache straight away; only an empty cache waits for the first scan, and
+ *   that wait is also just a flag checked from handleSerial()
+ *
+ * Packets are "IMPROV", version, type, length, data, then an 8-bit sum of
+ * everything before it. Call handleSerial() from loop(); it reads whatever
+ * the stream has and never blocks.
+ */
+
+#ifndef IMPROV_SERIAL_H
+#define IMPROV_SERIAL_H
+
+#include <WiFi.h>
+#include <string.h>
+#include "wifi_scan_cache.h"
+
+#define IMPROV_CONNECT_TIMEOUT_MS 15000
+#define IMPROV_MAX_DATA           128   // Longest packet we accept (credentials are < 100 bytes)
+
+class ImprovSerial {
+public:
+  typedef void (*ProvisionedCallback)(const char* ssid, const char* password);
+
+  ImprovSerial(Stream& io, WifiScanCache& networks)
+    : io(io), networks(networks), state(STATE_READY), onProvisionedCb(nullptr),
+      rxPos(0), rxLen(0), connectStart(0), scanPending(false), scanWaitFrom(0) {
+    ssid[0] = '\0';
+    password[0] = '\0';
+    setDeviceInfo("", "", "", "");
+  }
+
+  // Reported for "request device info"
+  void setDeviceInfo(const char* firmware, const char* version, const char* chip, const char* deviceName) {
+    info[0] = firmware;
+    info[1] = version;
+    info[2] = chip;
+    info[3] = deviceName;
+  }
+
+  // Runs once the network from Improv has connected - save the credentials here
+  void onProvisioned(ProvisionedCallback cb) { onProvisionedCb = cb; }
+
+  void handleSerial() {
+    while (io.available() > 0) {
+      int c = io.read();
+      if (c < 0) break;
+      receive((uint8_t)c);
+    }
+
+    if (state == STATE_PROVISIONING) checkConnection();
+
+    // Deferred network list: sent when the first scan finishes
+    if (scanPending && (networks.scanCount() != scanWaitFrom || !networks.isScanning())) {
+      scanPending = false;
+      sendNetworks();
+    }
+  }
+
+  bool isProvisioning() const { return state == STATE_PROVISIONING; }
+  bool isProvisioned() const { return state == STATE_PROVISIONED; }
+
+private:
+  // Packet types
+  static constexpr uint8_t TYPE_CURRENT_STATE = 0x01;
+  static constexpr uint8_t TYPE_ERROR_STATE = 0x02;
+  static constexpr uint8_t TYPE_RPC = 0x03;
+  static constexpr uint8_t TYPE_RPC_RESULT = 0x04;
+
+  // RPC commands
+  static constexpr uint8_t CMD_WIFI_SETTINGS = 0x01;
+  static constexpr uint8_t CMD_GET_STATE = 0x02;
+  static constexpr uint8_t CMD_GET_INFO = 0x03;
+  static constexpr uint8_t CMD_GET_NETWORKS = 0x04;
+
+  // Error codes
+  static constexpr uint8_t ERROR_NONE = 0x00;
+  static constexpr uint8_t ERROR_INVALID_RPC = 0x01;
+  static constexpr uint8_t ERROR_UNKNOWN_RPC = 0x02;
+  static constexpr uint8_t ERROR_UNABLE_TO_CONNECT = 0x03;
+
+  static constexpr uint8_t VERSION = 1;
+  static constexpr uint8_t HEADER_LEN = 9;   // "IMPROV", version, type, length
+
+  // Improv state values
+  enum State : uint8_t { STATE_READY = 0x02, STATE_PROVISIONING = 0x03, STATE_PROVISIONED = 0x04 };
+
+  Stream& io;
+  WifiScanCache& networks;
+  State state;
+  ProvisionedCallback onProvisionedCb;
+  const char* info[4];
+
+  uint8_t rx[HEADER_LEN + IMPROV_MAX_DATA + 1];
+  uint16_t rxPos;
+  uint8_t rxLen;
+
+  char ssid[33];
+  char password[65];
+  unsigned long connectStart;
+  bool scanPending;
+  uint32_t scanWaitFrom;
+
+  // --- Receiving ---
+
+  void receive(uint8_t b) {
+    static const char MAGIC[] = "IMPROV";
+
+    if (rxPos < 6) {
+      if (b != (uint8_t)MAGIC[rxPos]) {
+        // Not a packet (or a log line); resync, this byte may start one
+        rxPos = (b == (uint8_t)MAGIC[0]) ? 1 : 0;
+        if (rxPos == 1) rx[0] = b;
+        return;
+      }
+      rx[rxPos++] = b;
+      return;
+    }
+
+    rx[rxPos++] = b;
+    if (rxPos == 7 && b != VERSION) {
+      rxPos = 0;
+      return;
+    }
+    if (rxPos == HEADER_LEN) {
+      rxLen = b;
+      if (rxLen > IMPROV_MAX_DATA) {
+        rxPos = 0;
+        sendError(ERROR_INVALID_RPC);
+      }
+      return;
+    }
+    if (rxPos < HEADER_LEN + rxLen + 1) return;
+
+    // Whole packet: check the sum, then dispatch
+    uint8_t sum = 0;
+    for (uint16_t i = 0; i < HEADER_LEN + rxLen; i++) sum += rx[i];
+    rxPos = 0;
+    if (sum != rx[HEADER_LEN + rxLen]) {
+      sendError(ERROR_INVALID_RPC);
+      return;
+    }
+    if (rx[7] == TYPE_RPC) handleRpc(rx + HEADER_LEN, rxLen);
+  }
+
+  void handleRpc(const uint8_t* data, uint8_t len) {
+    if (len < 2 || data[1] != len - 2) {
+      sendError(ERROR_INVALID_RPC);
+      return;
+    }
+    uint8_t command = data[0];
+    const uint8_t* args = data + 2;
+    uint8_t argsLen = data[1];
+
+    switch (command) {
+      case CMD_WIFI_SETTINGS:
+        startProvisioning(args, argsLen);
+        break;
+
+      case CMD_GET_STATE:
+        sendState();
+        if (state == STATE_PROVISIONED) sendUrl(CMD_GET_STATE);
+        break;
+
+      case CMD_GET_INFO: {
+        const char* strings[4] = {info[0], info[1], info[2], info[3]};
+        sendResult(CMD_GET_INFO, strings, 4);
+        break;
+      }
+
+      case CMD_GET_NETWORKS:
+        networks.keepFresh();
+        if (networks.scanCount() > 0) {
+          sendNetworks();
+        } else {
+          // Nothing cached yet: answer when the scan keepFresh() started is in
+          scanPending = true;
+          scanWaitFrom = networks.scanCount();
+        }
+        break;
+
+      default:
+        sendError(ERROR_UNKNOWN_RPC);
+        break;
+    }
+  }
+
+  // Answers immediately; checkConnection() reports the outcome
+  void startProvisioning(const uint8_t* args, uint8_t len) {
+    uint8_t ssidLen = len > 0 ? args[0] : 0;
+    if (len < 2 || ssidLen == 0 || ssidLen >= sizeof(ssid) || 1 + ssidLen >= len) {
+      sendError(ERROR_INVALID_RPC);
+      return;
+    }
+    uint8_t passLen = args[1 + ssidLen];
+    if (passLen >= sizeof(password) || 2 + ssidLen + passLen > len) {
+      sendError(ERROR_INVALID_RPC);
+      return;
+    }
+    memcpy(ssid, args + 1, ssidLen);
+    ssid[ssidLen] = '\0';
+    memcpy(password, args + 2 + ssidLen, passLen);
+    password[passLen] = '\0';
+
+    sendError(ERROR_NONE);
+    state = STATE_PROVISIONING;
+    sendState();
+
+    WiFi.mode(WIFI_STA);
+    WiFi.begin(ssid, password);
+    connectStart = millis();
+  }
+
+  void checkConnection() {
+    if (WiFi.status() == WL_CONNECTED) {
+      state = STATE_PROVISIONED;
+      sendState();
+      sendUrl(CMD_WIFI_SETTINGS);
+      if (onProvisionedCb != nullptr) onProvisionedCb(ssid, password);
+      return;
+    }
+    if (millis() - connectStart >= IMPROV_CONNECT_TIMEOUT_MS) {
+      state = STATE_READY;
+      sendError(ERROR_UNABLE_TO_CONNECT);
+      sendState();
+    }
+  }
+
+  // --- Sending ---
+
+  void sendPacket(uint8_t type, const uint8_t* data, uint8_t len) {
+    uint8_t out[HEADER_LEN + 255 + 2];
+    memcpy(out, "IMPROV", 6);
+    out[6] = VERSION;
+    out[7] = type;
+    out[8] = len;
+    memcpy(out + HEADER_LEN, data, len);
+
+    uint8_t sum = 0;
+    for (uint16_t i = 0; i < HEADER_LEN + len; i++) sum += out[i];
+    out[HEADER_LEN + len] = sum;
+    out[HEADER_LEN + len + 1] = '\n';   // Keeps the serial log readable
+    io.write(out, HEADER_LEN + len + 2);
+  }
+
+  void sendState() {
+    uint8_t s = state;
+    sendPacket(TYPE_CURRENT_STATE, &s, 1);
+  }
+
+  void sendError(uint8_t error) {
+    sendPacket(TYPE_ERROR_STATE, &error, 1);
+  }
+
+  // RPC result: command, total length, then each string length-prefixed
+  void sendResult(uint8_t command, const char* const* strings, uint8_t count) {
+    uint8_t data[255];
+    uint16_t len = 2;
+    for (uint8_t i = 0; i < count; i++) {
+      size_t n = strlen(strings[i]);
+      if (len + 1 + n > sizeof(data)) break;
+      data[len++] = (uint8_t)n;
+      memcpy(data + len, strings[i], n);
+      len += n;
+    }
+    data[0] = command;
+    data[1] = (uint8_t)(len - 2);
+    sendPacket(TYPE_RPC_RESULT, data, (uint8_t)len);
+  }
+
+  void sendUrl(uint8_t command) {
+    char url[32];
+    snprintf(url, sizeof(url), "http://%s/", WiFi.localIP().toString().c_str());
+    const char* strings[1] = {url};
+    sendResult(command, strings, 1);
+  }
+
+  // One result per network, strongest first, then an empty one to end the list
+  void sendNetworks() {
+    for (uint8_t i = 0; i < networks.count(); i++) {
+      const WifiNetwork& n = networks.get(i);
+      char rssi[8];
+      snprintf(rssi, sizeof(rssi), "%d", n.rssi);
+      const char* strings[3] = {n.ssid, rssi, n.secure ? "YES" : "NO"};
+      sendResult(CMD_GET_NETWORKS, strings, 3);
+    }
+    sendResult(CMD_GET_NETWORKS, nullptr, 0);
+  }
+};
+
+#endif // IMPROV_SERIAL_H
@@ -0,0 +1,56 @@
+/*
+ * Log messages - Every message EventLog can record, by ID
+ *
+ * The firmware only stores a message's ID and its raw arguments; the format
+ * strings here are applied later, by tools/clock_log.py on the host (which
+ * reads this file) or by the drain task with LOG_TEXT_OUTPUT. Captures are
+ * decoded by position in this list, so only ever append to it.
+ *
+ * Arguments are stored as they are passed: 32-bit integers for %d/%u/%ld/%lu/
+ * %x/%c, 64-bit for %lld/%llu, float for %f/%e/%g, and a copy of the text for
+ * %s, cut short if the record runs out of room. They must match the format.
+ */
+
+#ifndef LOG_MESSAGES_H
+#define LOG_MESSAGES_H
+
+#define LOG_MESSAGES(X) \
+  X(BOOT,                 "=== NTP Clock v%s starting, reset reason %d ===") \
+  X(IMPROV_SETUP,         "Setting up Improv WiFi...") \
+  X(IMPROV_READY,         "Improv WiFi ready - waiting for provisioning...") \
+  X(IMPROV_GRACE_WIFI,    "Improv WiFi connected during grace period!") \
+  X(IMPROV_GRACE_ENDED,   "Improv grace period ended") \
+  X(IMPROV_SAVING,        "Improv: Saving credentials for SSID: %s") \
+  X(WIFI_USING_IMPROV,    "Using Improv WiFi connection") \
+  X(WIFI_TRYING_SAVED,    "Trying saved credentials: %s") \
+  X(WIFI_CONNECTED_SAVED, "Connected to saved WiFi") \
+  X(WIFI_AP_START,        "Starting AP mode") \
+  X(WIFI_AP_TO_STA,       "WiFi connected while in AP mode - switching to STA mode") \
+  X(RX_OVERFLOW,          "[RX] Buffer overflow: %lu bytes dropped total, high water %lu/%u") \
+  X(TIME_PHASE,           "[TIME] display phase error: avg=%ldus max=%ldus") \
+  X(SNTP_START,           "Starting SNTP with servers: %s") \
+  X(SNTP_SYNC,            "[SNTP] offset=%lldus delay=%lldus jitter=%lldus drift=%.2fppm servers=%u next=%lus") \
+  X(TZ_APPLIED,           "Timezone: %s (%s)") \
+  X(TZ_LOOKUP_STARTED,    "Timezone lookup started") \
+  X(TZ_LOOKUP_OK,         "Timezone lookup: %s") \
+  X(TZ_LOOKUP_FAILED,     "Timezone lookup failed (%d), retrying in %lus") \
+  X(OTA_UPLOAD_START,     "[OTA] Upload started: %s") \
+  X(OTA_PULL,             "[OTA] Pulling %s") \
+  X(OTA_RESUME,           "[OTA] Connection lost at %u bytes (HTTP %d), resuming") \
+  X(OTA_DONE,             "[OTA] Update from %s complete (%u bytes), restarting") \
+  X(OTA_FAILED,           "[OTA] Update from %s failed: %s (HTTP %d)") \
+  X(HEAP_SUMMARY,         "[HEAP] free %lu min %lu, largest block %lu min %lu") \
+  X(HEAP_SUBSYSTEM,       "[HEAP]   %s %lu/%lu, after setup %lu/%lu") \
+  X(TELEMETRY_START,      "[TM] Events on port %u, UDP broadcast every %lums (0 = off), %u per packet") \
+  X(SNTP_HOLDOVER_START,  "[SNTP] Holdover: no sync for %lus, correcting %.3fppm at %.1fC") \
+  X(SNTP_HOLDOVER_END,    "[SNTP] Holdover ended after %lus, offset %lldus") \
+  X(DRIFT_RESTORED,       "[SNTP] Drift model restored: %.3fppm, %s")
+
+#define LOG_ENUM_ENTRY(id, format) LOG_##id,
+enum LogId : uint16_t {
+  LOG_MESSAGES(LOG_ENUM_ENTRY)
+  LOG_MESSAGE_COUNT
+};
+#undef LOG_ENUM_ENTRY
+
+#endif // LOG_MESSAGES_H
@@ -0,0 +1,559 @@
+/*
+ * OtaUpdate - Streaming firmware update into the inactive OTA partition
+ *
+ * Takes an app image (NTP_Clock.ino.bin, not the merged installer image),
+ * either raw or gzip-compressed, and streams it into flash as it arrives:
+ * - Uploaded through the web server's /update form, one chunk per callback
+ * - Pulled from a URL in its own FreeRTOS task, like TimezoneLookup, so
+ *   loop() keeps rendering the time while it downloads
+ *
+ * gzip is inflated on the fly with the ROM copy of miniz's tinfl into a
+ * 32KB window, so RAM use is fixed (~44KB while an update runs, nothing
+ * otherwise) whatever the image size. A SHA-256 of the uncompressed image
+ * is computed as it streams and checked before the new partition is marked
+ * bootable; pulls require one, uploads may leave it out and rely on the
+ * image's own checksum. The gzip CRC-32 and length are checked as well.
+ *
+ * An interrupted pull resumes with an HTTP Range request from the last
+ * compressed byte received; the inflate state stays in RAM, so this works
+ * across dropped connections but not across a reboot.
+ *
+ * start*() kicks off an update, poll() from loop() reports the outcome once.
+ * Restarting into the new image is left to the caller.
+ */
+
+#ifndef OTA_UPDATE_H
+#define OTA_UPDATE_H
+
+#include <WiFi.h>
+#include <HTTPClient.h>
+#include <Update.h>
+#include <mbedtls/sha256.h>
+#include <esp_rom_crc.h>
+#include <string.h>
+#include <ctype.h>
+#include "event_log.h"
+#if __has_include(<rom/miniz.h>)
+#include <rom/miniz.h>
+#else
+#include <esp32s3/rom/miniz.h>
+#endif
+
+#define OTA_BUFFER_SIZE       2048    // Network read chunk
+#define OTA_HTTP_TIMEOUT_MS   8000
+#define OTA_READ_TIMEOUT_MS   10000   // No data for this long drops the connection
+#define OTA_MAX_RESUMES       5
+#define OTA_RESUME_DELAY_MS   2000
+#define OTA_TASK_STACK        8192
+#define OTA_URL_LEN           256
+#define OTA_SHA_HEX_LEN       64
+
+// Decodes a raw or gzip app image into the inactive OTA partition
+class OtaImageWriter {
+public:
+  OtaImageWriter() : inflator(nullptr), dict(nullptr) { reset(); }
+  ~OtaImageWriter() { release(); }
+
+  // expectedSha: 64 hex digits, or "" to rely on the image's own checksum
+  bool begin(const char* expectedSha) {
+    release();
+    reset();
+    if (expectedSha != nullptr && expectedSha[0] != '\0') {
+      if (!parseSha(expectedSha, expected)) return fail("SHA-256 must be 64 hex digits");
+      hasExpected = true;
+    }
+    if (!Update.begin(UPDATE_SIZE_UNKNOWN, U_FLASH)) return fail(Update.errorString());
+    mbedtls_sha256_init(&sha);
+    mbedtls_sha256_starts(&sha, 0);
+    started = true;
+    return true;
+  }
+
+  bool write(const uint8_t* data, size_t len) {
+    if (failed || !started) return false;
+    bytesInCount += len;
+
+    while (len > 0 && !failed) {
+      switch (stage) {
+        case STAGE_DETECT:
+          if (data[0] == GZIP_MAGIC0) {
+            stage = STAGE_GZIP_HEADER;
+            if (!allocateInflate()) return false;
+          } else if (data[0] == ESP_IMAGE_MAGIC) {
+            stage = STAGE_RAW;
+          } else {
+            return fail("Not an app image or gzip file");
+          }
+          break;
+
+        case STAGE_RAW:
+          output(data, len);
+          len = 0;
+          break;
+
+        case STAGE_GZIP_HEADER:
+          headerByte(*data++);
+          len--;
+          break;
+
+        case STAGE_INFLATE: {
+          size_t used = inflate(data, len);
+          data += used;
+          len -= used;
+          break;
+        }
+
+        case STAGE_TRAILER:
+          trailer[trailerLen++] = *data++;
+          len--;
+          if (trailerLen == sizeof(trailer)) stage = STAGE_DONE;
+          break;
+
+        case STAGE_DONE:
+          return fail("Data after the end of the gzip stream");
+      }
+    }
+    return !failed;
+  }
+
+  // True once a gzip stream has ended; raw images end when the input does
+  bool isComplete() const { return stage == STAGE_DONE; }
+
+  // Checks everything, then marks the new partition bootable. A failed
+  // check aborts the update, so the next begin() can start another.
+  bool end() {
+    if (failed || !started) return false;
+    if (stage != STAGE_RAW && stage != STAGE_DONE) return abortWith("Image is truncated");
+
+    if (stage == STAGE_DONE) {
+      uint32_t crc = readLe32(trailer);
+      uint32_t size = readLe32(trailer + 4);
+      if (crc != crcOut) return abortWith("gzip CRC mismatch");
+      if (size != (uint32_t)bytesOutCount) return abortWith("gzip length mismatch");
+    }
+
+    uint8_t digest[32];
+    mbedtls_sha256_finish(&sha, digest);
+    if (hasExpected && memcmp(digest, expected, sizeof(digest)) != 0) return abortWith("SHA-256 mismatch");
+    mbedtls_sha256_free(&sha);
+    started = false;
+
+    // Validates the image header and its appended checksum
+    bool ok = Update.end(true);
+    release();
+    if (!ok) return fail(Update.errorString());
+    return true;
+  }
+
+  void abort() {
+    if (started) {
+      mbedtls_sha256_free(&sha);
+      Update.abort();
+      started = false;
+    }
+    release();
+  }
+
+  size_t bytesIn() const { return bytesInCount; }    // Resume offset for a pull
+  size_t bytesOut() const { return bytesOutCount; }  // Image bytes written to flash
+  bool isCompressed() const { return inflator != nullptr || stage == STAGE_TRAILER || stage == STAGE_DONE; }
+  bool hasFailed() const { return failed; }
+  const char* error() const { return errorText; }
+
+private:
+  static constexpr uint8_t GZIP_MAGIC0 = 0x1F;
+  static constexpr uint8_t GZIP_MAGIC1 = 0x8B;
+  static constexpr uint8_t GZIP_DEFLATE = 8;
+  static constexpr uint8_t GZIP_FHCRC = 0x02;
+  static constexpr uint8_t GZIP_FEXTRA = 0x04;
+  static constexpr uint8_t GZIP_FNAME = 0x08;
+  static constexpr uint8_t GZIP_FCOMMENT = 0x10;
+  static constexpr uint8_t ESP_IMAGE_MAGIC = 0xE9;
+
+  enum Stage { STAGE_DETECT, STAGE_RAW, STAGE_GZIP_HEADER, STAGE_INFLATE, STAGE_TRAILER, STAGE_DONE };
+  enum HeaderField { FIELD_FIXED, FIELD_EXTRA_LEN, FIELD_EXTRA, FIELD_NAME, FIELD_COMMENT, FIELD_HCRC };
+
+  Stage stage;
+  HeaderField field;
+  uint8_t headerFlags;
+  uint8_t header[10];
+  uint16_t fieldPos;
+  uint16_t extraLen;
+  uint8_t trailer[8];   // CRC-32, then uncompressed length mod 2^32
+  uint8_t trailerLen;
+
+  tinfl_decompressor* inflator;
+  uint8_t* dict;        // TINFL_LZ_DICT_SIZE ring the inflater writes into
+  size_t dictPos;
+
+  mbedtls_sha256_context sha;
+  uint8_t expected[32];
+  bool hasExpected;
+  uint32_t crcOut;
+  size_t bytesInCount;
+  size_t bytesOutCount;
+  bool started;
+  bool failed;
+  char errorText[48];
+
+  void reset() {
+    stage = STAGE_DETECT;
+    field = FIELD_FIXED;
+    headerFlags = 0;
+    fieldPos = 0;
+    extraLen = 0;
+    trailerLen = 0;
+    dictPos = 0;
+    hasExpected = false;
+    crcOut = 0;
+    bytesInCount = 0;
+    bytesOutCount = 0;
+    started = false;
+    failed = false;
+    errorText[0] = '\0';
+  }
+
+  bool abortWith(const char* why) {
+    abort();
+    return fail(why);
+  }
+
+  bool fail(const char* why) {
+    if (!failed) {
+      strncpy(errorText, why, sizeof(errorText) - 1);
+      errorText[sizeof(errorText) - 1] = '\0';
+    }
+    failed = true;
+    return false;
+  }
+
+  bool allocateInflate() {
+    inflator = (tinfl_decompressor*)malloc(sizeof(tinfl_decompressor));
+    dict = (uint8_t*)malloc(TINFL_LZ_DICT_SIZE);
+    if (inflator == nullptr || dict == nullptr) {
+      release();
+      return fail("Out of memory for inflate");
+    }
+    tinfl_init(inflator);
+    return true;
+  }
+
+  void release() {
+    free(inflator);
+    free(dict);
+    inflator = nullptr;
+    dict = nullptr;
+  }
+
+  void output(const uint8_t* data, size_t len) {
+    mbedtls_sha256_update(&sha, data, len);
+    if (inflator != nullptr) crcOut = esp_rom_crc32_le(crcOut, data, len);
+    if (Update.write(const_cast<uint8_t*>(data), len) != len) {
+      fail(Update.errorString());
+      return;
+    }
+    bytesOutCount += len;
+  }
+
+  // RFC 1952 header: 10 fixed bytes, then whichever optional fields the flags name
+  void headerByte(uint8_t b) {
+    switch (field) {
+      case FIELD_FIXED:
+        header[fieldPos++] = b;
+        if (fieldPos < sizeof(header)) return;
+        if (header[1] != GZIP_MAGIC1 || header[2] != GZIP_DEFLATE) {
+          fail("Bad gzip header");
+          return;
+        }
+        headerFlags = header[3];
+        break;
+      case FIELD_EXTRA_LEN:
+        extraLen |= (uint16_t)b << (8 * fieldPos++);
+        if (fieldPos < 2) return;
+        if (extraLen > 0) {
+          field = FIELD_EXTRA;
+          fieldPos = 0;
+          return;
+        }
+        break;
+      case FIELD_EXTRA:
+        if (++fieldPos < extraLen) return;
+        break;
+      case FIELD_NAME:
+      case FIELD_COMMENT:
+        if (b != 0) return;
+        break;
+      case FIELD_HCRC:
+        if (++fieldPos < 2) return;
+        break;
+    }
+    nextHeaderField();
+  }
+
+  void nextHeaderField() {
+    fieldPos = 0;
+    if (headerFlags & GZIP_FEXTRA) {
+      headerFlags &= ~GZIP_FEXTRA;
+      field = FIELD_EXTRA_LEN;
+    } else if (headerFlags & GZIP_FNAME) {
+      headerFlags &= ~GZIP_FNAME;
+      field = FIELD_NAME;
+    } else if (headerFlags & GZIP_FCOMMENT) {
+      headerFlags &= ~GZIP_FCOMMENT;
+      field = FIELD_COMMENT;
+    } else if (headerFlags & GZIP_FHCRC) {
+      headerFlags &= ~GZIP_FHCRC;
+      field = FIELD_HCRC;
+    } else {
+      stage = STAGE_INFLATE;
+    }
+  }
+
+  // Feeds input until it is used up or the deflate stream ends; returns bytes used
+  size_t inflate(const uint8_t* data, size_t len) {
+    size_t used = 0;
+    for (;;) {
+      size_t inBytes = len - used;
+      size_t outBytes = TINFL_LZ_DICT_SIZE - dictPos;
+      tinfl_status status = tinfl_decompress(inflator, data + used, &inBytes, dict, dict + dictPos,
+                                             &outBytes, TINFL_FLAG_HAS_MORE_INPUT);
+      used += inBytes;
+
+      if (outBytes > 0) {
+        output(dict + dictPos, outBytes);
+        dictPos = (dictPos + outBytes) & (TINFL_LZ_DICT_SIZE - 1);
+        if (failed) return used;
+      }
+
+      if (status < TINFL_STATUS_DONE) {
+        fail("Corrupt gzip data");
+        return used;
+      }
+      if (status == TINFL_STATUS_DONE) {
+        // The window isn't needed for the trailer
+        release();
+        stage = STAGE_TRAILER;
+        return used;
+      }
+      if (status == TINFL_STATUS_NEEDS_MORE_INPUT && used == len) return used;
+    }
+  }
+
+  static uint32_t readLe32(const uint8_t* p) {
+    return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+  }
+
+  static bool parseSha(const char* hex, uint8_t* out) {
+    if (strlen(hex) != OTA_SHA_HEX_LEN) return false;
+    for (int i = 0; i < 32; i++) {
+      int hi = hexValue(hex[2 * i]);
+      int lo = hexValue(hex[2 * i + 1]);
+      if (hi < 0 || lo < 0) return false;
+      out[i] = (uint8_t)(hi << 4 | lo);
+    }
+    return true;
+  }
+
+  static int hexValue(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    c = tolower(c);
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    return -1;
+  }
+};
+
+class OtaUpdate {
+public:
+  enum Result { OTA_NONE, OTA_DONE, OTA_FAILED };
+
+  OtaUpdate() : state(STATE_IDLE), total(0), resumes(0), lastHttpCode(0), worker(nullptr) {
+    url[0] = '\0';
+    sha[0] = '\0';
+  }
+
+  // Download url in the background. Returns false if an update is already
+  // running or the arguments are unusable; sha256 is required.
+  bool startPull(const char* pullUrl, const char* sha256) {
+    if (state == STATE_RUNNING) return false;
+    if (pullUrl == nullptr || strlen(pullUrl) >= sizeof(url) || strncmp(pullUrl, "http", 4) != 0) return false;
+    if (sha256 == nullptr || strlen(sha256) != OTA_SHA_HEX_LEN) return false;
+    strcpy(url, pullUrl);
+    strcpy(sha, sha256);
+    total = 0;
+    resumes = 0;
+    lastHttpCode = 0;
+
+    state = STATE_RUNNING;
+    if (xTaskCreate(task, "ota_pull", OTA_TASK_STACK, this, 1, &worker) != pdPASS) {
+      state = STATE_IDLE;
+      return false;
+    }
+    return true;
+  }
+
+  // Upload path, driven from the web server's upload callback on the loop task
+  bool beginUpload(const char* sha256) {
+    if (state == STATE_RUNNING) return false;
+    url[0] = '\0';
+    total = 0;
+    resumes = 0;
+    state = STATE_RUNNING;
+    if (!writer.begin(sha256)) {
+      state = STATE_FAILED;
+      return false;
+    }
+    return true;
+  }
+
+  bool writeUpload(const uint8_t* data, size_t len) {
+    if (state != STATE_RUNNING || url[0] != '\0') return false;
+    if (writer.write(data, len)) return true;
+    writer.abort();
+    state = STATE_FAILED;
+    return false;
+  }
+
+  bool endUpload() {
+    if (state != STATE_RUNNING || url[0] != '\0') return false;
+    state = writer.end() ? STATE_DONE : STATE_FAILED;
+    return state == STATE_DONE;
+  }
+
+  void abortUpload() {
+    if (state != STATE_RUNNING || url[0] != '\0') return;
+    writer.abort();
+    state = STATE_FAILED;
+  }
+
+  bool isRunning() const { return state == STATE_RUNNING; }
+  bool succeeded() const { return state == STATE_DONE || state == STATE_DONE_REPORTED; }
+
+  // Reports a finished update exactly once
+  Result poll() {
+    if (state == STATE_DONE) {
+      state = STATE_DONE_REPORTED;
+      return OTA_DONE;
+    }
+    if (state == STATE_FAILED) {
+      state = STATE_FAILED_REPORTED;
+      return OTA_FAILED;
+    }
+    return OTA_NONE;
+  }
+
+  // Progress, for the status page and log
+  size_t bytesIn() const { return writer.bytesIn(); }
+  size_t bytesTotal() const { return total; }         // 0 = unknown (uploads)
+  size_t bytesWritten() const { return writer.bytesOut(); }
+  uint8_t resumeCount() const { return resumes; }
+  bool isCompressed() const { return writer.isCompressed(); }
+  const char* source() const { return url[0] != '\0' ? url : "upload"; }
+  const char* error() const {
+    if (writer.error()[0] != '\0') return writer.error();
+    return (state == STATE_FAILED || state == STATE_FAILED_REPORTED) ? "Download failed" : "";
+  }
+  // HTTP status of the last failed request, or a negative HTTPClient error
+  int lastError() const { return lastHttpCode; }
+
+  // The task started by the last successful startPull(); stale once it has finished
+  TaskHandle_t workerTask() const { return worker; }
+
+private:
+  enum State { STATE_IDLE, STATE_RUNNING, STATE_DONE, STATE_FAILED, STATE_DONE_REPORTED, STATE_FAILED_REPORTED };
+
+  volatile State state;
+  OtaImageWriter writer;
+  char url[OTA_URL_LEN];
+  char sha[OTA_SHA_HEX_LEN + 1];
+  volatile size_t total;
+  volatile uint8_t resumes;
+  volatile int lastHttpCode;
+  TaskHandle_t worker;
+
+  static void task(void* arg) {
+    OtaUpdate* self = (OtaUpdate*)arg;
+    bool ok = self->pull();
+    self->state = ok ? STATE_DONE : STATE_FAILED;
+    vTaskDelete(nullptr);
+  }
+
+  bool pull() {
+    if (!writer.begin(sha)) return false;
+
+    uint8_t* buf = (uint8_t*)malloc(OTA_BUFFER_SIZE);
+    if (buf == nullptr) {
+      writer.abort();
+      return false;
+    }
+
+    bool complete = false;
+    for (;;) {
+      size_t offset = writer.bytesIn();
+      int code = fetch(offset, buf, complete);
+      if (complete || writer.hasFailed()) break;
+
+      lastHttpCode = code;
+      if (offset > 0 && code == HTTP_CODE_OK) break;  // Server ignored Range; can't rewind the inflater
+      if (resumes >= OTA_MAX_RESUMES) break;
+      resumes++;
+      LOG(OTA_RESUME, (unsigned)writer.bytesIn(), code);
+      vTaskDelay(pdMS_TO_TICKS(OTA_RESUME_DELAY_MS));
+    }
+    free(buf);
+
+    if (!complete) {
+      writer.abort();
+      return false;
+    }
+    return writer.end();
+  }
+
+  // One request from offset to the end (or until the connection drops).
+  // Returns the HTTP status; complete is set once the whole image is in.
+  int fetch(size_t offset, uint8_t* buf, bool& complete) {
+    HTTPClient http;
+    http.useHTTP10(true);   // No chunked encoding: the stream is the body
+    http.setTimeout(OTA_HTTP_TIMEOUT_MS);
+    if (!http.begin(url)) return HTTPC_ERROR_CONNECTION_REFUSED;
+
+    if (offset > 0) {
+      char range[32];
+      snprintf(range, sizeof(range), "bytes=%u-", (unsigned)offset);
+      http.addHeader("Range", range);
+    }
+
+    int code = http.GET();
+    bool expected = (offset == 0) ? code == HTTP_CODE_OK : code == HTTP_CODE_PARTIAL_CONTENT;
+    if (!expected) {
+      http.end();
+      return code;
+    }
+    if (offset == 0 && http.getSize() > 0) total = http.getSize();
+
+    WiFiClient* stream = http.getStreamPtr();
+    unsigned long lastData = millis();
+    while (!writer.hasFailed() && !writer.isComplete() && (total == 0 || writer.bytesIn() < total)) {
+      size_t avail = stream->available();
+      if (avail == 0) {
+        if (!stream->connected() || millis() - lastData > OTA_READ_TIMEOUT_MS) break;
+        vTaskDelay(1);
+        continue;
+      }
+      int n = stream->read(buf, avail < OTA_BUFFER_SIZE ? avail : OTA_BUFFER_SIZE);
+      if (n <= 0) continue;
+      lastData = millis();
+      writer.write(buf, n);
+    }
+
+    // gzip knows where it ends; a raw image ends with the body
+    if (!writer.hasFailed()) {
+      if (writer.isComplete()) complete = true;
+      else if (!writer.isCompressed() && total > 0 && writer.bytesIn() >= total) complete = true;
+      else if (!writer.isCompressed() && total == 0 && !stream->connected()) complete = true;
+    }
+    http.end();
+    return code;
+  }
+};
+
+#endif // OTA_UPDATE_H
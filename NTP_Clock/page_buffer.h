@@ -0,0 +1,82 @@
+/*
+ * PageBuffer - Fixed-size text buffer the web pages are rendered into
+ *
+ * Stands in for Arduino String as the output of the page renderers in
+ * config_page.h: += for const char*, char and unsigned numbers, nothing
+ * else. The storage is part of the object, so a static PageBuffer means
+ * serving a page never touches the heap, however long the clock runs.
+ *
+ * Text that doesn't fit is cut off at the capacity and flagged, not
+ * written past the end; the high-water mark shows how close real pages
+ * come, so the size can be tuned.
+ *
+ * Pure C++ - no Arduino dependencies.
+ */
+
+#ifndef PAGE_BUFFER_H
+#define PAGE_BUFFER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+template <size_t Capacity>
+class PageBuffer {
+public:
+  PageBuffer() : len(0), highWaterMark(0), truncated(false) { text[0] = '\0'; }
+
+  void clear() {
+    len = 0;
+    truncated = false;
+    text[0] = '\0';
+  }
+
+  PageBuffer& operator+=(const char* s) {
+    size_t n = strlen(s);
+    size_t room = Capacity - 1 - len;
+    if (n > room) {
+      n = room;
+      truncated = true;
+    }
+    memcpy(text + len, s, n);
+    grow(n);
+    return *this;
+  }
+
+  PageBuffer& operator+=(char c) {
+    if (len + 1 >= Capacity) {
+      truncated = true;
+      return *this;
+    }
+    text[len] = c;
+    grow(1);
+    return *this;
+  }
+
+  PageBuffer& operator+=(unsigned long value) {
+    char digits[12];
+    snprintf(digits, sizeof(digits), "%lu", value);
+    return *this += (const char*)digits;
+  }
+
+  const char* c_str() const { return text; }
+  size_t length() const { return len; }
+  bool overflowed() const { return truncated; }
+  size_t highWater() const { return highWaterMark; }
+  static constexpr size_t capacity() { return Capacity; }
+
+private:
+  char text[Capacity];
+  size_t len;
+  size_t highWaterMark;
+  bool truncated;
+
+  void grow(size_t n) {
+    len += n;
+    text[len] = '\0';
+    if (len > highWaterMark) highWaterMark = len;
+  }
+};
+
+#endif // PAGE_BUFFER_H
@@ -0,0 +1,83 @@
+/*
+ * Config page bench - time to render the pages the web server sends
+ *
+ * Google Benchmark timings for renderConfigPage() and renderUpdatePage()
+ * into the static PageBuffer the device serves from, with a typical and a
+ * worst-case network list.
+ *
+ * Built by the CMakeLists.txt at the top of the repository
+ * (cmake --build <dir> --target config_page_bench).
+ */
+
+#include <benchmark/benchmark.h>
+#include "config_page.h"
+#include "page_buffer.h"
+
+#define SCAN_MAX 16   // WIFI_SCAN_MAX in wifi_scan_cache.h
+
+static PageBuffer<WEB_PAGE_BUFFER_SIZE> page;
+
+static ConfigPageData configData(const char* const* networks, uint8_t count) {
+  ConfigPageData d = {};
+  d.ssid = networks[0];
+  d.password = "correct horse battery staple";
+  d.timezone = "America/Los_Angeles";
+  d.ntpServers = "pool.ntp.org,time.google.com";
+  d.brightness = 8;
+  d.use24Hour = true;
+  d.stationIP = "192.168.1.50";
+  d.apIP = "192.168.4.1";
+  d.networks = networks;
+  d.networkCount = count;
+  d.telemetryPeriodMs = 1000;
+  d.telemetryBatch = 4;
+  return d;
+}
+
+static void BM_ConfigPage(benchmark::State& state) {
+  static const char* const NETWORKS[] = {"Home", "Neighbour 5G", "Cafe"};
+  ConfigPageData d = configData(NETWORKS, 3);
+  for (auto _ : state) {
+    page.clear();
+    renderConfigPage(page, d);
+    benchmark::DoNotOptimize(page.c_str());
+  }
+  state.SetBytesProcessed(state.iterations() * page.length());
+}
+BENCHMARK(BM_ConfigPage);
+
+static void BM_ConfigPageWorstCase(benchmark::State& state) {
+  static char ssids[SCAN_MAX][33];
+  static const char* names[SCAN_MAX];
+  for (int i = 0; i < SCAN_MAX; i++) {
+    memset(ssids[i], '&', 32);
+    ssids[i][32] = '\0';
+    names[i] = ssids[i];
+  }
+  ConfigPageData d = configData(names, SCAN_MAX);
+  for (auto _ : state) {
+    page.clear();
+    renderConfigPage(page, d);
+    benchmark::DoNotOptimize(page.c_str());
+  }
+  state.SetBytesProcessed(state.iterations() * page.length());
+}
+BENCHMARK(BM_ConfigPageWorstCase);
+
+static void BM_UpdatePage(benchmark::State& state) {
+  UpdatePageData u = {};
+  u.pullUrl = "http://192.168.1.10:8000/firmware-ota.bin.gz";
+  u.source = u.pullUrl;
+  u.error = "";
+  u.running = true;
+  u.bytesIn = 512000;
+  u.bytesTotal = 1048576;
+  for (auto _ : state) {
+    page.clear();
+    renderUpdatePage(page, u, "2.17");
+    benchmark::DoNotOptimize(page.c_str());
+  }
+}
+BENCHMARK(BM_UpdatePage);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,171 @@
+/*
+ * Config page unit tests - what getConfigPageHTML() and the update page render
+ *
+ * Renders from plain ConfigPageData/UpdatePageData into std::string and
+ * into the PageBuffer the device serves from, and checks escaping, the
+ * selected options and that the worst-case page fits the buffer.
+ *
+ * Built by the CMakeLists.txt at the top of the repository.
+ */
+
+#include <gtest/gtest.h>
+#include <string>
+#include "config_page.h"
+#include "page_buffer.h"
+
+static ConfigPageData sampleData() {
+  static const char* const NETWORKS[] = {"Home", "Cafe <Free>"};
+  ConfigPageData d = {};
+  d.ssid = "Home";
+  d.password = "secret";
+  d.timezone = "Europe/London";
+  d.ntpServers = "pool.ntp.org,time.google.com";
+  d.brightness = 8;
+  d.use24Hour = true;
+  d.stationIP = "192.168.1.50";
+  d.apIP = "192.168.4.1";
+  d.networks = NETWORKS;
+  d.networkCount = 2;
+  d.telemetryPeriodMs = 1000;
+  d.telemetryBatch = 4;
+  return d;
+}
+
+static size_t count(const std::string& html, const std::string& what) {
+  size_t n = 0;
+  for (size_t at = html.find(what); at != std::string::npos; at = html.find(what, at + 1)) n++;
+  return n;
+}
+
+TEST(ConfigPage, SavedValues) {
+  std::string html;
+  renderConfigPage(html, sampleData());
+  EXPECT_NE(std::string::npos, html.find("name='ssid' list='networks' value='Home'"));
+  EXPECT_NE(std::string::npos, html.find("value='pool.ntp.org,time.google.com'"));
+  EXPECT_NE(std::string::npos, html.find("name='brightness' min='0' max='15' value='8'"));
+  EXPECT_NE(std::string::npos, html.find("name='tm_period' min='0' max='60000' value='1000'"));
+  EXPECT_NE(std::string::npos, html.find("192.168.1.50"));
+  EXPECT_EQ(0u, html.rfind("<!DOCTYPE html>", 0));
+  EXPECT_NE(std::string::npos, html.find("</body></html>"));
+}
+
+// The timezone <select> alone, without the hour format one
+static std::string zoneSelect(const std::string& html) {
+  size_t from = html.find("<select name='tz'");
+  return from == std::string::npos ? "" : html.substr(from, html.find("</select>", from) - from);
+}
+
+TEST(ConfigPage, OneZoneSelected) {
+  std::string html;
+  renderConfigPage(html, sampleData());
+  EXPECT_EQ(1u, count(zoneSelect(html), " selected>"));
+  EXPECT_NE(std::string::npos, html.find("<option value='Europe/London' selected>"));
+  EXPECT_EQ(TIMEZONE_COUNT, count(html, "<option value='") - 2 - 2);   // Less networks and hour formats
+}
+
+TEST(ConfigPage, UnknownZoneSelectsNothing) {
+  ConfigPageData d = sampleData();
+  d.timezone = "Mars/Olympus_Mons";
+  std::string html;
+  renderConfigPage(html, d);
+  ASSERT_NE("", zoneSelect(html));
+  EXPECT_EQ(0u, count(zoneSelect(html), " selected>"));
+}
+
+TEST(ConfigPage, HourFormat) {
+  ConfigPageData d = sampleData();
+  std::string html;
+  renderConfigPage(html, d);
+  EXPECT_NE(std::string::npos, html.find("<option value='24' selected>"));
+  d.use24Hour = false;
+  html.clear();
+  renderConfigPage(html, d);
+  EXPECT_NE(std::string::npos, html.find("<option value='12' selected>"));
+  EXPECT_EQ(std::string::npos, html.find("<option value='24' selected>"));
+}
+
+TEST(ConfigPage, EscapesSavedText) {
+  ConfigPageData d = sampleData();
+  d.ssid = "x' onfocus='alert(1)";
+  d.password = "a\"b<c>&";
+  std::string html;
+  renderConfigPage(html, d);
+  EXPECT_EQ(std::string::npos, html.find("onfocus='alert"));
+  EXPECT_NE(std::string::npos, html.find("value='x&#39; onfocus=&#39;alert(1)'"));
+  EXPECT_NE(std::string::npos, html.find("value='a&quot;b&lt;c&gt;&amp;'"));
+  EXPECT_NE(std::string::npos, html.find("<option value='Cafe &lt;Free&gt;'>"));
+}
+
+#define SCAN_MAX        16    // WIFI_SCAN_MAX in wifi_scan_cache.h
+#define SERVERS_MAX_LEN 200   // SNTP_SERVERS_MAX_LEN in sntp_client.h
+
+// Longest SSIDs, all characters needing escapes, every network slot used
+TEST(ConfigPage, WorstCaseFitsThePageBuffer) {
+  static char ssids[SCAN_MAX][33];
+  static const char* names[SCAN_MAX];
+  for (int i = 0; i < SCAN_MAX; i++) {
+    memset(ssids[i], '&', 32);
+    ssids[i][32] = '\0';
+    names[i] = ssids[i];
+  }
+  char password[65];
+  memset(password, '"', 64);
+  password[64] = '\0';
+  char servers[SERVERS_MAX_LEN];
+  memset(servers, '\'', sizeof(servers) - 1);
+  servers[sizeof(servers) - 1] = '\0';
+
+  ConfigPageData d = sampleData();
+  d.ssid = ssids[0];
+  d.password = password;
+  d.ntpServers = servers;
+  d.networks = names;
+  d.networkCount = SCAN_MAX;
+
+  std::string html;
+  renderConfigPage(html, d);
+  static PageBuffer<WEB_PAGE_BUFFER_SIZE> page;
+  page.clear();
+  renderConfigPage(page, d);
+  EXPECT_FALSE(page.overflowed()) << html.size() << " bytes";
+  EXPECT_EQ(html, page.c_str());
+}
+
+TEST(PageBuffer, TruncatesInsteadOfOverrunning) {
+  PageBuffer<8> page;
+  page += "abc";
+  page += 'd';
+  page += "efghij";
+  EXPECT_TRUE(page.overflowed());
+  EXPECT_STREQ("abcdefg", page.c_str());
+  page += 'x';
+  EXPECT_STREQ("abcdefg", page.c_str());
+  EXPECT_EQ(7u, page.highWater());
+  page.clear();
+  page += 42ul;
+  EXPECT_STREQ("42", page.c_str());
+  EXPECT_FALSE(page.overflowed());
+}
+
+TEST(UpdatePage, ShowsProgressAndEscapedError) {
+  UpdatePageData u = {};
+  u.pullUrl = "http://h/fw.bin.gz";
+  u.source = "http://h/fw.bin.gz?a=1&b=2";
+  u.error = "<bad sha>";
+  u.bytesIn = 1000;
+  u.bytesTotal = 2000;
+  std::string html;
+  renderUpdatePage(html, u, "2.17");
+  EXPECT_NE(std::string::npos, html.find("Update failed"));
+  EXPECT_NE(std::string::npos, html.find("a=1&amp;b=2"));
+  EXPECT_NE(std::string::npos, html.find("&lt;bad sha&gt;"));
+  EXPECT_NE(std::string::npos, html.find("1000 of 2000 bytes received"));
+  EXPECT_EQ(std::string::npos, html.find("http-equiv='refresh'"));
+
+  u.running = true;
+  u.error = "";
+  html.clear();
+  renderUpdatePage(html, u, "2.17");
+  EXPECT_NE(std::string::npos, html.find("http-equiv='refresh'"));
+  EXPECT_EQ(std::string::npos, html.find("class='error'"));
+}
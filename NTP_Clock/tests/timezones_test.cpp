@@ -0,0 +1,187 @@
+/*
+ * Timezone unit tests - every zone's DST transitions, 2025 to 2035
+ *
+ * For each zone in timezones.h, finds the transitions glibc's localtime_r()
+ * makes from the zone's POSIX TZ string (the rule newlib uses on the
+ * device) and checks LocalClock one second before, at and after each one,
+ * and at every hour in between. Where the host has the IANA tz database,
+ * also checks that the POSIX string gives the same transitions as the real
+ * zone over those years.
+ *
+ * Built by the CMakeLists.txt at the top of the repository.
+ */
+
+#include <gtest/gtest.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include <string>
+#include <vector>
+#include "timezones.h"
+
+#define FIRST_YEAR 2025
+#define LAST_YEAR  2035
+
+struct Transition {
+  int64_t utc;          // First second of the new offset
+  int32_t offsetAfter;
+};
+
+static void useTz(const char* tz) {
+  setenv("TZ", tz, 1);
+  tzset();
+}
+
+static struct tm oracle(int64_t utc) {
+  time_t t = (time_t)utc;
+  struct tm tm;
+  localtime_r(&t, &tm);
+  return tm;
+}
+
+static int64_t yearStart(int32_t year) { return (int64_t)daysFromCivil(year, 1, 1) * 86400; }
+
+// Offset changes under the current TZ in [from, to): an hourly scan, then a
+// binary search for the exact second (transitions are hours apart)
+static std::vector<Transition> oracleTransitions(int64_t from, int64_t to) {
+  std::vector<Transition> out;
+  long before = oracle(from).tm_gmtoff;
+  for (int64_t t = from + 3600; t < to; t += 3600) {
+    long now = oracle(t).tm_gmtoff;
+    if (now == before) continue;
+    int64_t lo = t - 3600, hi = t;   // Old offset at lo, new at hi
+    while (hi - lo > 1) {
+      int64_t mid = lo + (hi - lo) / 2;
+      (oracle(mid).tm_gmtoff == before ? lo : hi) = mid;
+    }
+    out.push_back({hi, (int32_t)now});
+    before = now;
+  }
+  return out;
+}
+
+static ::testing::AssertionResult sameAsOracle(LocalClock& clock, int64_t utc) {
+  LocalTime lt;
+  clock.toLocal(utc, lt);
+  struct tm tm = oracle(utc);
+  if (lt.year == tm.tm_year + 1900 && lt.month == tm.tm_mon + 1 && lt.day == tm.tm_mday &&
+      lt.hour == tm.tm_hour && lt.minute == tm.tm_min && lt.second == tm.tm_sec &&
+      lt.weekday == tm.tm_wday && lt.dst == (tm.tm_isdst > 0) && lt.utcOffset == tm.tm_gmtoff) {
+    return ::testing::AssertionSuccess();
+  }
+  char got[80], want[80];
+  snprintf(got, sizeof(got), "%04d-%02u-%02u %02u:%02u:%02u wd%u dst%d %+d", (int)lt.year, lt.month, lt.day,
+           lt.hour, lt.minute, lt.second, lt.weekday, lt.dst, (int)lt.utcOffset);
+  snprintf(want, sizeof(want), "%04d-%02d-%02d %02d:%02d:%02d wd%d dst%d %+ld", tm.tm_year + 1900, tm.tm_mon + 1,
+           tm.tm_mday, tm.tm_hour, tm.tm_min, tm.tm_sec, tm.tm_wday, tm.tm_isdst > 0, tm.tm_gmtoff);
+  return ::testing::AssertionFailure() << "UTC " << utc << ": LocalClock " << got << ", localtime_r " << want;
+}
+
+class ZoneRules : public ::testing::TestWithParam<const TimeZone*> {
+protected:
+  // A day either side, so transitions near the ends of the range count too
+  const int64_t from = yearStart(FIRST_YEAR) - 86400;
+  const int64_t to = yearStart(LAST_YEAR + 1) + 86400;
+};
+
+TEST_P(ZoneRules, TransitionEdges) {
+  const TimeZone* zone = GetParam();
+  useTz(zone->posix);
+  std::vector<Transition> transitions = oracleTransitions(from, to);
+  bool hasDst = zone->dstOffset != zone->stdOffset;
+  EXPECT_EQ(hasDst ? 2u * (LAST_YEAR - FIRST_YEAR + 1) : 0u, transitions.size());
+
+  LocalClock clock;
+  clock.setZone(zone);
+  for (const Transition& tr : transitions) {
+    ASSERT_TRUE(sameAsOracle(clock, tr.utc - 1));
+    ASSERT_TRUE(sameAsOracle(clock, tr.utc));
+    ASSERT_TRUE(sameAsOracle(clock, tr.utc + 1));
+    LocalTime lt;
+    clock.toLocal(tr.utc, lt);
+    EXPECT_EQ(tr.offsetAfter, lt.utcOffset);
+  }
+}
+
+TEST_P(ZoneRules, EveryHour) {
+  const TimeZone* zone = GetParam();
+  useTz(zone->posix);
+  LocalClock clock;
+  clock.setZone(zone);
+  for (int64_t t = from + 1799; t < to; t += 3600) ASSERT_TRUE(sameAsOracle(clock, t));
+}
+
+// Catches a POSIX string that doesn't describe the zone it is named for
+TEST_P(ZoneRules, PosixStringMatchesTzdata) {
+  const TimeZone* zone = GetParam();
+  std::string file = std::string("/usr/share/zoneinfo/") + zone->name;
+  if (access(file.c_str(), R_OK) != 0) GTEST_SKIP() << "no tz database entry for " << zone->name;
+
+  useTz(zone->posix);
+  std::vector<Transition> fromPosix = oracleTransitions(from, to);
+  long posixOffset = oracle(from).tm_gmtoff;
+  useTz((":" + std::string(zone->name)).c_str());
+  std::vector<Transition> fromTzdata = oracleTransitions(from, to);
+  long tzdataOffset = oracle(from).tm_gmtoff;
+
+  EXPECT_EQ(tzdataOffset, posixOffset);
+  ASSERT_EQ(fromTzdata.size(), fromPosix.size());
+  for (size_t i = 0; i < fromPosix.size(); i++) {
+    EXPECT_EQ(fromTzdata[i].utc, fromPosix[i].utc) << "transition " << i;
+    EXPECT_EQ(fromTzdata[i].offsetAfter, fromPosix[i].offsetAfter) << "transition " << i;
+  }
+}
+
+static std::vector<const TimeZone*> allZones() {
+  std::vector<const TimeZone*> zones;
+  for (size_t i = 0; i < TIMEZONE_COUNT; i++) zones.push_back(&TIMEZONES[i]);
+  return zones;
+}
+
+static std::string zoneTestName(const ::testing::TestParamInfo<const TimeZone*>& info) {
+  std::string name = info.param->name;
+  for (char& c : name) {
+    if (!isalnum((unsigned char)c)) c = '_';
+  }
+  return name;
+}
+
+INSTANTIATE_TEST_SUITE_P(AllZones, ZoneRules, ::testing::ValuesIn(allZones()), zoneTestName);
+
+// Hand-checked instants, independent of localtime_r
+TEST(LocalClock, KnownChanges) {
+  LocalClock clock;
+  LocalTime lt;
+
+  // US spring forward, 2025-03-09 02:00 EST = 07:00 UTC
+  clock.setZone(findTimeZone("America/New_York"));
+  int64_t t = yearStart(2025) + (31 + 28 + 8) * 86400LL + 7 * 3600;
+  clock.toLocal(t - 1, lt);
+  EXPECT_EQ(1, lt.hour);
+  EXPECT_FALSE(lt.dst);
+  clock.toLocal(t, lt);
+  EXPECT_EQ(3, lt.hour);
+  EXPECT_TRUE(lt.dst);
+
+  // EU fall back, 2030-10-27 01:00 UTC: London 02:00 BST -> 01:00 GMT
+  clock.setZone(findTimeZone("Europe/London"));
+  t = (int64_t)daysFromCivil(2030, 10, 27) * 86400 + 3600;
+  clock.toLocal(t - 1, lt);
+  EXPECT_EQ(1, lt.hour);
+  EXPECT_EQ(59, lt.second);
+  EXPECT_TRUE(lt.dst);
+  clock.toLocal(t, lt);
+  EXPECT_EQ(1, lt.hour);
+  EXPECT_EQ(0, lt.minute);
+  EXPECT_FALSE(lt.dst);
+
+  // Southern hemisphere: Sydney ends DST 2035-04-01 03:00 AEDT = 16:00 UTC the day before
+  clock.setZone(findTimeZone("Australia/Sydney"));
+  t = (int64_t)daysFromCivil(2035, 3, 31) * 86400 + 16 * 3600;
+  clock.toLocal(t - 1, lt);
+  EXPECT_TRUE(lt.dst);
+  EXPECT_EQ(2, lt.hour);
+  clock.toLocal(t, lt);
+  EXPECT_FALSE(lt.dst);
+  EXPECT_EQ(2, lt.hour);
+}
@@ -0,0 +1,228 @@
+/*
+ * Timezones - Compiled POSIX TZ rules with integer local time conversion
+ *
+ * Every zone we ship is stored twice: as its POSIX TZ string (handed to newlib
+ * so anything else using localtime()/strftime() agrees) and as a pre-parsed
+ * rule. LocalClock converts UTC to local time from the parsed rule with
+ * integer days-from-civil arithmetic, caching the year's DST transitions, so a
+ * render costs a few divisions instead of a localtime() call.
+ *
+ * Pure C++ - no Arduino dependencies.
+ */
+
+#ifndef TIMEZONES_H
+#define TIMEZONES_H
+
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+// POSIX "Mm.w.d/time" rule: week 1-4, or 5 for the last one in the month,
+// weekday 0 = Sunday, minute = local wall-clock time of the change
+struct TzTransition {
+  uint8_t month;
+  uint8_t week;
+  uint8_t weekday;
+  int16_t minute;
+};
+
+struct TimeZone {
+  const char* name;     // IANA name, stored in Preferences
+  const char* label;    // Shown on the config page
+  const char* posix;    // POSIX TZ string for newlib
+  int32_t stdOffset;    // Seconds east of UTC
+  int32_t dstOffset;    // Seconds east of UTC while DST is active (== stdOffset if none)
+  TzTransition dstStart;
+  TzTransition dstEnd;
+};
+
+#define TZ_NO_DST   {0, 0, 0, 0}
+#define TZ_US_START {3, 2, 0, 120}     // Second Sunday in March, 02:00
+#define TZ_US_END   {11, 1, 0, 120}    // First Sunday in November, 02:00
+
+#define TZ_CLOCK_SET_UTC 1704067200LL  // 2024-01-01: any earlier and the clock hasn't been set
+
+// EU zones all switch at 01:00 UTC, so their local transition times differ
+static const TimeZone TIMEZONES[] = {
+  {"America/Los_Angeles", "Pacific Time (US)",  "PST8PDT,M3.2.0,M11.1.0",          -28800, -25200, TZ_US_START, TZ_US_END},
+  {"America/Denver",      "Mountain Time (US)", "MST7MDT,M3.2.0,M11.1.0",          -25200, -21600, TZ_US_START, TZ_US_END},
+  {"America/Phoenix",     "Arizona",            "MST7",                            -25200, -25200, TZ_NO_DST, TZ_NO_DST},
+  {"America/Chicago",     "Central Time (US)",  "CST6CDT,M3.2.0,M11.1.0",          -21600, -18000, TZ_US_START, TZ_US_END},
+  {"America/New_York",    "Eastern Time (US)",  "EST5EDT,M3.2.0,M11.1.0",          -18000, -14400, TZ_US_START, TZ_US_END},
+  {"America/Anchorage",   "Alaska",             "AKST9AKDT,M3.2.0,M11.1.0",        -32400, -28800, TZ_US_START, TZ_US_END},
+  {"Pacific/Honolulu",    "Hawaii",             "HST10",                           -36000, -36000, TZ_NO_DST, TZ_NO_DST},
+  {"America/Halifax",     "Atlantic Time",      "AST4ADT,M3.2.0,M11.1.0",          -14400, -10800, TZ_US_START, TZ_US_END},
+  {"America/Sao_Paulo",   "Brasilia",           "<-03>3",                          -10800, -10800, TZ_NO_DST, TZ_NO_DST},
+  {"UTC",                 "UTC",                "UTC0",                            0,      0,      TZ_NO_DST, TZ_NO_DST},
+  {"Europe/London",       "London, Dublin",     "GMT0BST,M3.5.0/1,M10.5.0",        0,      3600,   {3, 5, 0, 60},  {10, 5, 0, 120}},
+  {"Europe/Berlin",       "Central Europe",     "CET-1CEST,M3.5.0,M10.5.0/3",      3600,   7200,   {3, 5, 0, 120}, {10, 5, 0, 180}},
+  {"Europe/Athens",       "Eastern Europe",     "EET-2EEST,M3.5.0/3,M10.5.0/4",    7200,   10800,  {3, 5, 0, 180}, {10, 5, 0, 240}},
+  {"Europe/Moscow",       "Moscow",             "MSK-3",                           10800,  10800,  TZ_NO_DST, TZ_NO_DST},
+  {"Asia/Dubai",          "Gulf",               "<+04>-4",                         14400,  14400,  TZ_NO_DST, TZ_NO_DST},
+  {"Asia/Kolkata",        "India",              "IST-5:30",                        19800,  19800,  TZ_NO_DST, TZ_NO_DST},
+  {"Asia/Shanghai",       "China",              "CST-8",                           28800,  28800,  TZ_NO_DST, TZ_NO_DST},
+  {"Asia/Singapore",      "Singapore",          "<+08>-8",                         28800,  28800,  TZ_NO_DST, TZ_NO_DST},
+  {"Asia/Tokyo",          "Japan",              "JST-9",                           32400,  32400,  TZ_NO_DST, TZ_NO_DST},
+  {"Australia/Brisbane",  "Brisbane",           "AEST-10",                         36000,  36000,  TZ_NO_DST, TZ_NO_DST},
+  {"Australia/Sydney",    "Sydney, Melbourne",  "AEST-10AEDT,M10.1.0,M4.1.0/3",    36000,  39600,  {10, 1, 0, 120}, {4, 1, 0, 180}},
+  {"Pacific/Auckland",    "New Zealand",        "NZST-12NZDT,M9.5.0,M4.1.0/3",     43200,  46800,  {9, 5, 0, 120}, {4, 1, 0, 180}},
+};
+
+#define TIMEZONE_COUNT (sizeof(TIMEZONES) / sizeof(TIMEZONES[0]))
+#define TIMEZONE_DEFAULT (&TIMEZONES[0])
+
+// Days since 1970-01-01 for a proleptic Gregorian date (H. Hinnant's algorithm)
+inline int32_t daysFromCivil(int32_t y, uint32_t m, uint32_t d) {
+  y -= m <= 2;
+  int32_t era = (y >= 0 ? y : y - 399) / 400;
+  uint32_t yoe = (uint32_t)(y - era * 400);
+  uint32_t doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+  uint32_t doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+  return era * 146097 + (int32_t)doe - 719468;
+}
+
+inline void civilFromDays(int32_t z, int32_t& y, uint32_t& m, uint32_t& d) {
+  z += 719468;
+  int32_t era = (z >= 0 ? z : z - 146096) / 146097;
+  uint32_t doe = (uint32_t)(z - era * 146097);
+  uint32_t yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+  uint32_t doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+  uint32_t mp = (5 * doy + 2) / 153;
+  d = doy - (153 * mp + 2) / 5 + 1;
+  m = mp < 10 ? mp + 3 : mp - 9;
+  y = (int32_t)yoe + era * 400 + (m <= 2);
+}
+
+// 0 = Sunday
+inline uint32_t weekdayFromDays(int32_t z) {
+  return (uint32_t)(z >= -4 ? (z + 4) % 7 : (z + 5) % 7 + 6);
+}
+
+inline bool isLeapYear(int32_t y) {
+  return (y % 4 == 0 && y % 100 != 0) || y % 400 == 0;
+}
+
+// UTC instant of a transition in the given year; offsetBefore is the UTC
+// offset in effect just before the change (the rule is in local wall time)
+inline int64_t transitionUtc(const TzTransition& t, int32_t year, int32_t offsetBefore) {
+  static const uint8_t monthDays[] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+  int32_t first = daysFromCivil(year, t.month, 1);
+  uint32_t firstWeekday = weekdayFromDays(first);
+  int32_t day = (int32_t)((t.weekday + 7 - firstWeekday) % 7) + (t.week - 1) * 7;
+  int32_t length = monthDays[t.month - 1] + (t.month == 2 && isLeapYear(year));
+  while (day >= length) day -= 7;  // Week 5 means "last"
+  return (int64_t)(first + day) * 86400 + (int64_t)t.minute * 60 - offsetBefore;
+}
+
+struct LocalTime {
+  int32_t year;
+  uint8_t month;    // 1-12
+  uint8_t day;      // 1-31
+  uint8_t hour;
+  uint8_t minute;
+  uint8_t second;
+  uint8_t weekday;  // 0 = Sunday
+  bool dst;
+  int32_t utcOffset;
+};
+
+class LocalClock {
+public:
+  LocalClock() : zone(TIMEZONE_DEFAULT), cachedYear(INT32_MIN), dstStart(0), dstEnd(0) {}
+
+  void setZone(const TimeZone* tz) {
+    zone = tz != nullptr ? tz : TIMEZONE_DEFAULT;
+    cachedYear = INT32_MIN;
+  }
+
+  const TimeZone* getZone() const { return zone; }
+
+  bool isDst(int64_t utc) {
+    if (zone->dstOffset == zone->stdOffset) return false;
+
+    // DST transitions never fall near New Year, so the standard-time year is
+    // the right one to evaluate the rules for
+    int32_t days = (int32_t)floorDiv(utc + zone->stdOffset, 86400);
+    int32_t y;
+    uint32_t m, d;
+    civilFromDays(days, y, m, d);
+    if (y != cachedYear) {
+      cachedYear = y;
+      dstStart = transitionUtc(zone->dstStart, y, zone->stdOffset);
+      dstEnd = transitionUtc(zone->dstEnd, y, zone->dstOffset);
+    }
+
+    if (dstStart < dstEnd) {
+      return utc >= dstStart && utc < dstEnd;       // Northern hemisphere
+    }
+    return utc >= dstStart || utc < dstEnd;         // Southern: DST spans New Year
+  }
+
+  void toLocal(int64_t utc, LocalTime& out) {
+    out.dst = isDst(utc);
+    out.utcOffset = out.dst ? zone->dstOffset : zone->stdOffset;
+
+    int64_t local = utc + out.utcOffset;
+    int32_t days = (int32_t)floorDiv(local, 86400);
+    int32_t secs = (int32_t)(local - (int64_t)days * 86400);
+
+    uint32_t m, d;
+    civilFromDays(days, out.year, m, d);
+    out.month = m;
+    out.day = d;
+    out.weekday = weekdayFromDays(days);
+    out.hour = secs / 3600;
+    out.minute = (secs / 60) % 60;
+    out.second = secs % 60;
+  }
+
+private:
+  const TimeZone* zone;
+  int32_t cachedYear;
+  int64_t dstStart;
+  int64_t dstEnd;
+
+  static int64_t floorDiv(int64_t a, int64_t b) {
+    int64_t q = a / b;
+    return (a % b != 0 && (a < 0) != (b < 0)) ? q - 1 : q;
+  }
+};
+
+inline const TimeZone* findTimeZone(const char* name) {
+  if (name == nullptr) return nullptr;
+  for (size_t i = 0; i < TIMEZONE_COUNT; i++) {
+    if (strcmp(TIMEZONES[i].name, name) == 0) return &TIMEZONES[i];
+  }
+  return nullptr;
+}
+
+// Best guess for a bare UTC offset (current offset from IP geolocation, or a
+// legacy "timezone" preference). Standard-time matches win over DST matches.
+inline const TimeZone* findTimeZoneByOffset(int32_t offset) {
+  for (size_t i = 0; i < TIMEZONE_COUNT; i++) {
+    if (TIMEZONES[i].stdOffset == offset) return &TIMEZONES[i];
+  }
+  for (size_t i = 0; i < TIMEZONE_COUNT; i++) {
+    if (TIMEZONES[i].dstOffset == offset) return &TIMEZONES[i];
+  }
+  return nullptr;
+}
+
+// For an offset in effect at utc, as IP geolocation reports it (DST
+// included): the first zone on that offset at that moment. Before the clock
+// has been set there is no telling summer from winter, so the bare-offset
+// guess; the caller looks the zone up again once synced.
+inline const TimeZone* findTimeZoneByCurrentOffset(int32_t offset, int64_t utc) {
+  if (utc >= TZ_CLOCK_SET_UTC) {
+    LocalClock clock;
+    LocalTime lt;
+    for (size_t i = 0; i < TIMEZONE_COUNT; i++) {
+      clock.setZone(&TIMEZONES[i]);
+      clock.toLocal(utc, lt);
+      if (lt.utcOffset == offset) return &TIMEZONES[i];
+    }
+  }
+  return findTimeZoneByOffset(offset);
+}
+
+#endif // TIMEZONES_H
@@ -0,0 +1,228 @@
+#!/usr/bin/env python3
+"""
+Read NTP_Clock's binary event log (see event_log.h) as text.
+
+  monitor PORT [--save OUT.bin]   Print the log live from the USB CDC port
+                                  (needs pyserial), optionally saving the raw
+                                  stream. Ctrl-C to stop.
+  decode IN.bin                   Print a saved capture
+
+Message formats come from log_messages.h, read at start-up (--messages to
+point elsewhere), so a capture decodes with the header of the firmware that
+wrote it. Records replayed after a reset are marked "(prev boot)", and a line
+is printed whenever the clock reports records dropped (ring full) or unsent
+(no host reading). Plain text between frames, such as the ROM boot messages,
+is passed through; Improv packets are skipped.
+"""
+
+import argparse
+import os
+import re
+import struct
+import sys
+
+VERSION = 1
+TYPE_LOG = 0x4C
+HEADER = struct.Struct("<BBBBII")
+RECORD = struct.Struct("<IHBB")
+CRC = struct.Struct("<H")
+MESSAGES_H = os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", "log_messages.h")
+SPEC = re.compile(r"%([-+ #0]*\d*(?:\.\d+)?)(hh|h|ll|l|z)?([diouxXcsfFeEgG%])")
+
+
+def crc16(data):
+    """CRC-16/CCITT-FALSE, matching logCrc16()."""
+    crc = 0xFFFF
+    for byte in data:
+        crc ^= byte << 8
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x1021) if crc & 0x8000 else (crc << 1)
+            crc &= 0xFFFF
+    return crc
+
+
+def cobs_decode(data):
+    out = bytearray()
+    i = 0
+    while i < len(data):
+        code = data[i]
+        if code == 0 or i + code > len(data) + 1:
+            raise ValueError("bad COBS code")
+        out += data[i + 1:i + code]
+        i += code
+        if code < 0xFF and i < len(data):
+            out.append(0)
+    return bytes(out)
+
+
+def load_messages(path):
+    """Format strings by LogId, in LOG_MESSAGES order."""
+    with open(path) as f:
+        return [fmt for _, fmt in re.findall(r'X\((\w+),\s*"(.*)"\)', f.read())]
+
+
+def format_args(fmt, args):
+    """printf on the stored arguments, as logFormat() does; missing ones print as "?"."""
+    pos = 0
+
+    def convert(m):
+        nonlocal pos
+        flags, length, conv = m.groups()
+        if conv == "%":
+            return "%"
+        if conv == "s":
+            if pos >= len(args):
+                return "?"
+            end = args.find(b"\x00", pos)
+            end = len(args) if end < 0 else end
+            text = args[pos:end].decode("utf-8", "replace")
+            pos = end + 1
+            return ("%" + flags + "s") % text
+        if conv in "fFeEgG":
+            size, code = 4, "<f"
+        elif length == "ll":
+            size, code = 8, "<q" if conv in "di" else "<Q"
+        else:
+            size, code = 4, "<i" if conv in "dic" else "<I"
+        if pos + size > len(args):
+            pos += size
+            return "?"
+        (value,) = struct.unpack_from(code, args, pos)
+        pos += size
+        if conv == "u":
+            conv = "d"
+        return ("%" + flags + conv) % value
+
+    return SPEC.sub(convert, fmt)
+
+
+class Decoder:
+    """Feed raw bytes, get back text lines. Resyncs on every 0x00."""
+
+    def __init__(self, messages):
+        self.messages = messages
+        self.buf = bytearray()
+        self.frames = 0
+        self.records = 0
+        self.bad = 0
+        self.dropped = 0
+        self.unsent = 0
+
+    def feed(self, data):
+        self.buf += data
+        while True:
+            end = self.buf.find(b"\x00")
+            if end < 0:
+                return
+            chunk = bytes(self.buf[:end])
+            del self.buf[:end + 1]
+            if chunk:
+                yield from self._chunk(chunk)
+
+    def _chunk(self, chunk):
+        try:
+            frame = cobs_decode(chunk)
+        except ValueError:
+            frame = b""
+        if len(frame) >= HEADER.size + CRC.size and crc16(frame[:-CRC.size]) == CRC.unpack(frame[-CRC.size:])[0]:
+            yield from self._frame(frame[:-CRC.size])
+            return
+        if chunk.startswith(b"IMPROV"):
+            return
+        text = chunk.decode("utf-8", "replace").replace("\r", "")
+        if all(c.isprintable() or c in "\n\t" for c in text):
+            for line in text.split("\n"):
+                if line:
+                    yield line
+        else:
+            self.bad += 1
+
+    def _frame(self, body):
+        version, ftype, boot, count, dropped, unsent = HEADER.unpack_from(body)
+        if version != VERSION or ftype != TYPE_LOG:
+            self.bad += 1
+            return
+        self.frames += 1
+
+        # The counts are since power-on; a smaller one means the clock restarted
+        if dropped != self.dropped:
+            if dropped > self.dropped:
+                yield f"-- {dropped - self.dropped} records dropped (ring full)"
+            self.dropped = dropped
+        if unsent != self.unsent:
+            if unsent > self.unsent:
+                yield f"-- {unsent - self.unsent} records not sent (port not read)"
+            self.unsent = unsent
+
+        pos = HEADER.size
+        for _ in range(count):
+            if pos + RECORD.size > len(body):
+                self.bad += 1
+                return
+            ms, msg_id, rec_boot, length = RECORD.unpack_from(body, pos)
+            pos += RECORD.size
+            args = body[pos:pos + length]
+            pos += length
+            self.records += 1
+
+            if msg_id < len(self.messages):
+                text = format_args(self.messages[msg_id], args)
+            else:
+                text = f"unknown message {msg_id} ({args.hex()})"
+            prev = "(prev boot) " if rec_boot != boot else ""
+            yield f"{prev}{ms // 1000}.{ms % 1000:03d} {text}"
+
+
+def cmd_monitor(args, decoder):
+    import serial  # pyserial
+
+    save = open(args.save, "wb") if args.save else None
+    with serial.Serial(args.port, 115200, timeout=0.2) as port:
+        try:
+            while True:
+                data = port.read(4096)
+                if not data:
+                    continue
+                if save:
+                    save.write(data)
+                for line in decoder.feed(data):
+                    print(line, flush=True)
+        except KeyboardInterrupt:
+            pass
+    if save:
+        save.close()
+
+
+def cmd_decode(args, decoder):
+    with open(args.input, "rb") as f:
+        while True:
+            data = f.read(4096)
+            if not data:
+                break
+            for line in decoder.feed(data):
+                print(line)
+        for line in decoder.feed(b"\x00"):
+            print(line)
+    print(f"-- {decoder.frames} frames, {decoder.records} records, {decoder.bad} bad", file=sys.stderr)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--messages", default=MESSAGES_H, help="log_messages.h to take formats from")
+    sub = parser.add_subparsers(dest="cmd", required=True)
+
+    p = sub.add_parser("monitor")
+    p.add_argument("port")
+    p.add_argument("--save", help="also write the raw stream here")
+    p.set_defaults(func=cmd_monitor)
+
+    p = sub.add_parser("decode")
+    p.add_argument("input")
+    p.set_defaults(func=cmd_decode)
+
+    args = parser.parse_args()
+    args.func(args, Decoder(load_messages(args.messages)))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,321 @@
+/*
+ * Clock simulator - Renders a virtual year of NTP_Clock seconds and checks them
+ *
+ * Drives what renderTime() does on every second boundary - LocalClock from
+ * timezones.h and displayTime() on a real SegmentFrame - from a virtual wall
+ * clock, and compares every rendered frame with an oracle: glibc localtime_r()
+ * running the zone's POSIX TZ string, the same rule newlib uses on the device.
+ * A year of seconds in one zone takes a few seconds.
+ *
+ * Things that take days to reproduce on a real clock can be forced here:
+ *   --toggle N      flip 12/24-hour mode every N seconds, like the mode button
+ *   --jitter US     wake up to US early or late for each boundary (the
+ *                   rounding in renderTime() must still pick the right second)
+ *   --drift PPM     local oscillator error, corrected at every sync
+ *   --outage D H    no syncs for H hours starting on day D
+ *
+ * Rendering is checked against the device clock, which is what the firmware
+ * can know. With drift, the summary also totals the time the shown HH:MM
+ * disagreed with true time, and the worst clock error.
+ *
+ * Build and run from this directory:
+ *   g++ -std=gnu++17 -O2 -I.. -I../SevenSegmentDisplay \
+ *       -I../SevenSegmentDisplay/bench/mock clock_sim.cpp -o clock_sim
+ *   ./clock_sim --zone Europe/London --toggle 3600 --jitter 20000
+ *   ./clock_sim --all-zones --days 3650
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "Arduino.h"
+#include "timezones.h"
+#include "SegmentFrame.h"
+
+uint64_t mockBusNs = 0;   // millis() for SegmentFrame; the display never waits on it
+
+#define SYNC_INTERVAL_SEC 1024   // SNTP_MAX_POLL_EXP: a settled clock polls this often
+#define MAX_REPORTED      20     // Mismatches printed per zone
+
+// 4-digit frame with no bus; flush() just latches the frame
+class SimDisplay : public SegmentFrame<SimDisplay, 4, SegmentMapLinear> {
+public:
+  void flush() { memcpy(shown, frame, sizeof(frame)); }
+
+  const uint8_t* digits() const { return shown[0]; }
+};
+
+// Segments as text, DP as a '.' after its digit
+static void segmentText(const uint8_t* segs, char* out) {
+  static const char GLYPHS[] = " 0123456789";
+  int n = 0;
+  for (int i = 0; i < 4; i++) {
+    char c = '?';
+    for (const char* g = GLYPHS; *g != '\0'; g++) {
+      if (canonicalGlyph(*g) == (segs[i] & 0x7F)) {
+        c = *g;
+        break;
+      }
+    }
+    out[n++] = c;
+    if (segs[i] & 0x80) out[n++] = '.';
+  }
+  out[n] = '\0';
+}
+
+static void isoTime(int64_t utc, char* out, size_t len) {
+  time_t t = (time_t)utc;
+  struct tm tm;
+  gmtime_r(&t, &tm);
+  strftime(out, len, "%Y-%m-%dT%H:%M:%SZ", &tm);
+}
+
+// What the digits should be, built from localtime_r() rather than glyphs.h
+// arithmetic: HHMM, DP on the hours ones digit on even seconds
+struct Oracle {
+  int64_t minuteStart = INT64_MIN;
+  struct tm tm;
+
+  void local(int64_t utc, int& hour, int& minute, int& second, bool& dst) {
+    // Every zone offset is a whole number of minutes, so one localtime_r()
+    // per UTC minute covers all of its seconds
+    int64_t minute0 = utc - ((utc % 60) + 60) % 60;
+    if (minute0 != minuteStart) {
+      minuteStart = minute0;
+      time_t t = (time_t)minute0;
+      localtime_r(&t, &tm);
+    }
+    hour = tm.tm_hour;
+    minute = tm.tm_min;
+    second = tm.tm_sec + (int)(utc - minuteStart);
+    dst = tm.tm_isdst > 0;
+  }
+
+  void expected(int64_t utc, bool use24Hour, uint8_t* segs, bool& dst) {
+    int hour, minute, second;
+    local(utc, hour, minute, second, dst);
+    if (!use24Hour) {
+      hour %= 12;
+      if (hour == 0) hour = 12;
+    }
+    segs[0] = (!use24Hour && hour < 10) ? 0x00 : canonicalGlyph('0' + hour / 10);
+    segs[1] = canonicalGlyph('0' + hour % 10) | (second % 2 == 0 ? 0x80 : 0x00);
+    segs[2] = canonicalGlyph('0' + minute / 10);
+    segs[3] = canonicalGlyph('0' + minute % 10);
+  }
+};
+
+// xorshift64*: the same jitter on every host for a given seed
+static uint64_t rngState = 1;
+static uint64_t nextRandom() {
+  rngState ^= rngState >> 12;
+  rngState ^= rngState << 25;
+  rngState ^= rngState >> 27;
+  return rngState * 0x2545F4914F6CDD1DULL;
+}
+
+struct Options {
+  const TimeZone* zone = TIMEZONE_DEFAULT;
+  bool allZones = false;
+  int64_t start = 0;          // UTC seconds
+  int64_t days = 365;
+  bool use24Hour = true;
+  int64_t toggleSec = 0;      // 0 = never
+  int32_t jitterUs = 0;
+  double driftPpm = 0.0;
+  int64_t outageDay = -1;
+  double outageHours = 0.0;
+  bool frames = false;        // Log frames whose digits change
+  bool allFrames = false;     // Log every frame, colon blinks included
+};
+
+struct Result {
+  uint64_t frames = 0;
+  uint64_t mismatches = 0;
+  uint64_t wrongMinuteUs = 0; // Time HH:MM disagreed with true time
+  int64_t maxErrorUs = 0;
+  uint32_t dstChanges = 0;
+  uint32_t modeChanges = 0;
+};
+
+static void simulateZone(const TimeZone* zone, const Options& opt, Result& result) {
+  setenv("TZ", zone->posix, 1);
+  tzset();
+
+  LocalClock localClock;
+  localClock.setZone(zone);
+  SimDisplay display;
+  Oracle oracle;
+  bool use24Hour = opt.use24Hour;
+  uint64_t reported = 0;
+  bool lastDst = false;
+  bool firstFrame = true;
+  uint8_t lastDigits[4] = {0};
+
+  int64_t end = opt.start + opt.days * 86400;
+  int64_t outageStart = opt.outageDay >= 0 ? opt.start + opt.outageDay * 86400 : INT64_MAX;
+  int64_t outageEnd = opt.outageDay >= 0 ? outageStart + (int64_t)(opt.outageHours * 3600.0) : INT64_MAX;
+  int64_t lastSync = opt.start;
+
+  // Each pass is one boundary of the device clock, which runs ahead of true
+  // time by offsetUs and is pulled back at every sync
+  for (int64_t device = opt.start; device < end; device++) {
+    int64_t sinceSync = device - lastSync;
+    bool syncing = device < outageStart || device >= outageEnd;
+    if (syncing && sinceSync >= SYNC_INTERVAL_SEC) {
+      lastSync = device;
+      sinceSync = 0;
+    }
+    int64_t offsetUs = (int64_t)(sinceSync * opt.driftPpm);
+    int64_t absError = offsetUs < 0 ? -offsetUs : offsetUs;
+    if (absError > result.maxErrorUs) result.maxErrorUs = absError;
+
+    if (opt.toggleSec > 0 && device > opt.start && (device - opt.start) % opt.toggleSec == 0) {
+      use24Hour = !use24Hour;
+      result.modeChanges++;
+    }
+
+    // The boundary timer fires a little early or late; renderTime() rounds
+    // to the nearest second
+    int64_t wakeUs = device * 1000000;
+    if (opt.jitterUs > 0) {
+      wakeUs += (int64_t)(nextRandom() % (2 * (uint64_t)opt.jitterUs + 1)) - opt.jitterUs;
+    }
+    int64_t tvSec = wakeUs >= 0 ? wakeUs / 1000000 : -((-wakeUs + 999999) / 1000000);
+    int64_t tvUsec = wakeUs - tvSec * 1000000;
+    int64_t now = tvSec;
+    if (tvUsec >= 500000) now++;
+
+    // renderTime()
+    LocalTime local;
+    localClock.toLocal(now, local);
+    bool showColon = (local.second % 2 == 0);
+    display.displayTime(local.hour, local.minute, showColon, !use24Hour);
+    mockBusNs += 1000000000ULL;
+    result.frames++;
+
+    uint8_t expected[4];
+    bool dst;
+    oracle.expected(device, use24Hour, expected, dst);
+    if (!firstFrame && dst != lastDst) result.dstChanges++;
+    lastDst = dst;
+
+    const uint8_t* shown = display.digits();
+    if (memcmp(shown, expected, 4) != 0) {
+      result.mismatches++;
+      if (reported++ < MAX_REPORTED) {
+        char when[32], got[16], want[16];
+        isoTime(device, when, sizeof(when));
+        segmentText(shown, got);
+        segmentText(expected, want);
+        printf("MISMATCH %s %-20s %s shown [%s] expected [%s]\n", when, zone->name,
+               use24Hour ? "24h" : "12h", got, want);
+      }
+    }
+
+    // Zone offsets are whole minutes, so HH:MM changes on UTC minute
+    // boundaries; each one shown early or late is wrong for the clock error
+    if (device % 60 == 0) result.wrongMinuteUs += absError;
+
+    bool digitsChanged = firstFrame || ((lastDigits[0] ^ shown[0]) | ((lastDigits[1] ^ shown[1]) & 0x7F) |
+                                        (lastDigits[2] ^ shown[2]) | (lastDigits[3] ^ shown[3])) != 0;
+    if (opt.allFrames || (opt.frames && digitsChanged)) {
+      char when[32], text[16];
+      isoTime(device, when, sizeof(when));
+      segmentText(shown, text);
+      printf("%s %-20s %s%s [%s]\n", when, zone->name, use24Hour ? "24h" : "12h", dst ? " dst" : "    ", text);
+    }
+    memcpy(lastDigits, shown, 4);
+    firstFrame = false;
+  }
+}
+
+static bool parseDate(const char* text, int64_t& utc) {
+  int y, m, d;
+  if (sscanf(text, "%d-%d-%d", &y, &m, &d) != 3 || m < 1 || m > 12 || d < 1 || d > 31) return false;
+  utc = (int64_t)daysFromCivil(y, m, d) * 86400;
+  return true;
+}
+
+static void usage() {
+  fprintf(stderr,
+          "usage: clock_sim [options]\n"
+          "  --zone NAME       IANA name from timezones.h (default %s)\n"
+          "  --all-zones       every zone in timezones.h\n"
+          "  --start Y-M-D     first day, UTC midnight (default 2026-01-01)\n"
+          "  --days N          days to simulate (default 365)\n"
+          "  --12h             start in 12-hour mode\n"
+          "  --toggle N        flip 12/24-hour mode every N seconds\n"
+          "  --jitter US       boundary wake-up error, +/- microseconds\n"
+          "  --seed N          jitter seed (default 1)\n"
+          "  --drift PPM       oscillator error between syncs (every %d s)\n"
+          "  --outage D H      no syncs for H hours from day D\n"
+          "  --frames          log frames whose digits change\n"
+          "  --all-frames      log every frame\n",
+          TIMEZONE_DEFAULT->name, SYNC_INTERVAL_SEC);
+  exit(2);
+}
+
+int main(int argc, char** argv) {
+  Options opt;
+  parseDate("2026-01-01", opt.start);
+
+  for (int i = 1; i < argc; i++) {
+    const char* a = argv[i];
+    bool hasValue = i + 1 < argc;
+    if (!strcmp(a, "--zone") && hasValue) {
+      opt.zone = findTimeZone(argv[++i]);
+      if (opt.zone == nullptr) {
+        fprintf(stderr, "clock_sim: unknown zone %s\n", argv[i]);
+        return 2;
+      }
+    }
+    else if (!strcmp(a, "--all-zones")) opt.allZones = true;
+    else if (!strcmp(a, "--start") && hasValue) {
+      if (!parseDate(argv[++i], opt.start)) usage();
+    }
+    else if (!strcmp(a, "--days") && hasValue) opt.days = strtoll(argv[++i], NULL, 10);
+    else if (!strcmp(a, "--12h")) opt.use24Hour = false;
+    else if (!strcmp(a, "--toggle") && hasValue) opt.toggleSec = strtoll(argv[++i], NULL, 10);
+    else if (!strcmp(a, "--jitter") && hasValue) opt.jitterUs = atoi(argv[++i]);
+    else if (!strcmp(a, "--seed") && hasValue) rngState = strtoull(argv[++i], NULL, 10) | 1;
+    else if (!strcmp(a, "--drift") && hasValue) opt.driftPpm = atof(argv[++i]);
+    else if (!strcmp(a, "--outage") && i + 2 < argc) {
+      opt.outageDay = strtoll(argv[++i], NULL, 10);
+      opt.outageHours = atof(argv[++i]);
+    }
+    else if (!strcmp(a, "--frames")) opt.frames = true;
+    else if (!strcmp(a, "--all-frames")) opt.allFrames = true;
+    else usage();
+  }
+  if (opt.days <= 0 || opt.jitterUs < 0 || opt.jitterUs >= 500000) usage();
+
+  clock_t begin = clock();
+  uint64_t totalMismatches = 0;
+  uint64_t totalFrames = 0;
+
+  for (size_t z = 0; z < TIMEZONE_COUNT; z++) {
+    const TimeZone* zone = opt.allZones ? &TIMEZONES[z] : opt.zone;
+    Result r;
+    simulateZone(zone, opt, r);
+    totalMismatches += r.mismatches;
+    totalFrames += r.frames;
+
+    printf("%-20s frames %llu, mismatches %llu, DST changes %u, mode changes %u", zone->name,
+           (unsigned long long)r.frames, (unsigned long long)r.mismatches, r.dstChanges, r.modeChanges);
+    if (opt.driftPpm != 0.0) {
+      printf(", wrong minute %.1f s, max error %.3f s", r.wrongMinuteUs / 1e6, r.maxErrorUs / 1e6);
+    }
+    printf("\n");
+
+    if (!opt.allZones) break;
+  }
+
+  double wall = (double)(clock() - begin) / CLOCKS_PER_SEC;
+  double simulated = (double)totalFrames;
+  printf("\n%llu frames (%.0f days) in %.2f s, %.0fx real time, %llu mismatches\n",
+         (unsigned long long)totalFrames, simulated / 86400.0, wall, wall > 0 ? simulated / wall : 0.0,
+         (unsigned long long)totalMismatches);
+  return totalMismatches == 0 ? 0 : 1;
+}
@@ -0,0 +1,222 @@
+/*
+ * Heap check - Fails if a steady-state path of NTP_Clock allocates
+ *
+ * Replaces malloc/free and operator new on the host with counting versions,
+ * then runs each path the firmware takes over and over once setup() is done:
+ * rendering every web page into the static PageBuffer from config_page.h,
+ * the once-a-second time render (LocalClock and SegmentFrame, as in
+ * renderTime()), and publishing a telemetry snapshot (the UDP batch and an
+ * event's JSON from live_telemetry.h). Each path runs once to warm up, then
+ * many times counted; any allocation in the counted runs is a failure.
+ *
+ * Also renders the config page for the worst case the buffer was sized for
+ * (a full scan of 32-character SSIDs made of characters that need escaping)
+ * and fails if WEB_PAGE_BUFFER_SIZE cuts it off.
+ *
+ * Build and run from this directory (exit status 1 on failure):
+ *   g++ -std=gnu++17 -O2 -I.. -I../SevenSegmentDisplay \
+ *       -I../SevenSegmentDisplay/bench/mock heap_check.cpp -o heap_check
+ *   ./heap_check
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <new>
+#include "Arduino.h"
+#include "timezones.h"
+#include "config_page.h"
+#include "live_telemetry.h"
+#include "page_buffer.h"
+#include "SegmentFrame.h"
+
+uint64_t mockBusNs = 0;
+
+#define RUNS 1000
+#define SCAN_MAX 16   // WIFI_SCAN_MAX in wifi_scan_cache.h
+#define SNTP_SERVERS_MAX_LEN 200   // In sntp_client.h
+
+// --- Counting allocator ---
+
+static bool counting = false;
+static unsigned long allocations = 0;
+
+extern "C" void* __libc_malloc(size_t size);
+extern "C" void* __libc_calloc(size_t count, size_t size);
+extern "C" void* __libc_realloc(void* ptr, size_t size);
+extern "C" void __libc_free(void* ptr);
+
+extern "C" void* malloc(size_t size) {
+  if (counting) allocations++;
+  return __libc_malloc(size);
+}
+
+extern "C" void* calloc(size_t count, size_t size) {
+  if (counting) allocations++;
+  return __libc_calloc(count, size);
+}
+
+extern "C" void* realloc(void* ptr, size_t size) {
+  if (counting) allocations++;
+  return __libc_realloc(ptr, size);
+}
+
+extern "C" void free(void* ptr) { __libc_free(ptr); }
+
+void* operator new(size_t size) {
+  void* p = malloc(size);
+  if (p == nullptr) throw std::bad_alloc();
+  return p;
+}
+
+void* operator new[](size_t size) { return operator new(size); }
+void operator delete(void* ptr) noexcept { free(ptr); }
+void operator delete[](void* ptr) noexcept { free(ptr); }
+void operator delete(void* ptr, size_t) noexcept { free(ptr); }
+void operator delete[](void* ptr, size_t) noexcept { free(ptr); }
+
+// --- Paths ---
+
+// 4-digit frame with no bus, as in clock_sim
+class SimDisplay : public SegmentFrame<SimDisplay, 4, SegmentMapLinear> {
+public:
+  void flush() {}
+};
+
+static PageBuffer<WEB_PAGE_BUFFER_SIZE> page;
+static TelemetryBroadcast broadcast;
+static TelemetrySnapshot snapshot;
+static unsigned long telemetryNow = 0;
+static SimDisplay display;
+static LocalClock localClock;
+static int64_t clockNow = 1767225600;   // 2026-01-01T00:00:00Z
+
+static const char* const NETWORKS[] = {"Home", "Home-5G", "Neighbour's WiFi", "<guest>"};
+
+static ConfigPageData configData(const char* const* networks, uint8_t count) {
+  ConfigPageData data;
+  data.ssid = "Home";
+  data.password = "secret & \"quoted\"";
+  data.timezone = "Europe/London";
+  data.ntpServers = "pool.ntp.org,time.google.com,time.cloudflare.com";
+  data.brightness = 8;
+  data.use24Hour = true;
+  data.stationIP = "192.168.1.23";
+  data.apIP = "192.168.4.1";
+  data.networks = networks;
+  data.networkCount = count;
+  data.telemetryPeriodMs = 60000;
+  data.telemetryBatch = TELEMETRY_BATCH_MAX;
+  return data;
+}
+
+static UpdatePageData updateData() {
+  UpdatePageData data;
+  data.pullUrl = "http://server/firmware-ota.bin.gz";
+  data.running = true;
+  data.succeeded = false;
+  data.source = "http://server/firmware-ota.bin.gz";
+  data.error = "";
+  data.bytesIn = 524288;
+  data.bytesTotal = 1048576;
+  data.bytesWritten = 900000;
+  data.compressed = true;
+  data.resumes = 1;
+  return data;
+}
+
+static void configPage() {
+  page.clear();
+  renderConfigPage(page, configData(NETWORKS, 4));
+}
+
+static void updatePage() {
+  page.clear();
+  renderUpdatePage(page, updateData(), "0.0");
+}
+
+static void savePage() {
+  page.clear();
+  renderSaveSuccessPage(page);
+}
+
+static void resetPage() {
+  page.clear();
+  renderFactoryResetPage(page);
+}
+
+// renderTime(): one wall-clock second to HHMM on the digits
+static void timeRender() {
+  LocalTime local;
+  localClock.toLocal(clockNow++, local);
+  display.displayTime(local.hour, local.minute, local.second % 2 == 0, false);
+}
+
+static bool discardPacket(const uint8_t*, size_t) { return true; }
+
+// pollTelemetry(): a new snapshot, the broadcast and one event
+static void telemetryPublish() {
+  telemetryNow += 250;
+  snapshot.set(TM_SYNCED, 1);
+  snapshot.set(TM_OFFSET_US, (int32_t)(telemetryNow % 977) - 488);
+  snapshot.set(TM_CHIP_C, 4150 + (int32_t)(telemetryNow / 10000 % 7));
+  broadcast.poll(snapshot, telemetryNow);
+  char event[TELEMETRY_SSE_EVENT_MAX];
+  telemetryJson(snapshot, snapshot.present, event, sizeof(event));
+}
+
+struct Path {
+  const char* name;
+  void (*run)();
+};
+
+static const Path PATHS[] = {
+  {"config page", configPage},
+  {"update page", updatePage},
+  {"save page", savePage},
+  {"reset page", resetPage},
+  {"time render", timeRender},
+  {"telemetry", telemetryPublish},
+};
+
+int main() {
+  bool ok = true;
+  localClock.setZone(findTimeZone("Europe/London"));
+  broadcast.begin(discardPacket, 1, TELEMETRY_KIND_CLOCK, 1000, 10);
+
+  printf("%-14s %10s\n", "path", "allocs");
+  for (const Path& path : PATHS) {
+    path.run();
+    allocations = 0;
+    counting = true;
+    for (int i = 0; i < RUNS; i++) path.run();
+    counting = false;
+    printf("%-14s %10lu%s\n", path.name, allocations, allocations ? "  FAIL" : "");
+    if (allocations) ok = false;
+  }
+
+  // Worst case for the buffer: every SSID 32 characters, a 64 character
+  // password and a full server list, all of characters that escape to 5
+  static char ssids[SCAN_MAX][33];
+  const char* worst[SCAN_MAX];
+  for (int i = 0; i < SCAN_MAX; i++) {
+    memset(ssids[i], '&', 32);
+    ssids[i][32] = '\0';
+    worst[i] = ssids[i];
+  }
+  static char password[65];
+  memset(password, '"', 64);
+  static char servers[SNTP_SERVERS_MAX_LEN];
+  memset(servers, '\'', sizeof(servers) - 1);
+  ConfigPageData worstData = configData(worst, SCAN_MAX);
+  worstData.password = password;
+  worstData.ntpServers = servers;
+  page.clear();
+  renderConfigPage(page, worstData);
+  printf("\nworst config page %zu of %zu bytes%s\n", page.length(), page.capacity(),
+         page.overflowed() ? "  FAIL: cut off" : "");
+  if (page.overflowed()) ok = false;
+
+  printf("%s\n", ok ? "ok" : "FAILED");
+  return ok ? 0 : 1;
+}
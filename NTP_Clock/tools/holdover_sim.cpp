@@ -0,0 +1,262 @@
+/*
+ * Holdover simulator - How far the clock wanders while SNTP is out of reach
+ *
+ * Runs the real SntpClient (sntp_client.h, with drift_model.h) on this
+ * machine with the mocks in mock/, as sntp_test does: an NtpStandIn server
+ * and a simulated system clock the client reads, steps and slews. The
+ * clock's oscillator is a simulated crystal whose frequency error depends
+ * on its temperature and ages slowly. Ambient temperature follows a daily
+ * cycle and a slower weather swing; the die sensor, fed to setTemperature()
+ * every 10 s as the sketch does, reads the crystal plus self-heating, a
+ * little more with the radio busy, plus noise.
+ *
+ * After --train days of syncs the network goes away (WiFi.status() stops
+ * reporting WL_CONNECTED) for --outage hours. The outage is run once per
+ * way of keeping time through it, each from the same training:
+ *
+ *   free running        no correction (a clock with no drift compensation)
+ *   last estimate       the sync loop's last ppm: the model handed back
+ *                       with its temperature bins emptied
+ *   temperature model   DriftModel's value for the current temperature
+ *
+ * then again after a reboot, with the model saved before it restored
+ * through setDriftModel() or with a fresh one, to show what persisting it
+ * buys. The longer the clock was off (--off), the more the crystal has aged
+ * away from the saved model.
+ *
+ * Exits 1 if the temperature model does worse than the last estimate, or
+ * the restored model worse than a fresh one.
+ *
+ * Build and run from this directory:
+ *   g++ -std=gnu++17 -O2 -I.. -Imock holdover_sim.cpp -o holdover_sim
+ *   ./holdover_sim --train 7 --outage 24
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "sys_clock.h"   // Before sntp_client.h, which then uses the simulated clock
+#include "sntp_client.h"
+#include "ntp_standin.h"
+
+uint64_t mockBusNs = 0;
+
+#define TICK_MS     10000   // How often the die temperature is read (CHIP_TEMP_MS)
+#define IDLE_MS     1000    // Step while no request is out
+#define BUSY_MS     10      // Step while a burst is going on
+#define BURST_MS    (SNTP_BURST_SIZE * SNTP_REPLY_TIMEOUT_MS)
+#define BOOT_ERROR_S 3.0    // How far off the clock comes up after a power cut
+
+struct Options {
+  double trainDays = 7;
+  double outageHours = 24;
+  double offDays = 1.0 / 24;    // Powered off before the reboot
+  double rebootSyncHours = 2;   // Syncs between the reboot and the second outage
+  double jitterUs = 2000;       // Mean queueing delay each way at the server
+  double wifiHeatC = 2;         // Extra die heating while WiFi is connected
+  uint64_t seed = 1;
+};
+
+static Options opt;
+
+// xorshift64*, as clock_sim
+static uint64_t rngState = 1;
+static double uniform() {
+  rngState ^= rngState >> 12;
+  rngState ^= rngState << 25;
+  rngState ^= rngState >> 27;
+  return (double)((rngState * 0x2545F4914F6CDD1DULL) >> 11) / (double)(1ULL << 53);
+}
+
+static double symmetric(double span) { return (2 * uniform() - 1) * span; }
+
+// A 40 MHz crystal a few ppm fast at room temperature, with a turnover curve
+// and slow aging. Positive ppm: the local clock gains.
+static double crystalPpm(double crystalC, double days) {
+  double d = crystalC - 32;
+  return 6.5 + 0.11 * d - 0.006 * d * d + 0.02 * days;
+}
+
+static double ambientC(double t) {
+  return 21 + 3.5 * sin(2 * M_PI * (t / 86400 - 0.3)) + 2.5 * sin(2 * M_PI * t / (3.7 * 86400));
+}
+
+static double dieC(double t) {
+  bool wifi = WiFi.status() == WL_CONNECTED;
+  return ambientC(t) + 7 + 9 + (wifi ? opt.wifiHeatC : 0) + symmetric(0.4);
+}
+
+static double nowS() { return mockBusNs / 1e9; }
+
+enum Strategy { FREE, LAST, MODEL, STRATEGIES };
+static const char* const STRATEGY_NAMES[STRATEGIES] = {"free running", "last estimate", "temperature model"};
+
+struct Outcome {
+  double maxErrorUs = 0;
+  double endErrorUs = 0;
+};
+
+// One boot of the clock: the client and the server it syncs to
+struct Device {
+  NtpStandIn server;
+  SntpClient client;
+  uint32_t requestsSeen = 0;
+  uint64_t lastRequestNs = 0;
+
+  Device() : server(opt.seed * 2 + 1) {
+    if (!server.open(2)) {
+      fprintf(stderr, "can't listen on 127.0.0.2 port %d\n", 123 + mockPortShift);
+      exit(2);
+    }
+    server.baseDelayUs = 5000;
+    server.jitterUs = (int64_t)opt.jitterUs;
+    WiFi.clearHosts();
+    WiFi.addHost("ntp.test", server.ip());
+  }
+
+  // Powered up: the system clock starts seconds out and the temperature is
+  // read before anything else, as in setup()
+  void boot(const DriftModel* saved) {
+    mockClock.reset();
+    mockClock.errorNs = BOOT_ERROR_S * 1e9;
+    tick();
+    if (saved != nullptr) client.setDriftModel(*saved);
+    client.begin("ntp.test");
+  }
+
+  // The crystal follows the temperature; the sketch reads the die sensor
+  void tick() {
+    mockClock.advance();
+    mockClock.ppm = crystalPpm(ambientC(nowS()) + 7, nowS() / 86400);
+    client.setTemperature((float)dieC(nowS()));
+  }
+
+  // Until endS, online or not; the clock error is tracked while offline
+  Outcome run(double endS, bool online) {
+    WiFi.connection = online ? WL_CONNECTED : WL_DISCONNECTED;
+    uint64_t endNs = (uint64_t)(endS * 1e9);
+    Outcome out;
+    while (mockBusNs < endNs) {
+      bool busy = mockBusNs - lastRequestNs < BURST_MS * 1000000ULL;
+      uint64_t to = mockBusNs + (busy ? BUSY_MS : IDLE_MS) * 1000000ULL;
+      uint64_t tickNs = (mockBusNs / (TICK_MS * 1000000ULL) + 1) * TICK_MS * 1000000ULL;
+      if (tickNs < to) to = tickNs;
+      if (server.nextDueNs() < to) to = server.nextDueNs();
+      if (endNs < to) to = endNs;
+      mockBusNs = to;
+
+      if (mockBusNs == tickNs) {
+        tick();
+        if (!online) {
+          double errorUs = mockClock.errorUs();
+          if (fabs(errorUs) > out.maxErrorUs) out.maxErrorUs = fabs(errorUs);
+          out.endErrorUs = errorUs;
+        }
+      }
+      server.service();
+      client.poll();
+      server.service();
+      if (server.requests != requestsSeen) {
+        requestsSeen = server.requests;
+        lastRequestNs = mockBusNs;
+      }
+    }
+    return out;
+  }
+};
+
+static void usage() {
+  fprintf(stderr,
+          "usage: holdover_sim [options]\n"
+          "  --train DAYS      syncing before the outage (default 7)\n"
+          "  --outage HOURS    outage length (default 24)\n"
+          "  --off DAYS        powered off between the outage and the reboot (default 1 h)\n"
+          "  --reboot-sync H   syncing after the reboot, before the second outage (default 2)\n"
+          "  --jitter US       mean queueing delay each way at the server (default 2000)\n"
+          "  --wifi-heat C     extra die heating while connected (default 2)\n"
+          "  --seed N          (default 1)\n");
+  exit(2);
+}
+
+static void printOutcome(const char* name, const Outcome& o) {
+  printf("  %-22s max %9.3f ms   at end %9.3f ms\n", name, o.maxErrorUs / 1000, o.endErrorUs / 1000);
+}
+
+static void printModel(const DriftModel& model) {
+  for (int b = 0; b < DRIFT_BINS; b++) {
+    if (model.weight[b] == 0) continue;
+    printf("  %2d-%2d C  %8.3f ppm  (%u)\n", DRIFT_BIN_MIN_C + b * DRIFT_BIN_WIDTH_C,
+           DRIFT_BIN_MIN_C + (b + 1) * DRIFT_BIN_WIDTH_C, model.ppm[b], model.weight[b]);
+  }
+}
+
+int main(int argc, char** argv) {
+  for (int i = 1; i < argc; i++) {
+    const char* a = argv[i];
+    bool hasValue = i + 1 < argc;
+    if (!strcmp(a, "--train") && hasValue) opt.trainDays = atof(argv[++i]);
+    else if (!strcmp(a, "--outage") && hasValue) opt.outageHours = atof(argv[++i]);
+    else if (!strcmp(a, "--off") && hasValue) opt.offDays = atof(argv[++i]);
+    else if (!strcmp(a, "--reboot-sync") && hasValue) opt.rebootSyncHours = atof(argv[++i]);
+    else if (!strcmp(a, "--jitter") && hasValue) opt.jitterUs = atof(argv[++i]);
+    else if (!strcmp(a, "--wifi-heat") && hasValue) opt.wifiHeatC = atof(argv[++i]);
+    else if (!strcmp(a, "--seed") && hasValue) opt.seed = strtoull(argv[++i], NULL, 10);
+    else usage();
+  }
+  if (opt.trainDays <= 0 || opt.outageHours <= 0 || opt.offDays < 0 || opt.rebootSyncHours < 0) usage();
+
+  double outageStart = opt.trainDays * 86400;
+  double outageEnd = outageStart + opt.outageHours * 3600;
+
+  // Each strategy trains from scratch on the same seeds, so they all start
+  // the outage from the same state. The model is what the sketch would save.
+  Outcome outcomes[STRATEGIES];
+  DriftModel saved;
+  for (int s = 0; s < STRATEGIES; s++) {
+    mockBusNs = 0;
+    rngState = opt.seed * 2 + 1;
+    Device device;
+    device.boot(nullptr);
+    device.run(outageStart, true);
+
+    const DriftModel& trained = device.client.getDriftModel();
+    if (s == 0) {
+      printf("Sync loop correction %.3f ppm; learned correction by die temperature:\n", trained.currentPpm);
+      printModel(trained);
+      printf("\n%.0f h outage after %.1f days of syncs:\n", opt.outageHours, opt.trainDays);
+    }
+    if (s == MODEL) {
+      saved = trained;
+    } else {
+      DriftModel untrained;
+      untrained.currentPpm = s == LAST ? trained.currentPpm : 0;
+      device.client.setDriftModel(untrained);
+    }
+    outcomes[s] = device.run(outageEnd, false);
+    printOutcome(STRATEGY_NAMES[s], outcomes[s]);
+  }
+
+  // Power cut: boot, sync a while, lose the network again
+  double boot = outageEnd + opt.offDays * 86400;
+  double rebootOutage = boot + opt.rebootSyncHours * 3600;
+  printf("\nOff %.1f days, reboot, %.1f h of syncs, then %.0f h outage, temperature model:\n", opt.offDays,
+         opt.rebootSyncHours, opt.outageHours);
+  Outcome rebooted[2];
+  for (int restored = 1; restored >= 0; restored--) {
+    mockBusNs = (uint64_t)(boot * 1e9);
+    rngState = opt.seed * 2 + 3;
+    Device device;
+    device.boot(restored ? &saved : nullptr);
+    device.run(rebootOutage, true);
+    rebooted[restored] = device.run(rebootOutage + opt.outageHours * 3600, false);
+    printOutcome(restored ? "saved model restored" : "fresh model", rebooted[restored]);
+  }
+
+  bool modelOk = outcomes[MODEL].maxErrorUs <= outcomes[LAST].maxErrorUs;
+  bool restoreOk = rebooted[1].maxErrorUs <= rebooted[0].maxErrorUs;
+  if (!modelOk) printf("FAILED: temperature model worse than the last estimate\n");
+  if (!restoreOk) printf("FAILED: restored model worse than a fresh one\n");
+  if (modelOk && restoreOk) printf("ok\n");
+  return modelOk && restoreOk ? 0 : 1;
+}
@@ -0,0 +1,333 @@
+/*
+ * Improv bench - Improv packets per second through the serial RX ring
+ *
+ * The path provisioning takes on the device: the HW CDC RX event has
+ * pumpSerialRx() move up to 64 bytes at a time into the SpscRing inside
+ * BufferedHWCDC, and loop()'s ImprovSerial::handleSerial() reads them back
+ * a byte at a time and answers. Here the same ring and the real
+ * improv_serial.h run on the host, joined by a stand-in for BufferedHWCDC
+ * (NTP_Clock.ino); a producer thread plays the RX event and the main
+ * thread loop().
+ *
+ * The traffic repeats what ESP Web Tools sends once connected: get state,
+ * get device info and get networks (three in the scan cache), plus a
+ * packet with a bad checksum and log text between packets. Every reply is
+ * parsed back and must be the one its request gets, in order:
+ *
+ *   parser       one thread, 64 bytes in then handleSerial(): the CPU cost
+ *                per byte and per request, replies included
+ *   ring N       two threads, the producer retrying what doesn't fit (as
+ *                the driver holds bytes back); throughput, high water and
+ *                how often the ring was full, for N = 64, 256
+ *                (IMPROV_RX_BUFFER_SIZE) and 1024
+ *   dropping     as pumpSerialRx() does, bytes that don't fit are lost:
+ *                overflows() must count them, every reply must still be a
+ *                well-formed packet, and the parser must be back in step
+ *                within a few requests once the burst is over
+ *
+ * Throughput is the host's; scale by the ratio clock_sim or bus_bench
+ * shows to estimate the ESP32-S3. The argument is the number of traffic
+ * cycles per case. Exits 1 if any check fails.
+ *
+ * Build and run from this directory:
+ *   g++ -std=gnu++17 -O2 -I.. -Imock improv_bench.cpp -o improv_bench -pthread
+ *   ./improv_bench [cycles]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include "spsc_ring.h"
+#include "improv_serial.h"
+
+uint64_t mockBusNs = 0;
+
+#define IMPROV_RX_BUFFER_SIZE 256   // As in NTP_Clock.ino
+
+#define DEFAULT_CYCLES  10000
+#define USB_PACKET      64      // Largest chunk pumpSerialRx() moves at once
+#define HOST_WRITE      512     // Bytes that arrive back to back
+#define CASE_LIMIT_S    60      // Past this a case is stuck; the bench gives up
+#define RESYNC_REQUESTS 14      // A stale 128-byte length eats at most this many 12-byte requests
+
+// Protocol values, as in improv_serial.h
+#define TYPE_CURRENT_STATE 0x01
+#define TYPE_ERROR_STATE   0x02
+#define TYPE_RPC           0x03
+#define TYPE_RPC_RESULT    0x04
+#define CMD_GET_STATE      0x02
+#define CMD_GET_INFO       0x03
+#define CMD_GET_NETWORKS   0x04
+
+static int failures = 0;
+
+typedef std::chrono::steady_clock Clock;
+
+static double secondsSince(Clock::time_point t) {
+  return std::chrono::duration<double>(Clock::now() - t).count();
+}
+
+// --- Traffic ---
+
+static void addPacket(std::vector<uint8_t>& out, uint8_t type, const uint8_t* data, uint8_t len, bool badSum) {
+  size_t start = out.size();
+  out.insert(out.end(), {'I', 'M', 'P', 'R', 'O', 'V', 1, type, len});
+  out.insert(out.end(), data, data + len);
+  uint8_t sum = 0;
+  for (size_t i = start; i < out.size(); i++) sum += out[i];
+  out.push_back(badSum ? (uint8_t)(sum + 1) : sum);
+}
+
+static void addRpc(std::vector<uint8_t>& out, uint8_t command, bool badSum = false) {
+  uint8_t data[2] = {command, 0};
+  addPacket(out, TYPE_RPC, data, sizeof(data), badSum);
+}
+
+static void addText(std::vector<uint8_t>& out, const char* text) {
+  out.insert(out.end(), text, text + strlen(text));
+}
+
+// A reply's type, and for RPC results the command it answers
+static inline uint16_t replyCode(uint8_t type, uint8_t command = 0) { return type << 8 | command; }
+
+struct Traffic {
+  std::vector<uint8_t> cycle;
+  std::vector<uint16_t> replies;   // What one cycle is answered with, in order
+
+  Traffic() {
+    addRpc(cycle, CMD_GET_STATE);
+    replies.push_back(replyCode(TYPE_CURRENT_STATE));
+    addText(cycle, "[SNTP] poll ok, IMPRO offset 1 ms\r\n");   // A partial magic resyncs
+    addRpc(cycle, CMD_GET_INFO);
+    replies.push_back(replyCode(TYPE_RPC_RESULT, CMD_GET_INFO));
+    addRpc(cycle, CMD_GET_NETWORKS);
+    for (int i = 0; i < 4; i++) replies.push_back(replyCode(TYPE_RPC_RESULT, CMD_GET_NETWORKS));   // 3, then the end
+    addRpc(cycle, CMD_GET_STATE, true);
+    replies.push_back(replyCode(TYPE_ERROR_STATE));
+  }
+};
+
+static Traffic traffic;
+
+// --- BufferedHWCDC's stand-in, checking replies as they're written ---
+
+template <size_t Capacity>
+class RingSerial : public Stream {
+public:
+  SpscRing<Capacity> rx;
+
+  // Replies so far, and those that weren't what was expected (or not packets)
+  uint64_t replies = 0;
+  uint64_t wrong = 0;
+  bool anyOrder = false;   // Only check each reply is a well-formed packet
+  uint16_t lastCode = 0;
+
+  size_t feed(const uint8_t* data, size_t len) { return rx.write(data, len); }
+
+  virtual int available() override { return rx.available(); }
+  virtual int read() override { return rx.read(); }
+  virtual int peek() override { return rx.peek(); }
+
+  virtual size_t write(uint8_t byte) override { return write(&byte, 1); }
+
+  // ImprovSerial writes each reply whole: header, data, sum, then '\n'
+  virtual size_t write(const uint8_t* p, size_t size) override {
+    bool ok = size >= 11 && memcmp(p, "IMPROV", 6) == 0 && p[6] == 1 && size == 11u + p[8] && p[size - 1] == '\n';
+    if (ok) {
+      uint8_t sum = 0;
+      for (size_t i = 0; i < size - 2; i++) sum += p[i];
+      ok = sum == p[size - 2];
+    }
+    lastCode = ok ? replyCode(p[7], p[7] == TYPE_RPC_RESULT ? p[9] : 0) : 0;
+    if (ok && !anyOrder) ok = lastCode == traffic.replies[replies % traffic.replies.size()];
+    if (!ok) wrong++;
+    replies++;
+    return size;
+  }
+};
+
+struct Bench {
+  WifiScanCache networks;
+
+  Bench() {
+    WiFi.addNetwork("Home", -48, true);
+    WiFi.addNetwork("Cafe", -71, false);
+    WiFi.addNetwork("Neighbour", -83, true);
+    networks.refresh();
+    networks.poll();
+  }
+
+  template <size_t Capacity>
+  ImprovSerial* improvOn(RingSerial<Capacity>& io) {
+    ImprovSerial* improv = new ImprovSerial(io, networks);
+    improv->setDeviceInfo("NTP Clock", "1.0.0", "ESP32-S3", "Clock");
+    return improv;
+  }
+};
+
+static void report(bool ok, const char* name, uint64_t bytes, uint64_t requests, double seconds, const char* detail) {
+  printf("  %-4s %-10s %7.2f MB/s %9.0f requests/s %6.1f ns/byte  %s\n", ok ? "ok" : "FAIL", name,
+         bytes / seconds / 1e6, requests / seconds, seconds * 1e9 / bytes, detail);
+  if (!ok) failures++;
+}
+
+// --- Cases ---
+
+static void parserOnly(Bench& bench, uint32_t cycles) {
+  RingSerial<IMPROV_RX_BUFFER_SIZE> io;
+  ImprovSerial* improv = bench.improvOn(io);
+  const std::vector<uint8_t>& c = traffic.cycle;
+  uint64_t bytes = 0;
+
+  Clock::time_point t0 = Clock::now();
+  for (uint32_t n = 0; n < cycles; n++) {
+    for (size_t at = 0; at < c.size(); at += USB_PACKET) {
+      size_t len = c.size() - at < USB_PACKET ? c.size() - at : USB_PACKET;
+      bytes += io.feed(c.data() + at, len);
+      improv->handleSerial();
+    }
+  }
+  double seconds = secondsSince(t0);
+
+  uint64_t want = (uint64_t)cycles * traffic.replies.size();
+  char detail[96];
+  snprintf(detail, sizeof(detail), "%llu of %llu replies, %llu wrong", (unsigned long long)io.replies,
+           (unsigned long long)want, (unsigned long long)io.wrong);
+  report(io.replies == want && io.wrong == 0 && io.rx.overflows() == 0, "parser", bytes,
+         (uint64_t)cycles * 4, seconds, detail);
+  delete improv;
+}
+
+// The RX event's stand-in: USB-sized chunks, split at random as the host sends them
+static void produce(uint32_t cycles, uint64_t seed, size_t (*feed)(void*, const uint8_t*, size_t), void* io,
+                    bool retry, uint64_t& dropped) {
+  const std::vector<uint8_t>& c = traffic.cycle;
+  uint64_t s = seed;
+  size_t sinceYield = 0;
+  for (uint32_t n = 0; n < cycles; n++) {
+    size_t at = 0;
+    while (at < c.size()) {
+      s ^= s >> 12;
+      s ^= s << 25;
+      s ^= s >> 27;
+      size_t len = 1 + (s * 2685821657736338717ULL >> 32) % USB_PACKET;
+      if (len > c.size() - at) len = c.size() - at;
+      size_t done = 0;
+      while (done < len) {
+        size_t got = feed(io, c.data() + at + done, len - done);
+        done += got;
+        if (done == len) break;
+        if (!retry) {
+          dropped += len - done;
+          break;
+        }
+        std::this_thread::yield();
+      }
+      at += len;
+      // The host's writes arrive as bursts of chunks; loop() gets a turn
+      // between them even on one core
+      sinceYield += len;
+      if (sinceYield >= HOST_WRITE) {
+        sinceYield = 0;
+        std::this_thread::yield();
+      }
+    }
+  }
+}
+
+template <size_t Capacity>
+static size_t feedRing(void* io, const uint8_t* data, size_t len) {
+  return ((RingSerial<Capacity>*)io)->feed(data, len);
+}
+
+template <size_t Capacity>
+static void twoThreads(Bench& bench, uint32_t cycles) {
+  RingSerial<Capacity> io;
+  ImprovSerial* improv = bench.improvOn(io);
+  uint64_t want = (uint64_t)cycles * traffic.replies.size();
+  uint64_t dropped = 0;
+  bool stuck = false;
+
+  Clock::time_point t0 = Clock::now();
+  std::thread producer(produce, cycles, (uint64_t)Capacity, feedRing<Capacity>, &io, true, std::ref(dropped));
+  while (io.replies < want) {
+    improv->handleSerial();
+    if (io.rx.available() > 0) continue;
+    if (secondsSince(t0) > CASE_LIMIT_S) {
+      stuck = true;
+      break;
+    }
+    std::this_thread::yield();
+  }
+  double seconds = secondsSince(t0);
+  producer.join();
+
+  char name[16], detail[128];
+  snprintf(name, sizeof(name), "ring %zu", Capacity);
+  snprintf(detail, sizeof(detail), "%llu of %llu replies, %llu wrong; high water %u, %u bytes held back",
+           (unsigned long long)io.replies, (unsigned long long)want, (unsigned long long)io.wrong,
+           io.rx.highWater(), io.rx.overflows());
+  report(!stuck && io.replies == want && io.wrong == 0, name, (uint64_t)cycles * traffic.cycle.size(),
+         (uint64_t)cycles * 4, seconds, detail);
+  delete improv;
+}
+
+static void dropping(Bench& bench, uint32_t cycles) {
+  RingSerial<IMPROV_RX_BUFFER_SIZE> io;
+  io.anyOrder = true;
+  ImprovSerial* improv = bench.improvOn(io);
+  uint64_t dropped = 0;
+  std::atomic<bool> done(false);
+
+  Clock::time_point t0 = Clock::now();
+  std::thread producer([&] {
+    produce(cycles, 99, feedRing<IMPROV_RX_BUFFER_SIZE>, &io, false, dropped);
+    done.store(true, std::memory_order_release);
+  });
+  while (!done.load(std::memory_order_acquire) || io.rx.available() > 0) {
+    improv->handleSerial();
+    if (io.rx.available() == 0) std::this_thread::yield();
+  }
+  double seconds = secondsSince(t0);
+  producer.join();
+  uint64_t burstReplies = io.replies;
+
+  // Back in step: one get state at a time until it's answered
+  int tries = 0;
+  bool answered = false;
+  std::vector<uint8_t> probe;
+  addRpc(probe, CMD_GET_STATE);
+  while (!answered && tries < RESYNC_REQUESTS) {
+    uint64_t before = io.replies;
+    io.feed(probe.data(), probe.size());
+    improv->handleSerial();
+    tries++;
+    answered = io.replies > before && io.lastCode == replyCode(TYPE_CURRENT_STATE);
+  }
+
+  uint64_t sent = (uint64_t)cycles * traffic.cycle.size();
+  char detail[128];
+  snprintf(detail, sizeof(detail), "%.1f%% of bytes lost, %llu replies, %llu malformed; in step after %d request(s)",
+           100.0 * dropped / sent, (unsigned long long)burstReplies, (unsigned long long)io.wrong, tries);
+  report(io.rx.overflows() == (uint32_t)dropped && io.wrong == 0 && answered, "dropping", sent - dropped,
+         burstReplies * 4 / traffic.replies.size(), seconds, detail);   // Requests answered, roughly
+  delete improv;
+}
+
+int main(int argc, char** argv) {
+  uint32_t cycles = argc > 1 ? (uint32_t)strtoul(argv[1], nullptr, 10) : DEFAULT_CYCLES;
+  if (cycles == 0) cycles = DEFAULT_CYCLES;
+
+  Bench bench;
+  printf("Improv over the RX ring, %u cycles of %zu bytes (4 requests, %zu replies) per case:\n", cycles,
+         traffic.cycle.size(), traffic.replies.size());
+  parserOnly(bench, cycles);
+  twoThreads<64>(bench, cycles);
+  twoThreads<IMPROV_RX_BUFFER_SIZE>(bench, cycles);
+  twoThreads<1024>(bench, cycles);
+  dropping(bench, cycles);
+  printf("%s\n", failures ? "FAILED" : "ok");
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,36 @@
+/*
+ * Mock Arduino core for the tools/ programs that run firmware headers with
+ * networking: the display bench's clock and GPIO mock (millis() follows
+ * mockBusNs), plus a Serial that takes and drops whatever is written, the
+ * Stream interface the firmware's serial wrappers implement and, as on the
+ * device, the FreeRTOS task calls.
+ */
+
+#ifndef MOCK_TOOLS_ARDUINO_H
+#define MOCK_TOOLS_ARDUINO_H
+
+#include "../../SevenSegmentDisplay/bench/mock/Arduino.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+class Stream {
+public:
+  virtual ~Stream() {}
+  virtual int available() = 0;
+  virtual int read() = 0;
+  virtual int peek() = 0;
+  virtual void flush() {}
+  virtual size_t write(uint8_t byte) = 0;
+  virtual size_t write(const uint8_t* buffer, size_t size) = 0;
+};
+
+struct MockSerial {
+  int availableForWrite() { return 4096; }
+  size_t write(const uint8_t*, size_t len) { return len; }
+  size_t print(const char* s) { return strlen(s); }
+  size_t println(const char* s) { return strlen(s) + 2; }
+};
+
+inline MockSerial Serial;
+
+#endif // MOCK_TOOLS_ARDUINO_H
@@ -0,0 +1,239 @@
+/*
+ * Mock ArduinoJson: the slice timezone_lookup.h uses - a filtered
+ * deserializeJson() of a flat object read off a stream byte by byte, then
+ * strings and numbers read back out. Nested values are parsed and skipped.
+ * Errors are reported as the library does: IncompleteInput when the stream
+ * ends or times out inside the document, InvalidInput for malformed JSON.
+ */
+
+#ifndef MOCK_ARDUINOJSON_H
+#define MOCK_ARDUINOJSON_H
+
+#include <stdlib.h>
+#include <string.h>
+#include <map>
+#include <string>
+
+class JsonDocument;
+
+class JsonVariant {
+public:
+  JsonVariant(JsonDocument* d, const char* k) : doc(d), key(k) {}
+
+  JsonVariant& operator=(bool keep);   // For filters
+  bool operator==(const char* s) const;
+  bool operator!=(const char* s) const { return !(*this == s); }
+  template <class T> T as() const;
+
+private:
+  JsonDocument* doc;
+  std::string key;
+};
+
+class JsonDocument {
+public:
+  JsonVariant operator[](const char* key) { return JsonVariant(this, key); }
+  bool containsKey(const char* key) const { return members.count(key) != 0; }
+  void clear() { members.clear(); }
+
+  struct Value {
+    enum Type { NONE, STRING, NUMBER, BOOLEAN } type = NONE;
+    std::string text;
+    double number = 0;
+  };
+
+  std::map<std::string, Value> members;
+};
+
+template <size_t Capacity>
+class StaticJsonDocument : public JsonDocument {};
+
+inline JsonVariant& JsonVariant::operator=(bool keep) {
+  doc->members[key].type = JsonDocument::Value::BOOLEAN;
+  doc->members[key].number = keep;
+  return *this;
+}
+
+inline bool JsonVariant::operator==(const char* s) const {
+  auto it = doc->members.find(key);
+  return it != doc->members.end() && it->second.type == JsonDocument::Value::STRING && it->second.text == s;
+}
+
+template <> inline const char* JsonVariant::as<const char*>() const {
+  auto it = doc->members.find(key);
+  return it != doc->members.end() && it->second.type == JsonDocument::Value::STRING ? it->second.text.c_str()
+                                                                                   : nullptr;
+}
+
+template <> inline long JsonVariant::as<long>() const {
+  auto it = doc->members.find(key);
+  return it != doc->members.end() && it->second.type == JsonDocument::Value::NUMBER ? (long)it->second.number : 0;
+}
+
+class DeserializationError {
+public:
+  enum Code { Ok, EmptyInput, IncompleteInput, InvalidInput };
+
+  DeserializationError(Code c = Ok) : value(c) {}
+  explicit operator bool() const { return value != Ok; }
+  bool operator==(Code c) const { return value == c; }
+  Code code() const { return value; }
+  const char* c_str() const {
+    static const char* const NAMES[] = {"Ok", "EmptyInput", "IncompleteInput", "InvalidInput"};
+    return NAMES[value];
+  }
+
+private:
+  Code value;
+};
+
+namespace DeserializationOption {
+struct Filter {
+  explicit Filter(JsonDocument& f) : doc(f) {}
+  JsonDocument& doc;
+};
+}
+
+template <class TStream>
+class MockJsonParser {
+public:
+  MockJsonParser(TStream& s) : in(s), peeked(-2) {}
+
+  DeserializationError parse(JsonDocument& doc, const JsonDocument& filter) {
+    doc.clear();
+    int c = skipSpace();
+    if (c < 0) return DeserializationError::EmptyInput;
+    if (c != '{') return DeserializationError::InvalidInput;
+    take();
+    if (skipSpace() == '}') {
+      take();
+      return DeserializationError::Ok;
+    }
+    for (;;) {
+      std::string key;
+      JsonDocument::Value value;
+      DeserializationError e = readString(key);
+      if (e) return e;
+      c = skipSpace();
+      if (c < 0) return DeserializationError::IncompleteInput;
+      if (c != ':') return DeserializationError::InvalidInput;
+      take();
+      if ((e = readValue(value))) return e;
+      if (filter.containsKey(key.c_str())) doc.members[key] = value;
+      c = skipSpace();
+      if (c < 0) return DeserializationError::IncompleteInput;
+      take();
+      if (c == '}') return DeserializationError::Ok;
+      if (c != ',') return DeserializationError::InvalidInput;
+    }
+  }
+
+private:
+  TStream& in;
+  int peeked;
+
+  int peek() {
+    if (peeked == -2) peeked = in.read();
+    return peeked;
+  }
+
+  int take() {
+    int c = peek();
+    peeked = -2;
+    return c;
+  }
+
+  int skipSpace() {
+    while (peek() == ' ' || peek() == '\t' || peek() == '\r' || peek() == '\n') take();
+    return peek();
+  }
+
+  DeserializationError readString(std::string& out) {
+    int c = skipSpace();
+    if (c < 0) return DeserializationError::IncompleteInput;
+    if (c != '"') return DeserializationError::InvalidInput;
+    take();
+    for (;;) {
+      c = take();
+      if (c < 0) return DeserializationError::IncompleteInput;
+      if (c == '"') return DeserializationError::Ok;
+      if (c == '\\') {
+        c = take();
+        if (c < 0) return DeserializationError::IncompleteInput;
+        if (c == 'u') {
+          for (int i = 0; i < 4; i++) {
+            if (take() < 0) return DeserializationError::IncompleteInput;
+          }
+          c = '?';
+        } else if (c == 'n') {
+          c = '\n';
+        } else if (c == 't') {
+          c = '\t';
+        }
+      }
+      out += (char)c;
+    }
+  }
+
+  DeserializationError readWord(const char* word) {
+    for (const char* p = word; *p; p++) {
+      int c = take();
+      if (c < 0) return DeserializationError::IncompleteInput;
+      if (c != *p) return DeserializationError::InvalidInput;
+    }
+    return DeserializationError::Ok;
+  }
+
+  DeserializationError readValue(JsonDocument::Value& v) {
+    int c = skipSpace();
+    if (c < 0) return DeserializationError::IncompleteInput;
+    if (c == '"') {
+      v.type = JsonDocument::Value::STRING;
+      return readString(v.text);
+    }
+    if (c == 't' || c == 'f') {
+      v.type = JsonDocument::Value::BOOLEAN;
+      v.number = c == 't';
+      return readWord(c == 't' ? "true" : "false");
+    }
+    if (c == 'n') return readWord("null");
+    if (c == '{' || c == '[') return skipNested();
+    if (c == '-' || (c >= '0' && c <= '9')) {
+      std::string text;
+      while ((c = peek()) >= 0 && strchr("+-.eE0123456789", c) != nullptr) text += (char)take();
+      if (c < 0) return DeserializationError::IncompleteInput;   // A number only ends at what follows it
+      char* end;
+      v.number = strtod(text.c_str(), &end);
+      v.type = JsonDocument::Value::NUMBER;
+      return *end == '\0' ? DeserializationError::Ok : DeserializationError::InvalidInput;
+    }
+    return DeserializationError::InvalidInput;
+  }
+
+  // An object or array, matched up to its closing bracket and dropped
+  DeserializationError skipNested() {
+    int depth = 0;
+    do {
+      int c = skipSpace();
+      if (c < 0) return DeserializationError::IncompleteInput;
+      if (c == '"') {
+        std::string ignored;
+        DeserializationError e = readString(ignored);
+        if (e) return e;
+        continue;
+      }
+      take();
+      if (c == '{' || c == '[') depth++;
+      if (c == '}' || c == ']') depth--;
+    } while (depth > 0);
+    return DeserializationError::Ok;
+  }
+};
+
+template <class TStream>
+DeserializationError deserializeJson(JsonDocument& doc, TStream& in, DeserializationOption::Filter filter) {
+  MockJsonParser<TStream> parser(in);
+  return parser.parse(doc, filter.doc);
+}
+
+#endif // MOCK_ARDUINOJSON_H
@@ -0,0 +1,202 @@
+/*
+ * Mock HTTPClient: an HTTP/1.0 GET over a real TCP socket, so a tools/
+ * program can serve the firmware from a stand-in server. Host names come
+ * from the WiFi mock's table and ports are shifted by mockPortShift, as for
+ * UDP. The connect timeout bounds the connect, and the read timeout each
+ * wait for the status line, a header line or a body byte, as on the device;
+ * the same error codes come back. The body can also be drained without
+ * waiting, as a pull over getStreamPtr() does.
+ */
+
+#ifndef MOCK_HTTPCLIENT_H
+#define MOCK_HTTPCLIENT_H
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <strings.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include "WiFi.h"
+
+#define HTTP_CODE_OK                     200
+#define HTTP_CODE_PARTIAL_CONTENT        206
+#define HTTPC_ERROR_CONNECTION_REFUSED   (-1)
+#define HTTPC_ERROR_SEND_HEADER_FAILED   (-2)
+#define HTTPC_ERROR_NOT_CONNECTED        (-4)
+#define HTTPC_ERROR_CONNECTION_LOST      (-5)
+#define HTTPC_ERROR_NO_HTTP_SERVER       (-7)
+#define HTTPC_ERROR_READ_TIMEOUT         (-11)
+
+// The response body, read a byte at a time with the client's timeout
+class WiFiClient {
+public:
+  WiFiClient() : fd(-1), timeoutMs(1000) {}
+
+  // Next byte, or -1 once the peer has closed or nothing came in time
+  int read() {
+    if (fd < 0) return -1;
+    pollfd p = {fd, POLLIN, 0};
+    if (::poll(&p, 1, (int)timeoutMs) <= 0) return -1;
+    uint8_t c;
+    return recv(fd, &c, 1, 0) == 1 ? c : -1;
+  }
+
+  // Up to len bytes already received; 0 if none, -1 once the peer has closed
+  int read(uint8_t* buf, size_t len) {
+    if (fd < 0) return -1;
+    ssize_t n = recv(fd, buf, len, MSG_DONTWAIT);
+    if (n < 0) return (errno == EAGAIN || errno == EWOULDBLOCK) ? 0 : -1;
+    return n == 0 ? -1 : (int)n;
+  }
+
+  int available() {
+    int n = 0;
+    if (fd < 0 || ioctl(fd, FIONREAD, &n) < 0) return 0;
+    return n;
+  }
+
+  // Until the peer has closed its end (buffered data may still be unread)
+  uint8_t connected() {
+    if (fd < 0) return 0;
+    char c;
+    ssize_t n = recv(fd, &c, 1, MSG_PEEK | MSG_DONTWAIT);
+    return n > 0 || (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK));
+  }
+
+  size_t readBytes(char* buf, size_t len) {
+    size_t n = 0;
+    int c;
+    while (n < len && (c = read()) >= 0) buf[n++] = (char)c;
+    return n;
+  }
+
+  void setTimeout(unsigned long ms) { timeoutMs = ms; }
+
+private:
+  friend class HTTPClient;
+  int fd;
+  unsigned long timeoutMs;
+};
+
+class HTTPClient {
+public:
+  HTTPClient() : port(80), connectTimeoutMs(5000), timeoutMs(5000), size(-1) { extraHeaders[0] = '\0'; }
+  ~HTTPClient() { end(); }
+
+  void useHTTP10(bool) {}
+  void setConnectTimeout(int32_t ms) { connectTimeoutMs = ms; }
+  void setTimeout(uint16_t ms) { timeoutMs = ms; }
+
+  void addHeader(const char* name, const char* value) {
+    size_t used = strlen(extraHeaders);
+    snprintf(extraHeaders + used, sizeof(extraHeaders) - used, "%s: %s\r\n", name, value);
+  }
+
+  bool begin(const char* url) {
+    const char* p = strncmp(url, "http://", 7) == 0 ? url + 7 : nullptr;
+    if (p == nullptr) return false;
+    size_t hostLen = strcspn(p, ":/");
+    if (hostLen == 0 || hostLen >= sizeof(host)) return false;
+    memcpy(host, p, hostLen);
+    host[hostLen] = '\0';
+    p += hostLen;
+    port = 80;
+    if (*p == ':') port = (uint16_t)strtoul(p + 1, (char**)&p, 10);
+    snprintf(path, sizeof(path), "%s", *p == '/' ? p : "/");
+    return true;
+  }
+
+  int GET() {
+    IPAddress ip;
+    if (!WiFi.hostByName(host, ip)) return HTTPC_ERROR_CONNECTION_REFUSED;
+    if (!connectTo(ip)) return HTTPC_ERROR_CONNECTION_REFUSED;
+
+    char request[400];
+    int len = snprintf(request, sizeof(request), "GET %s HTTP/1.0\r\nHost: %s\r\nConnection: close\r\n%s\r\n",
+                       path, host, extraHeaders);
+    if (send(client.fd, request, len, MSG_NOSIGNAL) != len) return HTTPC_ERROR_SEND_HEADER_FAILED;
+
+    client.setTimeout(timeoutMs);
+    char line[256];
+    int got = readLine(line, sizeof(line));
+    if (got < 0) return got;
+    int code;
+    if (sscanf(line, "HTTP/1.%*d %d", &code) != 1) return HTTPC_ERROR_NO_HTTP_SERVER;
+    size = -1;
+    while ((got = readLine(line, sizeof(line))) > 0) {
+      if (strncasecmp(line, "Content-Length:", 15) == 0) size = atoi(line + 15);
+    }
+    return got < 0 ? got : code;
+  }
+
+  // Content-Length of the last response, -1 without one
+  int getSize() const { return size; }
+
+  WiFiClient& getStream() { return client; }
+  WiFiClient* getStreamPtr() { return &client; }
+
+  void end() {
+    if (client.fd >= 0) close(client.fd);
+    client.fd = -1;
+  }
+
+private:
+  char host[64];
+  char path[192];
+  uint16_t port;
+  int32_t connectTimeoutMs;
+  uint16_t timeoutMs;
+  int size;
+  char extraHeaders[128];   // addHeader() lines, sent with the request
+  WiFiClient client;
+
+  bool connectTo(const IPAddress& ip) {
+    end();
+    client.fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (client.fd < 0) return false;
+    sockaddr_in a;
+    memset(&a, 0, sizeof(a));
+    a.sin_family = AF_INET;
+    a.sin_port = htons((uint16_t)(port + mockPortShift));
+    a.sin_addr.s_addr = htonl(((uint32_t)ip[0] << 24) | (ip[1] << 16) | (ip[2] << 8) | ip[3]);
+
+    int flags = fcntl(client.fd, F_GETFL);
+    fcntl(client.fd, F_SETFL, flags | O_NONBLOCK);
+    int r = connect(client.fd, (sockaddr*)&a, sizeof(a));
+    if (r < 0 && errno == EINPROGRESS) {
+      pollfd p = {client.fd, POLLOUT, 0};
+      int err = 0;
+      socklen_t errLen = sizeof(err);
+      if (::poll(&p, 1, connectTimeoutMs) == 1 &&
+          getsockopt(client.fd, SOL_SOCKET, SO_ERROR, &err, &errLen) == 0 && err == 0) {
+        r = 0;
+      }
+    }
+    fcntl(client.fd, F_SETFL, flags);
+    if (r < 0) end();
+    return r == 0;
+  }
+
+  // One header line without its CRLF: its length, or an error code
+  int readLine(char* out, size_t size) {
+    size_t n = 0;
+    for (;;) {
+      pollfd p = {client.fd, POLLIN, 0};
+      if (::poll(&p, 1, timeoutMs) <= 0) return HTTPC_ERROR_READ_TIMEOUT;
+      char c;
+      if (recv(client.fd, &c, 1, 0) != 1) return HTTPC_ERROR_CONNECTION_LOST;
+      if (c == '\n') break;
+      if (c != '\r' && n + 1 < size) out[n++] = c;
+    }
+    out[n] = '\0';
+    return (int)n;
+  }
+};
+
+#endif // MOCK_HTTPCLIENT_H
@@ -0,0 +1,77 @@
+/*
+ * Mock Update (the Arduino OTA writer): the image is kept in memory instead
+ * of an OTA partition, so a tools/ program can check what was written.
+ * end() checks what the real one can without flash: the app image magic
+ * byte, and that something was written at all. As on the device, begin()
+ * is refused while an earlier update is neither ended nor aborted.
+ */
+
+#ifndef MOCK_UPDATE_H
+#define MOCK_UPDATE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+#define UPDATE_SIZE_UNKNOWN 0xFFFFFFFF
+#define U_FLASH             0
+
+class UpdateClass {
+public:
+  std::vector<uint8_t> image;   // Everything written since begin()
+  bool ended = false;           // end() accepted the image
+  bool aborted = false;
+
+  bool begin(size_t, int = U_FLASH) {
+    if (running) {
+      error = "Already running";
+      return false;
+    }
+    image.clear();
+    ended = false;
+    aborted = false;
+    error = "";
+    running = true;
+    return true;
+  }
+
+  size_t write(uint8_t* data, size_t len) {
+    if (!running) {
+      error = "Not started";
+      return 0;
+    }
+    image.insert(image.end(), data, data + len);
+    return len;
+  }
+
+  bool end(bool = false) {
+    if (!running) {
+      error = "Not started";
+      return false;
+    }
+    running = false;
+    if (image.empty() || image[0] != 0xE9) {
+      error = "Magic byte is wrong";
+      return false;
+    }
+    ended = true;
+    return true;
+  }
+
+  void abort() {
+    running = false;
+    aborted = true;
+    error = "Aborted";
+  }
+
+  bool isRunning() const { return running; }
+  const char* errorString() const { return error; }
+
+private:
+  bool running = false;
+  const char* error = "";
+};
+
+inline UpdateClass Update;
+
+#endif // MOCK_UPDATE_H
@@ -0,0 +1,152 @@
+/*
+ * Mock WiFi for host runs: the connection state is a flag the program sets,
+ * and name lookups come from a small table (unknown names fail, as with DNS
+ * unreachable). Lookups are counted per name. Scans find the networks the
+ * program added, and finish by the first scanComplete() call.
+ */
+
+#ifndef MOCK_WIFI_H
+#define MOCK_WIFI_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include "Arduino.h"
+
+#define WL_CONNECTED    3
+#define WL_DISCONNECTED 6
+
+#define WIFI_STA           1
+#define WIFI_AUTH_OPEN     0
+#define WIFI_AUTH_WPA2_PSK 3
+#define WIFI_SCAN_RUNNING  (-1)
+#define WIFI_SCAN_FAILED   (-2)
+
+#define MOCK_WIFI_HOSTS    8
+#define MOCK_WIFI_NETWORKS 8
+
+typedef int wl_status_t;
+
+// Ports below 1024 can't be bound without root, so the socket mocks
+// (WiFiUdp.h, HTTPClient.h) move every port up by this much
+inline uint16_t mockPortShift = 20000;
+
+class IPAddress {
+public:
+  IPAddress() { memset(bytes, 0, sizeof(bytes)); }
+  IPAddress(uint8_t a, uint8_t b, uint8_t c, uint8_t d) {
+    bytes[0] = a; bytes[1] = b; bytes[2] = c; bytes[3] = d;
+  }
+  uint8_t operator[](int i) const { return bytes[i]; }
+  bool operator==(const IPAddress& o) const { return memcmp(bytes, o.bytes, 4) == 0; }
+  std::string toString() const {
+    char s[16];
+    snprintf(s, sizeof(s), "%u.%u.%u.%u", bytes[0], bytes[1], bytes[2], bytes[3]);
+    return s;
+  }
+
+private:
+  uint8_t bytes[4];
+};
+
+class MockWiFi {
+public:
+  wl_status_t connection = WL_CONNECTED;
+  IPAddress ip = IPAddress(192, 168, 1, 50);
+
+  wl_status_t status() { return connection; }
+  IPAddress localIP() { return ip; }
+  void mode(int) {}
+  void begin(const char*, const char*) {}
+
+  // Found by every scan from now on
+  void addNetwork(const char* ssid, int8_t rssi, bool secure) {
+    if (networkCount == MOCK_WIFI_NETWORKS) return;
+    Network& n = networks[networkCount++];
+    snprintf(n.ssid, sizeof(n.ssid), "%.32s", ssid);
+    n.rssi = rssi;
+    n.auth = secure ? WIFI_AUTH_WPA2_PSK : WIFI_AUTH_OPEN;
+  }
+
+  int16_t scanNetworks(bool async) { return async ? WIFI_SCAN_RUNNING : networkCount; }
+  int16_t scanComplete() { return networkCount; }
+  void scanDelete() {}
+  std::string SSID(uint8_t i) const { return networks[i].ssid; }
+  int32_t RSSI(uint8_t i) const { return networks[i].rssi; }
+  int encryptionType(uint8_t i) const { return networks[i].auth; }
+
+  // Answers lookups of name with ip from now on
+  void addHost(const char* name, IPAddress ip) {
+    Host* h = find(name);
+    if (h == nullptr && hostCount < MOCK_WIFI_HOSTS) {
+      h = &hosts[hostCount++];
+      snprintf(h->name, sizeof(h->name), "%.47s", name);
+    }
+    if (h != nullptr) h->ip = ip;
+  }
+
+  void clearHosts() { hostCount = 0; lookupCounts.clear(); }
+
+  int hostByName(const char* name, IPAddress& ip) {
+    lookupCounts.add(name);
+    Host* h = find(name);
+    if (h == nullptr) return 0;
+    ip = h->ip;
+    return 1;
+  }
+
+  int lookups(const char* name) const { return lookupCounts.get(name); }
+
+private:
+  struct Host {
+    char name[48] = "";
+    IPAddress ip;
+  };
+
+  // Lookups of any name, known or not
+  struct Counts {
+    char names[MOCK_WIFI_HOSTS][48];
+    int counts[MOCK_WIFI_HOSTS];
+    int n = 0;
+
+    void clear() { n = 0; }
+    void add(const char* name) {
+      for (int i = 0; i < n; i++) {
+        if (!strcmp(names[i], name)) { counts[i]++; return; }
+      }
+      if (n == MOCK_WIFI_HOSTS) return;
+      snprintf(names[n], sizeof(names[n]), "%.47s", name);
+      counts[n++] = 1;
+    }
+    int get(const char* name) const {
+      for (int i = 0; i < n; i++) {
+        if (!strcmp(names[i], name)) return counts[i];
+      }
+      return 0;
+    }
+  };
+
+  struct Network {
+    char ssid[33];
+    int8_t rssi;
+    int auth;
+  };
+
+  Host hosts[MOCK_WIFI_HOSTS];
+  int hostCount = 0;
+  Network networks[MOCK_WIFI_NETWORKS];
+  int networkCount = 0;
+  Counts lookupCounts;
+
+  Host* find(const char* name) {
+    for (int i = 0; i < hostCount; i++) {
+      if (!strcmp(hosts[i].name, name)) return &hosts[i];
+    }
+    return nullptr;
+  }
+};
+
+inline MockWiFi WiFi;
+
+#endif // MOCK_WIFI_H
@@ -0,0 +1,102 @@
+/*
+ * Mock WiFiUDP over real, non-blocking UDP sockets on the loopback
+ * interface, so a tools/ program can answer the firmware from a stand-in
+ * server. Every port, to bind and to send to, is moved up by mockPortShift
+ * (WiFi.h).
+ */
+
+#ifndef MOCK_WIFIUDP_H
+#define MOCK_WIFIUDP_H
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include "WiFi.h"
+
+#define MOCK_UDP_MAX_PACKET 1472
+
+inline sockaddr_in mockUdpAddress(const IPAddress& ip, uint16_t port) {
+  sockaddr_in a;
+  memset(&a, 0, sizeof(a));
+  a.sin_family = AF_INET;
+  a.sin_port = htons((uint16_t)(port + mockPortShift));
+  a.sin_addr.s_addr = htonl(((uint32_t)ip[0] << 24) | (ip[1] << 16) | (ip[2] << 8) | ip[3]);
+  return a;
+}
+
+class WiFiUDP {
+public:
+  WiFiUDP() : fd(-1), inLen(0), inPos(0), outLen(0) {}
+  ~WiFiUDP() { stop(); }
+
+  uint8_t begin(uint16_t port) {
+    stop();
+    fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (fd < 0) return 0;
+    sockaddr_in a = mockUdpAddress(IPAddress(127, 0, 0, 1), port);
+    if (bind(fd, (sockaddr*)&a, sizeof(a)) < 0) {
+      stop();
+      return 0;
+    }
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    return 1;
+  }
+
+  void stop() {
+    if (fd >= 0) close(fd);
+    fd = -1;
+    inLen = inPos = 0;
+  }
+
+  // Next datagram, dropping what is left of the last one; 0 if none waiting
+  int parsePacket() {
+    inLen = inPos = 0;
+    if (fd < 0) return 0;
+    ssize_t n = recv(fd, in, sizeof(in), 0);
+    if (n <= 0) return 0;
+    inLen = (size_t)n;
+    return (int)n;
+  }
+
+  int available() { return (int)(inLen - inPos); }
+
+  int read() { return inPos < inLen ? in[inPos++] : -1; }
+
+  int read(uint8_t* buf, size_t len) {
+    size_t n = inLen - inPos < len ? inLen - inPos : len;
+    memcpy(buf, in + inPos, n);
+    inPos += n;
+    return (int)n;
+  }
+
+  int beginPacket(IPAddress ip, uint16_t port) {
+    if (fd < 0) return 0;
+    to = mockUdpAddress(ip, port);
+    outLen = 0;
+    return 1;
+  }
+
+  size_t write(const uint8_t* data, size_t len) {
+    if (len > sizeof(out) - outLen) len = sizeof(out) - outLen;
+    memcpy(out + outLen, data, len);
+    outLen += len;
+    return len;
+  }
+
+  int endPacket() {
+    return sendto(fd, out, outLen, 0, (sockaddr*)&to, sizeof(to)) == (ssize_t)outLen;
+  }
+
+private:
+  int fd;
+  uint8_t in[MOCK_UDP_MAX_PACKET];
+  size_t inLen;
+  size_t inPos;
+  uint8_t out[MOCK_UDP_MAX_PACKET];
+  size_t outLen;
+  sockaddr_in to;
+};
+
+#endif // MOCK_WIFIUDP_H
@@ -0,0 +1,10 @@
+// Mock ESP-IDF section attributes: a host has no RTC or IRAM
+
+#ifndef MOCK_ESP_ATTR_H
+#define MOCK_ESP_ATTR_H
+
+#define RTC_NOINIT_ATTR
+#define IRAM_ATTR
+#define DRAM_ATTR
+
+#endif // MOCK_ESP_ATTR_H
@@ -0,0 +1,18 @@
+// Mock ROM CRC: the same CRC-32 (IEEE, reflected) as esp_rom_crc32_le(),
+// which inverts on the way in and out so a running value can be passed back
+
+#ifndef MOCK_ESP_ROM_CRC_H
+#define MOCK_ESP_ROM_CRC_H
+
+#include <stdint.h>
+
+inline uint32_t esp_rom_crc32_le(uint32_t crc, const uint8_t* buf, uint32_t len) {
+  crc = ~crc;
+  while (len--) {
+    crc ^= *buf++;
+    for (int i = 0; i < 8; i++) crc = (crc >> 1) ^ (0xEDB88320u & (0u - (crc & 1)));
+  }
+  return ~crc;
+}
+
+#endif // MOCK_ESP_ROM_CRC_H
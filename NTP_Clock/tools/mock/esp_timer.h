@@ -0,0 +1,12 @@
+// Mock ESP-IDF timer: microseconds since boot, from mockBusNs as millis()
+
+#ifndef MOCK_ESP_TIMER_H
+#define MOCK_ESP_TIMER_H
+
+#include <stdint.h>
+
+extern uint64_t mockBusNs;
+
+inline int64_t esp_timer_get_time() { return (int64_t)(mockBusNs / 1000); }
+
+#endif // MOCK_ESP_TIMER_H
@@ -0,0 +1,23 @@
+// Mock FreeRTOS tasks: each task is a detached std::thread. A task ends by
+// returning after vTaskDelete(nullptr), which is how the firmware's one-shot
+// workers finish anyway.
+
+#ifndef MOCK_FREERTOS_TASK_H
+#define MOCK_FREERTOS_TASK_H
+
+#include <chrono>
+#include <thread>
+#include "FreeRTOS.h"
+
+inline BaseType_t xTaskCreate(void (*fn)(void*), const char*, uint32_t, void* arg, int, TaskHandle_t* handle) {
+  std::thread worker(fn, arg);
+  if (handle != nullptr) *handle = (TaskHandle_t)(uintptr_t)std::hash<std::thread::id>()(worker.get_id());
+  worker.detach();
+  return pdPASS;
+}
+
+inline void vTaskDelete(TaskHandle_t) {}
+
+inline void vTaskDelay(TickType_t ticks) { std::this_thread::sleep_for(std::chrono::milliseconds(ticks)); }
+
+#endif // MOCK_FREERTOS_TASK_H
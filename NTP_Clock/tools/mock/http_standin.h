@@ -0,0 +1,180 @@
+/*
+ * Stand-in HTTP server for host runs of firmware that fetches over HTTP
+ *
+ * Serves one canned response per connection, HTTP/1.0 style (closes when
+ * done), from its own thread on 127.0.0.1 at the shifted port (WiFi.h).
+ * The response can be slow to start, trickle its body, stop partway and
+ * close, or stop partway and hold the connection open until the client
+ * gives up. A "Range: bytes=N-" request gets 206 and the body from N, or,
+ * from a server set to ignore ranges, 200 and all of it.
+ */
+
+#ifndef MOCK_HTTP_STANDIN_H
+#define MOCK_HTTP_STANDIN_H
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <thread>
+#include "WiFi.h"
+
+class HttpStandIn {
+public:
+  struct Response {
+    int status = 200;
+    std::string body;
+    int headerDelayMs = 0;   // Before the status line
+    int byteGapMs = 0;       // Between body bytes
+    int cutAfter = -1;       // Close after this many body bytes (-1: send it all)
+    int cutTimes = -1;       // Only the first this many connections after serve() are cut (-1: all)
+    int stallAfter = -1;     // Hold the connection open after this many body bytes
+    bool ranges = true;      // Honour Range requests
+  };
+
+  std::atomic<int> requests{0};
+  std::atomic<int> rangeRequests{0};
+  std::atomic<long> lastRangeFrom{-1};   // Offset of the last Range request
+
+  HttpStandIn() : listener(-1), stopping(false) {}
+
+  ~HttpStandIn() {
+    stopping = true;
+    if (worker.joinable()) worker.join();
+    if (listener >= 0) close(listener);
+  }
+
+  // Listens on 127.0.0.1 at port (shifted); false if the port can't be had
+  bool open(uint16_t port = 80) {
+    listener = socket(AF_INET, SOCK_STREAM, 0);
+    if (listener < 0) return false;
+    int one = 1;
+    setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    sockaddr_in a;
+    memset(&a, 0, sizeof(a));
+    a.sin_family = AF_INET;
+    a.sin_port = htons((uint16_t)(port + mockPortShift));
+    a.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (bind(listener, (sockaddr*)&a, sizeof(a)) < 0 || listen(listener, 4) < 0) return false;
+    worker = std::thread(&HttpStandIn::run, this);
+    return true;
+  }
+
+  // What the next connections get
+  void serve(const Response& r) {
+    std::lock_guard<std::mutex> lock(mutex);
+    response = r;
+    served = 0;
+  }
+
+private:
+  int listener;
+  std::atomic<bool> stopping;
+  std::thread worker;
+  std::mutex mutex;
+  Response response;
+  int served = 0;   // Connections answered since serve()
+
+  void run() {
+    while (!stopping) {
+      pollfd p = {listener, POLLIN, 0};
+      if (::poll(&p, 1, 20) <= 0) continue;
+      int fd = accept(listener, nullptr, nullptr);
+      if (fd < 0) continue;
+      requests++;
+      Response r;
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        r = response;
+        if (r.cutTimes >= 0 && served >= r.cutTimes) r.cutAfter = -1;
+        served++;
+      }
+      long from = -1;
+      if (readRequest(fd, from)) {
+        if (from >= 0) {
+          rangeRequests++;
+          lastRangeFrom = from;
+        }
+        answer(fd, r, r.ranges ? from : -1);
+      }
+      close(fd);
+    }
+  }
+
+  // Up to the blank line; false if the client went away first. from is the
+  // start of a "Range: bytes=N-" header, -1 without one.
+  static bool readRequest(int fd, long& from) {
+    std::string head;
+    while (head.size() < 4 || head.compare(head.size() - 4, 4, "\r\n\r\n") != 0) {
+      pollfd p = {fd, POLLIN, 0};
+      char c;
+      if (::poll(&p, 1, 1000) <= 0 || recv(fd, &c, 1, 0) != 1) return false;
+      head += c;
+    }
+    const char* key = "\r\nRange: bytes=";
+    size_t range = head.find(key);
+    from = range == std::string::npos ? -1 : atol(head.c_str() + range + strlen(key));
+    return true;
+  }
+
+  // Sleeps in small steps, so a stop isn't held up
+  void pause(int ms) {
+    auto until = std::chrono::steady_clock::now() + std::chrono::milliseconds(ms);
+    while (!stopping && std::chrono::steady_clock::now() < until) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(ms < 5 ? ms : 5));
+    }
+  }
+
+  // Until the client closes its end (or the server stops)
+  void holdOpen(int fd) {
+    while (!stopping) {
+      pollfd p = {fd, POLLIN, 0};
+      char c;
+      if (::poll(&p, 1, 20) > 0 && recv(fd, &c, 1, 0) <= 0) return;
+    }
+  }
+
+  // from: where a honoured Range starts, -1 for the whole body
+  void answer(int fd, const Response& r, long from) {
+    pause(r.headerDelayMs);
+    int status = r.status;
+    size_t start = 0;
+    if (from >= 0 && status == 200) {
+      status = 206;
+      start = (size_t)from < r.body.size() ? (size_t)from : r.body.size();
+    }
+    char head[160];
+    int len = snprintf(head, sizeof(head), "HTTP/1.0 %d %s\r\nContent-Type: application/json\r\n"
+                       "Content-Length: %u\r\n\r\n", status, status < 300 ? "OK" : "Error",
+                       (unsigned)(r.body.size() - start));
+    if (send(fd, head, len, MSG_NOSIGNAL) != len) return;
+
+    for (size_t i = 0; start + i < r.body.size(); i++) {
+      if ((int)i == r.cutAfter) return;
+      if ((int)i == r.stallAfter) {
+        holdOpen(fd);
+        return;
+      }
+      if (i > 0) pause(r.byteGapMs);
+      if (r.byteGapMs > 0) {
+        if (send(fd, &r.body[start + i], 1, MSG_NOSIGNAL) != 1) return;
+        continue;
+      }
+      // Unpaced: the rest, or up to the cut or stall, in one go
+      size_t end = r.body.size() - start;
+      if (r.cutAfter > (int)i && (size_t)r.cutAfter < end) end = r.cutAfter;
+      if (r.stallAfter > (int)i && (size_t)r.stallAfter < end) end = r.stallAfter;
+      ssize_t sent = send(fd, r.body.data() + start + i, end - i, MSG_NOSIGNAL);
+      if (sent != (ssize_t)(end - i)) return;
+      i = end - 1;
+    }
+  }
+};
+
+#endif // MOCK_HTTP_STANDIN_H
@@ -0,0 +1,137 @@
+/*
+ * Stand-in NTP server for host runs of sntp_client.h
+ *
+ * Listens on a loopback address at the (shifted, see WiFiUdp.h) NTP port and
+ * answers in simulated time: each request takes baseDelayUs plus a random
+ * queueing delay (exponential, mean jitterUs) each way, so the two
+ * directions differ the way they do on a busy network. The server's clock
+ * is true time plus offsetUs. Call service() after every step of mockBusNs
+ * and after every client call that may have sent; replies go out once their
+ * delay is up.
+ *
+ * Every answered request is recorded, so a program can work out which
+ * sample the client should have picked and what offset that gives.
+ */
+
+#ifndef MOCK_NTP_STANDIN_H
+#define MOCK_NTP_STANDIN_H
+
+#include <math.h>
+#include <vector>
+#include "WiFiUdp.h"
+#include "sys_clock.h"
+
+#define STANDIN_PROCESS_US 20   // Between receive and transmit timestamps
+
+class NtpStandIn {
+public:
+  struct Exchange {
+    int64_t outUs;    // Client to server
+    int64_t backUs;   // Server to client
+  };
+
+  int64_t offsetUs = 0;      // Server clock minus true time
+  int64_t baseDelayUs = 1000;
+  int64_t jitterUs = 0;
+  bool silent = false;       // Reads requests and never answers
+  uint8_t stratum = 2;
+  uint32_t requests = 0;
+  std::vector<Exchange> answered;
+
+  explicit NtpStandIn(uint64_t seed = 1) : fd(-1), rng(seed | 1) {}
+  ~NtpStandIn() { if (fd >= 0) close(fd); }
+
+  // Listens on 127.0.0.<host>; false if the port can't be had
+  bool open(uint8_t host) {
+    address = IPAddress(127, 0, 0, host);
+    fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (fd < 0) return false;
+    sockaddr_in a = mockUdpAddress(address, 123);
+    if (bind(fd, (sockaddr*)&a, sizeof(a)) < 0) return false;
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    return true;
+  }
+
+  IPAddress ip() const { return address; }
+
+  bool busy() const { return !queue.empty(); }
+
+  // When the next reply goes out, so a program can step straight to it
+  uint64_t nextDueNs() const {
+    uint64_t due = UINT64_MAX;
+    for (const Reply& r : queue) due = r.dueNs < due ? r.dueNs : due;
+    return due;
+  }
+
+  void service() {
+    uint8_t packet[48];
+    sockaddr_in from;
+    socklen_t fromLen = sizeof(from);
+    ssize_t n;
+    while ((n = recvfrom(fd, packet, sizeof(packet), 0, (sockaddr*)&from, &fromLen)) > 0) {
+      fromLen = sizeof(from);
+      requests++;
+      if (silent || n < 48) continue;
+      answer(packet, from);
+    }
+
+    for (size_t i = 0; i < queue.size();) {
+      if (queue[i].dueNs > mockBusNs) {
+        i++;
+        continue;
+      }
+      sendto(fd, queue[i].packet, 48, 0, (sockaddr*)&queue[i].to, sizeof(queue[i].to));
+      queue.erase(queue.begin() + i);
+    }
+  }
+
+private:
+  struct Reply {
+    uint64_t dueNs;
+    uint8_t packet[48];
+    sockaddr_in to;
+  };
+
+  int fd;
+  IPAddress address;
+  uint64_t rng;
+  std::vector<Reply> queue;
+
+  // xorshift64*, as the other tools
+  double uniform() {
+    rng ^= rng >> 12;
+    rng ^= rng << 25;
+    rng ^= rng >> 27;
+    return (double)((rng * 0x2545F4914F6CDD1DULL) >> 11) / (double)(1ULL << 53);
+  }
+
+  int64_t oneWayUs() {
+    return baseDelayUs + (jitterUs > 0 ? (int64_t)(-log(1 - uniform()) * jitterUs) : 0);
+  }
+
+  static void writeStamp(uint8_t* p, int64_t unixUs) {
+    uint32_t sec = (uint32_t)(unixUs / 1000000 + 2208988800LL);
+    uint32_t frac = (uint32_t)(((uint64_t)(unixUs % 1000000) << 32) / 1000000);
+    p[0] = sec >> 24; p[1] = sec >> 16; p[2] = sec >> 8; p[3] = sec;
+    p[4] = frac >> 24; p[5] = frac >> 16; p[6] = frac >> 8; p[7] = frac;
+  }
+
+  void answer(const uint8_t* request, const sockaddr_in& from) {
+    Exchange e = {oneWayUs(), oneWayUs()};
+    answered.push_back(e);
+    int64_t arrivedUs = MockSysClock::trueUs() + e.outUs;
+
+    Reply r;
+    memset(r.packet, 0, sizeof(r.packet));
+    r.packet[0] = 0x24;              // LI=0, VN=4, Mode=4 (server)
+    r.packet[1] = stratum;
+    memcpy(r.packet + 24, request + 40, 8);   // Originate: the client's transmit time
+    writeStamp(r.packet + 32, arrivedUs + offsetUs);
+    writeStamp(r.packet + 40, arrivedUs + STANDIN_PROCESS_US + offsetUs);
+    r.dueNs = mockBusNs + (uint64_t)(e.outUs + STANDIN_PROCESS_US + e.backUs) * 1000;
+    r.to = from;
+    queue.push_back(r);
+  }
+};
+
+#endif // MOCK_NTP_STANDIN_H
@@ -0,0 +1,72 @@
+/*
+ * Mock ROM tinfl: the same calls and statuses as the ESP32's copy of miniz,
+ * answered by the host's zlib (raw deflate, as tinfl without
+ * TINFL_FLAG_PARSE_ZLIB_HEADER). zlib keeps its own window, so the caller's
+ * ring works as it does on the device. Its state is carved out of the
+ * decompressor itself, so free() on that releases everything, as with tinfl.
+ * Link with -lz.
+ */
+
+#ifndef MOCK_ROM_MINIZ_H
+#define MOCK_ROM_MINIZ_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <zlib.h>
+
+#define TINFL_LZ_DICT_SIZE        32768
+#define TINFL_FLAG_HAS_MORE_INPUT 2
+
+typedef enum {
+  TINFL_STATUS_FAILED = -1,
+  TINFL_STATUS_DONE = 0,
+  TINFL_STATUS_NEEDS_MORE_INPUT = 1,
+  TINFL_STATUS_HAS_MORE_OUTPUT = 2
+} tinfl_status;
+
+#define MOCK_TINFL_ARENA (48 * 1024)   // zlib's inflate state and its 32KB window
+
+struct tinfl_decompressor {
+  z_stream z;
+  size_t used;
+  bool ready;
+  alignas(16) uint8_t arena[MOCK_TINFL_ARENA];
+};
+
+inline voidpf mockTinflAlloc(voidpf opaque, uInt items, uInt size) {
+  tinfl_decompressor* r = (tinfl_decompressor*)opaque;
+  size_t bytes = ((size_t)items * size + 15) & ~(size_t)15;
+  if (r->used + bytes > MOCK_TINFL_ARENA) return Z_NULL;
+  voidpf p = r->arena + r->used;
+  r->used += bytes;
+  return p;
+}
+
+inline void mockTinflFree(voidpf, voidpf) {}
+
+inline void tinfl_init(tinfl_decompressor* r) {
+  memset(&r->z, 0, sizeof(r->z));
+  r->used = 0;
+  r->z.zalloc = mockTinflAlloc;
+  r->z.zfree = mockTinflFree;
+  r->z.opaque = r;
+  r->ready = inflateInit2(&r->z, -MAX_WBITS) == Z_OK;
+}
+
+inline tinfl_status tinfl_decompress(tinfl_decompressor* r, const uint8_t* in, size_t* inBytes, uint8_t*,
+                                     uint8_t* outNext, size_t* outBytes, uint32_t) {
+  if (!r->ready) return TINFL_STATUS_FAILED;
+  r->z.next_in = const_cast<uint8_t*>(in);
+  r->z.avail_in = (uInt)*inBytes;
+  r->z.next_out = outNext;
+  r->z.avail_out = (uInt)*outBytes;
+  int z = inflate(&r->z, Z_NO_FLUSH);
+  *inBytes -= r->z.avail_in;
+  *outBytes -= r->z.avail_out;
+  if (z == Z_STREAM_END) return TINFL_STATUS_DONE;
+  if (z != Z_OK && z != Z_BUF_ERROR) return TINFL_STATUS_FAILED;
+  return r->z.avail_out == 0 ? TINFL_STATUS_HAS_MORE_OUTPUT : TINFL_STATUS_NEEDS_MORE_INPUT;
+}
+
+#endif // MOCK_ROM_MINIZ_H
@@ -0,0 +1,88 @@
+/*
+ * Simulated system clock for host runs of sntp_client.h
+ *
+ * True time is mockBusNs past MOCK_EPOCH_S. The local clock is true time
+ * plus an error that grows at the oscillator's ppm, jumps with
+ * settimeofday() and moves with adjtime(), which slews at 1/64 of elapsed
+ * time as ESP-IDF's does. Include this before sntp_client.h: it renames the
+ * three calls to the simulated ones.
+ */
+
+#ifndef MOCK_SYS_CLOCK_H
+#define MOCK_SYS_CLOCK_H
+
+#include <stdint.h>
+#include <sys/time.h>
+#include <time.h>
+
+#define MOCK_EPOCH_S     1767225600ULL   // 2026-01-01 00:00 UTC at mockBusNs 0
+#define MOCK_SLEW_SHIFT  6
+
+extern uint64_t mockBusNs;
+
+struct MockSysClock {
+  double ppm = 0;           // Oscillator error; positive: the local clock gains
+  double errorNs = 0;       // Local minus true
+  double pendingNs = 0;     // adjtime() still to slew in
+  uint64_t lastNs = 0;
+  uint32_t steps = 0;       // settimeofday() calls
+  uint32_t slews = 0;       // adjtime() calls that set a new adjustment
+
+  // Brings the error up to mockBusNs; call after changing ppm
+  void advance() {
+    double dt = (double)(mockBusNs - lastNs);
+    lastNs = mockBusNs;
+    errorNs += dt * ppm * 1e-6;
+    double most = dt / (1 << MOCK_SLEW_SHIFT);
+    double slew = pendingNs > most ? most : pendingNs < -most ? -most : pendingNs;
+    errorNs += slew;
+    pendingNs -= slew;
+  }
+
+  double errorUs() { advance(); return errorNs / 1000; }
+
+  static int64_t trueUs() { return (int64_t)(MOCK_EPOCH_S * 1000000ULL + mockBusNs / 1000); }
+
+  int64_t localUs() { advance(); return trueUs() + (int64_t)(errorNs / 1000); }
+
+  void reset() { *this = MockSysClock(); lastNs = mockBusNs; }
+};
+
+inline MockSysClock mockClock;
+
+inline int mockGettimeofday(struct timeval* tv, void*) {
+  int64_t us = mockClock.localUs();
+  tv->tv_sec = us / 1000000;
+  tv->tv_usec = us % 1000000;
+  return 0;
+}
+
+// Cancels any slew in progress
+inline int mockSettimeofday(const struct timeval* tv, const void*) {
+  mockClock.advance();
+  int64_t us = (int64_t)tv->tv_sec * 1000000 + tv->tv_usec;
+  mockClock.errorNs = (double)(us - MockSysClock::trueUs()) * 1000;
+  mockClock.pendingNs = 0;
+  mockClock.steps++;
+  return 0;
+}
+
+inline int mockAdjtime(const struct timeval* delta, struct timeval* old) {
+  mockClock.advance();
+  if (old != nullptr) {
+    int64_t us = (int64_t)(mockClock.pendingNs / 1000);
+    old->tv_sec = us / 1000000;
+    old->tv_usec = us % 1000000;
+  }
+  if (delta != nullptr) {
+    mockClock.pendingNs = ((double)delta->tv_sec * 1000000 + delta->tv_usec) * 1000;
+    mockClock.slews++;
+  }
+  return 0;
+}
+
+#define gettimeofday mockGettimeofday
+#define settimeofday mockSettimeofday
+#define adjtime mockAdjtime
+
+#endif // MOCK_SYS_CLOCK_H
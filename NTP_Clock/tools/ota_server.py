@@ -0,0 +1,98 @@
+#!/usr/bin/env python3
+"""
+Local stand-in for a firmware server, for testing the clock's /update pull.
+
+  ota_server.py IMAGE [--port 8000] [--gzip] [--drop-after N] [--drops K]
+                      [--no-range] [--rate BYTES_PER_SEC]
+
+Serves IMAGE (the app image, build/NTP_Clock.ino.bin) at /firmware-ota.bin,
+or gzip-compressed at /firmware-ota.bin.gz with --gzip. Range requests are
+honoured so interrupted downloads can resume. Fault injection:
+
+  --drop-after N   close the connection after N body bytes...
+  --drops K        ...on each of the first K requests (default 1)
+  --no-range       ignore Range and always send the whole file (the clock
+                   must fail cleanly rather than resume from the wrong place)
+  --rate R         throttle to R bytes/s, to watch the clock keep time
+
+Prints the URL and the SHA-256 of the uncompressed image to paste into the
+clock's Firmware Update page.
+"""
+
+import argparse
+import gzip
+import hashlib
+import http.server
+import re
+import socket
+import time
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("image")
+    parser.add_argument("--port", type=int, default=8000)
+    parser.add_argument("--gzip", action="store_true")
+    parser.add_argument("--drop-after", type=int, default=0)
+    parser.add_argument("--drops", type=int, default=1)
+    parser.add_argument("--no-range", action="store_true")
+    parser.add_argument("--rate", type=int, default=0)
+    args = parser.parse_args()
+
+    with open(args.image, "rb") as f:
+        image = f.read()
+    body = gzip.compress(image, 9, mtime=0) if args.gzip else image
+    path = "/firmware-ota.bin.gz" if args.gzip else "/firmware-ota.bin"
+    state = {"drops": args.drops}
+
+    class Handler(http.server.BaseHTTPRequestHandler):
+        protocol_version = "HTTP/1.0"
+
+        def do_GET(self):
+            if self.path != path:
+                self.send_error(404)
+                return
+
+            start = 0
+            match = re.match(r"bytes=(\d+)-$", self.headers.get("Range", ""))
+            if match and not args.no_range:
+                start = int(match.group(1))
+                if start >= len(body):
+                    self.send_error(416)
+                    return
+                self.send_response(206)
+                self.send_header("Content-Range", f"bytes {start}-{len(body) - 1}/{len(body)}")
+            else:
+                self.send_response(200)
+            self.send_header("Content-Type", "application/octet-stream")
+            self.send_header("Content-Length", str(len(body) - start))
+            self.end_headers()
+
+            limit = len(body)
+            if args.drop_after and state["drops"] > 0:
+                state["drops"] -= 1
+                limit = min(limit, start + args.drop_after)
+
+            pos = start
+            try:
+                while pos < limit:
+                    chunk = body[pos:min(pos + 1460, limit)]
+                    self.wfile.write(chunk)
+                    pos += len(chunk)
+                    if args.rate:
+                        time.sleep(len(chunk) / args.rate)
+            except (BrokenPipeError, ConnectionResetError):
+                return
+            if limit < len(body):
+                self.log_message("dropped connection at byte %d of %d", limit, len(body))
+                self.connection.shutdown(socket.SHUT_RDWR)
+
+    host = socket.gethostbyname(socket.gethostname())
+    print(f"URL:     http://{host}:{args.port}{path}")
+    print(f"SHA-256: {hashlib.sha256(image).hexdigest()}")
+    print(f"Size:    {len(image)} bytes, {len(body)} served")
+    http.server.ThreadingHTTPServer(("", args.port), Handler).serve_forever()
+
+
+if __name__ == "__main__":
+    main()
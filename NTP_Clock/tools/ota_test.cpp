@@ -0,0 +1,296 @@
+/*
+ * OTA test - OtaImageWriter and OtaUpdate pulls against a stand-in server
+ *
+ * Runs ota_update.h on this machine with the mocks in mock/: Update keeps
+ * the image in memory, tinfl is the host's zlib behind the ROM's calls,
+ * SHA-256 and the ROM CRC are plain implementations, and a pull's task is a
+ * thread fetching from an HttpStandIn on loopback. The test image is
+ * 160KB, so inflating it wraps the 32KB window several times.
+ *
+ *   images      raw, and gzip with each optional header field (FEXTRA,
+ *               FNAME, FCOMMENT, FHCRC), fed in one piece, in network-sized
+ *               chunks and a byte at a time
+ *   rejected    not an image, truncated inside the deflate data and inside
+ *               the trailer, a bad CRC, a wrong length, bytes after the end,
+ *               a wrong SHA-256; each leaves no update running, so the next
+ *               one can begin
+ *   pulls       raw and gzip; a connection dropped twice, resumed from
+ *               where it stopped with Range requests; a server that answers
+ *               a Range request with 200 and the whole file, which the pull
+ *               must refuse rather than inflate twice
+ *
+ * Each resume waits OTA_RESUME_DELAY_MS, so the pulls take a few seconds.
+ * Exits 1 if any check fails.
+ *
+ * Build and run from this directory:
+ *   g++ -std=gnu++17 -O2 -I.. -Imock ota_test.cpp -o ota_test -pthread -lz
+ *   ./ota_test
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <zlib.h>
+#include "ota_update.h"
+#include "http_standin.h"
+
+uint64_t mockBusNs = 0;
+
+#define IMAGE_SIZE      (160 * 1024)
+#define PULL_LIMIT_MS   30000   // Past this the pull is stuck; the test gives up
+#define PULL_URL        "http://ota.test/NTP_Clock.ino.bin"
+
+static int failures = 0;
+static OtaUpdate ota;   // Outlives every worker thread
+static HttpStandIn server;
+
+static void check(const char* name, bool ok, const char* detail) {
+  printf("  %-4s %-26s %s\n", ok ? "ok" : "FAIL", name, detail);
+  if (!ok) failures++;
+}
+
+// --- Test images ---
+
+// xorshift64*, as clock_sim
+static uint64_t rngState = 1;
+static uint32_t random32() {
+  rngState ^= rngState >> 12;
+  rngState ^= rngState << 25;
+  rngState ^= rngState >> 27;
+  return (uint32_t)((rngState * 0x2545F4914F6CDD1DULL) >> 32);
+}
+
+// Something like code: an app image header, then runs of fresh bytes and
+// copies from up to 30KB back, so it compresses but needs the whole window
+static std::string makeImage() {
+  std::string image(1, (char)0xE9);
+  while (image.size() < IMAGE_SIZE) {
+    size_t run = 16 + random32() % 200;
+    if (image.size() > 1024 && random32() % 3 != 0) {
+      size_t back = 1 + random32() % (image.size() < 30000 ? image.size() : 30000);
+      size_t from = image.size() - back;
+      for (size_t i = 0; i < run; i++) image += image[from + i];
+    } else {
+      for (size_t i = 0; i < run; i++) image += (char)(random32() & 0x3F);
+    }
+  }
+  image.resize(IMAGE_SIZE);
+  return image;
+}
+
+static void putLe(std::string& s, uint32_t v, int bytes) {
+  for (int i = 0; i < bytes; i++) s += (char)(v >> (8 * i));
+}
+
+#define FHCRC    0x02
+#define FEXTRA   0x04
+#define FNAME    0x08
+#define FCOMMENT 0x10
+
+// RFC 1952 member with the given optional fields, deflated by zlib
+static std::string gzipOf(const std::string& data, uint8_t flags) {
+  std::string gz = "\x1f\x8b\x08";
+  gz += (char)flags;
+  putLe(gz, 1767225600, 4);   // mtime
+  gz += "\x02\x03";           // Best compression, Unix
+  if (flags & FEXTRA) {
+    std::string extra("AB\x04\x00wxyz", 8);
+    putLe(gz, extra.size(), 2);
+    gz += extra;
+  }
+  if (flags & FNAME) gz += std::string("NTP_Clock.ino.bin", 18);
+  if (flags & FCOMMENT) gz += std::string("built by ota_test", 18);
+  if (flags & FHCRC) putLe(gz, crc32(0, (const Bytef*)gz.data(), gz.size()) & 0xFFFF, 2);
+
+  z_stream z;
+  memset(&z, 0, sizeof(z));
+  deflateInit2(&z, 9, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY);
+  std::string body(deflateBound(&z, data.size()), '\0');
+  z.next_in = (Bytef*)data.data();
+  z.avail_in = data.size();
+  z.next_out = (Bytef*)&body[0];
+  z.avail_out = body.size();
+  deflate(&z, Z_FINISH);
+  body.resize(z.total_out);
+  deflateEnd(&z);
+
+  gz += body;
+  putLe(gz, crc32(0, (const Bytef*)data.data(), data.size()), 4);
+  putLe(gz, data.size(), 4);
+  return gz;
+}
+
+static std::string shaHex(const std::string& data) {
+  mbedtls_sha256_context sha;
+  uint8_t digest[32];
+  mbedtls_sha256_init(&sha);
+  mbedtls_sha256_starts(&sha, 0);
+  mbedtls_sha256_update(&sha, (const uint8_t*)data.data(), data.size());
+  mbedtls_sha256_finish(&sha, digest);
+  mbedtls_sha256_free(&sha);
+  char hex[65];
+  for (int i = 0; i < 32; i++) snprintf(hex + 2 * i, 3, "%02x", digest[i]);
+  return hex;
+}
+
+static bool written(const std::string& image) {
+  return Update.image.size() == image.size() && memcmp(Update.image.data(), image.data(), image.size()) == 0;
+}
+
+// --- Writer ---
+
+// Feeds input in chunks of chunk bytes; true if end() accepted it
+static bool writeImage(OtaImageWriter& writer, const std::string& input, size_t chunk, const char* sha) {
+  if (!writer.begin(sha)) return false;
+  for (size_t at = 0; at < input.size(); at += chunk) {
+    size_t n = input.size() - at < chunk ? input.size() - at : chunk;
+    if (!writer.write((const uint8_t*)input.data() + at, n)) {
+      writer.abort();
+      return false;
+    }
+  }
+  return writer.end();
+}
+
+static void expectImage(const char* name, const std::string& input, const std::string& image, size_t chunk,
+                        const char* sha = "") {
+  OtaImageWriter writer;
+  bool ok = writeImage(writer, input, chunk, sha);
+  char detail[96];
+  snprintf(detail, sizeof(detail), "%6zu in, %6zu out%s%s", writer.bytesIn(), writer.bytesOut(),
+           ok ? "" : ", error: ", writer.error());
+  check(name, ok && Update.ended && written(image) && writer.bytesIn() == input.size(), detail);
+}
+
+// Refused with this error, and no update left running
+static void expectRejected(const char* name, const std::string& input, const char* error, const char* sha = "") {
+  OtaImageWriter writer;
+  bool ok = writeImage(writer, input, OTA_BUFFER_SIZE, sha);
+  char detail[96];
+  snprintf(detail, sizeof(detail), "error: %s%s", writer.error(), Update.isRunning() ? ", update left running" : "");
+  check(name, !ok && strcmp(writer.error(), error) == 0 && !Update.isRunning(), detail);
+}
+
+// --- Pulls ---
+
+// startPull(), then poll() every millisecond as loop() would
+static OtaUpdate::Result runPull(const char* sha) {
+  if (!ota.startPull(PULL_URL, sha)) {
+    printf("  FAIL startPull() refused with nothing running\n");
+    exit(1);
+  }
+  auto t0 = std::chrono::steady_clock::now();
+  OtaUpdate::Result result;
+  while ((result = ota.poll()) == OtaUpdate::OTA_NONE) {
+    if (std::chrono::steady_clock::now() - t0 > std::chrono::milliseconds(PULL_LIMIT_MS)) {
+      printf("  FAIL pull still running after %d ms\n", PULL_LIMIT_MS);
+      exit(1);
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  return result;
+}
+
+static void pullDetail(char* detail, size_t size, OtaUpdate::Result result) {
+  snprintf(detail, size, "%-6s resumes %u, last range from %ld, HTTP %d%s%s",
+           result == OtaUpdate::OTA_DONE ? "DONE" : "FAILED", ota.resumeCount(), server.lastRangeFrom.load(),
+           ota.lastError(), ota.error()[0] ? ", " : "", ota.error());
+}
+
+// Succeeded after resumes Range requests, the last from lastFrom
+static void expectPull(const char* name, const HttpStandIn::Response& r, const std::string& image, int resumes,
+                       long lastFrom) {
+  server.serve(r);
+  int ranges = server.rangeRequests;
+  OtaUpdate::Result result = runPull(shaHex(image).c_str());
+  char detail[128];
+  pullDetail(detail, sizeof(detail), result);
+  bool ok = result == OtaUpdate::OTA_DONE && Update.ended && written(image) && ota.resumeCount() == resumes &&
+            server.rangeRequests - ranges == resumes && (resumes == 0 || server.lastRangeFrom == lastFrom) &&
+            ota.bytesTotal() == r.body.size();
+  check(name, ok, detail);
+}
+
+// Failed after resumes tries, with bytesIn taken before it stopped
+static void expectPullFailure(const char* name, const HttpStandIn::Response& r, const std::string& image,
+                              int resumes, int lastError, size_t bytesIn) {
+  server.serve(r);
+  OtaUpdate::Result result = runPull(shaHex(image).c_str());
+  char detail[128];
+  pullDetail(detail, sizeof(detail), result);
+  bool ok = result == OtaUpdate::OTA_FAILED && !Update.ended && !Update.isRunning() &&
+            ota.resumeCount() == resumes && ota.lastError() == lastError && ota.bytesIn() == bytesIn;
+  check(name, ok, detail);
+}
+
+int main() {
+  if (!server.open()) {
+    fprintf(stderr, "can't listen on port %d\n", 80 + mockPortShift);
+    return 2;
+  }
+  WiFi.addHost("ota.test", IPAddress(127, 0, 0, 1));
+
+  std::string image = makeImage();
+  std::string gz = gzipOf(image, 0);
+  std::string gzAll = gzipOf(image, FEXTRA | FNAME | FCOMMENT | FHCRC);
+  std::string sha = shaHex(image);
+  printf("%d byte image, %zu gzipped:\n", IMAGE_SIZE, gz.size());
+
+  expectImage("raw", image, image, image.size());
+  expectImage("raw, SHA-256", image, image, OTA_BUFFER_SIZE, sha.c_str());
+  expectImage("gzip", gz, image, gz.size());
+  expectImage("gzip, 2KB chunks", gz, image, OTA_BUFFER_SIZE, sha.c_str());
+  expectImage("gzip, FEXTRA", gzipOf(image, FEXTRA), image, OTA_BUFFER_SIZE);
+  expectImage("gzip, FNAME", gzipOf(image, FNAME), image, OTA_BUFFER_SIZE);
+  expectImage("gzip, FCOMMENT", gzipOf(image, FCOMMENT), image, OTA_BUFFER_SIZE);
+  expectImage("gzip, FHCRC", gzipOf(image, FHCRC), image, OTA_BUFFER_SIZE);
+  expectImage("gzip, all fields", gzAll, image, OTA_BUFFER_SIZE);
+  expectImage("gzip, all fields, 1 byte", gzAll, image, 1);
+  std::string emptyExtra = gzipOf(image, FEXTRA);
+  emptyExtra.replace(10, 10, std::string("\0\0", 2));   // XLEN 0, no subfields
+  expectImage("gzip, empty FEXTRA", emptyExtra, image, OTA_BUFFER_SIZE);
+
+  expectRejected("not an image", "PK\x03\x04" + image, "Not an app image or gzip file");
+  std::string bad = gz;
+  bad[1] = 0x00;
+  expectRejected("bad gzip magic", bad, "Bad gzip header");
+  expectRejected("truncated in deflate", gz.substr(0, gz.size() / 2), "Image is truncated");
+  expectRejected("truncated in trailer", gz.substr(0, gz.size() - 3), "Image is truncated");
+  bad = gz;
+  bad[bad.size() - 8] ^= 0x01;
+  expectRejected("bad CRC", bad, "gzip CRC mismatch");
+  bad = gz;
+  bad[bad.size() - 4] ^= 0x01;
+  expectRejected("wrong length", bad, "gzip length mismatch");
+  expectRejected("data after the end", gz + "x", "Data after the end of the gzip stream");
+  std::string wrongSha = sha;
+  wrongSha[0] = wrongSha[0] == '0' ? '1' : '0';
+  expectRejected("wrong SHA-256", gz, "SHA-256 mismatch", wrongSha.c_str());
+  expectImage("accepted after those", gz, image, OTA_BUFFER_SIZE, sha.c_str());
+
+  printf("Pulls from a stand-in server (resume delay %d ms):\n", OTA_RESUME_DELAY_MS);
+  HttpStandIn::Response r;
+  r.body = image;
+  expectPull("raw pull", r, image, 0, -1);
+  r.body = gzAll;
+  expectPull("gzip pull", r, image, 0, -1);
+
+  const int cut = 20000;
+  r.cutAfter = cut;
+  r.cutTimes = 2;
+  expectPull("gzip, dropped twice", r, image, 2, 2 * cut);
+  r.body = image;
+  r.cutTimes = 1;
+  expectPull("raw, dropped once", r, image, 1, cut);
+
+  // Nothing more is taken from the 200: the inflater can't start over
+  r.body = gzAll;
+  r.ranges = false;
+  expectPullFailure("Range answered with 200", r, image, 1, HTTP_CODE_OK, cut);
+
+  printf("%d requests served\n%s\n", server.requests.load(), failures ? "FAILED" : "ok");
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,236 @@
+/*
+ * SNTP test - the real SntpClient against stand-in NTP servers
+ *
+ * Runs sntp_client.h on this machine with the mocks in mock/: WiFi and
+ * name lookups from a table, UDP over loopback sockets, and a simulated
+ * system clock the client reads, steps and slews. The servers are
+ * NtpStandIn (mock/ntp_standin.h), answering with a chosen offset and
+ * delay plus random queueing each way, all in simulated time. Checks:
+ *
+ *   first sync      a clock seconds out is stepped onto the server
+ *   filter          per server, the burst's lowest-delay sample is used
+ *                   (the residual offset is exactly that sample's asymmetry)
+ *   median          two agreeing servers outvote a third far off
+ *   slew/step       a 40 ms offset is slewed, a 500 ms one stepped
+ *   drift           the sync loop learns a 25 ppm fast oscillator
+ *   silent server   keeps its address; looked up again every
+ *                   SNTP_STALE_POLLS polls, not at every timeout
+ *   failed lookup   retried with back-off, and found once DNS answers
+ *
+ * Exits 1 if any check fails.
+ *
+ * Build and run from this directory:
+ *   g++ -std=gnu++17 -O2 -I.. -Imock sntp_test.cpp -o sntp_test
+ *   ./sntp_test
+ */
+
+#include <math.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "sys_clock.h"   // Before sntp_client.h, which then uses the simulated clock
+#include "sntp_client.h"
+#include "ntp_standin.h"
+
+uint64_t mockBusNs = 0;
+
+#define STEP_MS 10   // Replies are stepped to exactly; this is the idle step
+
+static int failures = 0;
+
+static void check(bool ok, const char* name, const char* fmt, ...) {
+  char detail[160];
+  va_list args;
+  va_start(args, fmt);
+  vsnprintf(detail, sizeof(detail), fmt, args);
+  va_end(args);
+  printf("  %-4s %-16s %s\n", ok ? "ok" : "FAIL", name, detail);
+  if (!ok) failures++;
+}
+
+// One client and its servers, stepped together
+struct Sim {
+  SntpClient client;
+  NtpStandIn* servers[SNTP_MAX_SERVERS];
+  int serverCount = 0;
+
+  Sim() {
+    mockClock.reset();
+    WiFi.clearHosts();
+    WiFi.connection = WL_CONNECTED;
+  }
+
+  ~Sim() {
+    for (int i = 0; i < serverCount; i++) delete servers[i];
+  }
+
+  NtpStandIn& addServer(const char* name, uint8_t host, uint64_t seed = 1) {
+    NtpStandIn* s = new NtpStandIn(seed);
+    if (!s->open(host)) {
+      fprintf(stderr, "can't listen on 127.0.0.%d port %d\n", host, 123 + mockPortShift);
+      exit(2);
+    }
+    WiFi.addHost(name, s->ip());
+    servers[serverCount++] = s;
+    return *s;
+  }
+
+  void begin(const char* names) { client.begin(names); }
+
+  // To the next reply or STEP_MS, whichever is first. Servers take requests
+  // as soon as they are sent, so the delays are exactly what they chose.
+  void step() {
+    uint64_t to = mockBusNs + STEP_MS * 1000000ULL;
+    for (int i = 0; i < serverCount; i++) {
+      if (servers[i]->nextDueNs() < to) to = servers[i]->nextDueNs();
+    }
+    mockBusNs = to;
+    for (int i = 0; i < serverCount; i++) servers[i]->service();
+    client.poll();
+    for (int i = 0; i < serverCount; i++) servers[i]->service();
+  }
+
+  void runMs(uint64_t ms) {
+    uint64_t end = mockBusNs + ms * 1000000ULL;
+    while (mockBusNs < end) step();
+  }
+
+  // Runs until the client has finished `polls` polls in all; false on timeout
+  bool runToPoll(uint32_t polls, uint64_t limitMs) {
+    uint64_t end = mockBusNs + limitMs * 1000000ULL;
+    while (client.getStats().polls < polls) {
+      if (mockBusNs >= end) return false;
+      step();
+    }
+    return true;
+  }
+};
+
+static void firstSync() {
+  Sim sim;
+  sim.addServer("a.test", 2).baseDelayUs = 3000;
+  mockClock.errorNs = 2.5e9;
+  sim.begin("a.test");
+  bool polled = sim.runToPoll(1, 10000);
+  check(polled && sim.client.isSynced() && mockClock.steps == 1 && fabs(mockClock.errorUs()) < 10,
+        "first sync", "error %.0f us after %u step(s)", mockClock.errorUs(), mockClock.steps);
+}
+
+// The residual after a first sync is the chosen sample's asymmetry, so it
+// shows exactly which sample the filter took
+static void lowestDelayWins() {
+  int picked = 0;
+  double worst = 0, worstMean = 0;
+  const int SEEDS = 8;
+  for (int seed = 1; seed <= SEEDS; seed++) {
+    Sim sim;
+    NtpStandIn& s = sim.addServer("a.test", 2, seed);
+    s.baseDelayUs = 500;
+    s.jitterUs = 15000;
+    mockClock.errorNs = -1e9;
+    sim.begin("a.test");
+    if (!sim.runToPoll(1, 10000) || s.answered.size() != SNTP_BURST_SIZE) continue;
+
+    const NtpStandIn::Exchange* best = &s.answered[0];
+    double meanUs = 0;
+    for (const NtpStandIn::Exchange& e : s.answered) {
+      if (e.outUs + e.backUs < best->outUs + best->backUs) best = &e;
+      meanUs += (e.outUs - e.backUs) / 2.0 / SNTP_BURST_SIZE;
+    }
+    double wantUs = (best->outUs - best->backUs) / 2.0;
+    double errUs = mockClock.errorUs();
+    int64_t wantDelayUs = best->outUs + best->backUs;
+    if (fabs(errUs - wantUs) < 10 && llabs(sim.client.getStats().delayUs - wantDelayUs) < 10) picked++;
+    if (fabs(errUs) > worst) worst = fabs(errUs);
+    if (fabs(meanUs) > worstMean) worstMean = fabs(meanUs);
+  }
+  check(picked == SEEDS, "filter", "lowest-delay sample used in %d of %d bursts; worst error %.2f ms "
+        "(%.2f ms averaging the burst)", picked, SEEDS, worst / 1000, worstMean / 1000);
+}
+
+static void medianOutvotes() {
+  Sim sim;
+  sim.addServer("a.test", 2);
+  sim.addServer("b.test", 3).offsetUs = 1000;
+  sim.addServer("c.test", 4).offsetUs = 300000;
+  mockClock.errorNs = -0.8e9;
+  sim.begin("a.test,b.test,c.test");
+  sim.runToPoll(1, 20000);
+  const SntpClient::Stats& st = sim.client.getStats();
+  check(st.serversUsed == 3 && fabs(mockClock.errorUs() - 1000) < 20 && llabs(st.jitterUs - 300000) < 20,
+        "median", "%u servers, error %.0f us (want 1000), jitter %lld us", st.serversUsed,
+        mockClock.errorUs(), (long long)st.jitterUs);
+}
+
+static void slewOrStep() {
+  Sim sim;
+  NtpStandIn& s = sim.addServer("a.test", 2);
+  sim.begin("a.test");
+  sim.runToPoll(1, 10000);
+
+  // The server moves 40 ms: slewed in over 64 x 40 ms
+  s.offsetUs = 40000;
+  sim.runToPoll(2, 100000);
+  uint32_t slews = mockClock.slews;
+  sim.runMs(3000);
+  check(mockClock.steps == 1 && slews > 0 && fabs(mockClock.errorUs() - 40000) < 2000, "slew",
+        "40 ms offset: %u step(s), error %.2f ms after 3 s", mockClock.steps, mockClock.errorUs() / 1000);
+
+  s.offsetUs = 540000;
+  sim.runToPoll(3, 100000);
+  check(mockClock.steps == 2 && fabs(mockClock.errorUs() - 540000) < 2000, "step",
+        "500 ms offset: %u step(s), error %.2f ms", mockClock.steps, mockClock.errorUs() / 1000);
+}
+
+static void learnsDrift() {
+  Sim sim;
+  NtpStandIn& s = sim.addServer("a.test", 2);
+  s.jitterUs = 200;
+  mockClock.ppm = 25;
+  sim.begin("a.test");
+  sim.runMs(4 * 3600 * 1000ULL);
+  const SntpClient::Stats& st = sim.client.getStats();
+  check(fabs(st.driftPpm + 25) < 0.5 && fabs(mockClock.errorUs()) < 2000, "drift",
+        "25 ppm oscillator: correction %.2f ppm, error %.2f ms, polling every %lu s", st.driftPpm,
+        mockClock.errorUs() / 1000, (unsigned long)st.pollIntervalSec);
+}
+
+static void silentServer() {
+  Sim sim;
+  sim.addServer("a.test", 2);
+  sim.addServer("quiet.test", 3).silent = true;
+  sim.begin("a.test,quiet.test");
+  sim.runMs(2 * 3600 * 1000ULL);
+  uint32_t polls = sim.client.getStats().polls;
+  int lookups = WiFi.lookups("quiet.test");
+  check(sim.client.isSynced() && lookups >= 2 && lookups <= (int)polls / SNTP_STALE_POLLS + 1, "silent server",
+        "%d lookups in %u polls, %u timeouts", lookups, polls, sim.client.getStats().timeouts);
+}
+
+static void failedLookup() {
+  Sim sim;
+  NtpStandIn& s = sim.addServer("a.test", 2);
+  sim.begin("later.test");
+  sim.runMs(3600 * 1000ULL);
+  uint32_t polls = sim.client.getStats().polls;
+  int lookups = WiFi.lookups("later.test");
+  check(!sim.client.isSynced() && lookups <= 12, "failed lookup",
+        "%d lookups in %u polls over an hour", lookups, polls);
+
+  WiFi.addHost("later.test", s.ip());
+  sim.runMs(SNTP_RESOLVE_MAX_MS + 2 * SNTP_RETRY_MS);
+  check(sim.client.isSynced(), "lookup back", "synced %s", sim.client.isSynced() ? "yes" : "no");
+}
+
+int main() {
+  printf("SntpClient against stand-in servers:\n");
+  firstSync();
+  lowestDelayWins();
+  medianOutvotes();
+  slewOrStep();
+  learnsDrift();
+  silentServer();
+  failedLookup();
+  printf("%s\n", failures ? "FAILED" : "ok");
+  return failures ? 1 : 0;
+}
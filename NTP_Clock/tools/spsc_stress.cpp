@@ -0,0 +1,152 @@
+/*
+ * SpscRing stress test - one producer thread, one consumer thread
+ *
+ * Pushes a numbered byte stream through spsc_ring.h with std::thread on
+ * each side, the way pumpSerialRx() (the HW CDC RX event) and loop()'s
+ * Improv parser share the ring on the device. The producer writes chunks
+ * of random size and retries whatever didn't fit; the consumer reads
+ * random-sized chunks, or single bytes with peek() first as ImprovSerial
+ * does. Checks, for each capacity and access pattern:
+ *
+ *   sequence     every byte arrives once, in order (byte i is i % 251,
+ *                so a skipped or repeated ring's worth shows too)
+ *   peek         peek() returns the byte the next read() does
+ *   fill         available() never exceeds the capacity, and highWater()
+ *                lies between the largest fill the consumer saw and it
+ *   overflow     overflows() equals the bytes write() turned away
+ *
+ * Build with -fsanitize=thread as well (the CMake build does: spsc_stress_tsan)
+ * to have the memory ordering checked, not just the outcome: a relaxed
+ * store of tail is reported as a race on the buffer. -fno-builtin keeps
+ * GCC from inlining the ring's memcpy()s out of TSan's sight. The argument
+ * is megabytes per case; past 4096 the 32-bit indexes wrap during the run.
+ * Exits 1 if any check fails.
+ *
+ * Build and run from this directory:
+ *   g++ -std=gnu++17 -O2 -I.. spsc_stress.cpp -o spsc_stress -pthread
+ *   ./spsc_stress [MB]
+ *   g++ -std=gnu++17 -O2 -g -fsanitize=thread -fno-builtin -I.. spsc_stress.cpp -o spsc_stress_tsan -pthread
+ *   ./spsc_stress_tsan
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+#include <thread>
+#include "spsc_ring.h"
+
+#define DEFAULT_MB 2
+#define SEQ_MOD    251   // Prime, so no capacity is a multiple of it
+
+static int failures = 0;
+
+static uint64_t xorshift(uint64_t& s) {
+  s ^= s >> 12;
+  s ^= s << 25;
+  s ^= s >> 27;
+  return s * 2685821657736338717ULL;
+}
+
+static inline uint8_t seqByte(uint64_t i) { return (uint8_t)(i % SEQ_MOD); }
+
+enum ReadMode { READ_CHUNKS, READ_BYTES };
+
+struct Result {
+  uint64_t badAt = UINT64_MAX;   // First out-of-sequence byte
+  uint64_t received = 0;
+  uint64_t rejected = 0;         // As counted by the producer
+  uint64_t partialWrites = 0;
+  uint32_t peekMismatches = 0;
+  size_t maxSeen = 0;            // Largest available() the consumer saw
+  double seconds = 0;
+};
+
+template <size_t Capacity>
+static Result run(uint64_t total, size_t maxChunk, ReadMode mode, uint64_t seed) {
+  SpscRing<Capacity> ring;
+  Result r;
+
+  std::thread producer([&] {
+    uint64_t s = seed;
+    uint8_t chunk[256];
+    uint64_t sent = 0;
+    while (sent < total) {
+      size_t len = 1 + xorshift(s) % maxChunk;
+      if (len > total - sent) len = total - sent;
+      for (size_t i = 0; i < len; i++) chunk[i] = seqByte(sent + i);
+      size_t done = 0;
+      while (done < len) {
+        size_t n = ring.write(chunk + done, len - done);
+        if (n < len - done) {
+          r.rejected += len - done - n;
+          r.partialWrites++;
+          std::this_thread::yield();
+        }
+        done += n;
+      }
+      sent += len;
+    }
+  });
+
+  std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+  uint64_t s = seed * 31 + 7;
+  uint8_t chunk[256];
+  while (r.received < total) {
+    size_t avail = ring.available();
+    if (avail > r.maxSeen) r.maxSeen = avail;
+    if (avail == 0) {
+      std::this_thread::yield();
+      continue;
+    }
+    if (mode == READ_BYTES) {
+      int peeked = ring.peek();
+      int c = ring.read();
+      if (c < 0) {
+        r.peekMismatches++;   // available() said there was a byte
+        continue;
+      }
+      if (peeked != c) r.peekMismatches++;
+      if ((uint8_t)c != seqByte(r.received) && r.badAt == UINT64_MAX) r.badAt = r.received;
+      r.received++;
+    } else {
+      size_t n = ring.read(chunk, 1 + xorshift(s) % sizeof(chunk));
+      for (size_t i = 0; i < n; i++) {
+        if (chunk[i] != seqByte(r.received + i) && r.badAt == UINT64_MAX) r.badAt = r.received + i;
+      }
+      r.received += n;
+    }
+  }
+  producer.join();
+  r.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+
+  bool ok = r.badAt == UINT64_MAX && r.peekMismatches == 0 && ring.available() == 0 &&
+            r.maxSeen <= Capacity && ring.highWater() >= r.maxSeen && ring.highWater() <= Capacity &&
+            ring.overflows() == (uint32_t)r.rejected;
+  char name[48];
+  snprintf(name, sizeof(name), "%zu B ring, %s", Capacity, mode == READ_BYTES ? "peek+read()" : "chunks");
+  printf("  %-4s %-26s writes <= %3zu  %7.1f MB/s  high water %4u  %9llu partial writes  "
+         "%10u overflowed",
+         ok ? "ok" : "FAIL", name, maxChunk, r.received / r.seconds / 1e6, ring.highWater(),
+         (unsigned long long)r.partialWrites, ring.overflows());
+  if (r.badAt != UINT64_MAX) printf("  byte %llu out of sequence", (unsigned long long)r.badAt);
+  if (r.peekMismatches) printf("  %u peek mismatches", r.peekMismatches);
+  printf("\n");
+  if (!ok) failures++;
+  return r;
+}
+
+int main(int argc, char** argv) {
+  uint64_t mb = argc > 1 ? strtoull(argv[1], nullptr, 10) : DEFAULT_MB;
+  if (mb == 0) mb = DEFAULT_MB;
+  uint64_t total = mb << 20;
+
+  printf("SpscRing, %llu MB per case through two threads:\n", (unsigned long long)mb);
+  run<2>(total / 8, 3, READ_CHUNKS, 1);   // Full on nearly every write
+  run<16>(total / 2, 64, READ_CHUNKS, 2);
+  run<16>(total / 2, 64, READ_BYTES, 3);
+  run<256>(total, 64, READ_CHUNKS, 4);   // IMPROV_RX_BUFFER_SIZE, fed as pumpSerialRx() does
+  run<256>(total, 64, READ_BYTES, 5);
+  run<4096>(total, 256, READ_CHUNKS, 6);
+  printf("%s\n", failures ? "FAILED" : "ok");
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,296 @@
+/*
+ * Telemetry bench - Bandwidth and CPU cost of live_telemetry.h over real sockets
+ *
+ * Stands in for the network with localhost: TelemetryBroadcast sends to a
+ * UDP socket bound on 127.0.0.1, and EventStream serves subscribers that
+ * connect over TCP and send a GET like a browser's EventSource. A clock's
+ * day is simulated in fast time (snapshots every 250 ms, as loop() builds
+ * them): SNTP results change every poll, the die temperature and RSSI
+ * every 10 s, brightness now and then.
+ *
+ * Reports bytes per second on the wire for a few period/batch settings,
+ * and per-subscriber bytes per second and CPU time per snapshot for 1 to
+ * TELEMETRY_SSE_MAX subscribers. CPU time is the host's; scale by the
+ * ratio clock_sim or bus_bench shows to estimate the ESP32-S3. Every
+ * subscriber's stream is parsed back and checked against the final state.
+ *
+ * Build and run from this directory (exit status 1 on failure):
+ *   g++ -std=gnu++17 -O2 -I.. telemetry_bench.cpp -o telemetry_bench
+ *   ./telemetry_bench
+ */
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+#include <string>
+#include "live_telemetry.h"
+
+#define SIM_SECONDS  86400
+#define SNAPSHOT_MS  250
+
+// --- Localhost stand-ins ---
+
+static int udpReceiver = -1;
+static sockaddr_in udpAddr;
+static uint64_t udpBytes = 0;
+static uint32_t udpPackets = 0;
+
+static bool udpSink(const uint8_t* data, size_t len) {
+  return sendto(udpReceiver, data, len, 0, (sockaddr*)&udpAddr, sizeof(udpAddr)) == (ssize_t)len;
+}
+
+static void drainUdp() {
+  uint8_t buf[2048];
+  ssize_t n;
+  while ((n = recv(udpReceiver, buf, sizeof(buf), MSG_DONTWAIT)) > 0) {
+    udpBytes += n + 28;   // IPv4 and UDP headers
+    udpPackets++;
+  }
+}
+
+// EventStream's Client over a non-blocking TCP socket
+struct SocketClient {
+  int fd = -1;
+
+  bool connected() {
+    if (fd < 0) return false;
+    char c;
+    ssize_t n = recv(fd, &c, 1, MSG_PEEK | MSG_DONTWAIT);
+    return n > 0 || (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK));
+  }
+
+  int available() {
+    char c;
+    return fd >= 0 && recv(fd, &c, 1, MSG_PEEK | MSG_DONTWAIT) > 0 ? 1 : 0;
+  }
+
+  int read() {
+    unsigned char c;
+    return recv(fd, &c, 1, MSG_DONTWAIT) == 1 ? c : -1;
+  }
+
+  bool writable() {
+    pollfd p = {fd, POLLOUT, 0};
+    return fd >= 0 && poll(&p, 1, 0) > 0 && (p.revents & POLLOUT);
+  }
+
+  size_t write(const uint8_t* data, size_t len) {
+    ssize_t n = send(fd, data, len, MSG_DONTWAIT | MSG_NOSIGNAL);
+    return n < 0 ? 0 : (size_t)n;
+  }
+
+  void stop() {
+    if (fd >= 0) close(fd);
+    fd = -1;
+  }
+};
+
+// The browser end: reads the stream and keeps the latest value of each field
+struct Browser {
+  int fd = -1;
+  std::string pending;
+  uint64_t bytes = 0;
+  uint32_t events = 0;
+  std::string fields[TELEMETRY_FIELD_COUNT];
+
+  void drain() {
+    char buf[4096];
+    ssize_t n;
+    while ((n = recv(fd, buf, sizeof(buf), MSG_DONTWAIT)) > 0) {
+      bytes += n;
+      pending.append(buf, n);
+    }
+    size_t end;
+    while ((end = pending.find("\n\n")) != std::string::npos) {
+      std::string block = pending.substr(0, end);
+      pending.erase(0, end + 2);
+      size_t data = block.find("data: {");
+      if (data == std::string::npos) continue;
+      events++;
+      parse(block.substr(data + 7));
+    }
+  }
+
+  void parse(const std::string& json) {
+    size_t pos = 0;
+    while (pos < json.size() && json[pos] == '"') {
+      size_t nameEnd = json.find('"', pos + 1);
+      std::string name = json.substr(pos + 1, nameEnd - pos - 1);
+      size_t valueEnd = json.find_first_of(",}", nameEnd);
+      std::string value = json.substr(nameEnd + 2, valueEnd - nameEnd - 2);
+      for (uint8_t i = 0; i < TELEMETRY_FIELD_COUNT; i++) {
+        if (name == telemetryField(i).name) fields[i] = value;
+      }
+      pos = valueEnd + 1;
+    }
+  }
+};
+
+static int listener = -1;
+
+static void openSockets() {
+  udpReceiver = socket(AF_INET, SOCK_DGRAM, 0);
+  memset(&udpAddr, 0, sizeof(udpAddr));
+  udpAddr.sin_family = AF_INET;
+  udpAddr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  bind(udpReceiver, (sockaddr*)&udpAddr, sizeof(udpAddr));
+  socklen_t len = sizeof(udpAddr);
+  getsockname(udpReceiver, (sockaddr*)&udpAddr, &len);
+
+  listener = socket(AF_INET, SOCK_STREAM, 0);
+  sockaddr_in addr = {};
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  bind(listener, (sockaddr*)&addr, sizeof(addr));
+  listen(listener, 8);
+}
+
+static Browser connectBrowser(SocketClient& server) {
+  sockaddr_in addr;
+  socklen_t len = sizeof(addr);
+  getsockname(listener, (sockaddr*)&addr, &len);
+  Browser b;
+  b.fd = socket(AF_INET, SOCK_STREAM, 0);
+  connect(b.fd, (sockaddr*)&addr, sizeof(addr));
+  static const char GET[] = "GET /events HTTP/1.1\r\nHost: clock:81\r\nAccept: text/event-stream\r\n\r\n";
+  send(b.fd, GET, sizeof(GET) - 1, 0);
+  server.fd = accept(listener, nullptr, nullptr);
+  fcntl(server.fd, F_SETFL, O_NONBLOCK);
+  int one = 1;
+  setsockopt(server.fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+  return b;
+}
+
+// --- Simulated clock ---
+
+static uint64_t rng = 0x2545F4914F6CDD1DULL;
+
+static int32_t jitter(int32_t span) {
+  rng ^= rng << 13;
+  rng ^= rng >> 7;
+  rng ^= rng << 17;
+  return (int32_t)(rng % (2 * span + 1)) - span;
+}
+
+static void simulate(TelemetrySnapshot& snap, unsigned long ms) {
+  static int32_t offset = 0, jit = 0, drift = 12500, poll = 64, chip = 4150, rssi = -58, brightness = 8;
+  if (ms % (poll * 1000UL) == 0) {
+    offset = jitter(900);
+    jit = 200 + jitter(150);
+    drift += jitter(40);
+    if (poll < 1024) poll *= 2;
+  }
+  if (ms % 10000 == 0) {
+    chip += jitter(25);
+    rssi = -58 + jitter(3);
+  }
+  if (ms % 3600000 == 0) brightness = (brightness + 1) % 16;
+  snap.set(TM_SYNCED, 1);
+  snap.set(TM_OFFSET_US, offset);
+  snap.set(TM_JITTER_US, jit);
+  snap.set(TM_DRIFT_PPM, drift);
+  snap.set(TM_POLL_SEC, poll);
+  snap.set(TM_BRIGHTNESS, brightness);
+  snap.set(TM_CHIP_C, chip);
+  snap.set(TM_RSSI, rssi);
+}
+
+static double cpuNs() {
+  timespec ts;
+  clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+  return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+// --- Runs ---
+
+static void udpRun(uint32_t periodMs, uint8_t batch) {
+  static TelemetryBroadcast broadcast;
+  broadcast.begin(udpSink, 0xA1B2C3, TELEMETRY_KIND_CLOCK, periodMs, batch);
+  udpBytes = 0;
+  udpPackets = 0;
+  TelemetrySnapshot snap;
+  double cpu = 0;
+  uint32_t polls = 0;
+  for (unsigned long ms = SNAPSHOT_MS; ms <= SIM_SECONDS * 1000UL; ms += SNAPSHOT_MS) {
+    simulate(snap, ms);
+    double start = cpuNs();
+    broadcast.poll(snap, ms);
+    cpu += cpuNs() - start;
+    polls++;
+    if (polls % 64 == 0) drainUdp();
+  }
+  drainUdp();
+  printf("%8lu %6u %10.1f %12.2f %10.0f\n", (unsigned long)periodMs, batch, (double)udpBytes / SIM_SECONDS,
+         (double)udpPackets / SIM_SECONDS * 60, cpu / polls);
+}
+
+static bool sseRun(uint8_t count) {
+  static EventStream<SocketClient> stream;
+  SocketClient servers[TELEMETRY_SSE_MAX];
+  Browser browsers[TELEMETRY_SSE_MAX];
+  for (uint8_t i = 0; i < count; i++) {
+    browsers[i] = connectBrowser(servers[i]);
+    stream.add(servers[i], 0);
+  }
+
+  TelemetrySnapshot snap;
+  double cpu = 0;
+  uint32_t polls = 0;
+  uint32_t bytesBefore = stream.bytesSent();
+  for (unsigned long ms = SNAPSHOT_MS; ms <= SIM_SECONDS * 1000UL; ms += SNAPSHOT_MS) {
+    simulate(snap, ms);
+    double start = cpuNs();
+    stream.poll(snap, ms);
+    cpu += cpuNs() - start;
+    polls++;
+    for (uint8_t i = 0; i < count; i++) browsers[i].drain();
+  }
+
+  // Every browser must have ended up with the final value of every field
+  bool ok = stream.subscribers() == count;
+  char json[TELEMETRY_SSE_EVENT_MAX];
+  for (uint8_t f = 0; f < TELEMETRY_FIELD_COUNT; f++) {
+    if (!(snap.present & (1u << f))) continue;
+    telemetryJson(snap, 1u << f, json, sizeof(json));
+    std::string expect = strchr(json, ':') + 1;
+    expect.pop_back();
+    for (uint8_t i = 0; i < count; i++) ok = ok && browsers[i].fields[f] == expect;
+  }
+
+  uint64_t perBrowser = (stream.bytesSent() - bytesBefore) / count;
+  printf("%11u %10.1f %10u %14.0f %16.0f%s\n", count, (double)perBrowser / SIM_SECONDS, browsers[0].events,
+         cpu / polls, cpu / polls / count, ok ? "" : "  FAIL");
+
+  for (uint8_t i = 0; i < count; i++) close(browsers[i].fd);
+  stream.poll(snap, SIM_SECONDS * 1000UL + 1);
+  return ok;
+}
+
+int main() {
+  openSockets();
+  bool ok = true;
+
+  printf("UDP broadcast, one clock, %d s simulated\n", SIM_SECONDS);
+  printf("%8s %6s %10s %12s %10s\n", "period", "batch", "bytes/s", "packets/min", "ns/poll");
+  udpRun(1000, 1);
+  udpRun(1000, 10);
+  udpRun(1000, 32);
+  udpRun(250, 32);
+  udpRun(10000, 6);
+
+  printf("\nEvent stream, snapshots every %d ms\n", SNAPSHOT_MS);
+  printf("%11s %10s %10s %14s %16s\n", "subscribers", "bytes/s", "events", "ns/snapshot", "ns/subscriber");
+  for (uint8_t count = 1; count <= TELEMETRY_SSE_MAX; count *= 2) ok = sseRun(count) && ok;
+
+  printf("%s\n", ok ? "ok" : "FAILED");
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,134 @@
+#!/usr/bin/env python3
+"""
+Watch the UDP telemetry broadcast of every clock on the network.
+
+  telemetry_listen.py [--port 4210] [--log OUT.csv] [--raw]
+
+Clocks broadcast only once "Telemetry Broadcast" is set on their
+configuration page. Prints one line per device as its packets arrive, with
+the latest value of each field and lost packets counted from the sequence
+numbers. --log also appends every sample as CSV:
+time,device,ip,ms,field,value. --raw prints each packet's samples instead
+of the summary.
+
+Field names, widths and scales are read from live_telemetry.h (--header
+to point elsewhere), as the packets are decoded by field position.
+"""
+
+import argparse
+import os
+import re
+import socket
+import struct
+import time
+
+VERSION = 1
+TYPE_TELEMETRY = 0x54
+HEADER = struct.Struct("<BBBBIHI")
+SAMPLE = struct.Struct("<HH")
+KINDS = {1: "clock", 2: "chirp"}
+LIVE_TELEMETRY_H = os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", "live_telemetry.h")
+
+
+def load_fields(path):
+    """(name, bytes, scale) in TELEMETRY_FIELDS order."""
+    with open(path) as f:
+        return [(name, int(size), int(scale))
+                for _, name, size, scale in re.findall(r'X\((\w+),\s*"(\w+)",\s*(\d+),\s*(\d+)\)', f.read())]
+
+
+def decode(packet, fields):
+    """Yields (ms, {name: value}) for each sample; raises ValueError on a bad packet."""
+    if len(packet) < HEADER.size:
+        raise ValueError("short packet")
+    version, ptype, kind, count, device, seq, ms = HEADER.unpack_from(packet)
+    if version != VERSION or ptype != TYPE_TELEMETRY:
+        raise ValueError("not a telemetry packet")
+    samples = []
+    pos = HEADER.size
+    for _ in range(count):
+        dt, mask = SAMPLE.unpack_from(packet, pos)
+        pos += SAMPLE.size
+        ms = (ms + dt) & 0xFFFFFFFF
+        values = {}
+        for i, (name, size, scale) in enumerate(fields):
+            if not mask & (1 << i):
+                continue
+            if pos + size > len(packet):
+                raise ValueError("truncated sample")
+            value = int.from_bytes(packet[pos:pos + size], "little", signed=True)
+            pos += size
+            values[name] = value / scale if scale != 1 else value
+        samples.append((ms, values))
+    return kind, device, seq, samples
+
+
+class Device:
+    def __init__(self, kind, address):
+        self.kind = kind
+        self.address = address
+        self.values = {}
+        self.packets = 0
+        self.lost = 0
+        self.last_seq = None
+
+    def update(self, seq, samples):
+        if self.last_seq is not None:
+            self.lost += (seq - self.last_seq - 1) & 0xFFFF
+        self.last_seq = seq
+        self.packets += 1
+        for _, values in samples:
+            self.values.update(values)
+
+    def line(self, device):
+        fields = " ".join(f"{k}={v}" for k, v in self.values.items())
+        return (f"{device:06X} {KINDS.get(self.kind, self.kind):5} {self.address:15} "
+                f"pkts={self.packets} lost={self.lost} {fields}")
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--port", type=int, default=4210)
+    parser.add_argument("--header", default=LIVE_TELEMETRY_H, help="live_telemetry.h to take fields from")
+    parser.add_argument("--log", help="append samples to this CSV")
+    parser.add_argument("--raw", action="store_true")
+    args = parser.parse_args()
+
+    fields = load_fields(args.header)
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    sock.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+    sock.bind(("", args.port))
+    log = open(args.log, "a") if args.log else None
+    devices = {}
+    print(f"Listening on UDP {args.port} (Ctrl-C to stop)")
+
+    try:
+        while True:
+            packet, (address, _) = sock.recvfrom(2048)
+            try:
+                kind, device, seq, samples = decode(packet, fields)
+            except (ValueError, struct.error) as e:
+                print(f"{address}: {e}")
+                continue
+            entry = devices.setdefault(device, Device(kind, address))
+            entry.address = address
+            entry.update(seq, samples)
+            if log:
+                now = time.time()
+                for ms, values in samples:
+                    for name, value in values.items():
+                        log.write(f"{now:.3f},{device:06X},{address},{ms},{name},{value}\n")
+                log.flush()
+            if args.raw:
+                for ms, values in samples:
+                    print(f"{device:06X} {ms:>10} {values}")
+            else:
+                print(entry.line(device), flush=True)
+    except KeyboardInterrupt:
+        pass
+    if log:
+        log.close()
+
+
+if __name__ == "__main__":
+    main()
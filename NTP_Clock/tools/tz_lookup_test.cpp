@@ -0,0 +1,192 @@
+/*
+ * Timezone lookup test - TimezoneLookup against a stand-in ip-api.com
+ *
+ * Runs timezone_lookup.h on this machine with the mocks in mock/: its task
+ * is a thread, HTTPClient talks real TCP, and ip-api.com resolves to an
+ * HttpStandIn on loopback. Each case serves one response and checks what
+ * poll() reports, the error kept for the log, that start() returned at once
+ * whatever the server did, and that a bad server costs about one timeout:
+ *
+ *   answers         a shipped zone; an unknown zone by its offset, DST
+ *                   included in summer; extra and nested fields; a slow
+ *                   start and a trickled body
+ *   refusals        "status":"fail", HTTP 429 and 503, an HTML page
+ *   truncated       the body cut off inside a string, before the closing
+ *                   brace, and stalled with the connection left open
+ *   unreachable     headers later than the timeout, a refused connection,
+ *                   a name that doesn't resolve
+ *
+ * The lookup timeout is cut to TZ_LOOKUP_TIMEOUT_MS below to keep it quick,
+ * and the clock it reads the date from is mock/sys_clock.h's.
+ * Exits 1 if any check fails.
+ *
+ * Build and run from this directory:
+ *   g++ -std=gnu++17 -O2 -I.. -Imock tz_lookup_test.cpp -o tz_lookup_test -pthread
+ *   ./tz_lookup_test
+ */
+
+#define TZ_LOOKUP_TIMEOUT_MS 300
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+#include <thread>
+#include "sys_clock.h"   // Before timezone_lookup.h, which then reads the simulated clock
+#include "timezone_lookup.h"
+#include "http_standin.h"
+
+uint64_t mockBusNs = 0;
+
+#define START_LIMIT_MS  20      // start() must not wait on the network
+#define RESULT_LIMIT_MS 10000   // Past this the lookup is stuck; the test gives up
+
+static int failures = 0;
+static TimezoneLookup lookup;   // Outlives every worker thread
+static HttpStandIn server;
+
+typedef std::chrono::steady_clock Clock;
+
+static double msSince(Clock::time_point t) {
+  return std::chrono::duration<double, std::milli>(Clock::now() - t).count();
+}
+
+struct Outcome {
+  TimezoneLookup::Result result;
+  const TimeZone* zone;
+  int error;
+  double startMs;   // In start()
+  double tookMs;    // Until poll() reported
+};
+
+// start(), then poll() every millisecond as loop() would
+static Outcome runLookup() {
+  Outcome o = {TimezoneLookup::LOOKUP_NONE, nullptr, 0, 0, 0};
+  Clock::time_point t0 = Clock::now();
+  if (!lookup.start()) {
+    printf("  FAIL start() refused with nothing running\n");
+    exit(1);
+  }
+  o.startMs = msSince(t0);
+  if (lookup.start()) {
+    printf("  FAIL start() accepted a second lookup while one was running\n");
+    exit(1);
+  }
+  while ((o.result = lookup.poll(&o.zone)) == TimezoneLookup::LOOKUP_NONE) {
+    if (msSince(t0) > RESULT_LIMIT_MS) {
+      printf("  FAIL lookup still running after %d ms\n", RESULT_LIMIT_MS);
+      exit(1);
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  o.tookMs = msSince(t0);
+  o.error = lookup.lastError();
+
+  const TimeZone* again = nullptr;
+  if (lookup.poll(&again) != TimezoneLookup::LOOKUP_NONE) {
+    printf("  FAIL poll() reported the same lookup twice\n");
+    exit(1);
+  }
+  return o;
+}
+
+static void check(const char* name, const Outcome& o, bool ok, double limitMs) {
+  ok = ok && o.startMs < START_LIMIT_MS && o.tookMs < limitMs;
+  printf("  %-4s %-22s %-6s %-20s error %4d  start %5.2f ms  took %4.0f ms\n", ok ? "ok" : "FAIL", name,
+         o.result == TimezoneLookup::LOOKUP_OK ? "OK" : "FAILED", o.zone != nullptr ? o.zone->name : "-",
+         o.error, o.startMs, o.tookMs);
+  if (!ok) failures++;
+}
+
+static void expectZone(const char* name, const HttpStandIn::Response& r, const char* zone, double limitMs) {
+  server.serve(r);
+  Outcome o = runLookup();
+  check(name, o, o.result == TimezoneLookup::LOOKUP_OK && o.zone == findTimeZone(zone), limitMs);
+}
+
+// Failed, with this HTTP status or (negative) HTTPClient error
+static void expectFailure(const char* name, const HttpStandIn::Response& r, int error, double limitMs) {
+  server.serve(r);
+  Outcome o = runLookup();
+  check(name, o, o.result == TimezoneLookup::LOOKUP_FAILED && o.error == error, limitMs);
+}
+
+// The date the lookup sees, at noon UTC
+static void setDate(int32_t year, uint32_t month, uint32_t day) {
+  mockClock.reset();
+  int64_t utc = (int64_t)daysFromCivil(year, month, day) * 86400 + 12 * 3600;
+  mockClock.errorNs = (double)(utc - (int64_t)MOCK_EPOCH_S) * 1e9;
+}
+
+static HttpStandIn::Response body(const char* json) {
+  HttpStandIn::Response r;
+  r.body = json;
+  return r;
+}
+
+int main() {
+  if (!server.open()) {
+    fprintf(stderr, "can't listen on port %d\n", 80 + mockPortShift);
+    return 2;
+  }
+  WiFi.addHost("ip-api.com", IPAddress(127, 0, 0, 1));
+  const double quick = 2 * TZ_LOOKUP_TIMEOUT_MS;      // A bad answer still ends about at once
+  const double oneWait = 4 * TZ_LOOKUP_TIMEOUT_MS;    // Waiting out one timeout
+
+  printf("TimezoneLookup against a stand-in server (timeout %d ms):\n", TZ_LOOKUP_TIMEOUT_MS);
+
+  expectZone("shipped zone", body("{\"status\":\"success\",\"timezone\":\"Europe/London\",\"offset\":3600}"),
+             "Europe/London", quick);
+  expectZone("zone by offset", body("{\"status\":\"success\",\"timezone\":\"Asia/Colombo\",\"offset\":19800}"),
+             "Asia/Kolkata", quick);
+  // ip-api's offset includes DST: Paris is 7200 in July, as Berlin is then
+  setDate(2026, 7, 15);
+  expectZone("summer offset", body("{\"status\":\"success\",\"timezone\":\"Europe/Paris\",\"offset\":7200}"),
+             "Europe/Berlin", quick);
+  expectZone("summer offset, GMT", body("{\"status\":\"success\",\"timezone\":\"Europe/Dublin\",\"offset\":3600}"),
+             "Europe/London", quick);
+  setDate(2026, 1, 15);
+  expectZone("winter offset", body("{\"status\":\"success\",\"timezone\":\"Europe/Paris\",\"offset\":3600}"),
+             "Europe/Berlin", quick);
+  mockClock.errorNs = -(double)MOCK_EPOCH_S * 1e9;   // Not set yet: 1970
+  expectZone("offset, clock unset", body("{\"status\":\"success\",\"timezone\":\"Europe/Paris\",\"offset\":3600}"),
+             "Europe/Berlin", quick);
+  expectZone("extra fields", body("{ \"query\": \"203.0.113.9\", \"as\": {\"asn\": [1, {\"x\": \"}\"}]},\n"
+                                  "  \"status\": \"success\", \"timezone\": \"America/New_York\", \"offset\": -14400 }"),
+             "America/New_York", quick);
+  HttpStandIn::Response slow = body("{\"status\":\"success\",\"timezone\":\"Asia/Tokyo\",\"offset\":32400}");
+  slow.headerDelayMs = TZ_LOOKUP_TIMEOUT_MS * 2 / 3;
+  slow.byteGapMs = 5;
+  expectZone("slow but in time", slow, "Asia/Tokyo", oneWait);
+
+  expectFailure("unknown zone, offset", body("{\"status\":\"success\",\"timezone\":\"Asia/Kathmandu\",\"offset\":20700}"),
+                200, quick);
+  expectFailure("status fail", body("{\"status\":\"fail\",\"message\":\"reserved range\"}"), 200, quick);
+  HttpStandIn::Response limited = body("{\"status\":\"fail\",\"message\":\"rate limited\"}");
+  limited.status = 429;
+  expectFailure("HTTP 429", limited, 429, quick);
+  HttpStandIn::Response down = body("<html>Service Unavailable</html>");
+  down.status = 503;
+  expectFailure("HTTP 503", down, 503, quick);
+  expectFailure("HTML with 200", body("<html><body>Captive portal</body></html>"), 200, quick);
+
+  HttpStandIn::Response cut = body("{\"status\":\"success\",\"timezone\":\"Europe/London\",\"offset\":3600}");
+  cut.cutAfter = 40;   // Inside "Europe/London"
+  expectFailure("cut inside a string", cut, 200, quick);
+  expectFailure("no closing brace", body("{\"status\":\"success\",\"timezone\":\"Europe/London\",\"offset\":3600"),
+                200, quick);
+  HttpStandIn::Response stalled = body("{\"status\":\"success\",\"timezone\":\"Europe/London\",\"offset\":3600}");
+  stalled.stallAfter = 25;
+  expectFailure("stalled body", stalled, 200, oneWait);
+
+  HttpStandIn::Response late = body("{\"status\":\"success\",\"timezone\":\"Europe/London\",\"offset\":3600}");
+  late.headerDelayMs = TZ_LOOKUP_TIMEOUT_MS * 2;
+  expectFailure("headers too late", late, HTTPC_ERROR_READ_TIMEOUT, oneWait);
+  WiFi.addHost("ip-api.com", IPAddress(127, 0, 0, 9));   // Nothing listening there
+  expectFailure("connection refused", late, HTTPC_ERROR_CONNECTION_REFUSED, quick);
+  WiFi.clearHosts();
+  expectFailure("no DNS", late, HTTPC_ERROR_CONNECTION_REFUSED, quick);
+
+  printf("%d requests served\n%s\n", server.requests.load(), failures ? "FAILED" : "ok");
+  return failures ? 1 : 0;
+}
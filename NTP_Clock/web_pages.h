@@ -3,118 +3,107 @@
 
 #include <Preferences.h>
 #include <WiFi.h>
+#include "sntp_client.h"
+#include "timezones.h"
+#include "config_page.h"
+#include "page_buffer.h"
+#include "ota_update.h"
+#include "wifi_scan_cache.h"
 
-String getConfigPageHTML(Preferences& prefs) {
+typedef PageBuffer<WEB_PAGE_BUFFER_SIZE> WebPage;
+
+// Every page renders here. The web server handles one request at a time on
+// the loop task, so one static buffer serves them all without the heap.
+WebPage webPage;
+
+// Preferences string into out, or fallback if the key isn't set
+void loadPrefString(Preferences& prefs, const char* key, char* out, size_t size, const char* fallback) {
+  snprintf(out, size, "%s", fallback);
+  if (prefs.isKey(key)) prefs.getString(key, out, size);
+}
+
+void formatIP(const IPAddress& ip, char* out, size_t size) {
+  snprintf(out, size, "%u.%u.%u.%u", ip[0], ip[1], ip[2], ip[3]);
+}
+
+const WebPage& getConfigPageHTML(Preferences& prefs, WifiScanCache& networks) {
   // Load saved WiFi credentials
-  String savedSSID = "";
-  String savedPassword = "";
+  char savedSSID[33];
+  char savedPassword[65];
   prefs.begin("wifi_config", true);
-  savedSSID = prefs.getString("ssid", "");
-  savedPassword = prefs.getString("password", "");
+  loadPrefString(prefs, "ssid", savedSSID, sizeof(savedSSID), "");
+  loadPrefString(prefs, "password", savedPassword, sizeof(savedPassword), "");
   prefs.end();
-  
+
   // Load saved preferences
-  long savedTimezone = -28800;
-  int savedDSTOffset = 0;
-  int savedBrightness = 8;
-  bool saved24Hour = true;
+  char savedTimezone[48];
+  char savedNtpServers[SNTP_SERVERS_MAX_LEN];
   prefs.begin("ntp_clock", true);
-  savedTimezone = prefs.getLong("timezone", -28800);
-  savedDSTOffset = prefs.getInt("dst_offset", 0);
-  savedBrightness = prefs.getInt("brightness", 8);
-  saved24Hour = prefs.getBool("24hour", true);
+  loadPrefString(prefs, "tz_name", savedTimezone, sizeof(savedTimezone), TIMEZONE_DEFAULT->name);
+  int savedBrightness = prefs.getInt("brightness", 8);
+  bool saved24Hour = prefs.getBool("24hour", true);
+  loadPrefString(prefs, "ntp_servers", savedNtpServers, sizeof(savedNtpServers), SNTP_DEFAULT_SERVERS);
+  unsigned long savedTelemetryPeriod = prefs.getUInt("tm_period", TELEMETRY_DEFAULT_PERIOD_MS);
+  unsigned savedTelemetryBatch = prefs.getUInt("tm_batch", TELEMETRY_DEFAULT_BATCH);
   prefs.end();
-  
-  String html = "<!DOCTYPE html><html><head>";
-  html += "<meta name='viewport' content='width=device-width, initial-scale=1'>";
-  html += "<meta charset='UTF-8'>";
-  html += "<title>NTP Clock Configuration</title>";
-  html += "<style>";
-  html += "body{font-family:Arial,sans-serif;max-width:600px;margin:20px auto;padding:20px;background:#f5f5f5;}";
-  html += "h1{color:#333;margin-bottom:20px;}";
-  html += ".form-group{margin-bottom:15px;}";
-  html += "label{display:block;margin-bottom:5px;font-weight:bold;color:#555;}";
-  html += "input,select{width:100%;padding:8px;box-sizing:border-box;border:1px solid #ddd;border-radius:4px;font-size:14px;}";
-  html += "input:focus,select:focus{outline:none;border-color:#4CAF50;}";
-  html += "button{background:#4CAF50;color:white;padding:10px 20px;border:none;border-radius:4px;cursor:pointer;font-size:16px;width:100%;margin-top:10px;}";
-  html += "button:hover{background:#45a049;}";
-  html += ".reset-btn{background:#f44336;margin-top:20px;}";
-  html += ".reset-btn:hover{background:#da190b;}";
-  html += ".note{margin-top:20px;padding:10px;background:#fff3cd;border-left:4px solid #ffc107;border-radius:4px;}";
-  html += ".info{margin-top:15px;padding:10px;background:#e3f2fd;border-left:4px solid #2196F3;border-radius:4px;font-size:0.9em;}";
-  html += "</style></head><body>";
-  html += "<h1>NTP Clock Configuration</h1>";
-  html += "<form method='POST' action='/save'>";
-  html += "<div class='form-group'><label>WiFi SSID:</label>";
-  html += "<input type='text' name='ssid' value='" + savedSSID + "' required></div>";
-  html += "<div class='form-group'><label>WiFi Password:</label>";
-  html += "<input type='password' name='password' value='" + savedPassword + "' placeholder='Leave blank to keep current password'></div>";
-  html += "<div class='form-group'><label>Timezone:</label>";
-  html += "<select name='timezone' required>";
-  html += "<option value='-28800'" + String(savedTimezone == -28800 ? " selected" : "") + ">Pacific Time (PT) - UTC-8 (PST/PDT with DST)</option>";
-  html += "<option value='-21600'" + String(savedTimezone == -21600 ? " selected" : "") + ">Mountain Time (MT) - UTC-7 (MST/MDT with DST)</option>";
-  html += "<option value='-18000'" + String(savedTimezone == -18000 ? " selected" : "") + ">Central Time (CT) - UTC-6 (CST/CDT with DST)</option>";
-  html += "<option value='-14400'" + String(savedTimezone == -14400 ? " selected" : "") + ">Eastern Time (ET) - UTC-5 (EST/EDT with DST)</option>";
-  html += "<option value='0'" + String(savedTimezone == 0 ? " selected" : "") + ">UTC (Coordinated Universal Time)</option>";
-  html += "<option value='3600'" + String(savedTimezone == 3600 ? " selected" : "") + ">Central European Time (CET) - UTC+1</option>";
-  html += "<option value='7200'" + String(savedTimezone == 7200 ? " selected" : "") + ">Central European Summer Time (CEST) - UTC+2</option>";
-  html += "<option value='28800'" + String(savedTimezone == 28800 ? " selected" : "") + ">China Standard Time (CST) - UTC+8</option>";
-  html += "<option value='32400'" + String(savedTimezone == 32400 ? " selected" : "") + ">Japan Standard Time (JST) - UTC+9</option>";
-  html += "<option value='36000'" + String(savedTimezone == 36000 ? " selected" : "") + ">Australian Eastern Standard Time (AEST) - UTC+10</option>";
-  html += "</select></div>";
-  html += "<div class='form-group'><label>Daylight Saving Offset (seconds):</label>";
-  html += "<input type='number' name='dst_offset' value='" + String(savedDSTOffset) + "'>";
-  html += "<small style='display:block;color:#666;margin-top:5px;'>Usually 0 (DST handled automatically) or 3600 (1 hour)</small></div>";
-  html += "<div class='form-group'><label>Brightness (0-15):</label>";
-  html += "<input type='number' name='brightness' min='0' max='15' value='" + String(savedBrightness) + "'></div>";
-  html += "<div class='form-group'><label>Hour Format:</label>";
-  html += "<select name='hour_format'>";
-  html += "<option value='24'" + String(saved24Hour ? " selected" : "") + ">24-hour</option>";
-  html += "<option value='12'" + String(saved24Hour ? "" : " selected") + ">12-hour</option>";
-  html += "</select></div>";
-  html += "<button type='submit'>Save and Restart</button>";
-  html += "</form>";
-  html += "<form method='POST' action='/factory-reset'>";
-  html += "<button type='submit' class='reset-btn'>Factory Reset</button>";
-  html += "</form>";
-  html += "<div class='note'><strong>Note:</strong> After saving, the device will restart and connect to WiFi.</div>";
-  html += "<div class='info'><strong>Current IP:</strong> " + WiFi.localIP().toString() + " (if connected) or " + WiFi.softAPIP().toString() + " (AP mode)</div>";
-  html += "</body></html>";
-  return html;
+
+  char stationIP[16];
+  char apIP[16];
+  formatIP(WiFi.localIP(), stationIP, sizeof(stationIP));
+  formatIP(WiFi.softAPIP(), apIP, sizeof(apIP));
+
+  // Suggest networks from the last background scan; asking keeps the list fresh
+  networks.keepFresh();
+  const char* ssids[WIFI_SCAN_MAX];
+  for (uint8_t i = 0; i < networks.count(); i++) ssids[i] = networks.get(i).ssid;
+
+  ConfigPageData data;
+  data.ssid = savedSSID;
+  data.password = savedPassword;
+  data.timezone = savedTimezone;
+  data.ntpServers = savedNtpServers;
+  data.brightness = savedBrightness;
+  data.use24Hour = saved24Hour;
+  data.stationIP = stationIP;
+  data.apIP = apIP;
+  data.networks = ssids;
+  data.networkCount = networks.count();
+  data.telemetryPeriodMs = savedTelemetryPeriod;
+  data.telemetryBatch = savedTelemetryBatch;
+
+  webPage.clear();
+  renderConfigPage(webPage, data);
+  return webPage;
 }
 
-String getSaveSuccessPageHTML() {
-  String html = "<!DOCTYPE html><html><head>";
-  html += "<meta name='viewport' content='width=device-width, initial-scale=1'>";
-  html += "<meta charset='UTF-8'>";
-  html += "<title>Settings Saved</title>";
-  html += "<style>";
-  html += "body{font-family:Arial,sans-serif;max-width:600px;margin:20px auto;padding:20px;text-align:center;}";
-  html += "h1{color:#4CAF50;}";
-  html += "p{margin-top:20px;color:#666;}";
-  html += "</style></head><body>";
-  html += "<h1>Settings Saved!</h1>";
-  html += "<p>The device is restarting and will connect to WiFi.</p>";
-  html += "<p>You will be redirected to the configuration page shortly.</p>";
-  html += "</body></html>";
-  return html;
+const WebPage& getSaveSuccessPageHTML() {
+  webPage.clear();
+  renderSaveSuccessPage(webPage);
+  return webPage;
 }
 
-String getFactoryResetPageHTML() {
-  String html = "<!DOCTYPE html><html><head>";
-  html += "<meta name='viewport' content='width=device-width, initial-scale=1'>";
-  html += "<meta charset='UTF-8'>";
-  html += "<title>Factory Reset</title>";
-  html += "<style>";
-  html += "body{font-family:Arial,sans-serif;max-width:600px;margin:20px auto;padding:20px;text-align:center;}";
-  html += "h1{color:#f44336;}";
-  html += "p{margin-top:20px;color:#666;}";
-  html += "</style></head><body>";
-  html += "<h1>Factory Reset Complete</h1>";
-  html += "<p>All settings have been cleared. The device is restarting.</p>";
-  html += "<p>The device will start in AP mode. Connect to the access point and configure at 192.168.4.1</p>";
-  html += "</body></html>";
-  return html;
+const WebPage& getFactoryResetPageHTML() {
+  webPage.clear();
+  renderFactoryResetPage(webPage);
+  return webPage;
+}
+
+const WebPage& getUpdatePageHTML(const char* pullUrl, const OtaUpdate& ota) {
+  UpdatePageData data;
+  data.pullUrl = pullUrl;
+  data.running = ota.isRunning();
+  data.succeeded = ota.succeeded();
+  data.source = ota.source();
+  data.error = ota.error();
+  data.bytesIn = ota.bytesIn();
+  data.bytesTotal = ota.bytesTotal();
+  data.bytesWritten = ota.bytesWritten();
+  data.compressed = ota.isCompressed();
+  data.resumes = ota.resumeCount();
+
+  webPage.clear();
+  renderUpdatePage(webPage, data, FIRMWARE_VERSION);
+  return webPage;
 }
 
 #endif // WEB_PAGES_H
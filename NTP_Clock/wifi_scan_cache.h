@@ -0,0 +1,153 @@
+/*
+ * WifiScanCache - Background WiFi scans merged into a small sorted list
+ *
+ * Scans run asynchronously (WiFi.scanNetworks(true)) and poll() folds each
+ * finished one into the cache instead of replacing it: a network's RSSI is
+ * updated when it is seen again, and it is only dropped after missing
+ * WIFI_SCAN_MAX_MISSED scans in a row, so one short scan doesn't empty the
+ * list. Entries are kept sorted strongest first and deduplicated by SSID, so
+ * Improv and the config page can list them without waiting for the radio.
+ *
+ * Scans only repeat while someone is using the list (keepFresh()), so an
+ * unattended clock doesn't keep hopping channels.
+ */
+
+#ifndef WIFI_SCAN_CACHE_H
+#define WIFI_SCAN_CACHE_H
+
+#include <WiFi.h>
+#include <string.h>
+
+#define WIFI_SCAN_MAX          16
+#define WIFI_SCAN_MAX_MISSED   3        // Scans a network can be absent from before it's dropped
+#define WIFI_SCAN_INTERVAL_MS  30000UL  // Refresh this often while the list is in use
+#define WIFI_SCAN_INTEREST_MS  120000UL // keepFresh() keeps scans going for this long
+
+struct WifiNetwork {
+  char ssid[33];
+  int8_t rssi;
+  bool secure;
+  uint8_t missed;   // Consecutive scans it wasn't in
+};
+
+class WifiScanCache {
+public:
+  WifiScanCache() : networkCount(0), scanning(false), scans(0), lastScanAt(0), wantedUntil(0) {}
+
+  // Starts a background scan unless one is running
+  bool refresh() {
+    if (scanning) return true;
+    if (WiFi.scanNetworks(true) != WIFI_SCAN_RUNNING) return false;
+    scanning = true;
+    return true;
+  }
+
+  // Someone is looking at the list: scan now if it's stale, and keep it fresh for a while
+  void keepFresh() {
+    wantedUntil = millis() + WIFI_SCAN_INTEREST_MS;
+    if (scans == 0 || millis() - lastScanAt >= WIFI_SCAN_INTERVAL_MS) refresh();
+  }
+
+  // Call from loop(). Collects a finished scan; starts the next one when the
+  // list is in use and stale, if allowScan (scanning upsets a connection attempt).
+  // Returns true when the list has just been updated.
+  bool poll(bool allowScan = true) {
+    unsigned long now = millis();
+    if (scanning) {
+      int16_t found = WiFi.scanComplete();
+      if (found == WIFI_SCAN_RUNNING) return false;
+      scanning = false;
+      scans++;
+      lastScanAt = now;
+      if (found < 0) return true;   // Failed; the old list stands
+
+      beginMerge();
+      for (int16_t i = 0; i < found; i++) {
+        merge(WiFi.SSID(i).c_str(), (int8_t)WiFi.RSSI(i), WiFi.encryptionType(i) != WIFI_AUTH_OPEN);
+      }
+      endMerge();
+      WiFi.scanDelete();
+      return true;
+    }
+
+    if (allowScan && (long)(wantedUntil - now) > 0 && now - lastScanAt >= WIFI_SCAN_INTERVAL_MS) {
+      refresh();
+    }
+    return false;
+  }
+
+  uint8_t count() const { return networkCount; }
+  const WifiNetwork& get(uint8_t i) const { return networks[i]; }
+  bool isScanning() const { return scanning; }
+  uint32_t scanCount() const { return scans; }   // Finished scans, including failed ones
+
+  // --- Merging, separate from the radio so it can run on its own ---
+
+  void beginMerge() {
+    for (uint8_t i = 0; i < networkCount; i++) seen[i] = false;
+  }
+
+  void merge(const char* ssid, int8_t rssi, bool secure) {
+    if (ssid == nullptr || ssid[0] == '\0') return;   // Hidden network
+
+    for (uint8_t i = 0; i < networkCount; i++) {
+      if (strcmp(networks[i].ssid, ssid) != 0) continue;
+      // Several access points with one SSID show as the strongest of them
+      if (!seen[i] || rssi > networks[i].rssi) networks[i].rssi = rssi;
+      networks[i].secure = secure;
+      networks[i].missed = 0;
+      seen[i] = true;
+      return;
+    }
+
+    uint8_t slot = networkCount;
+    if (networkCount == WIFI_SCAN_MAX) {
+      // Full: replace the weakest entry if this one is stronger
+      slot = 0;
+      for (uint8_t i = 1; i < networkCount; i++) {
+        if (networks[i].rssi < networks[slot].rssi) slot = i;
+      }
+      if (networks[slot].rssi >= rssi) return;
+    } else {
+      networkCount++;
+    }
+    strncpy(networks[slot].ssid, ssid, sizeof(networks[slot].ssid) - 1);
+    networks[slot].ssid[sizeof(networks[slot].ssid) - 1] = '\0';
+    networks[slot].rssi = rssi;
+    networks[slot].secure = secure;
+    networks[slot].missed = 0;
+    seen[slot] = true;
+  }
+
+  void endMerge() {
+    // Age out networks that keep not showing up
+    uint8_t kept = 0;
+    for (uint8_t i = 0; i < networkCount; i++) {
+      if (!seen[i] && ++networks[i].missed > WIFI_SCAN_MAX_MISSED) continue;
+      networks[kept++] = networks[i];
+    }
+    networkCount = kept;
+
+    // Strongest first; insertion sort, the list is short and mostly in order already
+    for (uint8_t i = 1; i < networkCount; i++) {
+      WifiNetwork n = networks[i];
+      int j = i - 1;
+      while (j >= 0 && networks[j].rssi < n.rssi) {
+        networks[j + 1] = networks[j];
+        j--;
+      }
+      networks[j + 1] = n;
+    }
+  }
+
+private:
+  WifiNetwork networks[WIFI_SCAN_MAX];
+  bool seen[WIFI_SCAN_MAX];
+  uint8_t networkCount;
+  bool scanning;
+  uint32_t scans;
+  unsigned long lastScanAt;
+  unsigned long wantedUntil;
+};
+
+#endif // WIFI_SCAN_CACHE_H
@@ -0,0 +1,100 @@
+/*
+ * Chirp logic - Band tracking and settings rules for temp_chirp
+ *
+ * The decisions the sketch makes (which band a reading is in, whether to
+ * chirp, how the buttons change settings, what the display shows) with none
+ * of the hardware: the sketch owns tone(), the display and Preferences.
+ *
+ * Pure C++ - no Arduino dependencies, so it builds on the host too.
+ */
+
+#ifndef CHIRP_LOGIC_H
+#define CHIRP_LOGIC_H
+
+#include <stdint.h>
+#include <math.h>
+
+#define THRESHOLD_DEFAULT   170.0f
+#define THRESHOLD_MIN       0.0f
+#define THRESHOLD_MAX       500.0f
+#define THRESHOLD_INCREMENT 0.5f
+
+#define STEP_DEFAULT        0.5f
+#define STEP_MIN            0.1f
+#define STEP_MAX            10.0f
+#define STEP_INCREMENT      0.1f
+
+#define DISPLAY_MAX         999.9f   // 4 digits, one decimal
+#define DISPLAY_MIN         -99.9f   // Leaves a digit for the minus sign
+
+enum ChirpEvent { CHIRP_NONE, CHIRP_UP, CHIRP_DOWN };
+
+// Step-sized band above the threshold a reading falls in; -1 = below threshold
+inline int bandForTemp(float temp, float threshold, float step) {
+  if (temp < threshold) return -1;
+  return (int)((temp - threshold) / step);
+}
+
+// Degrees to the nearest boundary bandForTemp() would change at
+inline float bandEdgeDistance(float temp, float threshold, float step) {
+  if (temp < threshold) return threshold - temp;
+  float into = fmodf(temp - threshold, step);
+  return into < step - into ? into : step - into;
+}
+
+// At or above the threshold, or less than a step below it: where SamplePacer
+// holds its minimum interval
+inline bool nearBands(float temp, float threshold, float step) {
+  return temp > threshold - step;
+}
+
+// Chirps once per band crossed: a rising tone when moving into a higher band,
+// a falling one when dropping to a lower band that's still above threshold.
+// Falling below the threshold is silent.
+class ChirpBands {
+public:
+  ChirpBands() : lastBand(-1) {}
+
+  ChirpEvent update(float temp, float threshold, float step) {
+    int band = bandForTemp(temp, threshold, step);
+    if (band == lastBand) return CHIRP_NONE;
+
+    ChirpEvent event = CHIRP_NONE;
+    if (band > lastBand) event = CHIRP_UP;
+    else if (band >= 0) event = CHIRP_DOWN;
+    lastBand = band;
+    return event;
+  }
+
+  int band() const { return lastBand; }
+
+private:
+  int lastBand;
+};
+
+// --- Settings, as changed by the up/down buttons ---
+
+inline float adjustThreshold(float threshold, bool up) {
+  threshold += up ? THRESHOLD_INCREMENT : -THRESHOLD_INCREMENT;
+  if (threshold < THRESHOLD_MIN) threshold = THRESHOLD_MIN;
+  if (threshold > THRESHOLD_MAX) threshold = THRESHOLD_MAX;
+  return threshold;
+}
+
+inline float adjustStep(float step, bool up) {
+  step += up ? STEP_INCREMENT : -STEP_INCREMENT;
+  if (step < STEP_MIN) step = STEP_MIN;
+  if (step > STEP_MAX) step = STEP_MAX;
+  return step;
+}
+
+// --- Display ---
+
+// Reading in tenths of a degree for displayFixed(), clamped to what fits
+inline int32_t displayTenths(float value) {
+  if (value > DISPLAY_MAX) value = DISPLAY_MAX;
+  if (value < DISPLAY_MIN) value = DISPLAY_MIN;
+  return (int32_t)lroundf(value * 10.0f);
+}
+
+#endif // CHIRP_LOGIC_H
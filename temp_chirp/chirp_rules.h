@@ -0,0 +1,474 @@
+/*
+ * Chirp rules - Table-driven alarms for temp_chirp
+ *
+ * A small table of rules per probe (or for every probe) replaces the single
+ * threshold/step pair:
+ *
+ *   bands FROM STEP    chirp per STEP-wide band crossed above FROM (as before)
+ *   below LEVEL        long tone when the reading falls below LEVEL
+ *   above LEVEL        alarm when it rises above LEVEL
+ *   rate LIMIT         alarm when it rises faster than LIMIT degrees/minute
+ *   silence LOW HIGH   nothing sounds while the reading is in [LOW, HIGH)
+ *
+ * AlarmRule is 6 bytes with temperatures in tenths of a degree, so the whole
+ * table goes to NVS as one blob. RuleEngine compiles a probe's rules into a
+ * sorted list of edges (levels, their re-arm points, silence bounds); each
+ * sample then finds its place with a binary search and only looks at the
+ * edges crossed since the last one, however long the table is. Levels re-arm
+ * only once the reading has moved back RULE_HYSTERESIS past them, so noise
+ * around a level sounds once.
+ *
+ * Pure C++ - no Arduino dependencies, so it builds on the host too.
+ */
+
+#ifndef CHIRP_RULES_H
+#define CHIRP_RULES_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "chirp_logic.h"
+
+#define RULES_MAX             16
+#define RULES_BLOB_VERSION    1
+#define RULE_ALL_CHANNELS     0xFF
+#define RULE_HYSTERESIS       2       // Tenths of a degree back past a level before it re-arms
+#define RULE_RATE_SLOTS       12      // Rate history: one reading per slot...
+#define RULE_RATE_SLOT_MS     5000    // ...so rates are measured over the last minute
+#define RULE_RATE_REARM_PCT   80      // Rate alarm re-arms below this share of its limit
+
+#define RULE_TEMP_MIN         ((int16_t)(THRESHOLD_MIN * 10))
+#define RULE_TEMP_MAX         ((int16_t)(THRESHOLD_MAX * 10))
+#define RULE_TEMP_INCREMENT   ((int16_t)(THRESHOLD_INCREMENT * 10))
+#define RULE_STEP_MIN         ((int16_t)(STEP_MIN * 10))
+#define RULE_STEP_MAX         ((int16_t)(STEP_MAX * 10))
+#define RULE_RATE_MIN         1       // 0.1 degrees/minute
+#define RULE_RATE_MAX         500
+
+enum RuleKind : uint8_t {
+  RULE_BANDS = 1,     // a = from, b = step
+  RULE_BELOW = 2,     // a = level
+  RULE_ABOVE = 3,     // a = level
+  RULE_RATE = 4,      // a = limit, tenths of a degree per minute
+  RULE_SILENCE = 5,   // a = low, b = high
+};
+
+struct AlarmRule {
+  uint8_t kind;
+  uint8_t channel;   // Probe index, or RULE_ALL_CHANNELS
+  int16_t a;
+  int16_t b;
+};
+
+inline const char* ruleKindName(uint8_t kind) {
+  switch (kind) {
+    case RULE_BANDS: return "bands";
+    case RULE_BELOW: return "below";
+    case RULE_ABOVE: return "above";
+    case RULE_RATE: return "rate";
+    case RULE_SILENCE: return "silence";
+    default: return "?";
+  }
+}
+
+// Number of values a rule kind takes (a, or a and b)
+inline uint8_t ruleArity(uint8_t kind) {
+  return (kind == RULE_BANDS || kind == RULE_SILENCE) ? 2 : 1;
+}
+
+inline bool ruleValid(const AlarmRule& r) {
+  switch (r.kind) {
+    case RULE_BANDS: return r.b >= RULE_STEP_MIN && r.b <= RULE_STEP_MAX;
+    case RULE_BELOW: case RULE_ABOVE: return true;
+    case RULE_RATE: return r.a >= RULE_RATE_MIN && r.a <= RULE_RATE_MAX;
+    case RULE_SILENCE: return r.a < r.b;
+    default: return false;
+  }
+}
+
+// --- Text form, for the serial console ---
+
+inline bool parseTenths(const char* text, int16_t& out) {
+  char* end;
+  double v = strtod(text, &end);
+  if (end == text || fabs(v) > 3000.0) return false;
+  out = (int16_t)lround(v * 10.0);
+  return true;
+}
+
+// "CH KIND VALUE [VALUE]", CH a probe number from 1 to channels or "*" for
+// all of them. On failure, error (when given) says what was wrong.
+inline bool parseRule(const char* text, AlarmRule& rule, uint8_t channels, const char** error = nullptr) {
+  const char* ignored;
+  if (error == nullptr) error = &ignored;
+  char ch[8], kind[12], a[16], b[16];
+  int n = sscanf(text, "%7s %11s %15s %15s", ch, kind, a, b);
+  *error = "expected CH KIND VALUE [VALUE]";
+  if (n < 3) return false;
+
+  if (!strcmp(ch, "*")) {
+    rule.channel = RULE_ALL_CHANNELS;
+  } else {
+    int c = atoi(ch);
+    if (c < 1 || c > channels) {
+      *error = "no such probe";
+      return false;
+    }
+    rule.channel = (uint8_t)(c - 1);
+  }
+  rule.kind = 0;
+  for (uint8_t k = RULE_BANDS; k <= RULE_SILENCE; k++) {
+    if (!strcmp(kind, ruleKindName(k))) rule.kind = k;
+  }
+  *error = "unknown kind";
+  if (rule.kind == 0) return false;
+  *error = "wrong number of values";
+  if (n != 2 + ruleArity(rule.kind)) return false;
+  rule.b = 0;
+  *error = "value out of range";
+  if (!parseTenths(a, rule.a)) return false;
+  if (ruleArity(rule.kind) == 2 && !parseTenths(b, rule.b)) return false;
+  return ruleValid(rule);
+}
+
+inline int formatRule(const AlarmRule& r, char* out, size_t size) {
+  char ch[4];
+  if (r.channel == RULE_ALL_CHANNELS) strcpy(ch, "*");
+  else snprintf(ch, sizeof(ch), "%u", r.channel + 1);
+  if (ruleArity(r.kind) == 2) {
+    return snprintf(out, size, "%s %s %.1f %.1f", ch, ruleKindName(r.kind), r.a / 10.0, r.b / 10.0);
+  }
+  return snprintf(out, size, "%s %s %.1f", ch, ruleKindName(r.kind), r.a / 10.0);
+}
+
+// --- The table ---
+
+class RuleTable {
+public:
+  RuleTable() : count(0), generation(0) {}
+
+  // One bands rule per probe, the old threshold/step pair
+  void setBands(uint8_t channel, float threshold, float step) {
+    AlarmRule r = {RULE_BANDS, channel, (int16_t)lroundf(threshold * 10.0f), (int16_t)lroundf(step * 10.0f)};
+    add(r);
+  }
+
+  // A bands rule replaces the probe's existing one; others are added
+  bool add(const AlarmRule& rule) {
+    if (!ruleValid(rule)) return false;
+    if (rule.kind == RULE_BANDS) {
+      for (uint8_t i = 0; i < count; i++) {
+        if (rules[i].kind == RULE_BANDS && rules[i].channel == rule.channel) {
+          rules[i] = rule;
+          generation++;
+          return true;
+        }
+      }
+    }
+    if (count == RULES_MAX) return false;
+    rules[count++] = rule;
+    generation++;
+    return true;
+  }
+
+  bool remove(uint8_t i) {
+    if (i >= count) return false;
+    for (uint8_t j = i + 1; j < count; j++) rules[j - 1] = rules[j];
+    count--;
+    generation++;
+    return true;
+  }
+
+  void clear() {
+    count = 0;
+    generation++;
+  }
+
+  uint8_t size() const { return count; }
+  const AlarmRule& get(uint8_t i) const { return rules[i]; }
+
+  // Edits one value in place (the buttons); keeps the rule valid
+  void setValue(uint8_t i, uint8_t which, int16_t value) {
+    AlarmRule r = rules[i];
+    if (which == 0) r.a = value;
+    else r.b = value;
+    if (!ruleValid(r)) return;
+    rules[i] = r;
+    generation++;
+  }
+
+  // Bumped on every change, so engines know to recompile
+  uint32_t getGeneration() const { return generation; }
+
+  // NVS blob: version byte, then the rules as they are in memory
+  size_t toBlob(uint8_t* out, size_t size) const {
+    size_t len = 1 + count * sizeof(AlarmRule);
+    if (size < len) return 0;
+    out[0] = RULES_BLOB_VERSION;
+    memcpy(out + 1, rules, count * sizeof(AlarmRule));
+    return len;
+  }
+
+  bool fromBlob(const uint8_t* blob, size_t len) {
+    if (len < 1 || blob[0] != RULES_BLOB_VERSION || (len - 1) % sizeof(AlarmRule) != 0) return false;
+    size_t n = (len - 1) / sizeof(AlarmRule);
+    if (n > RULES_MAX) return false;
+    AlarmRule loaded[RULES_MAX];
+    memcpy(loaded, blob + 1, n * sizeof(AlarmRule));
+    for (size_t i = 0; i < n; i++) {
+      if (!ruleValid(loaded[i])) return false;
+    }
+    memcpy(rules, loaded, n * sizeof(AlarmRule));
+    count = (uint8_t)n;
+    generation++;
+    return true;
+  }
+
+private:
+  AlarmRule rules[RULES_MAX];
+  uint8_t count;
+  uint32_t generation;
+};
+
+#define RULES_BLOB_MAX (1 + RULES_MAX * sizeof(AlarmRule))
+
+// --- Button editing ---
+
+// One editable value: value `which` (0 = a, 1 = b) of table rule `rule`
+struct RuleField {
+  uint8_t rule;
+  uint8_t which;
+};
+
+// The values the buttons walk through for a probe, in table order
+inline uint8_t ruleFields(const RuleTable& table, uint8_t channel, RuleField* out, uint8_t max) {
+  uint8_t n = 0;
+  for (uint8_t i = 0; i < table.size(); i++) {
+    const AlarmRule& r = table.get(i);
+    if (r.channel != channel && r.channel != RULE_ALL_CHANNELS) continue;
+    for (uint8_t w = 0; w < ruleArity(r.kind) && n < max; w++) out[n++] = {i, w};
+  }
+  return n;
+}
+
+// What the display shows before a value (4 digits)
+inline const char* ruleFieldLabel(uint8_t kind, uint8_t which) {
+  switch (kind) {
+    case RULE_BANDS: return which == 0 ? "thr" : "StEP";
+    case RULE_BELOW: return "Lo";
+    case RULE_ABOVE: return "Hi";
+    case RULE_RATE: return "rAtE";
+    case RULE_SILENCE: return which == 0 ? "qLo" : "qHi";   // q for quiet
+    default: return "";
+  }
+}
+
+// One button press on a value, same increments and limits as before
+inline int16_t adjustRuleValue(uint8_t kind, uint8_t which, int16_t value, bool up) {
+  int16_t lo = RULE_TEMP_MIN, hi = RULE_TEMP_MAX, inc = RULE_TEMP_INCREMENT;
+  if (kind == RULE_BANDS && which == 1) {
+    lo = RULE_STEP_MIN; hi = RULE_STEP_MAX; inc = 1;
+  } else if (kind == RULE_RATE) {
+    lo = RULE_RATE_MIN; hi = RULE_RATE_MAX; inc = 1;
+  }
+  value += up ? inc : -inc;
+  if (value < lo) value = lo;
+  if (value > hi) value = hi;
+  return value;
+}
+
+// --- Evaluation ---
+
+struct RuleEvents {
+  ChirpEvent chirp;   // From the bands rule
+  bool lowTone;       // Fell below a "below" level
+  bool alarm;         // Rose above an "above" level, or faster than a rate limit
+  bool silenced;      // Inside a silence range: don't sound any of the above
+};
+
+class RuleEngine {
+public:
+  RuleEngine() : edgeCount(0), hasBands(false), bandsFrom(0), bandsStep(1), rateLimit(0), rateArmed(true),
+                 historyCount(0), historyNext(0), lastSlotMs(0), currentRate(0.0f), segment(-1) {}
+
+  // Builds this probe's sorted edge list from the table
+  void compile(const RuleTable& table, uint8_t channel) {
+    edgeCount = 0;
+    hasBands = false;
+    rateLimit = 0;
+    uint8_t slot = 0;
+    for (uint8_t i = 0; i < table.size(); i++) {
+      const AlarmRule& r = table.get(i);
+      if (r.channel != channel && r.channel != RULE_ALL_CHANNELS) continue;
+      switch (r.kind) {
+        case RULE_BANDS:
+          hasBands = true;
+          bandsFrom = r.a;
+          bandsStep = r.b;
+          break;
+        case RULE_BELOW:
+          addEdge(r.a, EDGE_FIRE_DOWN, slot);
+          addEdge(r.a + RULE_HYSTERESIS, EDGE_REARM_UP, slot);
+          armed[slot++] = true;
+          break;
+        case RULE_ABOVE:
+          addEdge(r.a, EDGE_FIRE_UP, slot);
+          addEdge(r.a - RULE_HYSTERESIS, EDGE_REARM_DOWN, slot);
+          armed[slot++] = true;
+          break;
+        case RULE_RATE:
+          if (rateLimit == 0 || r.a < rateLimit) rateLimit = r.a;   // Tightest limit wins
+          break;
+        case RULE_SILENCE:
+          addEdge(r.a, EDGE_SILENCE_ON, 0);
+          addEdge(r.b, EDGE_SILENCE_OFF, 0);
+          break;
+      }
+    }
+
+    // Insertion sort; at most 2 * RULES_MAX edges, once per edit
+    for (uint8_t i = 1; i < edgeCount; i++) {
+      Edge e = edges[i];
+      int j = i - 1;
+      while (j >= 0 && edges[j].at > e.at) {
+        edges[j + 1] = edges[j];
+        j--;
+      }
+      edges[j + 1] = e;
+    }
+
+    // Silence per segment: segment s lies above edges [0, s)
+    int depth = 0;
+    silent[0] = false;
+    for (uint8_t i = 0; i < edgeCount; i++) {
+      if (edges[i].role == EDGE_SILENCE_ON) depth++;
+      if (edges[i].role == EDGE_SILENCE_OFF) depth--;
+      silent[i + 1] = depth > 0;
+    }
+    segment = -1;   // Next sample places itself without firing
+  }
+
+  RuleEvents update(float temp, uint32_t nowMs) {
+    RuleEvents ev = {CHIRP_NONE, false, false, false};
+    if (hasBands) ev.chirp = bands.update(temp, bandsFrom / 10.0f, bandsStep / 10.0f);
+
+    int seg = segmentFor(temp * 10.0f);
+    if (segment >= 0 && seg > segment) {
+      for (int i = segment; i < seg; i++) crossUp(edges[i], ev);
+    } else if (segment >= 0 && seg < segment) {
+      for (int i = segment - 1; i >= seg; i--) crossDown(edges[i], ev);
+    }
+    segment = seg;
+    ev.silenced = silent[seg];
+
+    if (rateLimit > 0) updateRate(temp, nowMs, ev);
+    return ev;
+  }
+
+  int band() const { return hasBands ? bands.band() : -1; }
+
+  // Degrees from temp to the nearest edge any of the rules acts on, for
+  // SamplePacer; INFINITY with none (a rate rule has no edge)
+  float edgeDistance(float temp) const {
+    float nearest = INFINITY;
+    if (hasBands) nearest = bandEdgeDistance(temp, bandsFrom / 10.0f, bandsStep / 10.0f);
+    int seg = segmentFor(temp * 10.0f);
+    if (seg > 0) nearest = fminf(nearest, temp - edges[seg - 1].at / 10.0f);
+    if (seg < edgeCount) nearest = fminf(nearest, edges[seg].at / 10.0f - temp);
+    return nearest;
+  }
+
+  // Inside the bands rule's range or within a step of it; see nearBands()
+  bool nearBands(float temp) const {
+    return hasBands && ::nearBands(temp, bandsFrom / 10.0f, bandsStep / 10.0f);
+  }
+
+  // Degrees per minute over the rate window; 0 until there is history
+  float rate() const { return currentRate; }
+
+private:
+  enum EdgeRole : uint8_t { EDGE_FIRE_DOWN, EDGE_REARM_UP, EDGE_FIRE_UP, EDGE_REARM_DOWN, EDGE_SILENCE_ON, EDGE_SILENCE_OFF };
+
+  struct Edge {
+    int16_t at;
+    uint8_t role;
+    uint8_t slot;   // Level rule the edge belongs to (armed[])
+  };
+
+  Edge edges[2 * RULES_MAX];
+  bool silent[2 * RULES_MAX + 1];
+  bool armed[RULES_MAX];
+  uint8_t edgeCount;
+
+  bool hasBands;
+  int16_t bandsFrom, bandsStep;
+  ChirpBands bands;
+
+  int16_t rateLimit;   // 0 = no rate rule
+  bool rateArmed;
+  float history[RULE_RATE_SLOTS];
+  uint32_t historyMs[RULE_RATE_SLOTS];
+  uint8_t historyCount, historyNext;
+  uint32_t lastSlotMs;
+  float currentRate;
+
+  int segment;   // Edges at or below the last sample; -1 before the first
+
+  void addEdge(int16_t at, EdgeRole role, uint8_t slot) {
+    edges[edgeCount++] = {at, (uint8_t)role, slot};
+  }
+
+  // Binary search: how many edges are at or below x (tenths)
+  int segmentFor(float x) const {
+    int lo = 0, hi = edgeCount;
+    while (lo < hi) {
+      int mid = (lo + hi) / 2;
+      if (edges[mid].at <= x) lo = mid + 1;
+      else hi = mid;
+    }
+    return lo;
+  }
+
+  void crossUp(const Edge& e, RuleEvents& ev) {
+    if (e.role == EDGE_REARM_UP) armed[e.slot] = true;
+    if (e.role == EDGE_FIRE_UP && armed[e.slot]) {
+      armed[e.slot] = false;
+      ev.alarm = true;
+    }
+  }
+
+  void crossDown(const Edge& e, RuleEvents& ev) {
+    if (e.role == EDGE_REARM_DOWN) armed[e.slot] = true;
+    if (e.role == EDGE_FIRE_DOWN && armed[e.slot]) {
+      armed[e.slot] = false;
+      ev.lowTone = true;
+    }
+  }
+
+  void updateRate(float temp, uint32_t nowMs, RuleEvents& ev) {
+    if (historyCount > 0 && nowMs - lastSlotMs < RULE_RATE_SLOT_MS) return;
+    lastSlotMs = nowMs;
+    history[historyNext] = temp;
+    historyMs[historyNext] = nowMs;
+    historyNext = (historyNext + 1) % RULE_RATE_SLOTS;
+    if (historyCount < RULE_RATE_SLOTS) historyCount++;
+    if (historyCount < 3) return;   // Need a few slots before a rate means anything
+
+    uint8_t oldest = historyCount < RULE_RATE_SLOTS ? 0 : historyNext;
+    uint32_t span = nowMs - historyMs[oldest];
+    if (span == 0) return;
+    currentRate = (temp - history[oldest]) * 60000.0f / (float)span;
+
+    float limit = rateLimit / 10.0f;
+    if (rateArmed && currentRate > limit) {
+      rateArmed = false;
+      ev.alarm = true;
+    } else if (!rateArmed && currentRate < limit * RULE_RATE_REARM_PCT / 100.0f) {
+      rateArmed = true;
+    }
+  }
+};
+
+#endif // CHIRP_RULES_H
@@ -0,0 +1,312 @@
+/*
+ * RTD channels - Several MAX31865s on the shared SPI bus, read as they finish
+ *
+ * Each channel has its own CS and DRDY pin. Instead of the library's one-shot
+ * readRTD() (10ms bias settle + 65ms conversion, blocking, one chip at a
+ * time) every chip runs in auto-conversion mode and converts continuously on
+ * its own. poll() reads whichever chip has a result waiting, round-robin, so a
+ * slow channel can't starve the others.
+ *
+ * start() enables the chips one conversion-slot apart, so their DRDY edges
+ * are spread evenly over the conversion period: results arrive one at a time
+ * and each read (~40us) is done long before the next chip is ready. The
+ * chips' own oscillators drift the stagger slowly; that only matters for
+ * latency, since a result stays in the chip until it is read.
+ *
+ * A channel whose DRDY isn't wired (or never goes low) is read once it is
+ * overdue by a conversion period, so it still works at the same rate.
+ *
+ * setInterval() paces a channel that doesn't need 60 readings a second
+ * (see sample_pacer.h): at RTD_PACED_MIN_MS and up it leaves auto mode and
+ * runs one one-shot conversion per interval - bias on, settle, convert,
+ * read, bias off - from poll(), without blocking. The bias current only
+ * flows for ~63ms of each interval, so the probe self-heats that much
+ * less, and the bus carries one read per interval instead of 60 a second.
+ * Back under RTD_PACED_MIN_MS the channel returns to auto conversion (out
+ * of step with the others' stagger; that only costs latency).
+ *
+ * With an SpiArbiter (setArbiter(), after start()) every read in one poll()
+ * shares a single bus acquisition; the chips all use the same mode, only CS
+ * changes. The Adafruit calls in begin()/readOneShot()/start() open their own
+ * transactions, so they must come first.
+ *
+ * Achievable rates (60Hz filter, 16.7ms per conversion; 50Hz: x 0.83):
+ *
+ *   channels   samples/s   SPI busy      one-shot readRTD() (before)
+ *      1           60        0.2%          13 S/s max, loop blocked 75ms
+ *      2          120        0.5%          13 S/s shared
+ *      3          180        0.7%          13 S/s shared
+ *      4          240        1.0%          13 S/s shared
+ *
+ * The chips convert in parallel, so the aggregate scales with the channel
+ * count until the loop can't keep up; `chirp_telemetry.py stats` shows the
+ * measured per-channel and aggregate rates.
+ */
+
+#ifndef RTD_CHANNELS_H
+#define RTD_CHANNELS_H
+
+#include <Arduino.h>
+#include <SPI.h>
+#include <Adafruit_MAX31865.h>
+#include "../NTP_Clock/SevenSegmentDisplay/SpiArbiter.h"
+
+#define RTD_MAX_CHANNELS      4
+#define RTD_CONVERSION_US     16700   // Auto mode, 60Hz filter (20000 with the 50Hz filter)
+#define RTD_SPI_HZ            1000000
+#define RTD_BIAS_SETTLE_US    10500   // Bias on to one-shot start
+#define RTD_ONESHOT_US        52000   // One-shot conversion, 60Hz filter (62500 with the 50Hz filter)
+#define RTD_PACED_MIN_MS      250     // setInterval() at or above this runs paced one-shots
+
+struct RtdChannelPins {
+  int8_t cs;
+  int8_t drdy;   // -1 if not wired
+};
+
+struct RtdReading {
+  uint8_t channel;
+  uint16_t rtd;     // 15-bit RTD code
+  uint8_t fault;    // Fault register if the chip flagged one (now cleared), else 0
+};
+
+class RtdChannels {
+public:
+  RtdChannels(const RtdChannelPins* pins, uint8_t count)
+    : pins(pins), channelCount(count > RTD_MAX_CHANNELS ? RTD_MAX_CHANNELS : count), next(0), arbiter(nullptr) {
+    for (uint8_t i = 0; i < RTD_MAX_CHANNELS; i++) {
+      if (i < channelCount) devices[i] = {pins[i].cs, RTD_SPI_HZ, SPI_MODE1};
+      sensors[i] = nullptr;
+      enabled[i] = false;
+      lastReadUs[i] = 0;
+      sampleCount[i] = 0;
+      phase[i] = PHASE_AUTO;
+      phaseAtUs[i] = 0;
+      cycleStartUs[i] = 0;
+      intervalUs[i] = 0;
+      baseConfig[i] = 0;
+    }
+  }
+
+  // CS pins high first: no chip may listen while another is being set up
+  void begin(max31865_numwires_t wires) {
+    for (uint8_t i = 0; i < channelCount; i++) {
+      pinMode(pins[i].cs, OUTPUT);
+      digitalWrite(pins[i].cs, HIGH);
+      if (pins[i].drdy >= 0) pinMode(pins[i].drdy, INPUT_PULLUP);
+    }
+    for (uint8_t i = 0; i < channelCount; i++) {
+      sensors[i] = new Adafruit_MAX31865(pins[i].cs);
+      sensors[i]->begin(wires);
+    }
+  }
+
+  // Blocking one-shot conversion; for the boot-time wiring check only
+  uint16_t readOneShot(uint8_t ch) { return sensors[ch]->readRTD(); }
+
+  // Only enabled channels are started and polled (leave out missing probes)
+  void enable(uint8_t ch, bool on) { enabled[ch] = on; }
+  bool isEnabled(uint8_t ch) const { return enabled[ch]; }
+
+  // Starts auto conversion on each enabled chip, one slot apart
+  void start() {
+    uint8_t active = 0;
+    for (uint8_t i = 0; i < channelCount; i++) active += enabled[i];
+    if (active == 0) return;
+
+    uint32_t slotUs = RTD_CONVERSION_US / active;
+    bool first = true;
+    for (uint8_t i = 0; i < channelCount; i++) {
+      if (!enabled[i]) continue;
+      if (!first) delayMicroseconds(slotUs);
+      first = false;
+      sensors[i]->enableBias(true);
+      sensors[i]->autoConvert(true);
+      lastReadUs[i] = micros();
+    }
+  }
+
+  void setArbiter(SpiArbiter* bus) { arbiter = bus; }
+
+  // How often the caller wants a reading: under RTD_PACED_MIN_MS (or 0)
+  // auto conversion, every result read; from there up, one paced one-shot
+  // conversion per interval with the bias off in between
+  void setInterval(uint8_t ch, uint32_t ms) {
+    if (ch >= channelCount || !enabled[ch]) return;
+    intervalUs[ch] = ms * 1000UL;
+    bool paced = ms >= RTD_PACED_MIN_MS;
+    if (paced == (phase[ch] != PHASE_AUTO)) return;
+
+    uint32_t now = micros();
+    uint8_t config = readRegister8(ch, REG_CONFIG) & CONFIG_KEEP;
+    if (paced) {
+      baseConfig[ch] = config;
+      writeRegister8(ch, REG_CONFIG, config);   // Bias and auto off
+      readRegister16(ch, REG_RTD_MSB);          // Releases DRDY from the last auto result
+      phase[ch] = PHASE_IDLE;
+      phaseAtUs[ch] = now;
+    } else {
+      writeRegister8(ch, REG_CONFIG, config | CONFIG_BIAS | CONFIG_AUTO);
+      phase[ch] = PHASE_AUTO;
+      lastReadUs[ch] = now;
+    }
+  }
+
+  bool isPaced(uint8_t ch) const { return phase[ch] != PHASE_AUTO; }
+
+  // Reads every channel with a result waiting into out (room for count()
+  // readings), starting one channel further round each call so none is
+  // always served last. Returns how many were read.
+  uint8_t poll(RtdReading* out) {
+    uint32_t now = micros();
+    uint8_t n = 0;
+    for (uint8_t k = 0; k < channelCount; k++) {
+      uint8_t ch = (next + k) % channelCount;
+      if (!enabled[ch]) continue;
+      if (phase[ch] != PHASE_AUTO) stepPaced(ch, now);
+      if (!ready(ch, now)) continue;
+      if (n == 0 && arbiter != nullptr) arbiter->acquire(devices[ch]);   // One acquisition for the lot
+
+      lastReadUs[ch] = now;
+      sampleCount[ch]++;
+      uint16_t raw = readRegister16(ch, REG_RTD_MSB);
+      out[n].channel = ch;
+      out[n].rtd = raw >> 1;
+      out[n].fault = 0;
+      if (raw & 0x01) {
+        // Latch the fault for the caller, then clear it so conversions carry on
+        out[n].fault = readRegister8(ch, REG_FAULT_STATUS);
+        uint8_t config = readRegister8(ch, REG_CONFIG);
+        writeRegister8(ch, REG_CONFIG, (config & ~CONFIG_FAULT_BITS) | CONFIG_FAULT_CLEAR);
+      }
+      if (phase[ch] == PHASE_CONVERTING) {
+        writeRegister8(ch, REG_CONFIG, baseConfig[ch]);   // Bias off until the next one
+        phase[ch] = PHASE_IDLE;
+        // Next cycle an interval after this one started, or now if that's past
+        uint32_t due = cycleStartUs[ch] + intervalUs[ch];
+        phaseAtUs[ch] = (int32_t)(due - now) > 0 ? due : now;
+      }
+      n++;
+    }
+    if (n > 0 && arbiter != nullptr) arbiter->release();
+    next = (next + 1) % channelCount;
+    return n;
+  }
+
+  // A result is waiting on some channel; GPIO only, no bus traffic
+  bool anyReady() const {
+    uint32_t now = micros();
+    for (uint8_t ch = 0; ch < channelCount; ch++) {
+      if (enabled[ch] && ready(ch, now)) return true;
+    }
+    return false;
+  }
+
+  float temperature(uint8_t ch, uint16_t rtd, float nominal, float reference) {
+    return sensors[ch]->calculateTemperature(rtd, nominal, reference);
+  }
+
+  uint8_t count() const { return channelCount; }
+  uint32_t samples(uint8_t ch) const { return sampleCount[ch]; }
+
+private:
+  static constexpr uint8_t REG_CONFIG = 0x00;
+  static constexpr uint8_t REG_RTD_MSB = 0x01;        // MSB, then LSB with the fault flag in bit 0
+  static constexpr uint8_t REG_FAULT_STATUS = 0x07;
+  static constexpr uint8_t REG_WRITE = 0x80;
+  static constexpr uint8_t CONFIG_FAULT_BITS = 0x2C;  // One-shot and fault-detection cycle bits
+  static constexpr uint8_t CONFIG_FAULT_CLEAR = 0x02;
+  static constexpr uint8_t CONFIG_BIAS = 0x80;
+  static constexpr uint8_t CONFIG_AUTO = 0x40;
+  static constexpr uint8_t CONFIG_ONESHOT = 0x20;
+  static constexpr uint8_t CONFIG_KEEP = 0x11;         // 3-wire and 50Hz filter, as begin() set them
+
+  enum Phase : uint8_t {
+    PHASE_AUTO,         // Converting continuously
+    PHASE_IDLE,         // Paced, bias off until phaseAtUs
+    PHASE_SETTLING,     // Bias on; one-shot starts at phaseAtUs
+    PHASE_CONVERTING,   // Result due by phaseAtUs (sooner on DRDY)
+  };
+
+  const RtdChannelPins* pins;
+  uint8_t channelCount;
+  uint8_t next;   // Round-robin start for the next poll()
+  SpiArbiter* arbiter;
+  SpiDevice devices[RTD_MAX_CHANNELS];
+  Adafruit_MAX31865* sensors[RTD_MAX_CHANNELS];
+  bool enabled[RTD_MAX_CHANNELS];
+  uint32_t lastReadUs[RTD_MAX_CHANNELS];
+  uint32_t sampleCount[RTD_MAX_CHANNELS];
+  Phase phase[RTD_MAX_CHANNELS];
+  uint32_t phaseAtUs[RTD_MAX_CHANNELS];
+  uint32_t cycleStartUs[RTD_MAX_CHANNELS];
+  uint32_t intervalUs[RTD_MAX_CHANNELS];
+  uint8_t baseConfig[RTD_MAX_CHANNELS];
+
+  // Moves a paced channel through bias-on and conversion start as they fall due
+  void stepPaced(uint8_t ch, uint32_t now) {
+    if ((int32_t)(now - phaseAtUs[ch]) < 0) return;
+    if (phase[ch] == PHASE_IDLE) {
+      cycleStartUs[ch] = now;
+      writeRegister8(ch, REG_CONFIG, baseConfig[ch] | CONFIG_BIAS);
+      phase[ch] = PHASE_SETTLING;
+      phaseAtUs[ch] = now + RTD_BIAS_SETTLE_US;
+    } else if (phase[ch] == PHASE_SETTLING) {
+      writeRegister8(ch, REG_CONFIG, baseConfig[ch] | CONFIG_BIAS | CONFIG_ONESHOT);
+      phase[ch] = PHASE_CONVERTING;
+      phaseAtUs[ch] = now + RTD_ONESHOT_US + RTD_ONESHOT_US / 8;
+    }
+  }
+
+  bool ready(uint8_t ch, uint32_t now) const {
+    if (phase[ch] != PHASE_AUTO) {
+      if (phase[ch] != PHASE_CONVERTING) return false;
+      if (pins[ch].drdy >= 0 && digitalRead(pins[ch].drdy) == LOW) return true;
+      return (int32_t)(now - phaseAtUs[ch]) >= 0;
+    }
+    uint32_t since = now - lastReadUs[ch];
+    // DRDY low = fresh result. Without it (or if it never comes), read once overdue.
+    if (pins[ch].drdy >= 0 && digitalRead(pins[ch].drdy) == LOW) return true;
+    uint32_t overdue = pins[ch].drdy >= 0 ? 2 * RTD_CONVERSION_US : RTD_CONVERSION_US;
+    return since >= overdue;
+  }
+
+  // Register access. Without an arbiter each access opens its own transaction.
+  void busBegin(uint8_t ch) {
+    if (arbiter != nullptr) arbiter->acquire(devices[ch]);
+    else SPI.beginTransaction(SPISettings(RTD_SPI_HZ, MSBFIRST, SPI_MODE1));
+    digitalWrite(pins[ch].cs, LOW);
+  }
+
+  void busEnd(uint8_t ch) {
+    digitalWrite(pins[ch].cs, HIGH);
+    if (arbiter != nullptr) arbiter->release();
+    else SPI.endTransaction();
+  }
+
+  // Reading the RTD LSB also releases DRDY until the next conversion
+  uint16_t readRegister16(uint8_t ch, uint8_t reg) {
+    busBegin(ch);
+    SPI.transfer(reg);
+    uint16_t value = (uint16_t)SPI.transfer(0xFF) << 8;
+    value |= SPI.transfer(0xFF);
+    busEnd(ch);
+    return value;
+  }
+
+  uint8_t readRegister8(uint8_t ch, uint8_t reg) {
+    busBegin(ch);
+    SPI.transfer(reg);
+    uint8_t value = SPI.transfer(0xFF);
+    busEnd(ch);
+    return value;
+  }
+
+  void writeRegister8(uint8_t ch, uint8_t reg, uint8_t value) {
+    busBegin(ch);
+    SPI.transfer(reg | REG_WRITE);
+    SPI.transfer(value);
+    busEnd(ch);
+  }
+};
+
+#endif // RTD_CHANNELS_H
@@ -0,0 +1,127 @@
+/*
+ * Sample pacer - How often to read a probe, from how close it is to an edge
+ *
+ * A fixed 200 ms report period is only needed right at a band edge; far
+ * below the first rule it is sixty conversions a second of bias current
+ * self-heating the sensor for nothing. After each reading, pace() takes
+ * the distance to the nearest edge of the probe's rules (a band boundary, a
+ * level or its re-arm point, a silence bound; see RuleEngine::edgeDistance())
+ * and how fast the reading is moving, and picks the next interval so
+ * PACE_READINGS_TO_EDGE readings fit before the edge at that speed, within
+ * the configured limits.
+ *
+ * In the bands rule's range, and within one step below it, pace() holds
+ * the minimum whatever the distance (RuleEngine::nearBands()): there a band
+ * edge is never more than a step away, and a probe paced between edges
+ * reaches the next one late. Only below that, and near the other rules, is
+ * the interval lengthened. Approaching an edge there, each reading covers
+ * a quarter of what is left, so the interval shrinks to the minimum just
+ * before a crossing. The speed is measured over PACE_RATE_WINDOW_MS, so
+ * sensor noise doesn't read as movement, and never taken below
+ * PACE_SPEED_FLOOR, so a probe that has been still gets closer looks as it
+ * comes up to an edge. Within PACE_EDGE_MARGIN of an edge it stays at the
+ * minimum: a slow probe there would otherwise be on single paced
+ * one-shots, each as noisy as one conversion, rather than the mean of a
+ * dozen, and noise right at an edge is what makes false chirps.
+ *
+ * RtdChannels::setInterval() turns long intervals into paced one-shot
+ * conversions with the bias off between them. tools/chirp_sim.cpp
+ * (--adaptive) compares this with fixed-rate sampling. With 0.05 C noise,
+ * 200-2000 ms against the fixed 200 ms, seeds 1-5 each started at five
+ * points across one 200 ms period (a ramp that crosses every edge on a
+ * multiple of the period flatters the fixed rate):
+ *
+ *   20-180 C in 30 min    4.4 samples/s instead of 60, bias on 9.5%;
+ *                         latency 236 ms mean (fixed 210), worst per run
+ *                         480 ms (473); 14 false chirps/hour (10)
+ *   160-180 C in 30 min   32 samples/s, bias on 54%; latency 421 ms mean
+ *                         (fixed 406), worst per run 1.4 s (1.3 s);
+ *                         196 false chirps/hour (205)
+ *
+ * Over seeds 1-12 and seven start points, 20-180 C averages 224 ms against
+ * 215 ms fixed: the remaining difference is the phase of the report period,
+ * which restarts when the probe leaves paced one-shots. The saving is all
+ * below the bands, so a ramp that spends its time there keeps most of it.
+ * False chirps are no fewer: they come from noise at an edge, where both
+ * run at the minimum.
+ *
+ * A minimum below 200 ms averages fewer conversions per reading: 100 ms
+ * took about a third off the latency but tripled the false chirps, so it is a
+ * setting, not the default.
+ *
+ * Pure C++ - no Arduino dependencies, so it builds on the host too.
+ */
+
+#ifndef SAMPLE_PACER_H
+#define SAMPLE_PACER_H
+
+#include <stdint.h>
+#include <math.h>
+
+#define PACE_MIN_MS_DEFAULT     200     // The old fixed rate; see above
+#define PACE_MAX_MS_DEFAULT     2000
+#define PACE_MIN_MS_LIMIT       20      // About one auto conversion
+#define PACE_MAX_MS_LIMIT       5000    // RULE_RATE_SLOT_MS: rate rules need a reading per slot
+#define PACE_READINGS_TO_EDGE   4
+#define PACE_RATE_WINDOW_MS     5000
+#define PACE_SPEED_FLOOR        0.02f   // Degrees/second (1.2/minute)
+#define PACE_EDGE_MARGIN        0.1f    // Degrees: this close to an edge, run at the minimum
+
+class SamplePacer {
+public:
+  SamplePacer() : minMs(PACE_MIN_MS_DEFAULT), maxMs(PACE_MIN_MS_DEFAULT), speed(0.0f), anchorTemp(0.0f),
+                  anchorMs(0), anchored(false), intervalMs(PACE_MIN_MS_DEFAULT) {
+    setLimits(PACE_MIN_MS_DEFAULT, PACE_MAX_MS_DEFAULT);
+  }
+
+  // Clamped to PACE_MIN_MS_LIMIT..PACE_MAX_MS_LIMIT; min == max is fixed-rate
+  void setLimits(uint32_t lo, uint32_t hi) {
+    if (lo < PACE_MIN_MS_LIMIT) lo = PACE_MIN_MS_LIMIT;
+    if (hi > PACE_MAX_MS_LIMIT) hi = PACE_MAX_MS_LIMIT;
+    if (hi < lo) hi = lo;
+    minMs = lo;
+    maxMs = hi;
+    intervalMs = lo;   // Start fast until there is a speed
+  }
+
+  // After a reading: the next interval, given the distance (degrees, INFINITY
+  // if there are no rules) to the nearest edge. holdMin: the reading is in or
+  // next to the bands (RuleEngine::nearBands()), so stay at the minimum.
+  uint32_t pace(float temp, uint32_t nowMs, float edgeDistance, bool holdMin) {
+    if (!anchored) {
+      anchorTemp = temp;
+      anchorMs = nowMs;
+      anchored = true;
+    } else if (nowMs - anchorMs >= PACE_RATE_WINDOW_MS) {
+      speed = fabsf(temp - anchorTemp) * 1000.0f / (float)(nowMs - anchorMs);
+      anchorTemp = temp;
+      anchorMs = nowMs;
+    }
+
+    if (holdMin) {
+      intervalMs = minMs;
+      return intervalMs;
+    }
+    float d = edgeDistance > PACE_EDGE_MARGIN ? edgeDistance - PACE_EDGE_MARGIN : 0.0f;
+    float ms = d / (speed + PACE_SPEED_FLOOR) * 1000.0f / PACE_READINGS_TO_EDGE;
+    if (!(ms < (float)maxMs)) intervalMs = maxMs;   // Also NAN and INFINITY
+    else if (ms < (float)minMs) intervalMs = minMs;
+    else intervalMs = (uint32_t)ms;
+    return intervalMs;
+  }
+
+  uint32_t interval() const { return intervalMs; }
+  float degreesPerSecond() const { return speed; }
+  uint32_t getMin() const { return minMs; }
+  uint32_t getMax() const { return maxMs; }
+
+private:
+  uint32_t minMs, maxMs;
+  float speed;            // |degrees/second| over the last window
+  float anchorTemp;       // Start of the current window
+  uint32_t anchorMs;
+  bool anchored;
+  uint32_t intervalMs;
+};
+
+#endif // SAMPLE_PACER_H
@@ -0,0 +1,222 @@
+/*
+ * Telemetry - COBS-framed binary sample stream over USB CDC
+ *
+ * Samples are batched into frames instead of printed one per line. A frame is
+ *
+ *   u8  version        TELEMETRY_VERSION
+ *   u8  type           TELEMETRY_TYPE_SAMPLES
+ *   u16 seq            Frame counter; gaps mean frames were dropped
+ *   u8  count          Samples in this frame
+ *   count x {
+ *     u32 timestampMs  millis() when the sample was taken
+ *     u16 rtd          Raw 15-bit MAX31865 RTD code
+ *     i32 tempMilli    Temperature in 0.001 C
+ *     u8  fault        MAX31865 fault register
+ *     i8  band         Chirp band index (-1 = below threshold)
+ *     u8  channel      RTD channel the sample is from (version 2 and up)
+ *   }
+ *   u16 crc            CRC-16/CCITT-FALSE over everything above
+ *
+ * Text for the host (replies to serial commands) goes out as its own frame
+ * type between sample frames: version, TELEMETRY_TYPE_TEXT, seq, length,
+ * then that many bytes of text, then the crc.
+ *
+ * All fields little-endian. The frame is COBS-encoded and terminated with a
+ * 0x00 byte, so a reader can resync on any zero. Writing never blocks: bytes
+ * go out only as fast as the USB FIFO has room, and if another batch fills up
+ * before the previous frame got out, one of them is dropped (the seq gap shows it).
+ *
+ * tools/chirp_telemetry.py records, decodes and replays the stream.
+ */
+
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <Arduino.h>
+#include <stdint.h>
+#include <string.h>
+
+#define TELEMETRY_VERSION       2
+#define TELEMETRY_TYPE_SAMPLES  1
+#define TELEMETRY_TYPE_TEXT     2
+#define TELEMETRY_TEXT_BUF      512     // Text waiting to go out
+#define TELEMETRY_TEXT_CHUNK    192     // Most text per frame
+#define TELEMETRY_BATCH         16      // Samples per frame
+#define TELEMETRY_MAX_AGE_MS    1000    // Send a partial batch after this long
+#define TELEMETRY_HEADER_SIZE   5
+#define TELEMETRY_SAMPLE_SIZE   13
+#define TELEMETRY_FRAME_SIZE    (TELEMETRY_HEADER_SIZE + TELEMETRY_BATCH * TELEMETRY_SAMPLE_SIZE + 2)
+// COBS adds one byte per 254 plus the leading code byte; +1 for the delimiter
+#define TELEMETRY_ENCODED_SIZE  (TELEMETRY_FRAME_SIZE + TELEMETRY_FRAME_SIZE / 254 + 2)
+static_assert(TELEMETRY_HEADER_SIZE + TELEMETRY_TEXT_CHUNK + 2 <= TELEMETRY_FRAME_SIZE, "Text frame must fit the frame buffer");
+
+// CRC-16/CCITT-FALSE (poly 0x1021, init 0xFFFF)
+inline uint16_t telemetryCrc16(const uint8_t* data, size_t len) {
+  uint16_t crc = 0xFFFF;
+  for (size_t i = 0; i < len; i++) {
+    crc ^= (uint16_t)data[i] << 8;
+    for (int b = 0; b < 8; b++) {
+      crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+    }
+  }
+  return crc;
+}
+
+// Consistent Overhead Byte Stuffing; returns encoded length (without delimiter)
+inline size_t cobsEncode(const uint8_t* in, size_t len, uint8_t* out) {
+  size_t codeIndex = 0;
+  size_t outIndex = 1;
+  uint8_t code = 1;
+
+  for (size_t i = 0; i < len; i++) {
+    if (in[i] == 0) {
+      out[codeIndex] = code;
+      codeIndex = outIndex++;
+      code = 1;
+    } else {
+      out[outIndex++] = in[i];
+      if (++code == 0xFF) {
+        out[codeIndex] = code;
+        codeIndex = outIndex++;
+        code = 1;
+      }
+    }
+  }
+  out[codeIndex] = code;
+  return outIndex;
+}
+
+struct TelemetrySample {
+  uint32_t timestampMs;
+  uint16_t rtd;
+  int32_t tempMilli;
+  uint8_t fault;
+  int8_t band;
+  uint8_t channel;
+};
+
+class TelemetryStream {
+public:
+  TelemetryStream(Print& out) : out(out), count(0), seq(0), batchStartMs(0),
+                                pendingLen(0), pendingSent(0), pendingText(false), textLen(0),
+                                framesSent(0), framesDropped(0) {}
+
+  void addSample(const TelemetrySample& sample) {
+    // Previous batch still full because a frame is mid-transmission: drop it
+    if (count >= TELEMETRY_BATCH) {
+      framesDropped++;
+      seq++;
+      count = 0;
+    }
+    if (count == 0) batchStartMs = sample.timestampMs;
+    samples[count++] = sample;
+    if (count >= TELEMETRY_BATCH) seal();
+  }
+
+  // Queues text for the host; false if there isn't room for all of it
+  bool sendText(const char* text) {
+    size_t len = strlen(text);
+    if (textLen + len > TELEMETRY_TEXT_BUF) return false;
+    memcpy(this->text + textLen, text, len);
+    textLen += len;
+    return true;
+  }
+
+  // Call every loop pass: seals stale partial batches and pushes pending
+  // bytes only as far as the USB FIFO has room
+  void service(uint32_t now) {
+    if (count > 0 && now - batchStartMs >= TELEMETRY_MAX_AGE_MS) seal();
+    if (pendingLen == 0 && textLen > 0) sealText();
+    if (pendingLen == 0) return;
+
+    int room = out.availableForWrite();
+    if (room <= 0) return;
+    size_t chunk = pendingLen - pendingSent;
+    if (chunk > (size_t)room) chunk = room;
+    pendingSent += out.write(pending + pendingSent, chunk);
+    if (pendingSent >= pendingLen) {
+      pendingLen = 0;
+      pendingSent = 0;
+      framesSent++;
+    }
+  }
+
+  uint32_t sent() const { return framesSent; }
+  uint32_t dropped() const { return framesDropped; }
+
+private:
+  Print& out;
+  TelemetrySample samples[TELEMETRY_BATCH];
+  uint8_t count;
+  uint16_t seq;
+  uint32_t batchStartMs;
+  uint8_t pending[TELEMETRY_ENCODED_SIZE];
+  size_t pendingLen;
+  size_t pendingSent;
+  bool pendingText;   // The pending frame is text; a sample batch doesn't replace it
+  char text[TELEMETRY_TEXT_BUF];
+  size_t textLen;
+  uint32_t framesSent;
+  uint32_t framesDropped;
+
+  static uint8_t* put16(uint8_t* p, uint16_t v) {
+    p[0] = v; p[1] = v >> 8;
+    return p + 2;
+  }
+
+  static uint8_t* put32(uint8_t* p, uint32_t v) {
+    p[0] = v; p[1] = v >> 8; p[2] = v >> 16; p[3] = v >> 24;
+    return p + 4;
+  }
+
+  void seal() {
+    // A frame that has started going out must finish, or the host loses sync
+    // mid-frame; one that hasn't is replaced by the newer batch
+    if (pendingLen > 0 && (pendingSent > 0 || pendingText)) return;
+    if (pendingLen > 0) framesDropped++;
+
+    uint8_t frame[TELEMETRY_FRAME_SIZE];
+    uint8_t* p = frame;
+    *p++ = TELEMETRY_VERSION;
+    *p++ = TELEMETRY_TYPE_SAMPLES;
+    p = put16(p, seq++);
+    *p++ = count;
+    for (uint8_t i = 0; i < count; i++) {
+      p = put32(p, samples[i].timestampMs);
+      p = put16(p, samples[i].rtd);
+      p = put32(p, (uint32_t)samples[i].tempMilli);
+      *p++ = samples[i].fault;
+      *p++ = (uint8_t)samples[i].band;
+      *p++ = samples[i].channel;
+    }
+    p = put16(p, telemetryCrc16(frame, p - frame));
+    queueFrame(frame, p - frame, false);
+    count = 0;
+  }
+
+  void sealText() {
+    uint8_t frame[TELEMETRY_HEADER_SIZE + TELEMETRY_TEXT_CHUNK + 2];
+    size_t len = textLen < TELEMETRY_TEXT_CHUNK ? textLen : TELEMETRY_TEXT_CHUNK;
+    uint8_t* p = frame;
+    *p++ = TELEMETRY_VERSION;
+    *p++ = TELEMETRY_TYPE_TEXT;
+    p = put16(p, seq++);
+    *p++ = (uint8_t)len;
+    memcpy(p, text, len);
+    p += len;
+    p = put16(p, telemetryCrc16(frame, p - frame));
+    queueFrame(frame, p - frame, true);
+
+    memmove(text, text + len, textLen - len);
+    textLen -= len;
+  }
+
+  void queueFrame(const uint8_t* frame, size_t len, bool isText) {
+    pendingLen = cobsEncode(frame, len, pending);
+    pending[pendingLen++] = 0x00;
+    pendingSent = 0;
+    pendingText = isText;
+  }
+};
+
+#endif // TELEMETRY_H
@@ -8,11 +8,36 @@
  *    - If you see ~100 to 110 at boot, sensor is good.
  *    - If you see 0, sensor is disconnected/shorted.
  * 3. Forces temperature display even if sensor complains.
+ * 4. Streams readings as COBS-framed binary telemetry on USB CDC
+ *    (see telemetry.h, decode with tools/chirp_telemetry.py).
+ * 5. Up to four probes (top, middle, bottom of the column), each a MAX31865
+ *    in auto-conversion mode with its own threshold, step and chirp pitch
+ *    (see rtd_channels.h). UP/DOWN in run mode picks the probe shown, or
+ *    "CYCL" to step through them.
+ * 6. Alarms come from a rule table (see chirp_rules.h): bands, below/above
+ *    levels, rate of rise and silence ranges, per probe or for all of them.
+ *    MODE walks through the shown probe's values; the serial console
+ *    ("rules", "add ...", "del N", "clear") edits the table. It is saved
+ *    to NVS on every change.
+ * 7. Buttons come from edge interrupts (../NTP_Clock/ButtonInput), so a
+ *    press during a chirp isn't missed; UP/DOWN repeat faster when held.
+ * 8. Each probe is read as often as its rules need (see sample_pacer.h):
+ *    every 200ms close to an edge, as before, up to every 2s far from
+ *    one, with the sensor's bias off between readings. "pace MIN MAX" on
+ *    the console sets the limits ("pace 200 200" is the old fixed rate).
  */
 
  #include <SPI.h>
  #include <Adafruit_MAX31865.h> 
  #include <Preferences.h>       
+ #include "telemetry.h"
+ #include "chirp_logic.h"
+ #include "chirp_rules.h"
+ #include "rtd_channels.h"
+ #include "sample_pacer.h"
+ #include "../NTP_Clock/SevenSegmentDisplay/MAX7219Display.h"
+ #include "../NTP_Clock/SevenSegmentDisplay/MAX7219Display.cpp"
+ #include "../NTP_Clock/ButtonInput/ButtonInput.h"
  
  // --- PIN DEFINITIONS ---
  const int PIN_BTN_MODE = 7; 
@@ -26,103 +51,132 @@
  const int PIN_SPI_MISO = 18;
  
  // Chip Selects
- const int PIN_CS_RTD   = 10;
+ const int PIN_CS_RTD   = 10;   // Top probe
+ const int PIN_CS_RTD2  = 9;    // Middle probe
+ const int PIN_CS_RTD3  = 8;    // Bottom probe
  const int PIN_CS_DISP  = 11;
  
+ // MAX31865 DRDY outputs (-1 if not wired; the channel is then read on a timer)
+ const int PIN_DRDY_RTD  = 12;
+ const int PIN_DRDY_RTD2 = 13;
+ const int PIN_DRDY_RTD3 = 14;
+ 
+ // One entry per probe, top first. Probes that read open or shorted at boot
+ // are left out (except the first, which shows "Err" as before).
+ const RtdChannelPins RTD_PINS[] = {
+   {PIN_CS_RTD,  PIN_DRDY_RTD},
+   {PIN_CS_RTD2, PIN_DRDY_RTD2},
+   {PIN_CS_RTD3, PIN_DRDY_RTD3},
+ };
+ const uint8_t RTD_COUNT = sizeof(RTD_PINS) / sizeof(RTD_PINS[0]);
+ 
  // --- CONSTANTS ---
  const float R_REF     = 430.0; // Reference Resistor (R4 on PT100 boards)
  const float R_NOMINAL = 100.0; // PT100
  const float TEMP_MAX  = 999.0; 
+ const unsigned long CHANNEL_SHOW_MS = 3000;  // Per probe when cycling
+ const unsigned long LABEL_MS        = 700;   // "Ch 2" before a probe's reading
  
- // --- SIMPLE MAX7219 DRIVER (Display) ---
- class SimpleMAX7219 {
- private:
-   int csPin;
-   void writeRegister(uint8_t address, uint8_t value) {
-     // Ensure we strictly use SPI MODE 0 for Display
-     SPI.beginTransaction(SPISettings(1000000, MSBFIRST, SPI_MODE0)); 
-     digitalWrite(csPin, LOW);
-     SPI.transfer(address);
-     SPI.transfer(value);
-     digitalWrite(csPin, HIGH);
-     SPI.endTransaction();
-   }
-   
- public:
-   SimpleMAX7219(int cs) : csPin(cs) {}
-   
-   void begin() {
-     pinMode(csPin, OUTPUT);
-     digitalWrite(csPin, HIGH); 
-     writeRegister(0x0C, 0x01); // Shutdown: normal
-     writeRegister(0x0B, 0x03); // Scan limit: 4 digits
-     writeRegister(0x09, 0xFF); // Decode mode: Code B
-     writeRegister(0x0A, 0x08); // Intensity: medium
-     clearDisplay(0);
-   }
-   
-   void clearDisplay(int device) {
-     for (int i = 1; i <= 8; i++) writeRegister(i, 0x0F);
-   }
-   
-   void setDigit(int device, int digit, int value, bool dp) {
-     if (digit < 0 || digit > 7) return;
-     uint8_t code = value & 0x0F;
-     if (dp) code |= 0x80;
-     writeRegister(digit + 1, code);
-   }
-   
-   void setChar(int device, int digit, char value, bool dp) {
-     if (digit < 0 || digit > 7) return;
-     uint8_t code = 0x0F; // Blank
-     if (value == '-') code = 0x0A;
-     else if (value == 'E') code = 0x0B;
-     else if (value >= '0' && value <= '9') code = value - '0';
-     if (dp) code |= 0x80;
-     writeRegister(digit + 1, code);
-   }
- };
+ // Chirp pitch per probe, percent of the first probe's (top = highest)
+ const uint8_t CHIRP_VOICE_PCT[RTD_MAX_CHANNELS] = {100, 80, 64, 50};
+ const unsigned long LOW_TONE_MS = 1000;   // "below" rules
+ const unsigned long ALARM_MS    = 600;    // "above" and "rate" rules
  
  // --- OBJECTS ---
- // PT100 Sensor Object
- Adafruit_MAX31865 thermo = Adafruit_MAX31865(PIN_CS_RTD);
- // Display Object
- SimpleMAX7219 lc(PIN_CS_DISP);
+ // PT100 sensors, read as their conversions finish
+ RtdChannels rtdChannels(RTD_PINS, RTD_COUNT);
+ // Shared SPI bus: sensor reads first, display flushes batched (see SpiArbiter.h)
+ SpiArbiter spiBus;
+ // Display Object (skips SPI writes for digits that haven't changed)
+ MAX7219Display display(PIN_CS_DISP);
  Preferences preferences;
+ // Binary sample stream on USB CDC (see telemetry.h)
+ TelemetryStream telemetry(Serial);
+ // Buttons, debounced from their edge interrupts (see ButtonInput.h);
+ // added in this order in setup()
+ enum { BTN_MODE, BTN_UP, BTN_DOWN };
+ ButtonInput buttons;
  
  // --- STATE VARIABLES ---
- enum SystemMode { MODE_RUN, MODE_SET_THRESH, MODE_SET_STEP };
+ enum SystemMode { MODE_RUN, MODE_EDIT };
  SystemMode currentMode = MODE_RUN;
  
- float configThreshold = 170.0; 
- float configStepSize  = 0.5;   
- float currentTempC    = 0.0;
- int   lastBandIndex   = -1;
+ // Alarm rules for every probe, as saved in NVS
+ RuleTable alarmRules;
+ 
+ // Per probe: the latest reading and its compiled rules
+ struct ColumnProbe {
+   float tempC;
+   RuleEngine rules;   // Band last chirped for, armed levels, rate history
+   SamplePacer pacer;  // Report interval, from the distance to the rules' edges
+   float sum;          // Conversions since the last report
+   uint16_t count;
+   unsigned long reportAt;
+ };
+ ColumnProbe probes[RTD_COUNT];
+ uint32_t rulesCompiled = 0;     // alarmRules generation the engines were built from
+ 
+ // MODE_EDIT: which value of the shown probe's rules the buttons change
+ RuleField editFields[2 * RULES_MAX];
+ uint8_t editFieldCount = 0;
+ uint8_t editField = 0;
  
- unsigned long lastInputTime = 0;
- bool buttonHeld = false;
- unsigned long buttonHoldStart = 0;
+ // Serial console input, one line at a time
+ char consoleLine[48];
+ uint8_t consoleLen = 0;
+ 
+ uint8_t viewChannel = 0;        // Probe shown, and edited in the set modes
+ bool viewCycle = false;         // Step through the probes on a timer
+ unsigned long viewSince = 0;
+ unsigned long labelUntil = 0;   // Showing viewLabel until then
+ char viewLabel[5] = "";         // "Ch 2", "CYCL", or the name of a value being edited
+ char nextLabel[5] = "";         // Shown when viewLabel ends, e.g. a value's name after "Ch 2"
  
  // Forward Declarations
  void displayFloat(float val);
- void displayInt(int val);
  void handleButtons();
- void handleAudioLogic(float temp);
- void playChirp(bool goingUp);
+ void readChannels();
+ bool sensorWaiting();
+ void handleAudioLogic(uint8_t ch);
+ void playChirp(uint8_t ch, bool goingUp);
  void cycleMode();
+ void showEditField();
  void saveSettings();
+ void loadRules();
+ void compileRules();
+ void loadPace();
+ void handleConsole();
+ void runCommand(char* line);
  void modifyValue(bool up, bool down);
+ void selectView(bool up);
+ void showView(uint8_t ch);
+ void displayRun();
+ bool displayLabel();
+ void showLabel(const char* text);
+ void queueLabel(const char* text);
+ void clearLabel();
+ void prefKey(char* out, const char* base, uint8_t ch);
  
  void setup() {
+   // USB CDC for telemetry. Never block on writes if no host is listening.
+   Serial.begin(115200);
+   Serial.setTxTimeoutMs(0);
+ 
    // 1. Init Pins
    pinMode(PIN_BTN_MODE, INPUT_PULLUP); 
    pinMode(PIN_BTN_UP,   INPUT_PULLUP);
    pinMode(PIN_BTN_DOWN, INPUT_PULLUP);
    pinMode(PIN_BUZZER,   OUTPUT);
+   buttons.add(PIN_BTN_MODE);
+   buttons.add(PIN_BTN_UP,   BUTTON_REPEATS);
+   buttons.add(PIN_BTN_DOWN, BUTTON_REPEATS);
+   buttons.begin();
    
    // Set CS High to prevent bus conflict
-   pinMode(PIN_CS_RTD, OUTPUT);
-   digitalWrite(PIN_CS_RTD, HIGH);
+   for (uint8_t i = 0; i < RTD_COUNT; i++) {
+     pinMode(RTD_PINS[i].cs, OUTPUT);
+     digitalWrite(RTD_PINS[i].cs, HIGH);
+   }
    pinMode(PIN_CS_DISP, OUTPUT);
    digitalWrite(PIN_CS_DISP, HIGH);
  
@@ -131,193 +185,423 @@
    delay(100);
    
    // 3. Init Display
-   lc.begin();
+   display.begin();
    
-   // 4. Init Sensor (Try 3-Wire config)
-   thermo.begin(MAX31865_3WIRE); 
+   // 4. Init Sensors (Try 3-Wire config)
+   rtdChannels.begin(MAX31865_3WIRE); 
    
    // --- DEBUG STARTUP SEQUENCE ---
-   // Show Raw Resistance for 2 seconds to verify wiring.
+   // Show Raw Resistance for 2 seconds to verify wiring (split between probes).
    // Expect ~100.0 to 110.0 for PT100.
    // If 0.0 or >400, wiring is wrong.
-   uint16_t rtd = thermo.readRTD();
-   float ohms = thermo.temperature(R_NOMINAL, R_REF) * 0.0; // Dummy calc to init
-   ohms = (float)rtd; 
-   // Actually calculate ohms:
-   ohms = ((float)rtd * R_REF) / 32768.0;
-   
-   displayFloat(ohms); 
    tone(PIN_BUZZER, 2000, 100);
-   delay(2000); 
+   for (uint8_t i = 0; i < RTD_COUNT; i++) {
+     uint16_t rtd = rtdChannels.readOneShot(i);
+     float ohms = ((float)rtd * R_REF) / 32768.0;
+     // A missing probe reads open or shorted; don't let it chirp
+     rtdChannels.enable(i, i == 0 || (ohms > 10.0 && ohms < 400.0));
+ 
+     if (RTD_COUNT > 1) {
+       showView(i);
+       displayLabel();
+       delay(LABEL_MS);
+     }
+     displayFloat(ohms); 
+     delay(2000 / RTD_COUNT); 
+   }
    // ------------------------------
  
    // Load Prefs
    preferences.begin("col_temp", false);
-   configThreshold = preferences.getFloat("thresh", 170.0);
-   configStepSize  = preferences.getFloat("step", 0.5);
+   loadRules();
+   for (uint8_t i = 0; i < RTD_COUNT; i++) {
+     probes[i].tempC = 0.0;
+     probes[i].sum = 0.0;
+     probes[i].count = 0;
+     probes[i].reportAt = 0;
+   }
+   loadPace();
+   compileRules();
+   uint8_t view = preferences.getUChar("view", 0);
+   viewCycle = RTD_COUNT > 1 && view >= RTD_COUNT;
+   showView(view < RTD_COUNT && rtdChannels.isEnabled(view) ? view : 0);
+   labelUntil = 0;
+ 
+   // Staggered auto conversions from here on
+   rtdChannels.start();
+ 
+   // Everything after this shares the bus through the arbiter
+   rtdChannels.setArbiter(&spiBus);
+   display.driver().setArbiter(&spiBus);
+   spiBus.setPreempt(sensorWaiting);
  }
  
  void loop() {
    handleButtons();
  
+   handleConsole();
+ 
    if (currentMode == MODE_RUN) {
-     static unsigned long lastTempRead = 0;
-     
-     // Read every 200ms
-     if (millis() - lastTempRead >= 200) {
-       lastTempRead = millis();
-       
-       // 1. Clear any stuck faults so we can read fresh
-       uint8_t fault = thermo.readFault();
-       if (fault) {
-         thermo.clearFault();
-       }
-       
-       // 2. Force Read Temperature
-       // We do not put this in an 'else'. We read no matter what.
-       float tempVal = thermo.temperature(R_NOMINAL, R_REF);
-       
-       // 3. Update Global
-       currentTempC = tempVal;
-       
-       handleAudioLogic(currentTempC);
-     }
-     
-     // Check for catastrophic failure (0 ohms = ~ -242C)
-     if (currentTempC < -200) {
-       lc.setChar(0, 0, 'E', false);
-       lc.setChar(0, 1, 'r', false);
-       lc.setChar(0, 2, 'r', false);
-       lc.setChar(0, 3, ' ', false);
-     } else {
-       displayFloat(currentTempC);
-     }
-   } 
-   else if (currentMode == MODE_SET_THRESH) {
-     displayFloat(configThreshold); 
+     readChannels();
+     displayRun();
    } 
-   else if (currentMode == MODE_SET_STEP) {
-     displayFloat(configStepSize);
+   else if (displayLabel()) {
+     // Names the value that follows
+   }
+   else if (currentMode == MODE_EDIT && editField < editFieldCount) {
+     const RuleField& f = editFields[editField];
+     const AlarmRule& rule = alarmRules.get(f.rule);
+     displayFloat((f.which == 0 ? rule.a : rule.b) / 10.0f);
    }
    
+   telemetry.service(millis());
+   spiBus.service();   // Display flushes, once no sensor is waiting
    delay(10);
  }
  
- // --- AUDIO LOGIC ---
- void handleAudioLogic(float temp) {
-   if (temp < configThreshold) {
-     lastBandIndex = -1; 
-     return;
+ // --- SENSORS ---
+ // Every finished conversion goes to telemetry; the chirp logic gets each
+ // probe's mean over its pacer's interval (a paced one-shot probe: each
+ // reading), and the interval is chosen again after every report.
+ void readChannels() {
+   RtdReading readings[RTD_MAX_CHANNELS];
+   uint8_t n = rtdChannels.poll(readings);
+   for (uint8_t i = 0; i < n; i++) {
+     // Faults were cleared in poll(); the reading is used no matter what
+     uint8_t ch = readings[i].channel;
+     uint16_t rtd = readings[i].rtd;
+     float tempVal = rtdChannels.temperature(ch, rtd, R_NOMINAL, R_REF);
+     ColumnProbe& probe = probes[ch];
+     probe.sum += tempVal;
+     probe.count++;
+ 
+     // Queue for telemetry (sent in batches)
+     TelemetrySample sample;
+     sample.timestampMs = millis();
+     sample.rtd = rtd;
+     sample.tempMilli = (int32_t)lroundf(tempVal * 1000.0f);
+     sample.fault = readings[i].fault;
+     sample.band = (int8_t)constrain(probe.rules.band(), -1, 127);
+     sample.channel = ch;
+     telemetry.addSample(sample);
    }
-   float diff = temp - configThreshold;
-   int currentBand = (int)(diff / configStepSize);
  
-   if (currentBand > lastBandIndex) {
-     playChirp(true);
-     lastBandIndex = currentBand;
-   } 
-   else if (currentBand < lastBandIndex) {
-     if (currentBand >= 0) playChirp(false);
-     lastBandIndex = currentBand;
+   unsigned long now = millis();
+   for (uint8_t i = 0; i < RTD_COUNT; i++) {
+     ColumnProbe& probe = probes[i];
+     if (probe.count == 0) continue;
+     if (!rtdChannels.isPaced(i) && now - probe.reportAt < probe.pacer.interval()) continue;
+     probe.reportAt = now;
+     probe.tempC = probe.sum / probe.count;
+     probe.sum = 0.0;
+     probe.count = 0;
+     handleAudioLogic(i);
+     uint32_t interval = probe.pacer.pace(probe.tempC, now, probe.rules.edgeDistance(probe.tempC),
+                                         probe.rules.nearBands(probe.tempC));
+    rtdChannels.setInterval(i, interval);
    }
  }
  
- void playChirp(bool goingUp) {
+ // Preempt hook for spiBus: hold display flushes while a conversion waits
+ bool sensorWaiting() {
+   return currentMode == MODE_RUN && rtdChannels.anyReady();
+ }
+ 
+ // --- AUDIO LOGIC ---
+ // One sound per report: alarm over long tone over chirp, none inside a silence range
+ void handleAudioLogic(uint8_t ch) {
+   ColumnProbe& probe = probes[ch];
+   RuleEvents ev = probe.rules.update(probe.tempC, millis());
+   if (ev.silenced) return;
+   uint32_t pct = CHIRP_VOICE_PCT[ch];
+   if (ev.alarm) tone(PIN_BUZZER, 3500 * pct / 100, ALARM_MS);
+   else if (ev.lowTone) tone(PIN_BUZZER, 600 * pct / 100, LOW_TONE_MS);
+   else if (ev.chirp == CHIRP_UP) playChirp(ch, true);
+   else if (ev.chirp == CHIRP_DOWN) playChirp(ch, false);
+ }
+ 
+ // Same chirps for every probe, pitched down for the lower ones
+ void playChirp(uint8_t ch, bool goingUp) {
+   uint32_t pct = CHIRP_VOICE_PCT[ch];
    if (goingUp) {
-     tone(PIN_BUZZER, 2500, 50); delay(70); tone(PIN_BUZZER, 3000, 50);
+     tone(PIN_BUZZER, 2500 * pct / 100, 50); delay(70); tone(PIN_BUZZER, 3000 * pct / 100, 50);
    } else {
-     tone(PIN_BUZZER, 1000, 150); 
+     tone(PIN_BUZZER, 1000 * pct / 100, 150); 
    }
  }
  
  // --- INPUT HANDLING ---
+ // Presses made while loop() was busy (a chirp, the startup sequence) still
+ // arrive. UP/DOWN repeat while held, faster the longer they are.
  void handleButtons() {
-   bool btnMode = (digitalRead(PIN_BTN_MODE) == LOW);
-   bool btnUp   = (digitalRead(PIN_BTN_UP) == LOW);
-   bool btnDown = (digitalRead(PIN_BTN_DOWN) == LOW);
-   unsigned long now = millis();
- 
-   static bool lastModeBtnState = false;
-   if (btnMode && !lastModeBtnState) {
-     if (now - lastInputTime > 200) { 
+   ButtonEvent ev;
+   while (buttons.next(ev)) {
+     if (ev.button == BTN_MODE) {
+       if (ev.type != BUTTON_PRESS) continue;
        cycleMode();
        tone(PIN_BUZZER, 2000, 50);
-       lastInputTime = now;
+     } else if (ev.type == BUTTON_PRESS || ev.type == BUTTON_REPEAT) {
+       modifyValue(ev.button == BTN_UP, ev.button == BTN_DOWN);
      }
    }
-   lastModeBtnState = btnMode;
- 
-   if (btnUp || btnDown) {
-     if (!buttonHeld) {
-       modifyValue(btnUp, btnDown);
-       buttonHeld = true;
-       buttonHoldStart = now;
-       lastInputTime = now;
-     } else {
-       if ((now - buttonHoldStart > 400) && (now - lastInputTime > 100)) {
-          modifyValue(btnUp, btnDown);
-          lastInputTime = now;
-       }
+ }
+ 
+ // MODE steps run -> each value of the shown probe's rules -> run
+ void cycleMode() {
+   if (currentMode == MODE_RUN) {
+     editFieldCount = ruleFields(alarmRules, viewChannel, editFields, 2 * RULES_MAX);
+     editField = 0;
+     if (editFieldCount > 0) {
+       currentMode = MODE_EDIT;
+       if (RTD_COUNT > 1) showView(viewChannel);   // "Ch n" first, then the value's name
+       showEditField();
      }
    } else {
-     buttonHeld = false;
+     saveSettings();
+     clearLabel();   // Pressed on past "Ch n" or the last value's name
+     if (++editField >= editFieldCount) {
+       currentMode = MODE_RUN;
+       compileRules();
+     } else {
+       showEditField();
+     }
    }
+   display.clear();
  }
  
- void cycleMode() {
-   if (currentMode != MODE_RUN) saveSettings();
-   if (currentMode == MODE_RUN) currentMode = MODE_SET_THRESH;
-   else if (currentMode == MODE_SET_THRESH) currentMode = MODE_SET_STEP;
-   else currentMode = MODE_RUN;
-   lc.clearDisplay(0);
+ // Names the value about to be edited, unless it's the plain threshold/step
+ // pair the buttons always edited
+ void showEditField() {
+   bool plain = editFieldCount == 2 && alarmRules.get(editFields[0].rule).kind == RULE_BANDS;
+   if (plain) return;
+   const RuleField& f = editFields[editField];
+   queueLabel(ruleFieldLabel(alarmRules.get(f.rule).kind, f.which));
  }
  
  void saveSettings() {
-   preferences.putFloat("thresh", configThreshold);
-   preferences.putFloat("step", configStepSize);
+   uint8_t blob[RULES_BLOB_MAX];
+   size_t len = alarmRules.toBlob(blob, sizeof(blob));
+   if (len > 0) preferences.putBytes("rules", blob, len);
+ }
+ 
+ // The table from NVS, or one bands rule per probe from the old threshold/step keys
+ void loadRules() {
+   uint8_t blob[RULES_BLOB_MAX];
+   size_t len = preferences.getBytesLength("rules");
+   if (len > 0 && len <= sizeof(blob) && preferences.getBytes("rules", blob, len) == len &&
+       alarmRules.fromBlob(blob, len)) {
+     return;
+   }
+   alarmRules.clear();
+   for (uint8_t i = 0; i < RTD_COUNT; i++) {
+     char key[12];
+     prefKey(key, "thresh", i);
+     float threshold = preferences.getFloat(key, THRESHOLD_DEFAULT);
+     prefKey(key, "step", i);
+     alarmRules.setBands(i, threshold, preferences.getFloat(key, STEP_DEFAULT));
+   }
+ }
+ 
+ // Sampling limits for every probe, as saved by "pace"
+ void loadPace() {
+   uint32_t lo = preferences.getUInt("paceMin", PACE_MIN_MS_DEFAULT);
+   uint32_t hi = preferences.getUInt("paceMax", PACE_MAX_MS_DEFAULT);
+   for (uint8_t i = 0; i < RTD_COUNT; i++) probes[i].pacer.setLimits(lo, hi);
+ }
+ 
+ // Rebuilds each probe's engine after the table changed
+ void compileRules() {
+   if (rulesCompiled == alarmRules.getGeneration()) return;
+   rulesCompiled = alarmRules.getGeneration();
+   for (uint8_t i = 0; i < RTD_COUNT; i++) probes[i].rules.compile(alarmRules, i);
+ }
+ 
+ // "thresh", "step" for the first probe, "thresh2", "step2"... for the rest
+ // (read once, to carry settings over into the rule table)
+ void prefKey(char* out, const char* base, uint8_t ch) {
+   if (ch == 0) strcpy(out, base);
+   else sprintf(out, "%s%u", base, ch + 1);
  }
  
  void modifyValue(bool up, bool down) {
-   float direction = up ? 1.0 : -1.0;
-   if (currentMode == MODE_SET_THRESH) {
-     configThreshold += (0.5 * direction);
-     if (configThreshold < 0) configThreshold = 0;
-     if (configThreshold > 500) configThreshold = 500;
+   if (currentMode == MODE_RUN) {
+     selectView(up);
    }
-   else if (currentMode == MODE_SET_STEP) {
-     configStepSize += (0.1 * direction);
-     if (configStepSize < 0.1) configStepSize = 0.1;
-     if (configStepSize > 10.0) configStepSize = 10.0;
+   else if (currentMode == MODE_EDIT && editField < editFieldCount) {
+     const RuleField& f = editFields[editField];
+     const AlarmRule& rule = alarmRules.get(f.rule);
+     int16_t value = f.which == 0 ? rule.a : rule.b;
+     alarmRules.setValue(f.rule, f.which, adjustRuleValue(rule.kind, f.which, value, up));
    }
  }
  
- // --- DISPLAY HELPERS ---
- void displayFloat(float val) {
-   // Range Limit
-   if (val > 999.9) val = 999.9;
-   if (val < -99.9) val = -99.9;
-   
-   bool isNegative = (val < 0);
-   if (isNegative) val = -val;
-   
-   int valToDisplay = (int)(val * 10 + 0.5); 
-   
-   int d1 = valToDisplay % 10;           
-   int d2 = (valToDisplay / 10) % 10;    
-   int d3 = (valToDisplay / 100) % 10;   
-   int d4 = (valToDisplay / 1000) % 10;  
-   
-   lc.setDigit(0, 3, d1, false);   // Decimal (Rightmost)
-   lc.setDigit(0, 2, d2, true);    // Ones + Dot
-   
-   // Clean zero handling
-   if (valToDisplay < 100) lc.setChar(0, 1, ' ', false);
-   else lc.setDigit(0, 1, d3, false);
-   
-   if (valToDisplay < 1000) {
-      if (isNegative) lc.setChar(0, 0, '-', false);
-      else lc.setChar(0, 0, ' ', false);
+ // --- SERIAL CONSOLE ---
+ // Text commands on USB CDC; replies go back as telemetry text frames
+ // (tools/chirp_telemetry.py cmd PORT "rules")
+ void handleConsole() {
+   while (Serial.available() > 0) {
+     char c = Serial.read();
+     if (c == '\r') continue;
+     if (c != '\n') {
+       if (consoleLen < sizeof(consoleLine) - 1) consoleLine[consoleLen++] = c;
+       continue;
+     }
+     consoleLine[consoleLen] = '\0';
+     consoleLen = 0;
+     runCommand(consoleLine);
+   }
+ }
+ 
+ //   rules              list the table
+ //   add CH KIND ...    e.g. "add 1 below 165", "add * silence 175 178"
+ //   del N              remove rule N (from "rules")
+ //   clear              remove every rule
+ //   pace [MIN MAX]     each probe's sampling interval; MIN MAX (ms) sets the limits
+ void runCommand(char* line) {
+   char reply[48];
+   if (!strcmp(line, "rules")) {
+     for (uint8_t i = 0; i < alarmRules.size(); i++) {
+       char rule[32];
+       formatRule(alarmRules.get(i), rule, sizeof(rule));
+       snprintf(reply, sizeof(reply), "%u: %s\n", i + 1, rule);
+       telemetry.sendText(reply);
+     }
+     if (alarmRules.size() == 0) telemetry.sendText("no rules\n");
+     return;
+   }
+ 
+   if (!strcmp(line, "pace") || !strncmp(line, "pace ", 5)) {
+     unsigned long lo, hi;
+     if (sscanf(line, "pace %lu %lu", &lo, &hi) == 2) {
+       preferences.putUInt("paceMin", lo);
+       preferences.putUInt("paceMax", hi);
+       loadPace();
+     }
+     for (uint8_t i = 0; i < RTD_COUNT; i++) {
+       const SamplePacer& p = probes[i].pacer;
+       snprintf(reply, sizeof(reply), "%u: %lu ms (%lu-%lu)%s\n", i + 1, (unsigned long)p.interval(),
+                (unsigned long)p.getMin(), (unsigned long)p.getMax(), rtdChannels.isPaced(i) ? " one-shot" : "");
+       telemetry.sendText(reply);
+     }
+     return;
+   }
+ 
+   bool ok;
+   const char* error = "";
+   if (!strncmp(line, "add ", 4)) {
+     AlarmRule rule;
+     ok = parseRule(line + 4, rule, RTD_COUNT, &error);
+     if (ok && !alarmRules.add(rule)) {
+       ok = false;
+       error = "rule table full";
+     }
+   } else if (!strncmp(line, "del ", 4)) {
+     ok = alarmRules.remove(atoi(line + 4) - 1);
+     error = "no such rule";
+   } else if (!strcmp(line, "clear")) {
+     alarmRules.clear();
+     ok = true;
    } else {
-      lc.setDigit(0, 0, d4, false);
+     telemetry.sendText("commands: rules, add CH KIND VALUE [VALUE], del N, clear, pace [MIN MAX]\n");
+     return;
    }
- }
\ No newline at end of file
+ 
+   if (ok) {
+     saveSettings();
+     compileRules();
+     // Values being edited on the buttons may have moved
+     if (currentMode == MODE_EDIT) {
+       currentMode = MODE_RUN;
+       clearLabel();
+       display.clear();
+     }
+   }
+   if (ok) snprintf(reply, sizeof(reply), "ok, %u rules\n", alarmRules.size());
+   else snprintf(reply, sizeof(reply), "error: %s\n", error);
+   telemetry.sendText(reply);
+ }
+ 
+ // --- PROBE SELECTION ---
+ // Run mode UP/DOWN steps through the probes that are fitted, then "CYCL"
+ void selectView(bool up) {
+   if (RTD_COUNT < 2) return;
+   uint8_t options = RTD_COUNT + 1;   // Probes, then cycling
+   uint8_t pos = viewCycle ? RTD_COUNT : viewChannel;
+   do {
+     pos = (pos + (up ? 1 : options - 1)) % options;
+   } while (pos < RTD_COUNT && !rtdChannels.isEnabled(pos));
+ 
+   viewCycle = (pos == RTD_COUNT);
+   showView(viewCycle ? viewChannel : pos);
+   if (viewCycle) showLabel("CYCL");
+   preferences.putUChar("view", pos);
+ }
+ 
+ void showView(uint8_t ch) {
+   viewChannel = ch;
+   viewSince = millis();
+   if (RTD_COUNT < 2) return;
+   char label[5];
+   sprintf(label, "Ch %u", ch + 1);
+   showLabel(label);
+ }
+ 
+ void displayRun() {
+   if (viewCycle && millis() - viewSince >= CHANNEL_SHOW_MS) {
+     uint8_t ch = viewChannel;
+     do {
+       ch = (ch + 1) % RTD_COUNT;
+     } while (!rtdChannels.isEnabled(ch));
+     showView(ch);
+   }
+ 
+   if (displayLabel()) return;
+   // Check for catastrophic failure (0 ohms = ~ -242C)
+   if (probes[viewChannel].tempC < -200) {
+     display.displayText("Err");
+   } else {
+     displayFloat(probes[viewChannel].tempC);
+   }
+ }
+ 
+ // --- DISPLAY HELPERS ---
+ // A short label ("Ch 2", "thr") before the reading or value it names
+ void showLabel(const char* text) {
+   strncpy(viewLabel, text, sizeof(viewLabel) - 1);
+   viewLabel[sizeof(viewLabel) - 1] = '\0';
+   labelUntil = millis() + LABEL_MS;
+   nextLabel[0] = '\0';
+ }
+ 
+ // After the label showing now, if any, instead of over it
+ void queueLabel(const char* text) {
+   if ((long)(labelUntil - millis()) <= 0) {
+     showLabel(text);
+     return;
+   }
+   strncpy(nextLabel, text, sizeof(nextLabel) - 1);
+   nextLabel[sizeof(nextLabel) - 1] = '\0';
+ }
+ 
+ void clearLabel() {
+   labelUntil = millis();
+   nextLabel[0] = '\0';
+ }
+ 
+ bool displayLabel() {
+   if ((long)(labelUntil - millis()) <= 0) {
+     if (nextLabel[0] == '\0') return false;
+     char text[sizeof(nextLabel)];
+     strcpy(text, nextLabel);
+     showLabel(text);
+   }
+   display.displayText(viewLabel);
+   return true;
+ }
+ 
+ // One decimal place, same range as before. The display compares against what
+ // it last sent, so calling this every loop pass only costs SPI traffic when
+ // the shown tenths actually change.
+ void displayFloat(float val) {
+   display.displayFixed(displayTenths(val), 1);
+ }
@@ -0,0 +1,96 @@
+/*
+ * Chirp logic bench - per-reading cost of the rule engine and pacer
+ *
+ * Google Benchmark timings for what readChannels() runs on every report:
+ * RuleEngine::update() (the old single bands rule, and a full table),
+ * RuleEngine::edgeDistance() and SamplePacer::pace().
+ *
+ * Built by the CMakeLists.txt at the top of the repository
+ * (cmake --build <dir> --target chirp_logic_bench).
+ */
+
+#include <benchmark/benchmark.h>
+#include "chirp_logic.h"
+#include "chirp_rules.h"
+#include "sample_pacer.h"
+
+// A reading wandering over 150-200 C, so edges get crossed both ways
+static float wander(uint32_t i) {
+  return 175.0f + 25.0f * sinf(i * 0.001f) + 0.05f * (float)((i * 2654435761u) >> 28);
+}
+
+static void fullTable(RuleTable& table) {
+  table.setBands(0, 170.0f, 0.5f);
+  table.add({RULE_RATE, 0, 100, 0});
+  table.add({RULE_SILENCE, RULE_ALL_CHANNELS, 1500, 1520});
+  for (int16_t i = 0; table.size() < RULES_MAX; i++) {
+    table.add({(uint8_t)(i & 1 ? RULE_ABOVE : RULE_BELOW), 0, (int16_t)(1550 + i * 37), 0});
+  }
+}
+
+static void BM_ChirpBands(benchmark::State& state) {
+  ChirpBands bands;
+  uint32_t i = 0;
+  for (auto _ : state) benchmark::DoNotOptimize(bands.update(wander(i++), 170.0f, 0.5f));
+}
+BENCHMARK(BM_ChirpBands);
+
+static void BM_RulesBandsOnly(benchmark::State& state) {
+  RuleTable table;
+  table.setBands(0, 170.0f, 0.5f);
+  RuleEngine engine;
+  engine.compile(table, 0);
+  uint32_t i = 0;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(engine.update(wander(i), i * 200));
+    i++;
+  }
+}
+BENCHMARK(BM_RulesBandsOnly);
+
+static void BM_RulesFullTable(benchmark::State& state) {
+  RuleTable table;
+  fullTable(table);
+  RuleEngine engine;
+  engine.compile(table, 0);
+  uint32_t i = 0;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(engine.update(wander(i), i * 200));
+    i++;
+  }
+}
+BENCHMARK(BM_RulesFullTable);
+
+static void BM_RulesCompile(benchmark::State& state) {
+  RuleTable table;
+  fullTable(table);
+  RuleEngine engine;
+  for (auto _ : state) {
+    engine.compile(table, 0);
+    benchmark::ClobberMemory();
+  }
+}
+BENCHMARK(BM_RulesCompile);
+
+static void BM_EdgeDistance(benchmark::State& state) {
+  RuleTable table;
+  fullTable(table);
+  RuleEngine engine;
+  engine.compile(table, 0);
+  uint32_t i = 0;
+  for (auto _ : state) benchmark::DoNotOptimize(engine.edgeDistance(wander(i++)));
+}
+BENCHMARK(BM_EdgeDistance);
+
+static void BM_Pace(benchmark::State& state) {
+  SamplePacer pacer;
+  uint32_t i = 0;
+  for (auto _ : state) {
+    float t = wander(i);
+    benchmark::DoNotOptimize(pacer.pace(t, i * 200, bandEdgeDistance(t, 170.0f, 0.5f), nearBands(t, 170.0f, 0.5f)));
+    i++;
+  }
+}
+BENCHMARK(BM_Pace);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,305 @@
+/*
+ * Chirp logic unit tests - bands, rules, button editing and the display clamp
+ *
+ * handleAudioLogic() is RuleEngine::update() plus tone() calls, and
+ * modifyValue() is adjustRuleValue() and RuleTable::setValue(), so these
+ * cover what the sketch decides without any of its hardware.
+ *
+ * Built by the CMakeLists.txt at the top of the repository.
+ */
+
+#include <gtest/gtest.h>
+#include "chirp_logic.h"
+#include "chirp_rules.h"
+
+// --- Bands ---
+
+TEST(Bands, BandForTemp) {
+  EXPECT_EQ(-1, bandForTemp(169.9f, 170.0f, 0.5f));
+  EXPECT_EQ(0, bandForTemp(170.0f, 170.0f, 0.5f));
+  EXPECT_EQ(0, bandForTemp(170.4f, 170.0f, 0.5f));
+  EXPECT_EQ(1, bandForTemp(170.5f, 170.0f, 0.5f));
+  EXPECT_EQ(20, bandForTemp(180.2f, 170.0f, 0.5f));
+}
+
+TEST(Bands, EdgeDistance) {
+  EXPECT_NEAR(10.0f, bandEdgeDistance(160.0f, 170.0f, 0.5f), 1e-4f);
+  EXPECT_NEAR(0.1f, bandEdgeDistance(170.1f, 170.0f, 0.5f), 1e-4f);
+  EXPECT_NEAR(0.1f, bandEdgeDistance(170.4f, 170.0f, 0.5f), 1e-4f);
+  EXPECT_NEAR(0.25f, bandEdgeDistance(170.25f, 170.0f, 0.5f), 1e-4f);
+}
+
+TEST(Bands, ChirpsOncePerBandCrossed) {
+  ChirpBands bands;
+  EXPECT_EQ(CHIRP_NONE, bands.update(160.0f, 170.0f, 0.5f));
+  EXPECT_EQ(CHIRP_UP, bands.update(170.1f, 170.0f, 0.5f));
+  EXPECT_EQ(CHIRP_NONE, bands.update(170.3f, 170.0f, 0.5f));
+  EXPECT_EQ(CHIRP_UP, bands.update(170.6f, 170.0f, 0.5f));
+  EXPECT_EQ(1, bands.band());
+}
+
+TEST(Bands, SkippingBandsChirpsOnce) {
+  ChirpBands bands;
+  bands.update(160.0f, 170.0f, 0.5f);
+  EXPECT_EQ(CHIRP_UP, bands.update(173.0f, 170.0f, 0.5f));
+  EXPECT_EQ(6, bands.band());
+}
+
+TEST(Bands, DownwardAboveThresholdOnly) {
+  ChirpBands bands;
+  bands.update(171.2f, 170.0f, 0.5f);
+  EXPECT_EQ(CHIRP_DOWN, bands.update(170.7f, 170.0f, 0.5f));
+  EXPECT_EQ(CHIRP_DOWN, bands.update(170.2f, 170.0f, 0.5f));
+  // Falling below the threshold is silent
+  EXPECT_EQ(CHIRP_NONE, bands.update(169.0f, 170.0f, 0.5f));
+  EXPECT_EQ(-1, bands.band());
+}
+
+TEST(Bands, StartingAboveThresholdChirps) {
+  ChirpBands bands;
+  EXPECT_EQ(CHIRP_UP, bands.update(175.0f, 170.0f, 0.5f));
+}
+
+// --- Settings ---
+
+TEST(Settings, ThresholdStepsAndClamps) {
+  EXPECT_FLOAT_EQ(170.5f, adjustThreshold(170.0f, true));
+  EXPECT_FLOAT_EQ(169.5f, adjustThreshold(170.0f, false));
+  EXPECT_FLOAT_EQ(THRESHOLD_MAX, adjustThreshold(THRESHOLD_MAX, true));
+  EXPECT_FLOAT_EQ(THRESHOLD_MIN, adjustThreshold(THRESHOLD_MIN, false));
+}
+
+TEST(Settings, StepStepsAndClamps) {
+  EXPECT_NEAR(0.6f, adjustStep(0.5f, true), 1e-5f);
+  EXPECT_NEAR(STEP_MIN, adjustStep(STEP_MIN, false), 1e-5f);
+  EXPECT_NEAR(STEP_MAX, adjustStep(STEP_MAX, true), 1e-5f);
+}
+
+TEST(Settings, DisplayTenthsRoundsAndClamps) {
+  EXPECT_EQ(1705, displayTenths(170.46f));
+  EXPECT_EQ(-12, displayTenths(-1.24f));
+  EXPECT_EQ(9999, displayTenths(5000.0f));
+  EXPECT_EQ(-999, displayTenths(-242.0f));
+}
+
+// --- Rule table and button editing (modifyValue) ---
+
+TEST(RuleEdit, AdjustRuleValueUsesEachKindsIncrement) {
+  EXPECT_EQ(1705, adjustRuleValue(RULE_BANDS, 0, 1700, true));
+  EXPECT_EQ(6, adjustRuleValue(RULE_BANDS, 1, 5, true));
+  EXPECT_EQ(RULE_STEP_MIN, adjustRuleValue(RULE_BANDS, 1, RULE_STEP_MIN, false));
+  EXPECT_EQ(RULE_TEMP_MAX, adjustRuleValue(RULE_ABOVE, 0, RULE_TEMP_MAX, true));
+  EXPECT_EQ(RULE_RATE_MIN, adjustRuleValue(RULE_RATE, 0, RULE_RATE_MIN, false));
+}
+
+TEST(RuleEdit, SetValueKeepsRulesValid) {
+  RuleTable table;
+  ASSERT_TRUE(table.add({RULE_SILENCE, 0, 1000, 1100}));
+  table.setValue(0, 0, 1200);   // low above high: refused
+  EXPECT_EQ(1000, table.get(0).a);
+  uint32_t gen = table.getGeneration();
+  table.setValue(0, 0, 1050);
+  EXPECT_EQ(1050, table.get(0).a);
+  EXPECT_NE(gen, table.getGeneration());
+}
+
+TEST(RuleEdit, FieldsForAProbe) {
+  RuleTable table;
+  table.setBands(0, 170.0f, 0.5f);
+  table.add({RULE_ABOVE, 1, 1900, 0});
+  table.add({RULE_SILENCE, RULE_ALL_CHANNELS, 200, 300});
+  RuleField fields[2 * RULES_MAX];
+  ASSERT_EQ(4, ruleFields(table, 0, fields, 2 * RULES_MAX));
+  EXPECT_EQ(0, fields[0].rule);
+  EXPECT_EQ(1, fields[1].which);
+  EXPECT_EQ(2, fields[2].rule);
+  EXPECT_STREQ("thr", ruleFieldLabel(RULE_BANDS, 0));
+  EXPECT_STREQ("qHi", ruleFieldLabel(RULE_SILENCE, 1));
+}
+
+TEST(RuleEdit, BandsRuleReplacesTheProbesOwn) {
+  RuleTable table;
+  table.setBands(0, 170.0f, 0.5f);
+  table.setBands(0, 150.0f, 1.0f);
+  ASSERT_EQ(1, table.size());
+  EXPECT_EQ(1500, table.get(0).a);
+}
+
+TEST(RuleText, ParseAndFormat) {
+  AlarmRule r;
+  ASSERT_TRUE(parseRule("2 above 190.5", r, 4));
+  EXPECT_EQ(RULE_ABOVE, r.kind);
+  EXPECT_EQ(1, r.channel);
+  EXPECT_EQ(1905, r.a);
+  char text[32];
+  formatRule(r, text, sizeof(text));
+  EXPECT_STREQ("2 above 190.5", text);
+
+  ASSERT_TRUE(parseRule("* silence 20 30", r, 4));
+  EXPECT_EQ(RULE_ALL_CHANNELS, r.channel);
+  formatRule(r, text, sizeof(text));
+  EXPECT_STREQ("* silence 20.0 30.0", text);
+}
+
+TEST(RuleText, RejectsMalformed) {
+  AlarmRule r;
+  EXPECT_FALSE(parseRule("1 bands 170", r, 4));        // Needs a step
+  EXPECT_FALSE(parseRule("1 above 170 5", r, 4));      // Takes one value
+  EXPECT_FALSE(parseRule("1 rate 0", r, 4));           // Below RULE_RATE_MIN
+  EXPECT_FALSE(parseRule("1 silence 30 20", r, 4));    // Empty range
+  EXPECT_FALSE(parseRule("0 above 170", r, 4));
+  EXPECT_FALSE(parseRule("1 warmer 170", r, 4));
+  EXPECT_FALSE(parseRule("1 above hot", r, 4));
+}
+
+// Only probes that are fitted, with the reason for the console
+TEST(RuleText, RejectsMissingProbe) {
+  AlarmRule r;
+  const char* error = nullptr;
+  EXPECT_TRUE(parseRule("2 above 170", r, 2, &error));
+  EXPECT_FALSE(parseRule("3 above 170", r, 2, &error));
+  EXPECT_STREQ("no such probe", error);
+  EXPECT_FALSE(parseRule("9 above 170", r, 4, &error));
+  EXPECT_STREQ("no such probe", error);
+  EXPECT_TRUE(parseRule("* above 170", r, 1, &error));
+
+  EXPECT_FALSE(parseRule("1 warmer 170", r, 4, &error));
+  EXPECT_STREQ("unknown kind", error);
+  EXPECT_FALSE(parseRule("1 rate 0", r, 4, &error));
+  EXPECT_STREQ("value out of range", error);
+}
+
+TEST(RuleTable, BlobRoundTrip) {
+  RuleTable table;
+  table.setBands(0, 170.0f, 0.5f);
+  table.add({RULE_RATE, 0, 50, 0});
+  uint8_t blob[RULES_BLOB_MAX];
+  size_t len = table.toBlob(blob, sizeof(blob));
+  ASSERT_EQ(1 + 2 * sizeof(AlarmRule), len);
+
+  RuleTable loaded;
+  ASSERT_TRUE(loaded.fromBlob(blob, len));
+  ASSERT_EQ(2, loaded.size());
+  EXPECT_EQ(RULE_RATE, loaded.get(1).kind);
+
+  blob[0] = RULES_BLOB_VERSION + 1;
+  EXPECT_FALSE(loaded.fromBlob(blob, len));
+  EXPECT_FALSE(loaded.fromBlob(blob, len - 1));
+  EXPECT_EQ(2, loaded.size());   // Unchanged by a bad blob
+}
+
+// --- Evaluation (handleAudioLogic) ---
+
+class Engine : public ::testing::Test {
+protected:
+  RuleTable table;
+  RuleEngine engine;
+  uint32_t now = 0;
+
+  RuleEvents feed(float temp) {
+    now += 200;
+    return engine.update(temp, now);
+  }
+};
+
+TEST_F(Engine, BandsChirp) {
+  table.setBands(0, 170.0f, 0.5f);
+  engine.compile(table, 0);
+  EXPECT_EQ(CHIRP_NONE, feed(160.0f).chirp);
+  EXPECT_EQ(CHIRP_UP, feed(170.2f).chirp);
+  EXPECT_EQ(CHIRP_UP, feed(170.6f).chirp);
+  EXPECT_EQ(CHIRP_DOWN, feed(170.2f).chirp);
+  EXPECT_EQ(0, engine.band());
+}
+
+TEST_F(Engine, OtherProbesRulesDontApply) {
+  table.setBands(1, 170.0f, 0.5f);
+  engine.compile(table, 0);
+  feed(160.0f);
+  EXPECT_EQ(CHIRP_NONE, feed(175.0f).chirp);
+  EXPECT_EQ(-1, engine.band());
+}
+
+TEST_F(Engine, AboveSoundsOnceThroughNoise) {
+  table.add({RULE_ABOVE, 0, 1900, 0});
+  engine.compile(table, 0);
+  feed(185.0f);
+  EXPECT_TRUE(feed(190.1f).alarm);
+  // Noise around the level: inside the hysteresis, no re-arm
+  EXPECT_FALSE(feed(189.9f).alarm);
+  EXPECT_FALSE(feed(190.1f).alarm);
+  // Back past the re-arm point, then up again
+  EXPECT_FALSE(feed(189.7f).alarm);
+  EXPECT_TRUE(feed(190.3f).alarm);
+}
+
+TEST_F(Engine, FirstSampleDoesntFire) {
+  table.add({RULE_ABOVE, 0, 1900, 0});
+  engine.compile(table, 0);
+  EXPECT_FALSE(feed(200.0f).alarm);
+}
+
+TEST_F(Engine, BelowGivesLowTone) {
+  table.add({RULE_BELOW, 0, 500, 0});
+  engine.compile(table, 0);
+  feed(60.0f);
+  RuleEvents ev = feed(49.0f);
+  EXPECT_TRUE(ev.lowTone);
+  EXPECT_FALSE(ev.alarm);
+  EXPECT_FALSE(feed(48.0f).lowTone);
+}
+
+TEST_F(Engine, SilenceRange) {
+  table.setBands(0, 170.0f, 0.5f);
+  table.add({RULE_SILENCE, RULE_ALL_CHANNELS, 1700, 1720});
+  engine.compile(table, 0);
+  feed(160.0f);
+  RuleEvents ev = feed(170.6f);
+  EXPECT_EQ(CHIRP_UP, ev.chirp);
+  EXPECT_TRUE(ev.silenced);
+  EXPECT_FALSE(feed(172.5f).silenced);
+}
+
+TEST_F(Engine, RateAlarm) {
+  table.add({RULE_RATE, 0, 100, 0});   // 10 degrees/minute
+  engine.compile(table, 0);
+  bool alarmed = false;
+  float temp = 100.0f;
+  for (int i = 0; i < 400 && !alarmed; i++) {
+    temp += 0.05f;   // 15 degrees/minute at one reading per 200 ms
+    alarmed = feed(temp).alarm;
+  }
+  EXPECT_TRUE(alarmed);
+  EXPECT_GT(engine.rate(), 10.0f);
+}
+
+TEST_F(Engine, SteadyRateDoesntAlarm) {
+  table.add({RULE_RATE, 0, 100, 0});
+  engine.compile(table, 0);
+  float temp = 100.0f;
+  for (int i = 0; i < 1000; i++) {
+    temp += 0.02f;   // 6 degrees/minute
+    EXPECT_FALSE(feed(temp).alarm) << "reading " << i;
+  }
+}
+
+TEST_F(Engine, EdgeDistance) {
+  EXPECT_TRUE(isinf(engine.edgeDistance(100.0f)));
+  table.setBands(0, 170.0f, 0.5f);
+  table.add({RULE_ABOVE, 0, 1610, 0});
+  engine.compile(table, 0);
+  // The level's re-arm point, 160.8, is nearer than the threshold
+  EXPECT_NEAR(0.8f, engine.edgeDistance(160.0f), 1e-3f);
+  EXPECT_NEAR(0.1f, engine.edgeDistance(160.9f), 1e-3f);
+  EXPECT_NEAR(0.2f, engine.edgeDistance(169.8f), 1e-3f);
+}
+
+TEST_F(Engine, NearBands) {
+  EXPECT_FALSE(engine.nearBands(500.0f));   // No bands rule
+  table.setBands(0, 170.0f, 0.5f);
+  engine.compile(table, 0);
+  EXPECT_FALSE(engine.nearBands(169.4f));
+  EXPECT_TRUE(engine.nearBands(169.6f));
+  EXPECT_TRUE(engine.nearBands(170.0f));
+  EXPECT_TRUE(engine.nearBands(400.0f));   // Bands have no top
+}
@@ -0,0 +1,160 @@
+/*
+ * Bus benchmark - SPI traffic of the temp_chirp loop with and without SpiArbiter
+ *
+ * Runs the sketch's MODE_RUN bus users against the mock core: RtdChannels
+ * reading auto-converting MAX31865s (mode 1) and the MAX7219 display
+ * (mode 0), one loop pass every ~10ms. Each chip's DRDY is modelled from
+ * when start() set it converting and when its CS last went low, so reads
+ * happen exactly when the firmware would make them.
+ *
+ * "direct" is each driver opening its own transaction per register access;
+ * "arbiter" routes both through SpiArbiter. For every probe count and
+ * display change rate it reports, per second of simulated time:
+ *
+ *   txn/s      beginTransaction() calls
+ *   switch/s   ...that changed SPI mode or clock
+ *   busy       share of time the bus was held (arbiter only)
+ *   wait       mean / max queue wait of display jobs (arbiter only)
+ *   read lat   DRDY-to-read latency, mean / max
+ *
+ * Build and run from this directory:
+ *   g++ -std=gnu++17 -O2 -I.. -Imock -I../../NTP_Clock/SevenSegmentDisplay \
+ *       -I../../NTP_Clock/SevenSegmentDisplay/bench/mock bus_bench.cpp -o bus_bench
+ *   ./bus_bench
+ */
+
+#include <stdio.h>
+#include "Arduino.h"
+#include "SPI.h"
+#include "MAX7219Display.h"
+#include "MAX7219Display.cpp"
+#include "rtd_channels.h"
+
+uint64_t mockBusNs = 0;
+SPIClass SPI;
+
+#define SIM_SECONDS 20
+#define PIN_CS_DISP 11
+
+static const RtdChannelPins PINS[RTD_MAX_CHANNELS] = {{10, 20}, {9, 21}, {8, 22}, {7, 23}};
+
+// --- DRDY model ---
+
+static uint64_t lastReadNs[64];   // By CS pin
+static uint64_t latencySumNs;
+static uint64_t latencyMaxNs;
+static uint32_t reads;
+
+// End of the newest conversion a chip has finished by now, or 0
+static uint64_t lastConversionEnd(int cs) {
+  uint64_t start = mockConversionStartNs[cs];
+  if (start == 0 || mockBusNs < start + RTD_CONVERSION_US * 1000ULL) return 0;
+  uint64_t period = RTD_CONVERSION_US * 1000ULL;
+  return start + (mockBusNs - start) / period * period;
+}
+
+static int csForDrdy(int pin) {
+  for (uint8_t i = 0; i < RTD_MAX_CHANNELS; i++) {
+    if (PINS[i].drdy == pin) return PINS[i].cs;
+  }
+  return -1;
+}
+
+static int pinRead(int pin) {
+  int cs = csForDrdy(pin);
+  if (cs < 0) return HIGH;
+  uint64_t end = lastConversionEnd(cs);
+  return end != 0 && end > lastReadNs[cs] ? LOW : HIGH;
+}
+
+// CS low on a chip with a result waiting is the read that releases DRDY
+static void pinWrite(int pin, int value) {
+  if (value != LOW || pin >= 64 || mockConversionStartNs[pin] == 0) return;
+  uint64_t end = lastConversionEnd(pin);
+  if (end == 0 || end <= lastReadNs[pin]) return;
+  uint64_t latency = mockBusNs - end;
+  latencySumNs += latency;
+  if (latency > latencyMaxNs) latencyMaxNs = latency;
+  reads++;
+  lastReadNs[pin] = mockBusNs;
+}
+
+// --- Loop ---
+
+static SpiArbiter* benchBus;
+static RtdChannels* benchRtd;
+static bool sensorWaiting() { return benchRtd->anyReady(); }
+
+static void run(uint8_t channels, uint32_t displayChangeMs, bool arbiter) {
+  memset(mockConversionStartNs, 0, sizeof(mockConversionStartNs));
+  memset(lastReadNs, 0, sizeof(lastReadNs));
+  latencySumNs = latencyMaxNs = 0;
+  reads = 0;
+
+  SpiArbiter bus;
+  RtdChannels rtd(PINS, channels);
+  MAX7219Driver<4> display(PIN_CS_DISP);
+  benchBus = &bus;
+  benchRtd = &rtd;
+
+  display.begin();
+  rtd.begin(MAX31865_3WIRE);
+  for (uint8_t i = 0; i < channels; i++) rtd.enable(i, true);
+  rtd.start();
+  if (arbiter) {
+    rtd.setArbiter(&bus);
+    display.setArbiter(&bus);
+    bus.setPreempt(sensorWaiting);
+  }
+
+  uint32_t startTxn = SPI.transactions;
+  uint32_t startSwitches = SPI.modeSwitches;
+  uint32_t startReads = reads;
+  unsigned long startMs = millis();
+  bus.resetStats();
+
+  int32_t shown = 1000;
+  unsigned long lastChange = 0;
+  RtdReading readings[RTD_MAX_CHANNELS];
+  while (millis() - startMs < SIM_SECONDS * 1000UL) {
+    rtd.poll(readings);
+    if (millis() - lastChange >= displayChangeMs) {
+      lastChange = millis();
+      shown++;
+    }
+    display.displayFixed(shown, 1);
+    if (arbiter) bus.service();
+    delayMicroseconds(150);   // Button reads, float math, telemetry
+    delay(10);
+  }
+
+  const SpiBusStats& stats = bus.getStats();
+  double seconds = (millis() - startMs) / 1000.0;
+  printf("%-8s %3u %7u %9.1f %9.1f", arbiter ? "arbiter" : "direct", channels, displayChangeMs,
+         (SPI.transactions - startTxn) / seconds, (SPI.modeSwitches - startSwitches) / seconds);
+  if (arbiter) {
+    printf(" %6.2f%% %6.1f/%5.1f", bus.utilization(),
+           stats.jobs ? stats.waitUsTotal / 1000.0 / stats.jobs : 0.0, stats.waitUsMax / 1000.0);
+  } else {
+    printf(" %7s %12s", "-", "-");
+  }
+  uint32_t n = reads - startReads;
+  printf(" %6.1f/%5.1f %7.1f\n", n ? latencySumNs / 1e6 / n : 0.0, latencyMaxNs / 1e6, n / seconds);
+}
+
+int main() {
+  mockPinRead = pinRead;
+  mockPinWrite = pinWrite;
+
+  printf("%-8s %3s %7s %9s %9s %7s %12s %12s %7s\n", "bus", "ch", "disp ms", "txn/s", "switch/s", "busy",
+         "wait ms", "read lat ms", "reads/s");
+  static const uint32_t displayRates[] = {200, 10};   // Run-mode reading; something changing every pass
+  for (uint32_t rate : displayRates) {
+    for (uint8_t ch = 1; ch <= 4; ch++) {
+      run(ch, rate, false);
+      run(ch, rate, true);
+    }
+    printf("\n");
+  }
+  return 0;
+}
@@ -0,0 +1,497 @@
+/*
+ * Chirp simulator - Replays a temperature trace through the temp_chirp run loop
+ *
+ * Runs the sketch's MODE_RUN path against virtual time: auto conversions
+ * averaged over the report period (or, with --oneshot, the older blocking
+ * one-shot reads; with --adaptive, SamplePacer choosing the period and
+ * paced one-shots as RtdChannels runs them), the chirp delays, ChirpBands
+ * from chirp_logic.h and the real SegmentFrame rendering. millis() comes from the mock core in
+ * NTP_Clock/SevenSegmentDisplay/bench/mock, and every delay() just advances
+ * it, so an hour of trace takes a fraction of a second.
+ *
+ * The trace is either a CSV from `chirp_telemetry.py decode`
+ * (ms,rtd,temp_c,...,channel; --channel picks one probe) or a synthetic ramp
+ * up and back down. Both are taken as the true
+ * temperature; --noise adds Gaussian sensor noise on top, from a fixed seed,
+ * so a run is repeatable. Against that truth it reports:
+ *
+ *   latency   time from the true temperature entering a band to its chirp
+ *   false     chirps the true temperature doesn't justify (noise, or a band
+ *             left again before the chirp)
+ *   missed    bands the true temperature entered and left without a chirp
+ *   bias on   share of the time the sensor's bias current flows (self-heating)
+ *
+ * Build and run from this directory:
+ *   g++ -std=gnu++17 -O2 -I.. -I../../NTP_Clock/SevenSegmentDisplay \
+ *       -I../../NTP_Clock/SevenSegmentDisplay/bench/mock chirp_sim.cpp -o chirp_sim
+ *   ./chirp_sim --ramp 160 180 30 --noise 0.05 --step 0.5
+ *   ./chirp_sim --threshold 78 --frames run.csv
+ *   ./chirp_sim --ramp 20 180 30 --noise 0.05 --adaptive 200 2000
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <vector>
+#include "Arduino.h"
+#include "chirp_logic.h"
+#include "sample_pacer.h"
+#include "SegmentFrame.h"
+
+uint64_t mockBusNs = 0;   // Virtual clock; millis() reads it
+
+// Same timing as the sketch
+#define READ_PERIOD_MS  200   // REPORT_MS: chirp logic runs on the mean over this long
+#define RTD_CONVERSION_US 16700 // rtd_channels.h: MAX31865 auto conversion, 60Hz filter
+#define RTD_READ_MS     75    // --oneshot: Adafruit readRTD(), 10ms bias settle + 65ms conversion
+#define RTD_PACED_MIN_MS 250  // rtd_channels.h: intervals from here up run paced one-shots...
+#define RTD_PACED_US    62500 // ...bias settle + one-shot conversion, not blocking
+#define CHIRP_UP_MS     70    // playChirp(true) blocks between its two tones
+#define LOOP_DELAY_MS   10    // delay(10) at the end of loop()
+
+#define MAX_BANDS 128         // Telemetry clamps the band to this too
+
+// --- Traces ---
+
+class Trace {
+public:
+  virtual ~Trace() {}
+  virtual float at(uint32_t ms) = 0;   // True temperature
+  virtual uint32_t length() const = 0; // ms
+};
+
+// Recorded run; linear interpolation between samples, ms rebased to 0
+class CsvTrace : public Trace {
+public:
+  bool load(const char* path, int channel) {
+    FILE* f = fopen(path, "r");
+    if (f == NULL) return false;
+
+    char line[128];
+    unsigned long first = 0;
+    while (fgets(line, sizeof(line), f) != NULL) {
+      unsigned long ms;
+      int rtd, fault, band, ch = 0;
+      float temp;
+      int fields = sscanf(line, "%lu,%d,%f,%d,%d,%d", &ms, &rtd, &temp, &fault, &band, &ch);
+      if (fields < 3) continue;  // Header
+      if (fields < 6) ch = 0;    // Recorded before there were channels
+      if (ch != channel) continue;
+      if (points.empty()) first = ms;
+      Point p = {(uint32_t)(ms - first), temp};
+      if (!points.empty() && p.ms <= points.back().ms) continue;
+      points.push_back(p);
+    }
+    fclose(f);
+    cursor = 0;
+    return points.size() >= 2;
+  }
+
+  float at(uint32_t ms) {
+    // Queries only move forward, so walk a cursor instead of searching
+    while (cursor + 2 < points.size() && points[cursor + 1].ms <= ms) cursor++;
+    const Point& a = points[cursor];
+    const Point& b = points[cursor + 1];
+    if (ms <= a.ms) return a.temp;
+    if (ms >= b.ms) return b.temp;
+    return a.temp + (b.temp - a.temp) * (float)(ms - a.ms) / (float)(b.ms - a.ms);
+  }
+
+  uint32_t length() const { return points.back().ms; }
+
+private:
+  struct Point {
+    uint32_t ms;
+    float temp;
+  };
+  std::vector<Point> points;
+  size_t cursor;
+};
+
+// Linear rise from -> to over minutes, then the same fall back down
+class RampTrace : public Trace {
+public:
+  RampTrace(float from, float to, float minutes)
+    : from(from), to(to), halfMs((uint32_t)(minutes * 60000.0f)) {}
+
+  float at(uint32_t ms) {
+    if (ms > halfMs) ms = 2 * halfMs - (ms < 2 * halfMs ? ms : 2 * halfMs);
+    return from + (to - from) * (float)ms / (float)halfMs;
+  }
+
+  uint32_t length() const { return 2 * halfMs; }
+
+private:
+  float from, to;
+  uint32_t halfMs;
+};
+
+// --- Sensor noise ---
+
+// xorshift64* and Box-Muller: same sequence on every host for a given seed
+class Noise {
+public:
+  Noise(float sigma, uint64_t seed) : sigma(sigma), state(seed ? seed : 1), spare(0), hasSpare(false) {}
+
+  float next() {
+    if (sigma <= 0.0f) return 0.0f;
+    if (hasSpare) {
+      hasSpare = false;
+      return spare * sigma;
+    }
+    double u1 = uniform(), u2 = uniform();
+    double r = sqrt(-2.0 * log(u1));
+    spare = (float)(r * sin(2.0 * M_PI * u2));
+    hasSpare = true;
+    return (float)(r * cos(2.0 * M_PI * u2)) * sigma;
+  }
+
+private:
+  float sigma;
+  uint64_t state;
+  float spare;
+  bool hasSpare;
+
+  double uniform() {
+    state ^= state >> 12;
+    state ^= state << 25;
+    state ^= state >> 27;
+    return ((state * 0x2545F4914F6CDD1DULL) >> 11) * (1.0 / 9007199254740992.0) + 1e-300;
+  }
+};
+
+// --- Display ---
+
+// 4-digit frame with no bus; flush() just notes that the frame changed
+class SimDisplay : public SegmentFrame<SimDisplay, 4, SegmentMapLinear> {
+public:
+  bool changed = false;
+
+  void flush() {
+    if (!frameDirty()) return;
+    memcpy(shown, frame, sizeof(frame));
+    changed = true;
+  }
+
+  // What a person would read off the digits, dots included
+  void text(char* out) const {
+    static const char GLYPHS[] = " 0123456789-AbCdEFHJLnoPrtUy";
+    int n = 0;
+    for (uint8_t i = 0; i < 4; i++) {
+      char c = '?';
+      for (const char* g = GLYPHS; *g != '\0'; g++) {
+        if (canonicalGlyph(*g) == (shown[0][i] & 0x7F)) {
+          c = *g;
+          break;
+        }
+      }
+      out[n++] = c;
+      if (shown[0][i] & 0x80) out[n++] = '.';
+    }
+    out[n] = '\0';
+  }
+};
+
+// --- Simulation ---
+
+struct Options {
+  float threshold = THRESHOLD_DEFAULT;
+  float step = STEP_DEFAULT;
+  uint32_t periodMs = READ_PERIOD_MS;
+  bool oneShot = false;
+  bool adaptive = false;
+  uint32_t minMs = PACE_MIN_MS_DEFAULT;
+  uint32_t maxMs = PACE_MAX_MS_DEFAULT;
+  int channel = 0;
+  float noise = 0.0f;
+  uint64_t seed = 1;
+  bool frames = false;
+  bool quiet = false;
+};
+
+struct Stats {
+  uint32_t samples = 0;   // Conversions
+  uint32_t reports = 0;   // Readings the chirp logic saw
+  uint32_t chirpsUp = 0;
+  uint32_t chirpsDown = 0;
+  uint32_t falseChirps = 0;
+  uint32_t missed = 0;
+  uint32_t latencyCount = 0;
+  uint64_t latencySumMs = 0;
+  uint32_t latencyMaxMs = 0;
+  uint32_t frames = 0;
+  uint64_t biasUs = 0;    // Time the bias current was on
+};
+
+// Tracks which bands the true temperature is in and when it entered them
+class Truth {
+public:
+  Truth(float threshold, float step) : threshold(threshold), step(step), band(-1) {
+    for (int b = 0; b < MAX_BANDS; b++) {
+      enteredMs[b] = 0;
+      chirped[b] = true;   // Nothing to miss yet
+    }
+  }
+
+  void advance(uint32_t ms, float temp, Stats& stats) {
+    int now = bandForTemp(temp, threshold, step);
+    if (now >= MAX_BANDS) now = MAX_BANDS - 1;
+    for (int b = band + 1; b <= now; b++) {
+      if (b < 0) continue;
+      enteredMs[b] = ms;
+      chirped[b] = false;
+    }
+    for (int b = band; b > now && b >= 0; b--) {
+      if (!chirped[b]) stats.missed++;
+      chirped[b] = true;
+    }
+    band = now;
+  }
+
+  int current() const { return band; }
+  uint32_t entered(int b) const { return enteredMs[b]; }
+  bool wasChirped(int b) const { return chirped[b]; }
+  void markChirped(int b) { chirped[b] = true; }
+
+private:
+  float threshold, step;
+  int band;
+  uint32_t enteredMs[MAX_BANDS];
+  bool chirped[MAX_BANDS];
+};
+
+static void run(Trace& trace, const Options& opt, Stats& stats) {
+  ChirpBands bands;
+  SimDisplay display;
+  Truth truth(opt.threshold, opt.step);
+  Noise noise(opt.noise, opt.seed);
+
+  float currentTempC = 0.0f;
+  uint32_t truthMs = 0;
+  unsigned long lastTempRead = 0;
+  bool firstRead = true;
+  char shown[16];
+  uint64_t nextConversionUs = RTD_CONVERSION_US;
+  float sum = 0.0f;
+  uint32_t count = 0;
+  SamplePacer pacer;
+  pacer.setLimits(opt.minMs, opt.maxMs);
+  uint32_t periodMs = opt.adaptive ? pacer.interval() : opt.periodMs;
+  bool paced = false;           // --adaptive: one-shot per period, bias off between
+  uint64_t pacedDueUs = 0;      // Paced: result ready then (cycle started RTD_PACED_US before)
+  uint64_t lastPassUs = 0;
+
+  while (millis() < trace.length()) {
+    // Truth at 1ms resolution up to now, so band entry times are exact
+    while (truthMs <= millis() && truthMs <= trace.length()) {
+      truth.advance(truthMs, trace.at(truthMs), stats);
+      truthMs++;
+    }
+
+    // Auto conversions finish on their own; readChannels() collects them each pass
+    uint64_t nowUs = mockBusNs / 1000;
+    if (!opt.oneShot && !paced) stats.biasUs += nowUs - lastPassUs;
+    lastPassUs = nowUs;
+    while (!opt.oneShot && !paced && nextConversionUs <= nowUs) {
+      sum += trace.at((uint32_t)(nextConversionUs / 1000)) + noise.next();
+      count++;
+      stats.samples++;
+      nextConversionUs += RTD_CONVERSION_US;
+    }
+
+    bool report = false;
+    if (opt.oneShot && (firstRead || millis() - lastTempRead >= opt.periodMs)) {
+      firstRead = false;
+      lastTempRead = millis();
+
+      // The conversion starts now but the value is only back 75ms later
+      float measured = trace.at(lastTempRead) + noise.next();
+      delay(RTD_READ_MS);
+      currentTempC = measured;
+      stats.samples++;
+      report = true;
+    }
+    if (paced && pacedDueUs <= nowUs) {
+      // poll() picks the one-shot up; the next cycle starts a period after this one did
+      currentTempC = trace.at((uint32_t)(pacedDueUs / 1000)) + noise.next();
+      stats.samples++;
+      stats.biasUs += RTD_PACED_US;
+      lastTempRead = millis();
+      report = true;
+    } else if (!opt.oneShot && !paced && millis() - lastTempRead >= periodMs) {
+      lastTempRead = millis();
+      if (count > 0) {
+        currentTempC = sum / count;
+        sum = 0.0f;
+        count = 0;
+        report = true;
+      }
+    }
+
+    if (report) {
+      stats.reports++;
+      if (opt.adaptive) {
+        // readChannels(): next interval, and RtdChannels::setInterval()
+        uint64_t cycleUs = paced ? pacedDueUs - RTD_PACED_US : nowUs;
+        periodMs = pacer.pace(currentTempC, millis(), bandEdgeDistance(currentTempC, opt.threshold, opt.step),
+                              nearBands(currentTempC, opt.threshold, opt.step));
+        bool wasPaced = paced;
+        paced = periodMs >= RTD_PACED_MIN_MS;
+        if (paced) {
+          uint64_t startUs = wasPaced ? cycleUs + periodMs * 1000ULL : nowUs;
+          if (startUs < nowUs) startUs = nowUs;
+          pacedDueUs = startUs + RTD_PACED_US;
+        } else if (wasPaced) {
+          nextConversionUs = nowUs + RTD_CONVERSION_US;
+          sum = 0.0f;
+          count = 0;
+        }
+      }
+
+      // handleAudioLogic()
+      ChirpEvent event = bands.update(currentTempC, opt.threshold, opt.step);
+      if (event != CHIRP_NONE) {
+        uint32_t now = millis();
+        int b = bands.band();
+        if (b >= MAX_BANDS) b = MAX_BANDS - 1;
+        bool justified;
+
+        if (event == CHIRP_UP) {
+          stats.chirpsUp++;
+          justified = truth.current() >= b && !truth.wasChirped(b);
+          if (justified) {
+            uint32_t latency = now - truth.entered(b);
+            stats.latencyCount++;
+            stats.latencySumMs += latency;
+            if (latency > stats.latencyMaxMs) stats.latencyMaxMs = latency;
+          }
+          // Later bands crossed in the same step are covered by this chirp
+          for (int k = b; k >= 0 && k <= truth.current() && !truth.wasChirped(k); k--) {
+            truth.markChirped(k);
+          }
+        } else {
+          stats.chirpsDown++;
+          justified = truth.current() <= b;
+        }
+        if (!justified) stats.falseChirps++;
+
+        if (!opt.quiet) {
+          printf("%10lu  chirp %-4s band %3d  read %8.3f  true %8.3f%s\n", (unsigned long)now,
+                 event == CHIRP_UP ? "up" : "down", b, currentTempC, trace.at(now),
+                 justified ? "" : "  FALSE");
+        }
+        if (event == CHIRP_UP) delay(CHIRP_UP_MS);
+      }
+    }
+
+    // Display, as in loop(): Err for an open sensor, otherwise the reading
+    if (currentTempC < -200) {
+      display.displayText("Err");
+    } else {
+      display.displayFixed(displayTenths(currentTempC), 1);
+    }
+    if (display.changed) {
+      display.changed = false;
+      stats.frames++;
+      if (opt.frames && !opt.quiet) {
+        display.text(shown);
+        printf("%10lu  display [%s]\n", millis(), shown);
+      }
+    }
+
+    delay(LOOP_DELAY_MS);
+  }
+}
+
+static void usage() {
+  fprintf(stderr,
+          "usage: chirp_sim [options] (TRACE.csv | --ramp FROM TO MINUTES)\n"
+          "  --threshold C   chirp threshold (default %.1f)\n"
+          "  --step C        band width (default %.1f)\n"
+          "  --period MS     report period (default %d)\n"
+          "  --oneshot       blocking one-shot reads, as before auto conversion\n"
+          "  --adaptive LO HI report period chosen by SamplePacer, LO..HI ms\n"
+          "  --channel N     probe to take from a CSV trace (default 0)\n"
+          "  --noise C       sensor noise, standard deviation (default 0)\n"
+          "  --seed N        noise seed (default 1)\n"
+          "  --frames        print display frames as well as chirps\n"
+          "  --quiet         summary only\n",
+          THRESHOLD_DEFAULT, STEP_DEFAULT, READ_PERIOD_MS);
+  exit(2);
+}
+
+int main(int argc, char** argv) {
+  Options opt;
+  const char* csvPath = NULL;
+  bool ramp = false;
+  float rampFrom = 0, rampTo = 0, rampMinutes = 0;
+
+  for (int i = 1; i < argc; i++) {
+    const char* a = argv[i];
+    bool hasValue = i + 1 < argc;
+    if (!strcmp(a, "--threshold") && hasValue) opt.threshold = atof(argv[++i]);
+    else if (!strcmp(a, "--step") && hasValue) opt.step = atof(argv[++i]);
+    else if (!strcmp(a, "--period") && hasValue) opt.periodMs = strtoul(argv[++i], NULL, 10);
+    else if (!strcmp(a, "--noise") && hasValue) opt.noise = atof(argv[++i]);
+    else if (!strcmp(a, "--seed") && hasValue) opt.seed = strtoull(argv[++i], NULL, 10);
+    else if (!strcmp(a, "--oneshot")) opt.oneShot = true;
+    else if (!strcmp(a, "--adaptive") && i + 2 < argc) {
+      opt.adaptive = true;
+      opt.minMs = strtoul(argv[++i], NULL, 10);
+      opt.maxMs = strtoul(argv[++i], NULL, 10);
+    }
+    else if (!strcmp(a, "--channel") && hasValue) opt.channel = atoi(argv[++i]);
+    else if (!strcmp(a, "--frames")) opt.frames = true;
+    else if (!strcmp(a, "--quiet")) opt.quiet = true;
+    else if (!strcmp(a, "--ramp") && i + 3 < argc) {
+      ramp = true;
+      rampFrom = atof(argv[++i]);
+      rampTo = atof(argv[++i]);
+      rampMinutes = atof(argv[++i]);
+    }
+    else if (a[0] != '-' && csvPath == NULL) csvPath = a;
+    else usage();
+  }
+  if (ramp == (csvPath != NULL) || opt.step <= 0.0f || opt.periodMs == 0) usage();
+  if (ramp && rampMinutes <= 0.0f) usage();
+  if (opt.adaptive && opt.oneShot) usage();
+
+  CsvTrace csv;
+  RampTrace rampTrace(rampFrom, rampTo, rampMinutes);
+  Trace* trace = &rampTrace;
+  if (csvPath != NULL) {
+    if (!csv.load(csvPath, opt.channel)) {
+      fprintf(stderr, "chirp_sim: can't read a trace from %s\n", csvPath);
+      return 1;
+    }
+    trace = &csv;
+  }
+
+  Stats stats;
+  clock_t start = clock();
+  run(*trace, opt, stats);
+  double wall = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+  double simulated = trace->length() / 1000.0;
+  double hours = simulated / 3600.0;
+  char period[40];
+  if (opt.adaptive) snprintf(period, sizeof(period), "adaptive %lu-%lu ms", (unsigned long)opt.minMs,
+                             (unsigned long)opt.maxMs);
+  else snprintf(period, sizeof(period), "period %lu ms%s", (unsigned long)opt.periodMs,
+                opt.oneShot ? " (one-shot)" : "");
+  printf("\nthreshold %.2f C, step %.2f C, %s, noise %.3f C, seed %llu\n", opt.threshold, opt.step, period,
+         opt.noise, (unsigned long long)opt.seed);
+  printf("simulated %.1f s in %.3f s (%.0fx real time)\n", simulated, wall, wall > 0 ? simulated / wall : 0.0);
+  printf("samples %u (%.1f/s), readings %u, display frames %u, bias on %.1f%%\n", stats.samples,
+         simulated > 0 ? stats.samples / simulated : 0.0, stats.reports, stats.frames,
+         simulated > 0 ? stats.biasUs / 1e4 / simulated : 0.0);
+  printf("chirps up %u, down %u, false %u (%.1f/hour), missed bands %u\n", stats.chirpsUp, stats.chirpsDown,
+         stats.falseChirps, hours > 0 ? stats.falseChirps / hours : 0.0, stats.missed);
+  if (stats.latencyCount > 0) {
+    printf("latency mean %.0f ms, max %u ms over %u bands\n",
+           (double)stats.latencySumMs / stats.latencyCount, stats.latencyMaxMs, stats.latencyCount);
+  }
+  return 0;
+}
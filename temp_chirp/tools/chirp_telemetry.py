@@ -0,0 +1,243 @@
+#!/usr/bin/env python3
+"""
+Record, decode and replay temp_chirp binary telemetry (see telemetry.h).
+
+  record PORT OUT.bin        Save the raw COBS stream from the USB CDC port
+                             (needs pyserial). Ctrl-C to stop.
+  decode IN.bin [OUT.csv]    Decode a recording to CSV (stdout by default):
+                             ms,rtd,temp_c,fault,band,channel
+  replay IN.bin [--speed N]  Print samples with their original spacing,
+                             N times faster (default 1, 0 = no waiting)
+  cmd PORT LINE...           Send console commands (see temp_chirp.ino, e.g.
+                             "rules", "add 1 below 165") and print the replies
+  stats IN.bin               Frame, sample, CRC-error and dropped-frame counts,
+                             and samples/s per channel and in total
+
+Recordings are the raw byte stream, so they can always be re-decoded if the
+decoder changes. The CSV is the trace format the offline tools read.
+"""
+
+import argparse
+import struct
+import sys
+import time
+
+VERSION = 2
+TYPE_SAMPLES = 1
+TYPE_TEXT = 2
+HEADER = struct.Struct("<BBHB")
+# Version 1 had no channel byte; its samples are all channel 0
+SAMPLES = {1: struct.Struct("<IHiBb"), 2: struct.Struct("<IHiBbB")}
+CRC = struct.Struct("<H")
+
+
+def crc16(data):
+    """CRC-16/CCITT-FALSE, matching telemetryCrc16()."""
+    crc = 0xFFFF
+    for byte in data:
+        crc ^= byte << 8
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x1021) if crc & 0x8000 else (crc << 1)
+            crc &= 0xFFFF
+    return crc
+
+
+def cobs_decode(data):
+    out = bytearray()
+    i = 0
+    while i < len(data):
+        code = data[i]
+        if code == 0 or i + code > len(data) + 1:
+            raise ValueError("bad COBS code")
+        out += data[i + 1:i + code]
+        i += code
+        if code < 0xFF and i < len(data):
+            out.append(0)
+    return bytes(out)
+
+
+class Decoder:
+    """Feed raw bytes, get back decoded samples. Resyncs on every 0x00."""
+
+    def __init__(self, on_text=None):
+        self.on_text = on_text
+        self.buf = bytearray()
+        self.frames = 0
+        self.samples = 0
+        self.crc_errors = 0
+        self.dropped = 0
+        self.last_seq = None
+
+    def feed(self, data):
+        self.buf += data
+        while True:
+            end = self.buf.find(b"\x00")
+            if end < 0:
+                return
+            chunk = bytes(self.buf[:end])
+            del self.buf[:end + 1]
+            if chunk:
+                yield from self._frame(chunk)
+
+    def _frame(self, chunk):
+        try:
+            frame = cobs_decode(chunk)
+        except ValueError:
+            self.crc_errors += 1
+            return
+        if len(frame) < HEADER.size + CRC.size:
+            self.crc_errors += 1
+            return
+        body, (crc,) = frame[:-CRC.size], CRC.unpack(frame[-CRC.size:])
+        if crc16(body) != crc:
+            self.crc_errors += 1
+            return
+
+        version, ftype, seq, count = HEADER.unpack_from(body)
+        sample = SAMPLES.get(version)
+        if sample is None or ftype not in (TYPE_SAMPLES, TYPE_TEXT):
+            return
+        size = count if ftype == TYPE_TEXT else count * sample.size
+        if len(body) != HEADER.size + size:
+            self.crc_errors += 1
+            return
+
+        if self.last_seq is not None:
+            self.dropped += (seq - self.last_seq - 1) & 0xFFFF
+        self.last_seq = seq
+        self.frames += 1
+
+        if ftype == TYPE_TEXT:
+            if self.on_text:
+                self.on_text(body[HEADER.size:].decode("utf-8", "replace"))
+            return
+
+        for i in range(count):
+            fields = sample.unpack_from(body, HEADER.size + i * sample.size)
+            ms, rtd, temp_milli, fault, band = fields[:5]
+            channel = fields[5] if len(fields) > 5 else 0
+            self.samples += 1
+            yield ms, rtd, temp_milli / 1000.0, fault, band, channel
+
+
+def read_samples(path):
+    decoder = Decoder()
+    with open(path, "rb") as f:
+        while True:
+            data = f.read(4096)
+            if not data:
+                break
+            yield from decoder.feed(data)
+    read_samples.decoder = decoder
+
+
+def cmd_record(args):
+    import serial  # pyserial
+
+    decoder = Decoder()
+    with serial.Serial(args.port, 115200, timeout=0.2) as port, open(args.out, "wb") as out:
+        print(f"Recording {args.port} -> {args.out} (Ctrl-C to stop)", file=sys.stderr)
+        try:
+            while True:
+                data = port.read(4096)
+                if not data:
+                    continue
+                out.write(data)
+                for _ in decoder.feed(data):
+                    pass
+                print(f"\r{decoder.samples} samples, {decoder.frames} frames, "
+                      f"{decoder.dropped} dropped, {decoder.crc_errors} bad", end="", file=sys.stderr)
+        except KeyboardInterrupt:
+            print(file=sys.stderr)
+
+
+def cmd_cmd(args):
+    import serial  # pyserial
+
+    decoder = Decoder(on_text=lambda text: print(text, end="", flush=True))
+    with serial.Serial(args.port, 115200, timeout=0.2) as port:
+        for line in args.lines:
+            port.write(line.encode() + b"\n")
+            deadline = time.monotonic() + args.wait
+            while time.monotonic() < deadline:
+                for _ in decoder.feed(port.read(4096)):
+                    pass
+
+
+def cmd_decode(args):
+    out = open(args.out, "w") if args.out else sys.stdout
+    out.write("ms,rtd,temp_c,fault,band,channel\n")
+    for ms, rtd, temp_c, fault, band, channel in read_samples(args.input):
+        out.write(f"{ms},{rtd},{temp_c:.3f},{fault},{band},{channel}\n")
+    if out is not sys.stdout:
+        out.close()
+
+
+def cmd_replay(args):
+    start_ms = None
+    start_wall = time.monotonic()
+    for ms, rtd, temp_c, fault, band, channel in read_samples(args.input):
+        if start_ms is None:
+            start_ms = ms
+        if args.speed > 0:
+            due = start_wall + ((ms - start_ms) & 0xFFFFFFFF) / 1000.0 / args.speed
+            delay = due - time.monotonic()
+            if delay > 0:
+                time.sleep(delay)
+        flags = f" fault=0x{fault:02X}" if fault else ""
+        print(f"{ms:>10} ch{channel} {temp_c:8.3f} C  rtd={rtd:5d}  band={band:3d}{flags}", flush=True)
+
+
+def cmd_stats(args):
+    per_channel = {}
+    first_ms = last_ms = None
+    for ms, _, _, _, _, channel in read_samples(args.input):
+        per_channel[channel] = per_channel.get(channel, 0) + 1
+        if first_ms is None:
+            first_ms = ms
+        last_ms = ms
+    d = read_samples.decoder
+    print(f"frames={d.frames} samples={d.samples} dropped_frames={d.dropped} bad_frames={d.crc_errors}")
+
+    span = ((last_ms - first_ms) & 0xFFFFFFFF) / 1000.0 if first_ms is not None else 0
+    if span > 0:
+        for channel in sorted(per_channel):
+            print(f"channel {channel}: {per_channel[channel] / span:.1f} samples/s")
+        print(f"{len(per_channel)} channels: {d.samples / span:.1f} samples/s aggregate")
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    sub = parser.add_subparsers(dest="cmd", required=True)
+
+    p = sub.add_parser("record")
+    p.add_argument("port")
+    p.add_argument("out")
+    p.set_defaults(func=cmd_record)
+
+    p = sub.add_parser("cmd")
+    p.add_argument("port")
+    p.add_argument("lines", nargs="+")
+    p.add_argument("--wait", type=float, default=1.0, help="seconds to collect replies per command")
+    p.set_defaults(func=cmd_cmd)
+
+    p = sub.add_parser("decode")
+    p.add_argument("input")
+    p.add_argument("out", nargs="?")
+    p.set_defaults(func=cmd_decode)
+
+    p = sub.add_parser("replay")
+    p.add_argument("input")
+    p.add_argument("--speed", type=float, default=1.0)
+    p.set_defaults(func=cmd_replay)
+
+    p = sub.add_parser("stats")
+    p.add_argument("input")
+    p.set_defaults(func=cmd_stats)
+
+    args = parser.parse_args()
+    args.func(args)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,32 @@
+/*
+ * Mock Adafruit_MAX31865 for the host benches. Only what rtd_channels.h
+ * calls; autoConvert(true) notes when each chip (by CS pin) started
+ * converting, so a bench can model its DRDY line.
+ */
+
+#ifndef MOCK_ADAFRUIT_MAX31865_H
+#define MOCK_ADAFRUIT_MAX31865_H
+
+#include <Arduino.h>
+
+typedef enum { MAX31865_2WIRE = 0, MAX31865_3WIRE = 1, MAX31865_4WIRE = 0 } max31865_numwires_t;
+
+inline uint64_t mockConversionStartNs[64];   // By CS pin; 0 = not converting
+
+class Adafruit_MAX31865 {
+public:
+  explicit Adafruit_MAX31865(int8_t cs) : cs(cs) {}
+  bool begin(max31865_numwires_t = MAX31865_2WIRE) { return true; }
+  uint16_t readRTD() { return 8192; }   // ~107.5 ohms with a 430 ohm reference
+  void enableBias(bool) {}
+  void autoConvert(bool on) { mockConversionStartNs[cs] = on ? mockBusNs : 0; }
+  float calculateTemperature(uint16_t rtd, float nominal, float reference) {
+    float ohms = rtd * reference / 32768.0f;
+    return (ohms / nominal - 1.0f) / 0.00385f;
+  }
+
+private:
+  int8_t cs;
+};
+
+#endif // MOCK_ADAFRUIT_MAX31865_H